@@ -80,6 +80,10 @@ public:
 		FmtChkFlag_ALL        = -1
 	};
 
+	// Source frames already fetched by the caller, indexed by ClipIdx. The
+	// missing ones are fetched from the clips.
+	typedef std::array <::PVideoFrame, ClipIdx_NBR_ELT> FrameArray;
+
 	explicit       PlaneProcessor (const ::VideoInfo &vi, PlaneProcCbInterface &cb, bool manual_flag);
 	virtual        ~PlaneProcessor () = default;
 
@@ -93,7 +97,7 @@ public:
 
 	int            get_nbr_planes () const;
 
-	void           process_frame (::PVideoFrame &dst_sptr, int n, ::IScriptEnvironment &env, void *ctx_ptr);
+	void           process_frame (::PVideoFrame &dst_sptr, int n, ::IScriptEnvironment &env, void *ctx_ptr, const FrameArray *src_arr_ptr = nullptr);
 	const ::VideoInfo &
 	               use_vi (ClipIdx index) const;
 	int            get_plane_id (int plane_index, ClipIdx index) const;
@@ -104,7 +108,7 @@ public:
 	bool           is_manual () const;
 	PlaneProcMode  get_mode (int plane_index) const;
 	double         get_fill_val (int plane_index) const;
-	void           process_plane_default (::PVideoFrame &dst_sptr, int n, ::IScriptEnvironment &env, int plane_index);
+	void           process_plane_default (::PVideoFrame &dst_sptr, int n, ::IScriptEnvironment &env, int plane_index, const FrameArray *src_arr_ptr = nullptr);
 	void           fill_plane (::PVideoFrame &dst_sptr, int n, double val, int plane_index);
 	void           copy_plane (::PVideoFrame &dst_sptr, ClipIdx clip_idx, int n, int plane_index, ::IScriptEnvironment &env);
 
@@ -135,7 +139,7 @@ private:
 	};
 
 	void           fill (::PVideoFrame &dst_sptr, int n, int plane_index, float val);
-	void           copy (::PVideoFrame &dst_sptr, int n, int plane_index, ClipIdx src_idx, ::IScriptEnvironment &env);
+	void           copy (::PVideoFrame &dst_sptr, int n, int plane_index, ClipIdx src_idx, ::IScriptEnvironment &env, const FrameArray *src_arr_ptr = nullptr);
 
 	const ::VideoInfo & // For the destination clip. May be changed during the filter setup.
 	               _vi;
@@ -207,7 +207,8 @@ int	PlaneProcessor::get_nbr_planes () const
 
 
 
-void	PlaneProcessor::process_frame (::PVideoFrame &dst_sptr, int n, ::IScriptEnvironment &env, void *ctx_ptr)
+// src_arr_ptr: optional source frames, to avoid fetching them again
+void	PlaneProcessor::process_frame (::PVideoFrame &dst_sptr, int n, ::IScriptEnvironment &env, void *ctx_ptr, const FrameArray *src_arr_ptr)
 {
 	assert (dst_sptr != nullptr);
 	assert (dst_sptr->IsWritable ());
@@ -226,7 +227,7 @@ void	PlaneProcessor::process_frame (::PVideoFrame &dst_sptr, int n, ::IScriptEnv
 		}
 		else
 		{
-			process_plane_default (dst_sptr, n, env, plane_index);
+			process_plane_default (dst_sptr, n, env, plane_index, src_arr_ptr);
 		}
 	}
 }
@@ -326,7 +327,7 @@ double	PlaneProcessor::get_fill_val (int plane_index) const
 
 
 
-void	PlaneProcessor::process_plane_default (::PVideoFrame &dst_sptr, int n, ::IScriptEnvironment &env, int plane_index)
+void	PlaneProcessor::process_plane_default (::PVideoFrame &dst_sptr, int n, ::IScriptEnvironment &env, int plane_index, const FrameArray *src_arr_ptr)
 {
 	assert (plane_index >= 0);
 	assert (plane_index < _nbr_planes);
@@ -352,7 +353,7 @@ void	PlaneProcessor::process_plane_default (::PVideoFrame &dst_sptr, int n, ::IS
 		const ClipIdx     src_index = burp [mode_i];
 		if (_clip_info_arr [src_index]._clip_sptr)
 		{
-			copy (dst_sptr, n, plane_index, src_index, env);
+			copy (dst_sptr, n, plane_index, src_index, env, src_arr_ptr);
 		}
 	}
 
@@ -632,7 +633,7 @@ void	PlaneProcessor::fill (::PVideoFrame &dst_sptr, int n, int plane_index, floa
 
 
 
-void	PlaneProcessor::copy (::PVideoFrame &dst_sptr, int n, int plane_index, ClipIdx src_idx, ::IScriptEnvironment &env)
+void	PlaneProcessor::copy (::PVideoFrame &dst_sptr, int n, int plane_index, ClipIdx src_idx, ::IScriptEnvironment &env, const FrameArray *src_arr_ptr)
 {
 	assert (dst_sptr != nullptr);
 	assert (n >= 0);
@@ -655,7 +656,15 @@ void	PlaneProcessor::copy (::PVideoFrame &dst_sptr, int n, int plane_index, Clip
 	assert (src_clip);
 	n = std::min (n, src_clip->GetVideoInfo ().num_frames - 1);
 
-	::PVideoFrame  src_sptr     = src_clip->GetFrame (n, &env);
+	::PVideoFrame  src_sptr;
+	if (src_arr_ptr != nullptr)
+	{
+		src_sptr = (*src_arr_ptr) [src_idx];
+	}
+	if (! src_sptr)
+	{
+		src_sptr = src_clip->GetFrame (n, &env);
+	}
 	const int      plane_id_s   = get_plane_id (plane_index, src_idx);
 	const int      src_stride   = src_sptr->GetPitch (plane_id_s);
 	const int      src_width    = get_width (src_sptr, plane_id_s, src_idx);
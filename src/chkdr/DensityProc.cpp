@@ -0,0 +1,138 @@
+/*****************************************************************************
+
+        DensityProc.cpp
+        Author: Laurent de Soras, 2022
+
+--- Legal stuff ---
+
+This program is free software. It comes without any warranty, to
+the extent permitted by applicable law. You can redistribute it
+and/or modify it under the terms of the Do What The Fuck You Want
+To Public License, Version 2, as published by Sam Hocevar. See
+http://sam.zoy.org/wtfpl/COPYING for more details.
+
+*Tab=3***********************************************************************/
+
+
+
+
+/*\\\ INCLUDE FILES \\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\*/
+
+#include "chkdr/DensityProc.h"
+#include "chkdr/GrainProc.h"
+
+#include <cassert>
+#include <cstring>
+
+
+
+namespace chkdr
+{
+
+
+
+/*\\\ PUBLIC \\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\*/
+
+
+
+// Parameters have the same meaning as in GrainProc
+DensityProc::DensityProc (float rad, float dev, uint32_t seed, bool cf_flag, bool cp_flag, bool simd4_flag)
+:	_simd4_flag (simd4_flag)
+,	_rad (rad)
+,	_dev (dev)
+,	_seed_base (seed)
+,	_cf_flag (cf_flag)
+,	_cp_flag (cp_flag)
+{
+	assert (GrainProc::check_rad (rad));
+	assert (GrainProc::check_dev (dev));
+}
+
+
+
+// The destination receives the int32_t grain counts.
+// Strides in bytes
+void	DensityProc::process_plane (uint8_t *dst_ptr, ptrdiff_t dst_stride, const uint8_t *src_ptr, ptrdiff_t src_stride, int w, int h, int frame_idx, int plane_idx)
+{
+	assert (dst_ptr != nullptr);
+	assert (src_ptr != nullptr);
+	assert (w > 0);
+	assert (h > 0);
+	assert (frame_idx >= 0);
+	assert (plane_idx >= 0);
+
+	// Recycles a processor from the pool or creates a new one if empty
+	DensityUPtr    proc_uptr;
+	{
+		std::lock_guard <std::mutex> lock (_mtx_pool);
+		if (_proc_pool.empty ())
+		{
+			proc_uptr = std::make_unique <fgrn::GrainDensity> (_simd4_flag);
+		}
+		else
+		{
+			proc_uptr = std::move (_proc_pool.back ());
+			_proc_pool.pop_back ();
+		}
+	}
+
+	const auto     seed = compute_seed (frame_idx, plane_idx);
+	proc_uptr->reset (
+		w, h, _rad, _dev, seed, fgrn::GrainDensity::Output_NONE
+	);
+	proc_uptr->process_area (
+		0, h,
+		reinterpret_cast <const float *> (src_ptr),
+		src_stride / ptrdiff_t (sizeof (float)),
+		nullptr, 0
+	);
+
+	const auto     res = proc_uptr->get_result ();
+	const auto     len = size_t (w) * sizeof (int32_t);
+	for (int y = 0; y < h; ++y)
+	{
+		memcpy (dst_ptr + y * dst_stride, res._q_ptr + y * res._stride, len);
+	}
+
+	std::lock_guard <std::mutex> lock (_mtx_pool);
+	_proc_pool.push_back (std::move (proc_uptr));
+}
+
+
+
+uint32_t	DensityProc::compute_seed (int frame_idx, int plane_idx) const noexcept
+{
+	return GrainProc::make_seed (
+		_seed_base, _cf_flag, _cp_flag, frame_idx, plane_idx
+	);
+}
+
+
+
+float	DensityProc::get_rad () const noexcept
+{
+	return _rad;
+}
+
+
+
+float	DensityProc::get_dev () const noexcept
+{
+	return _dev;
+}
+
+
+
+/*\\\ PROTECTED \\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\*/
+
+
+
+/*\\\ PRIVATE \\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\*/
+
+
+
+}  // namespace chkdr
+
+
+
+/*\\\ EOF \\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\*/
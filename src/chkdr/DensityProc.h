@@ -0,0 +1,122 @@
+/*****************************************************************************
+
+        DensityProc.h
+        Author: Laurent de Soras, 2022
+
+Computes the grain count maps (first pass of the rendering) for whole
+planes. The result can be rendered later with GrainProc::process_density(),
+possibly several times with different vision filters.
+All functions are thread-safe.
+
+--- Legal stuff ---
+
+This program is free software. It comes without any warranty, to
+the extent permitted by applicable law. You can redistribute it
+and/or modify it under the terms of the Do What The Fuck You Want
+To Public License, Version 2, as published by Sam Hocevar. See
+http://sam.zoy.org/wtfpl/COPYING for more details.
+
+*Tab=3***********************************************************************/
+
+
+
+#pragma once
+#if ! defined (chkdr_DensityProc_HEADER_INCLUDED)
+#define chkdr_DensityProc_HEADER_INCLUDED
+
+
+
+/*\\\ INCLUDE FILES \\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\*/
+
+#include "fgrn/GrainDensity.h"
+
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include <cstddef>
+#include <cstdint>
+
+
+
+namespace chkdr
+{
+
+
+
+class DensityProc
+{
+
+/*\\\ PUBLIC \\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\*/
+
+public:
+
+	explicit       DensityProc (float rad, float dev, uint32_t seed, bool cf_flag, bool cp_flag, bool simd4_flag);
+	virtual        ~DensityProc () {}
+
+	void           process_plane (uint8_t *dst_ptr, ptrdiff_t dst_stride, const uint8_t *src_ptr, ptrdiff_t src_stride, int w, int h, int frame_idx, int plane_idx);
+	uint32_t       compute_seed (int frame_idx, int plane_idx) const noexcept;
+
+	float          get_rad () const noexcept;
+	float          get_dev () const noexcept;
+
+
+
+/*\\\ PROTECTED \\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\*/
+
+protected:
+
+
+
+/*\\\ PRIVATE \\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\*/
+
+private:
+
+	typedef std::unique_ptr <fgrn::GrainDensity> DensityUPtr;
+
+	bool           _simd4_flag = false;
+
+	// Grain radius average value in pixels and standard deviation
+	float          _rad        = 0;
+	float          _dev        = 0;
+
+	uint32_t       _seed_base  = 0;
+	bool           _cf_flag    = false;
+	bool           _cp_flag    = false;
+
+	// Mutex to lock before accessing the processor pool
+	std::mutex     _mtx_pool;
+	std::vector <DensityUPtr>
+	               _proc_pool;
+
+
+
+/*\\\ FORBIDDEN MEMBER FUNCTIONS \\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\*/
+
+private:
+
+	               DensityProc ()                               = delete;
+	               DensityProc (const DensityProc &other)       = delete;
+	               DensityProc (DensityProc &&other)            = delete;
+	DensityProc &  operator = (const DensityProc &other)        = delete;
+	DensityProc &  operator = (DensityProc &&other)             = delete;
+	bool           operator == (const DensityProc &other) const = delete;
+	bool           operator != (const DensityProc &other) const = delete;
+
+}; // class DensityProc
+
+
+
+}  // namespace chkdr
+
+
+
+//#include "chkdr/DensityProc.hpp"
+
+
+
+#endif   // chkdr_DensityProc_HEADER_INCLUDED
+
+
+
+/*\\\ EOF \\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\*/
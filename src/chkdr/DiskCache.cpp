@@ -0,0 +1,655 @@
+/*****************************************************************************
+
+        DiskCache.cpp
+        Author: Laurent de Soras, 2022
+
+--- Legal stuff ---
+
+This program is free software. It comes without any warranty, to
+the extent permitted by applicable law. You can redistribute it
+and/or modify it under the terms of the Do What The Fuck You Want
+To Public License, Version 2, as published by Sam Hocevar. See
+http://sam.zoy.org/wtfpl/COPYING for more details.
+
+*Tab=3***********************************************************************/
+
+
+
+
+/*\\\ INCLUDE FILES \\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\*/
+
+#include "chkdr/DiskCache.h"
+#include "fstb/fnc.h"
+#include "fstb/Hash.h"
+
+#if fstb_SYS == fstb_SYS_WIN
+	#define NOMINMAX
+	#define NOGDI
+	#define WIN32_LEAN_AND_MEAN
+	#include <Windows.h>
+	#include <sys/types.h>
+	#include <sys/utime.h>
+#else
+	#include <dirent.h>
+	#include <fcntl.h>
+	#include <sys/mman.h>
+	#include <sys/stat.h>
+	#include <sys/types.h>
+	#include <unistd.h>
+	#include <utime.h>
+#endif
+
+#include <algorithm>
+
+#include <cassert>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+
+
+
+namespace chkdr
+{
+
+
+
+/*\\\ PUBLIC \\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\*/
+
+
+
+// dir: existing directory. Empty string disables the cache.
+// budget: maximum total size of the files in bytes. 0 disables the cache.
+// param_hash: identifies the rendering parameters. Entries with different
+// parameters may share the same directory, each set of parameters has its
+// own budget.
+// The directory content is scanned, and the oldest files with the same
+// parameters are deleted if the budget is exceeded.
+DiskCache::DiskCache (const std::string &dir, int64_t budget, uint64_t param_hash)
+:	_budget (budget)
+,	_param_hash (param_hash)
+{
+	assert (budget >= 0);
+
+	if (dir.empty () || budget <= 0)
+	{
+		return;
+	}
+
+	_dir = add_separator (dir);
+	FileInfoList   file_list;
+	if (! list_files (file_list, _dir, build_prefix ()))
+	{
+		_dir.clear ();
+		return;
+	}
+
+	// Most recently used first
+	std::stable_sort (
+		file_list.begin (), file_list.end (),
+		[] (const FileInfo &lhs, const FileInfo &rhs) {
+			return (lhs._mtime > rhs._mtime);
+		}
+	);
+	for (const auto &info : file_list)
+	{
+		_lru_list.push_back (Entry { info._name, info._size });
+		_entry_map [info._name] = std::prev (_lru_list.end ());
+		_size += info._size;
+	}
+
+	std::lock_guard <std::mutex> lock (_mtx);
+	evict (_budget);
+}
+
+
+
+bool	DiskCache::is_enabled () const noexcept
+{
+	return (! _dir.empty ());
+}
+
+
+
+// Copies the stored planes into the destination planes of plane_arr.
+// Returns false if the entry was not found or is invalid.
+// Entries written by other processes are found too.
+bool	DiskCache::fetch (const Key &key, const fgrn::GenGrain::PlaneArray &plane_arr)
+{
+	assert (is_enabled ());
+
+	const auto     name      = build_name (key);
+	const auto     pathname  = build_pathname (name);
+	const auto     file_size = compute_file_size (key);
+
+	FileMap        file_map (pathname);
+	const auto     data_ptr  = file_map.get_ptr ();
+	if (data_ptr == nullptr || file_map.get_size () != file_size)
+	{
+		++ _nbr_misses;
+		return false;
+	}
+	Header         header;
+	memcpy (&header, data_ptr, sizeof (header));
+	if (! check_header (header, key))
+	{
+		++ _nbr_misses;
+		return false;
+	}
+
+	const int      h   = key._h;
+	const auto     len = size_t (key._w * key._dst_fmt.get_size ());
+	auto           src_ptr = data_ptr + sizeof (header);
+	for (int p_idx = 0; p_idx < key._nbr_planes; ++p_idx)
+	{
+		const auto &   plane = plane_arr [p_idx];
+		for (int y = 0; y < h; ++y)
+		{
+			memcpy (plane.use_dst_row (y), src_ptr, len);
+			src_ptr += len;
+		}
+	}
+	++ _nbr_hits;
+
+	// Keeps the usage order for the next sessions
+	touch_file (pathname);
+	std::lock_guard <std::mutex> lock (_mtx);
+	use_entry (name, file_size);
+
+	return true;
+}
+
+
+
+// Stores the destination planes of plane_arr. Failures are silently
+// ignored, the cache is not essential.
+void	DiskCache::store (const Key &key, const fgrn::GenGrain::PlaneArray &plane_arr)
+{
+	assert (is_enabled ());
+
+	const auto     file_size = compute_file_size (key);
+	if (file_size > _budget)
+	{
+		return;
+	}
+
+	const auto     name     = build_name (key);
+	const auto     pathname = build_pathname (name);
+	char           tmp_0 [63+1];
+	fstb::snprintf4all (
+		tmp_0, sizeof (tmp_0), ".tmp-%08x-%08x",
+		unsigned (get_process_id ()), unsigned (_tmp_cnt.fetch_add (1))
+	);
+	const auto     pathname_tmp = pathname + tmp_0;
+
+	Header         header;
+	header._magic      = _magic;
+	header._version    = _version;
+	header._param_hash = _param_hash;
+	header._key_hash   = key._hash;
+	header._key_chk    = key._hash_chk;
+	header._seed       = key._seed;
+	header._w          = key._w;
+	header._h          = key._h;
+	header._nbr_planes = key._nbr_planes;
+	header._fmt_id     = int32_t (key._dst_fmt.get_id ());
+
+	FILE *         f_ptr = fopen (pathname_tmp.c_str (), "wb");
+	if (f_ptr == nullptr)
+	{
+		return;
+	}
+	bool           ok_flag = (fwrite (&header, sizeof (header), 1, f_ptr) == 1);
+	const auto     len     = size_t (key._w * key._dst_fmt.get_size ());
+	for (int p_idx = 0; p_idx < key._nbr_planes && ok_flag; ++p_idx)
+	{
+		const auto &   plane = plane_arr [p_idx];
+		for (int y = 0; y < key._h && ok_flag; ++y)
+		{
+			ok_flag = (fwrite (plane.use_dst_row (y), 1, len, f_ptr) == len);
+		}
+	}
+	ok_flag &= (fclose (f_ptr) == 0);
+
+	// The final file may already exist (written by another process) and
+	// rename() does not replace it on every platform.
+	if (ok_flag && rename (pathname_tmp.c_str (), pathname.c_str ()) != 0)
+	{
+		remove (pathname.c_str ());
+		ok_flag = (rename (pathname_tmp.c_str (), pathname.c_str ()) == 0);
+	}
+	if (! ok_flag)
+	{
+		remove (pathname_tmp.c_str ());
+		return;
+	}
+
+	std::lock_guard <std::mutex> lock (_mtx);
+	use_entry (name, file_size);
+	evict (_budget);
+}
+
+
+
+int64_t	DiskCache::get_budget () const noexcept
+{
+	return _budget;
+}
+
+
+
+int64_t	DiskCache::get_size () const
+{
+	std::lock_guard <std::mutex> lock (_mtx);
+
+	return _size;
+}
+
+
+
+int	DiskCache::get_nbr_entries () const
+{
+	std::lock_guard <std::mutex> lock (_mtx);
+
+	return int (_lru_list.size ());
+}
+
+
+
+int64_t	DiskCache::get_nbr_hits () const noexcept
+{
+	return _nbr_hits.load ();
+}
+
+
+
+int64_t	DiskCache::get_nbr_misses () const noexcept
+{
+	return _nbr_misses.load ();
+}
+
+
+
+// Returns true if the directory exists and can be read.
+bool	DiskCache::check_dir (const std::string &dir)
+{
+	FileInfoList   file_list;
+
+	return (! dir.empty () && list_files (file_list, add_separator (dir), "chkdr-"));
+}
+
+
+
+/*\\\ PROTECTED \\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\*/
+
+
+
+/*\\\ PRIVATE \\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\*/
+
+
+
+// Returns a null pointer if the file cannot be mapped
+DiskCache::FileMap::FileMap (const std::string &pathname)
+{
+#if fstb_SYS == fstb_SYS_WIN
+
+	const auto     file_hnd = ::CreateFileA (
+		pathname.c_str (), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE,
+		nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr
+	);
+	if (file_hnd == INVALID_HANDLE_VALUE)
+	{
+		return;
+	}
+	_file_hnd = file_hnd;
+	::LARGE_INTEGER   size;
+	if (! ::GetFileSizeEx (file_hnd, &size) || size.QuadPart <= 0)
+	{
+		return;
+	}
+	_map_hnd = ::CreateFileMappingA (
+		file_hnd, nullptr, PAGE_READONLY, 0, 0, nullptr
+	);
+	if (_map_hnd == nullptr)
+	{
+		return;
+	}
+	_ptr = static_cast <const uint8_t *> (
+		::MapViewOfFile (_map_hnd, FILE_MAP_READ, 0, 0, 0)
+	);
+	if (_ptr != nullptr)
+	{
+		_size = int64_t (size.QuadPart);
+	}
+
+#else // fstb_SYS
+
+	const int      fd = ::open (pathname.c_str (), O_RDONLY);
+	if (fd < 0)
+	{
+		return;
+	}
+	struct ::stat  st;
+	if (::fstat (fd, &st) == 0 && st.st_size > 0)
+	{
+		void *         ptr =
+			::mmap (nullptr, size_t (st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+		if (ptr != MAP_FAILED)
+		{
+			_ptr  = static_cast <const uint8_t *> (ptr);
+			_size = int64_t (st.st_size);
+		}
+	}
+	// The mapping stays valid after closing the file
+	::close (fd);
+
+#endif // fstb_SYS
+}
+
+
+
+DiskCache::FileMap::~FileMap ()
+{
+#if fstb_SYS == fstb_SYS_WIN
+
+	if (_ptr != nullptr)
+	{
+		::UnmapViewOfFile (_ptr);
+	}
+	if (_map_hnd != nullptr)
+	{
+		::CloseHandle (_map_hnd);
+	}
+	if (_file_hnd != nullptr)
+	{
+		::CloseHandle (_file_hnd);
+	}
+
+#else // fstb_SYS
+
+	if (_ptr != nullptr)
+	{
+		::munmap (const_cast <uint8_t *> (_ptr), size_t (_size));
+	}
+
+#endif // fstb_SYS
+}
+
+
+
+const uint8_t *	DiskCache::FileMap::get_ptr () const noexcept
+{
+	return _ptr;
+}
+
+
+
+int64_t	DiskCache::FileMap::get_size () const noexcept
+{
+	return _size;
+}
+
+
+
+// Common to all the files of the instance parameters
+std::string	DiskCache::build_prefix () const
+{
+	char           txt_0 [63+1];
+	fstb::snprintf4all (
+		txt_0, sizeof (txt_0), "chkdr-%016llx-",
+		static_cast <unsigned long long> (_param_hash)
+	);
+
+	return txt_0;
+}
+
+
+
+// The file name depends on both the parameters and the source content
+std::string	DiskCache::build_name (const Key &key) const
+{
+	char           txt_0 [63+1];
+	fstb::snprintf4all (
+		txt_0, sizeof (txt_0), "%016llx.bin",
+		static_cast <unsigned long long> (key._hash)
+	);
+
+	return build_prefix () + txt_0;
+}
+
+
+
+std::string	DiskCache::build_pathname (const std::string &name) const
+{
+	return _dir + name;
+}
+
+
+
+bool	DiskCache::check_header (const Header &header, const Key &key) const noexcept
+{
+	return (
+		   header._magic      == _magic
+		&& header._version    == _version
+		&& header._param_hash == _param_hash
+		&& header._key_hash   == key._hash
+		&& header._key_chk    == key._hash_chk
+		&& header._seed       == key._seed
+		&& header._w          == key._w
+		&& header._h          == key._h
+		&& header._nbr_planes == key._nbr_planes
+		&& header._fmt_id     == int32_t (key._dst_fmt.get_id ())
+	);
+}
+
+
+
+// Inserts or moves the entry to the front of the LRU list.
+// Call with the mutex locked.
+void	DiskCache::use_entry (const std::string &name, int64_t size)
+{
+	const auto     it = _entry_map.find (name);
+	if (it == _entry_map.end ())
+	{
+		_lru_list.push_front (Entry { name, size });
+		_entry_map [name] = _lru_list.begin ();
+	}
+	else
+	{
+		_lru_list.splice (_lru_list.begin (), _lru_list, it->second);
+		_size -= it->second->_size;
+		it->second->_size = size;
+	}
+	_size += size;
+}
+
+
+
+// Deletes the least recently used files until the total size is lower or
+// equal to the target. Call with the mutex locked.
+// A file may be already gone (deleted by another process) or still in use
+// (Windows), the error is ignored in both cases.
+void	DiskCache::evict (int64_t size_target)
+{
+	while (_size > size_target && ! _lru_list.empty ())
+	{
+		const auto &   entry = _lru_list.back ();
+		remove (build_pathname (entry._name).c_str ());
+		_size -= entry._size;
+		_entry_map.erase (entry._name);
+		_lru_list.pop_back ();
+	}
+}
+
+
+
+int64_t	DiskCache::compute_file_size (const Key &key) noexcept
+{
+	return
+		  int64_t (sizeof (Header))
+		+ int64_t (key._w) * int64_t (key._h) * key._nbr_planes
+		* int64_t (key._dst_fmt.get_size ());
+}
+
+
+
+std::string	DiskCache::add_separator (std::string dir)
+{
+	assert (! dir.empty ());
+
+	const char     c = dir.back ();
+#if fstb_SYS == fstb_SYS_WIN
+	if (c != '\\' && c != '/' && c != ':')
+	{
+		dir += '\\';
+	}
+#else
+	if (c != '/')
+	{
+		dir += '/';
+	}
+#endif
+
+	return dir;
+}
+
+
+
+// Lists the cache files of the directory whose name starts with prefix
+// (not the temporary files). Abandoned temporary files, whatever their
+// prefix, are deleted.
+// dir must end with a separator.
+// Returns false if the directory cannot be read.
+bool	DiskCache::list_files (FileInfoList &file_list, const std::string &dir, const std::string &prefix)
+{
+	const auto     is_cache_file = [&prefix] (const char *name_0) {
+		const auto     len = strlen (name_0);
+		return (
+			   len > prefix.length () + 4
+			&& strncmp (name_0, prefix.c_str (), prefix.length ()) == 0
+			&& strcmp (name_0 + len - 4, ".bin") == 0
+		);
+	};
+	const auto     is_tmp_file = [] (const char *name_0) {
+		return (
+			   strncmp (name_0, "chkdr-", 6) == 0
+			&& strstr (name_0, ".bin.tmp-") != nullptr
+		);
+	};
+
+	file_list.clear ();
+
+#if fstb_SYS == fstb_SYS_WIN
+
+	// File times are in 100 ns units
+	::FILETIME     now;
+	::GetSystemTimeAsFileTime (&now);
+	const auto     now_ft  =
+		(int64_t (now.dwHighDateTime) << 32) + now.dwLowDateTime;
+	const auto     tmp_max = _tmp_max_age * 10'000'000;
+
+	const auto     pattern = dir + "*";
+	::WIN32_FIND_DATAA   data;
+	const auto     find_hnd = ::FindFirstFileA (pattern.c_str (), &data);
+	if (find_hnd == INVALID_HANDLE_VALUE)
+	{
+		return (::GetLastError () == ERROR_FILE_NOT_FOUND);
+	}
+	do
+	{
+		const auto     mtime =
+			  (int64_t (data.ftLastWriteTime.dwHighDateTime) << 32)
+			+ data.ftLastWriteTime.dwLowDateTime;
+		if ((data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) != 0)
+		{
+			// Nothing
+		}
+		else if (is_tmp_file (data.cFileName))
+		{
+			if (now_ft - mtime > tmp_max)
+			{
+				remove ((dir + data.cFileName).c_str ());
+			}
+		}
+		else if (is_cache_file (data.cFileName))
+		{
+			FileInfo       info;
+			info._name  = data.cFileName;
+			info._size  =
+				(int64_t (data.nFileSizeHigh) << 32) + data.nFileSizeLow;
+			info._mtime = mtime;
+			file_list.push_back (info);
+		}
+	}
+	while (::FindNextFileA (find_hnd, &data));
+	::FindClose (find_hnd);
+
+#else // fstb_SYS
+
+	::DIR *        dir_ptr = ::opendir (dir.c_str ());
+	if (dir_ptr == nullptr)
+	{
+		return false;
+	}
+	const auto     now     = int64_t (::time (nullptr));
+	const ::dirent *  ent_ptr = nullptr;
+	while ((ent_ptr = ::readdir (dir_ptr)) != nullptr)
+	{
+		const auto     pathname = dir + ent_ptr->d_name;
+		struct ::stat  st;
+		if (   is_tmp_file (ent_ptr->d_name)
+		    && ::stat (pathname.c_str (), &st) == 0
+		    && S_ISREG (st.st_mode))
+		{
+			if (now - int64_t (st.st_mtime) > _tmp_max_age)
+			{
+				remove (pathname.c_str ());
+			}
+		}
+		else if (   is_cache_file (ent_ptr->d_name)
+		         && ::stat (pathname.c_str (), &st) == 0
+		         && S_ISREG (st.st_mode))
+		{
+			FileInfo       info;
+			info._name  = ent_ptr->d_name;
+			info._size  = int64_t (st.st_size);
+			info._mtime = int64_t (st.st_mtime);
+			file_list.push_back (info);
+		}
+	}
+	::closedir (dir_ptr);
+
+#endif // fstb_SYS
+
+	return true;
+}
+
+
+
+// Sets the modification time to now
+void	DiskCache::touch_file (const std::string &pathname)
+{
+#if fstb_SYS == fstb_SYS_WIN
+	::_utime (pathname.c_str (), nullptr);
+#else
+	::utime (pathname.c_str (), nullptr);
+#endif
+}
+
+
+
+uint32_t	DiskCache::get_process_id ()
+{
+#if fstb_SYS == fstb_SYS_WIN
+	return uint32_t (::GetCurrentProcessId ());
+#else
+	return uint32_t (::getpid ());
+#endif
+}
+
+
+
+}  // namespace chkdr
+
+
+
+/*\\\ EOF \\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\*/
@@ -0,0 +1,233 @@
+/*****************************************************************************
+
+        DiskCache.h
+        Author: Laurent de Soras, 2022
+
+Persistent cache of rendered planes, stored in a directory. Each entry is a
+file named after the rendering parameters and the OutputCache key of the
+source frame. Files are memory-mapped when read, and the rows are copied
+directly from the mapping into the destination planes.
+The total size of the files is limited; the least recently used entries are
+deleted first. The usage order survives the process through the file
+modification times.
+Several processes may share a directory. Entries are written to a temporary
+file and renamed once complete, so a reader never sees a partial entry.
+The size limit applies to the files of a given set of rendering parameters:
+an instance never deletes the entries of other parameters, so the directory
+may grow up to the sum of the budgets. Instances with the same parameters
+account only for the files they have seen, so the limit is approximate in
+this case. Temporary files left by a crashed process are deleted after a
+few minutes.
+All functions are thread-safe.
+
+--- Legal stuff ---
+
+This program is free software. It comes without any warranty, to
+the extent permitted by applicable law. You can redistribute it
+and/or modify it under the terms of the Do What The Fuck You Want
+To Public License, Version 2, as published by Sam Hocevar. See
+http://sam.zoy.org/wtfpl/COPYING for more details.
+
+*Tab=3***********************************************************************/
+
+
+
+#pragma once
+#if ! defined (chkdr_DiskCache_HEADER_INCLUDED)
+#define chkdr_DiskCache_HEADER_INCLUDED
+
+
+
+/*\\\ INCLUDE FILES \\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\*/
+
+#include "chkdr/OutputCache.h"
+#include "fgrn/GenGrain.h"
+#include "fstb/def.h"
+
+#include <atomic>
+#include <list>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <cstdint>
+
+
+
+namespace chkdr
+{
+
+
+
+class DiskCache
+{
+
+/*\\\ PUBLIC \\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\*/
+
+public:
+
+	typedef OutputCache::Key Key;
+
+	explicit       DiskCache (const std::string &dir, int64_t budget, uint64_t param_hash);
+
+	bool           is_enabled () const noexcept;
+	bool           fetch (const Key &key, const fgrn::GenGrain::PlaneArray &plane_arr);
+	void           store (const Key &key, const fgrn::GenGrain::PlaneArray &plane_arr);
+
+	int64_t        get_budget () const noexcept;
+	int64_t        get_size () const;
+	int            get_nbr_entries () const;
+	int64_t        get_nbr_hits () const noexcept;
+	int64_t        get_nbr_misses () const noexcept;
+
+	static bool    check_dir (const std::string &dir);
+
+
+
+/*\\\ PROTECTED \\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\*/
+
+protected:
+
+
+
+/*\\\ PRIVATE \\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\*/
+
+private:
+
+	// File layout: header, then the planes one after the other, with
+	// stride = width. The header is padded to keep the data aligned.
+	class Header
+	{
+	public:
+		uint32_t       _magic      = 0;
+		uint32_t       _version    = 0;
+		uint64_t       _param_hash = 0;
+		uint64_t       _key_hash   = 0;
+		uint64_t       _key_chk    = 0;
+		uint32_t       _seed       = 0;
+		int32_t        _w          = 0;
+		int32_t        _h          = 0;
+		int32_t        _nbr_planes = 0;
+		int32_t        _fmt_id     = 0; // fgrn::SplFmt::get_id()
+		uint8_t        _pad [12]   = {};
+	};
+	static_assert (sizeof (Header) == 64, "");
+
+	static constexpr uint32_t  _magic   = 0x43524443; // "CDRC"
+	static constexpr uint32_t  _version = 2;
+
+	// Temporary files older than this are considered as abandoned, seconds
+	static constexpr int64_t   _tmp_max_age = 10 * 60;
+
+	// Read-only mapping of a whole file
+	class FileMap
+	{
+	public:
+		explicit       FileMap (const std::string &pathname);
+		               ~FileMap ();
+		const uint8_t* get_ptr () const noexcept;
+		int64_t        get_size () const noexcept;
+	private:
+		const uint8_t* _ptr  = nullptr;
+		int64_t        _size = 0;
+#if fstb_SYS == fstb_SYS_WIN
+		void *         _file_hnd = nullptr;
+		void *         _map_hnd  = nullptr;
+#endif
+		               FileMap (const FileMap &other)         = delete;
+		FileMap &      operator = (const FileMap &other)      = delete;
+	};
+
+	// Existing file, as found in the directory
+	class FileInfo
+	{
+	public:
+		std::string    _name;
+		int64_t        _size  = 0;
+		int64_t        _mtime = 0;
+	};
+	typedef std::vector <FileInfo> FileInfoList;
+
+	class Entry
+	{
+	public:
+		std::string    _name;
+		int64_t        _size = 0; // Bytes
+	};
+
+	// Most recently used first
+	typedef std::list <Entry> EntryList;
+	typedef std::unordered_map <std::string, EntryList::iterator> EntryMap;
+
+	std::string    build_prefix () const;
+	std::string    build_name (const Key &key) const;
+	std::string    build_pathname (const std::string &name) const;
+	bool           check_header (const Header &header, const Key &key) const noexcept;
+	void           use_entry (const std::string &name, int64_t size);
+	void           evict (int64_t size_target);
+
+	static int64_t compute_file_size (const Key &key) noexcept;
+	static std::string
+	               add_separator (std::string dir);
+	static bool    list_files (FileInfoList &file_list, const std::string &dir, const std::string &prefix);
+	static void    touch_file (const std::string &pathname);
+	static uint32_t
+	               get_process_id ();
+
+	// Directory, with a trailing separator. Empty = disabled
+	std::string    _dir;
+
+	// Maximum total size of the files, in bytes
+	int64_t        _budget     = 0;
+
+	// Hash of the rendering parameters not included in the key
+	uint64_t       _param_hash = 0;
+
+	// Mutex to lock before accessing the entries
+	mutable std::mutex
+	               _mtx;
+	EntryList      _lru_list;
+	EntryMap       _entry_map;
+	int64_t        _size       = 0; // Bytes
+
+	// Makes the temporary file names unique within the process
+	std::atomic <uint32_t>
+	               _tmp_cnt    { 0 };
+
+	std::atomic <int64_t>
+	               _nbr_hits   { 0 };
+	std::atomic <int64_t>
+	               _nbr_misses { 0 };
+
+
+
+/*\\\ FORBIDDEN MEMBER FUNCTIONS \\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\*/
+
+private:
+
+	               DiskCache ()                               = delete;
+	               DiskCache (const DiskCache &other)         = delete;
+	               DiskCache (DiskCache &&other)              = delete;
+	DiskCache &    operator = (const DiskCache &other)        = delete;
+	DiskCache &    operator = (DiskCache &&other)             = delete;
+	bool           operator == (const DiskCache &other) const = delete;
+	bool           operator != (const DiskCache &other) const = delete;
+
+}; // class DiskCache
+
+
+
+}  // namespace chkdr
+
+
+
+//#include "chkdr/DiskCache.hpp"
+
+
+
+#endif   // chkdr_DiskCache_HEADER_INCLUDED
+
+
+
+/*\\\ EOF \\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\*/
@@ -19,14 +19,20 @@ http://sam.zoy.org/wtfpl/COPYING for more details.
 /*\\\ INCLUDE FILES \\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\*/
 
 #include "chkdr/GrainProc.h"
+#include "fgrn/SplConv.h"
 #include "fstb/def.h"
+#include "fstb/fnc.h"
+#include "fstb/Hash.h"
 #include "AvstpWrapper.h"
 
 #if fstb_ARCHI == fstb_ARCHI_X86
 # include <mmintrin.h>
 #endif
 
+#include <algorithm>
+
 #include <cassert>
+#include <cstring>
 
 
 
@@ -39,26 +45,98 @@ namespace chkdr
 
 
 
-GrainProc::GrainProc (float sigma, int res, float rad, float dev, uint32_t seed, bool cf_flag, bool cp_flag, bool draft_flag, bool simd4_flag, bool avx_flag)
+// cache_size is in bytes, 0 to disable the output cache.
+// cache_dir is the directory of the disk cache, empty to disable it.
+// cache_dir_size is the size limit of the disk cache, in bytes.
+GrainProc::GrainProc (float sigma, int res, float rad, float dev, uint32_t seed, bool cf_flag, bool cp_flag, fgrn::RenderMode mode, int64_t cache_size, const std::string &cache_dir, int64_t cache_dir_size, bool simd4_flag, bool avx_flag)
+:	GrainProc (
+		sigma, res, 1, make_single_layer (rad, dev), 1, seed, cf_flag, cp_flag, mode,
+		fgrn::Transfer::Curve_LINEAR, 1, 1,
+		cache_size, cache_dir, cache_dir_size, simd4_flag, avx_flag
+	)
+{
+	// Nothing
+}
+
+
+
+// Several grain layers, mixed according to their weights. The weights are
+// normalized. Layer k uses the seed of a single layer rendering plus
+// k * fgrn::GenGrain::_layer_seed_step. Several layers require the full
+// rendering mode.
+// scale: output size relative to the source size (see
+// compute_scaled_size()). A scale other than 1 requires the full rendering
+// mode and a single layer. The temporal reuse is disabled in this case.
+// curve: transfer curve of the source and destination planes. The grain is
+// rendered on the linearized values.
+// amount_blk, amount_wht: grain amount for black and white sources, mixing
+// the output with the source (1 = grain only). Requires a scale of 1 and
+// another mode than the texture atlas.
+GrainProc::GrainProc (float sigma, int res, float scale, const LayerArray &layer_arr, int nbr_layers, uint32_t seed, bool cf_flag, bool cp_flag, fgrn::RenderMode mode, fgrn::Transfer::Curve curve, float amount_blk, float amount_wht, int64_t cache_size, const std::string &cache_dir, int64_t cache_dir_size, bool simd4_flag, bool avx_flag)
 :	_simd4_flag (simd4_flag)
 ,	_avx_flag (avx_flag)
-,	_filter (sigma, res, rad, dev)
+,	_scale (scale)
+,	_layer_arr (layer_arr)
+,	_nbr_layers (nbr_layers)
+,	_filter_sptr (fgrn::VisionFilterPool::use_instance ().use_filter (
+		sigma, res,
+		layer_arr [find_largest_layer (layer_arr, nbr_layers)]._rad_avg,
+		layer_arr [find_largest_layer (layer_arr, nbr_layers)]._rad_stddev
+	))
 ,	_seed_base (seed)
 ,	_cf_flag (cf_flag)
 ,	_cp_flag (cp_flag)
-,	_draft_flag (draft_flag)
+,	_mode (mode)
+,	_curve (curve)
+,	_amount_blk (amount_blk)
+,	_amount_wht (amount_wht)
 ,	_avstp (AvstpWrapper::use_instance ())
+,	_out_cache (cache_size)
+,	_disk_cache (
+		cache_dir, cache_dir_size,
+		compute_param_hash (
+			sigma, res, scale, layer_arr, nbr_layers, seed, cf_flag, cp_flag, mode,
+			curve, amount_blk, amount_wht, simd4_flag, avx_flag
+		)
+	)
 {
 	assert (check_sigma (sigma));
 	assert (check_res (res));
-	assert (check_rad (rad));
-	assert (check_dev (dev));
+	assert (check_mode (mode));
+	assert (check_nbr_layers (nbr_layers, mode));
+	assert (check_scale (scale));
+	assert (check_scale_mode (scale, mode, nbr_layers));
+	assert (check_weights (layer_arr, nbr_layers));
+	assert (check_transfer (curve));
+	assert (check_transfer_mode (curve, mode));
+	assert (check_amount (amount_blk));
+	assert (check_amount (amount_wht));
+	assert (check_amount_mode (amount_blk, amount_wht, mode, scale));
+	assert (cache_size >= 0);
+	assert (cache_dir_size >= 0);
+
+	float          w_sum = 0;
+	for (int l_idx = 0; l_idx < _nbr_layers; ++l_idx)
+	{
+		assert (check_rad (_layer_arr [l_idx]._rad_avg));
+		assert (check_dev (_layer_arr [l_idx]._rad_stddev));
+		w_sum += _layer_arr [l_idx]._weight;
+	}
+	for (int l_idx = 0; l_idx < _nbr_layers; ++l_idx)
+	{
+		_layer_arr [l_idx]._weight /= w_sum;
+	}
 }
 
 
 
-// Strides in bytes
-void	GrainProc::process_plane (uint8_t *dst_ptr, ptrdiff_t dst_stride, const uint8_t *src_ptr, ptrdiff_t src_stride, int w, int h, int frame_idx, int plane_idx)
+// The destination plane has the output size, see compute_scaled_size().
+// Strides in bytes. fmt is the sample format of both planes, it is
+// converted on the fly by the generator.
+// With a mask, only the tiles containing non-null mask values are rendered,
+// the other ones are copied from the source.
+// The rendering statistics are added to stats_arr_ptr, if not null.
+void	GrainProc::process_plane (uint8_t *dst_ptr, ptrdiff_t dst_stride, const uint8_t *src_ptr, ptrdiff_t src_stride, int w, int h, int frame_idx, int plane_idx, fgrn::SplFmt fmt, const Mask *msk_ptr, StatsArray *stats_arr_ptr)
 {
 	assert (dst_ptr != nullptr);
 	assert (src_ptr != nullptr);
@@ -66,59 +144,804 @@ void	GrainProc::process_plane (uint8_t *dst_ptr, ptrdiff_t dst_stride, const uin
 	assert (h > 0);
 	assert (frame_idx >= 0);
 	assert (plane_idx >= 0);
+	assert (check_fmt_mode (fmt, _mode));
+	assert (msk_ptr == nullptr || check_mask_mode (_mode, _scale));
+
+	const auto     spl_size = ptrdiff_t (fmt.get_size ());
+	const auto     tf_sptr  = use_transfer (fmt);
+	fgrn::GenGrain::PlaneArray plane_arr;
+	auto &         plane = plane_arr [0];
+	plane._dst_ptr    = dst_ptr;
+	plane._src_ptr    = src_ptr;
+	plane._dst_stride = dst_stride / spl_size;
+	plane._src_stride = src_stride / spl_size;
+	plane._dst_fmt    = fmt;
+	plane._src_fmt    = fmt;
+	plane._tf_ptr     = tf_sptr.get ();
+	plane._amount_blk = _amount_blk;
+	plane._amount_wht = _amount_wht;
+	if (msk_ptr != nullptr)
+	{
+		set_mask (plane, *msk_ptr);
+	}
+
+	process_planes (
+		plane_arr, 1, w, h, compute_seed (frame_idx, plane_idx), plane_idx,
+		stats_arr_ptr
+	);
+}
+
+
+
+// Returns the source area required to render the rect_dst part of a
+// picture of size pic_w * pic_h. The area is aligned on the tiles.
+GrainProc::Rect	GrainProc::compute_rect_src (const Rect &rect_dst, int pic_w, int pic_h) const noexcept
+{
+	return fgrn::GenGrain::compute_rect_src (
+		rect_dst, pic_w, pic_h, _filter_sptr->get_reach (),
+		_tile_size, _tile_size
+	);
+}
+
+
+
+// Renders the rect_dst part of a picture of size pic_w * pic_h. The result
+// is identical to the same part rendered by process_plane() on the whole
+// picture, so a picture can be split across several processes or machines.
+// dst_ptr points on the rect_dst area, src_ptr on the source area given by
+// compute_rect_src(). The optional mask covers the same area as the source.
+// Strides in bytes. The output caches are not used.
+void	GrainProc::process_rect (uint8_t *dst_ptr, ptrdiff_t dst_stride, const uint8_t *src_ptr, ptrdiff_t src_stride, const Rect &rect_dst, int pic_w, int pic_h, int frame_idx, int plane_idx, fgrn::SplFmt fmt, const Mask *msk_ptr)
+{
+	assert (dst_ptr != nullptr);
+	assert (src_ptr != nullptr);
+	assert (frame_idx >= 0);
+	assert (plane_idx >= 0);
+	assert (check_fmt_mode (fmt, _mode));
+	assert (check_rect_mode (_mode, _scale));
+
+	const auto     rect_src = compute_rect_src (rect_dst, pic_w, pic_h);
+	const int      w        = rect_src._w;
+	const int      h        = rect_src._h;
+
+	// The generator may write anywhere in the source area, so it renders
+	// in a temporary plane.
+	const auto     spl_size = ptrdiff_t (fmt.get_size ());
+	std::vector <uint8_t> tmp_arr (size_t (w) * size_t (h) * size_t (spl_size));
+
+	const auto     tf_sptr  = use_transfer (fmt);
+	fgrn::GenGrain::PlaneArray plane_arr;
+	auto &         plane = plane_arr [0];
+	plane._dst_ptr    = tmp_arr.data ();
+	plane._src_ptr    = src_ptr;
+	plane._dst_stride = w;
+	plane._src_stride = src_stride / spl_size;
+	plane._dst_fmt    = fmt;
+	plane._src_fmt    = fmt;
+	plane._tf_ptr     = tf_sptr.get ();
+	plane._amount_blk = _amount_blk;
+	plane._amount_wht = _amount_wht;
+	if (msk_ptr != nullptr)
+	{
+		set_mask (plane, *msk_ptr);
+	}
+
+	// The source area is aligned on the tiles of the whole picture, so the
+	// masked tiles are the same.
+	ProcSPtr       proc_sptr = acquire_proc ();
+	auto &         tile_mask = proc_sptr->_tile_mask;
+	find_mask_tiles (tile_mask, plane_arr, 1, w, h);
+	const int      tx_beg = (rect_dst._x - rect_src._x) / _tile_size;
+	const int      ty_beg = (rect_dst._y - rect_src._y) / _tile_size;
+	const int      tx_end =
+		(rect_dst._x + rect_dst._w - rect_src._x + _tile_size - 1) / _tile_size;
+	const int      ty_end =
+		(rect_dst._y + rect_dst._h - rect_src._y + _tile_size - 1) / _tile_size;
+	for (int ty = 0; ty < tile_mask.get_nbr_tiles_y (); ++ty)
+	{
+		for (int tx = 0; tx < tile_mask.get_nbr_tiles_x (); ++tx)
+		{
+			if (ty < ty_beg || ty >= ty_end || tx < tx_beg || tx >= tx_end)
+			{
+				tile_mask.set_tile (tx, ty, false);
+			}
+		}
+	}
+	if (tile_mask.get_nbr_tiles_set () > 0)
+	{
+		render_planes (
+			*proc_sptr, plane_arr, 1, w, h, compute_seed (frame_idx, plane_idx),
+			_mode, &tile_mask, rect_src._x, rect_src._y
+		);
+	}
+	if (has_mask (plane_arr, 1))
+	{
+		copy_src_tiles (plane_arr, 1, tile_mask);
+	}
+	release_proc (proc_sptr);
+
+	const int      ofs_x = rect_dst._x - rect_src._x;
+	const int      ofs_y = rect_dst._y - rect_src._y;
+	const auto     len   = size_t (rect_dst._w * spl_size);
+	for (int y = 0; y < rect_dst._h; ++y)
+	{
+		memcpy (
+			dst_ptr + y * dst_stride,
+			plane.use_dst_row (y + ofs_y) + ofs_x * spl_size,
+			len
+		);
+	}
+}
+
+
+
+// Joint processing is possible when all the planes of a frame share the
+// same seed and the full renderer is used, without output scaling.
+bool	GrainProc::can_process_frame () const noexcept
+{
+	return (
+		   _cp_flag && _mode == fgrn::RenderMode_FULL && _nbr_layers == 1
+		&& _scale == 1
+	);
+}
+
+
+
+// Processes all the planes of a frame at once. Requires
+// can_process_frame() to be true. Planes must have the same size.
+// Strides in bytes. Masks and statistics are optional, see process_plane().
+void	GrainProc::process_frame (const DstPtrArray &dst_ptr_arr, const StrideArray &dst_stride_arr, const SrcPtrArray &src_ptr_arr, const StrideArray &src_stride_arr, int w, int h, int frame_idx, int nbr_planes, fgrn::SplFmt fmt, const MaskArray *msk_arr_ptr, StatsArray *stats_arr_ptr)
+{
+	assert (can_process_frame ());
+	assert (w > 0);
+	assert (h > 0);
+	assert (frame_idx >= 0);
+	assert (nbr_planes > 0);
+	assert (nbr_planes <= _max_nbr_planes);
+	assert (fmt.is_valid ());
+
+	const auto     spl_size = ptrdiff_t (fmt.get_size ());
+	const auto     tf_sptr  = use_transfer (fmt);
+	fgrn::GenGrain::PlaneArray plane_arr;
+	for (int p_idx = 0; p_idx < nbr_planes; ++p_idx)
+	{
+		assert (dst_ptr_arr [p_idx] != nullptr);
+		assert (src_ptr_arr [p_idx] != nullptr);
+		auto &         plane = plane_arr [p_idx];
+		plane._dst_ptr    = dst_ptr_arr [p_idx];
+		plane._src_ptr    = src_ptr_arr [p_idx];
+		plane._dst_stride = dst_stride_arr [p_idx] / spl_size;
+		plane._src_stride = src_stride_arr [p_idx] / spl_size;
+		plane._dst_fmt    = fmt;
+		plane._src_fmt    = fmt;
+		plane._tf_ptr     = tf_sptr.get ();
+		plane._amount_blk = _amount_blk;
+		plane._amount_wht = _amount_wht;
+		if (msk_arr_ptr != nullptr)
+		{
+			set_mask (plane, (*msk_arr_ptr) [p_idx]);
+		}
+	}
+
+	// All the planes share the same seed, so identical sources give identical
+	// outputs (gray pictures stored as RGB). Only the distinct planes are
+	// rendered, the others are copied afterwards.
+	fgrn::GenGrain::PlaneArray uniq_arr;
+	std::array <int, _max_nbr_planes> uniq_idx_arr {};
+	int            nbr_uniq = 0;
+	for (int p_idx = 0; p_idx < nbr_planes; ++p_idx)
+	{
+		const auto &   plane = plane_arr [p_idx];
+		int            u_idx = 0;
+		while (u_idx < nbr_uniq && ! is_same_src (uniq_arr [u_idx], plane, w, h))
+		{
+			++ u_idx;
+		}
+		if (u_idx == nbr_uniq)
+		{
+			uniq_arr [nbr_uniq] = plane;
+			++ nbr_uniq;
+		}
+		uniq_idx_arr [p_idx] = u_idx;
+	}
+
+	process_planes (
+		uniq_arr, nbr_uniq, w, h, compute_seed (frame_idx, 0), 0, stats_arr_ptr
+	);
+
+	const auto     len = size_t (w * spl_size);
+	for (int p_idx = 0; p_idx < nbr_planes; ++p_idx)
+	{
+		const auto &   plane = plane_arr [p_idx];
+		const auto &   ref   = uniq_arr [uniq_idx_arr [p_idx]];
+		if (ref._dst_ptr != plane._dst_ptr)
+		{
+			for (int y = 0; y < h; ++y)
+			{
+				memcpy (plane.use_dst_row (y), ref.use_dst_row (y), len);
+			}
+		}
+	}
+}
+
+
+
+// Renders the grain from grain count maps computed separately (see
+// DensityProc), one int32_t map per plane. seed_arr contains the seeds used
+// to compute the maps. Strides in bytes.
+// The output caches and the temporal reuse are not used in this case.
+void	GrainProc::process_density (const DstPtrArray &dst_ptr_arr, const StrideArray &dst_stride_arr, const SrcPtrArray &q_ptr_arr, const StrideArray &q_stride_arr, int w, int h, const SeedArray &seed_arr, int nbr_planes, fgrn::SplFmt dst_fmt)
+{
+	assert (_mode != fgrn::RenderMode_ATLAS);
+	assert (_nbr_layers == 1);
+	assert (_scale == 1);
+	assert (w > 0);
+	assert (h > 0);
+	assert (nbr_planes > 0);
+	assert (nbr_planes <= _max_nbr_planes);
+	assert (dst_fmt.is_valid ());
+
+	const auto     tf_sptr = use_transfer (dst_fmt);
+	fgrn::GenGrain::PlaneArray plane_arr;
+	bool           same_seed_flag = true;
+	for (int p_idx = 0; p_idx < nbr_planes; ++p_idx)
+	{
+		assert (dst_ptr_arr [p_idx] != nullptr);
+		assert (q_ptr_arr [p_idx] != nullptr);
+		auto &         plane = plane_arr [p_idx];
+		plane._dst_ptr    = dst_ptr_arr [p_idx];
+		plane._q_ptr      =
+			reinterpret_cast <const int32_t *> (q_ptr_arr [p_idx]);
+		plane._dst_stride = dst_stride_arr [p_idx] / dst_fmt.get_size ();
+		plane._dst_fmt    = dst_fmt;
+		plane._tf_ptr     = tf_sptr.get ();
+		plane._q_stride   = q_stride_arr [p_idx] / ptrdiff_t (sizeof (int32_t));
+		same_seed_flag   &= (seed_arr [p_idx] == seed_arr [0]);
+	}
+
+	ProcSPtr       proc_sptr = acquire_proc ();
+	if (same_seed_flag && _mode == fgrn::RenderMode_FULL)
+	{
+		render_planes (
+			*proc_sptr, plane_arr, nbr_planes, w, h, seed_arr [0], _mode, nullptr
+		);
+	}
+	else
+	{
+		for (int p_idx = 0; p_idx < nbr_planes; ++p_idx)
+		{
+			fgrn::GenGrain::PlaneArray plane_one_arr;
+			plane_one_arr [0] = plane_arr [p_idx];
+			render_planes (
+				*proc_sptr, plane_one_arr, 1, w, h, seed_arr [p_idx], _mode, nullptr
+			);
+		}
+	}
+	release_proc (proc_sptr);
+}
+
+
+
+// Sums the statistics of all the threads. The pass times are summed too.
+fgrn::RenderStats	GrainProc::sum_stats (const StatsArray &stats_arr) noexcept
+{
+	fgrn::RenderStats stats;
+	for (const auto &stats_thr : stats_arr)
+	{
+		stats.accumulate (stats_thr);
+	}
+
+	return stats;
+}
+
+
+
+// Seed of a given plane, shared with DensityProc
+uint32_t	GrainProc::make_seed (uint32_t seed_base, bool cf_flag, bool cp_flag, int frame_idx, int plane_idx) noexcept
+{
+	return uint32_t (
+			seed_base
+		+ ((cp_flag) ? 0 : plane_idx    )
+		+ ((cf_flag) ? 0 : frame_idx * 4)
+	);
+}
+
+
+
+bool	GrainProc::check_sigma (float sigma) noexcept
+{
+	return (sigma >= 0 && sigma <= 1);
+}
+
+
+
+bool	GrainProc::check_res (int res) noexcept
+{
+	return (res > 0);
+}
+
+
+
+bool	GrainProc::check_rad (float rad) noexcept
+{
+	return (rad > 0);
+}
+
+
+
+bool	GrainProc::check_dev (float dev) noexcept
+{
+	return (dev >= 0 && dev <= 1);
+}
+
+
+
+bool	GrainProc::check_mode (int mode) noexcept
+{
+	return (mode >= 0 && mode < fgrn::RenderMode_NBR_ELT);
+}
+
+
+
+// Several layers are rendered only with the full model
+bool	GrainProc::check_nbr_layers (int nbr_layers, int mode) noexcept
+{
+	return (
+		   nbr_layers > 0
+		&& nbr_layers <= _max_nbr_layers
+		&& (nbr_layers == 1 || mode == fgrn::RenderMode_FULL)
+	);
+}
+
+
+
+// Weights must be positive or null, with a positive sum
+bool	GrainProc::check_weights (const LayerArray &layer_arr, int nbr_layers) noexcept
+{
+	assert (nbr_layers > 0);
+	assert (nbr_layers <= _max_nbr_layers);
+
+	float          w_sum = 0;
+	for (int l_idx = 0; l_idx < nbr_layers; ++l_idx)
+	{
+		const auto     weight = layer_arr [l_idx]._weight;
+		if (! (weight >= 0))
+		{
+			return false;
+		}
+		w_sum += weight;
+	}
+
+	return (w_sum > 0);
+}
+
+
+
+bool	GrainProc::check_scale (float scale) noexcept
+{
+	return (scale >= 0.125f && scale <= 8);
+}
+
+
+
+// The output scaling is implemented only in the full model, for a single
+// grain layer
+bool	GrainProc::check_scale_mode (float scale, int mode, int nbr_layers) noexcept
+{
+	return (
+		   scale == 1
+		|| (mode == fgrn::RenderMode_FULL && nbr_layers == 1)
+	);
+}
+
+
+
+// The texture atlas works only on float planes
+bool	GrainProc::check_fmt_mode (fgrn::SplFmt fmt, int mode) noexcept
+{
+	return (
+		   fmt.is_valid ()
+		&& (fmt.is_float32 () || mode != fgrn::RenderMode_ATLAS)
+	);
+}
+
+
+
+bool	GrainProc::check_transfer (int curve) noexcept
+{
+	return (curve >= 0 && curve < fgrn::Transfer::Curve_NBR_ELT);
+}
+
 
-	const auto     seed = uint32_t (
-			_seed_base
-		+ ((_cp_flag) ? 0 : plane_idx    )
-		+ ((_cf_flag) ? 0 : frame_idx * 4)
+
+// The texture atlas works only on linear data
+bool	GrainProc::check_transfer_mode (int curve, int mode) noexcept
+{
+	return (
+		   curve == fgrn::Transfer::Curve_LINEAR
+		|| mode != fgrn::RenderMode_ATLAS
 	);
+}
+
+
+
+bool	GrainProc::check_amount (float amount) noexcept
+{
+	return (amount >= 0 && amount <= 1);
+}
+
+
+
+// The mix with the source is not available with the texture atlas, and
+// requires the source and the output to have the same size.
+bool	GrainProc::check_amount_mode (float amount_blk, float amount_wht, int mode, float scale) noexcept
+{
+	return (
+		   (amount_blk == 1 && amount_wht == 1)
+		|| (mode != fgrn::RenderMode_ATLAS && scale == 1)
+	);
+}
+
+
+
+// Masks are mixed like the amount, so they have the same constraints
+bool	GrainProc::check_mask_mode (int mode, float scale) noexcept
+{
+	return check_amount_mode (0, 0, mode, scale);
+}
+
+
+
+// Picture parts are rendered with the generator, on the source grid
+bool	GrainProc::check_rect_mode (int mode, float scale) noexcept
+{
+	return (mode != fgrn::RenderMode_ATLAS && scale == 1);
+}
+
+
+
+// Output width or height for a source dimension
+int	GrainProc::compute_scaled_size (int len, float scale) noexcept
+{
+	assert (len > 0);
+	assert (check_scale (scale));
+
+	return std::max (fstb::round_int (float (len) * scale), 1);
+}
+
+
+
+bool	GrainProc::check_cache_size (int cache_size_mib) noexcept
+{
+	return (cache_size_mib >= 0);
+}
+
+
+
+// Default output cache size, in MiB. Without cf, the grain changes on each
+// frame and only duplicated frames with identical content hit the cache.
+// This doesn't justify hashing and copying every frame, nor the memory of
+// one cache per filter instance. The draft and statistical modes are about
+// as fast as the hash.
+int	GrainProc::compute_def_cache_size (int mode, bool cf_flag) noexcept
+{
+	return (mode == fgrn::RenderMode_FULL && cf_flag) ? _def_cache_size_mib : 0;
+}
+
+
+
+// The directory must exist. Empty string is accepted (disabled cache).
+bool	GrainProc::check_cache_dir (const std::string &cache_dir)
+{
+	return (cache_dir.empty () || DiskCache::check_dir (cache_dir));
+}
+
+
+
+const OutputCache &	GrainProc::use_output_cache () const noexcept
+{
+	return _out_cache;
+}
+
+
+
+const DiskCache &	GrainProc::use_disk_cache () const noexcept
+{
+	return _disk_cache;
+}
+
+
+
+/*\\\ PROTECTED \\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\*/
+
 
-	// Recycles a generator from the pool or creates a new one if empty
+
+/*\\\ PRIVATE \\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\*/
+
+
+
+// Recycles a generator from the pool or creates a new one if empty
+GrainProc::ProcSPtr	GrainProc::acquire_proc ()
+{
 	ProcSPtr       proc_sptr;
+
+	std::lock_guard <std::mutex> lock (_mtx_pool);
+	if (_proc_pool.empty ())
+	{
+		proc_sptr = std::make_shared <FrameProc> (_simd4_flag, _avx_flag);
+	}
+	else
+	{
+		proc_sptr = _proc_pool.back ();
+		_proc_pool.pop_back ();
+	}
+
+	return proc_sptr;
+}
+
+
+
+// Puts back the generator into the pool
+void	GrainProc::release_proc (ProcSPtr proc_sptr)
+{
+	assert (proc_sptr != nullptr);
+
+	std::lock_guard <std::mutex> lock (_mtx_pool);
+	_proc_pool.push_back (proc_sptr);
+}
+
+
+
+// Transfer object for source planes of the given format, or nullptr for
+// linear data. The tables are rebuilt when the format changes. The returned
+// object stays valid while the caller holds it.
+GrainProc::TransferSPtr	GrainProc::use_transfer (fgrn::SplFmt fmt)
+{
+	if (_curve == fgrn::Transfer::Curve_LINEAR)
+	{
+		return TransferSPtr ();
+	}
+
+	std::lock_guard <std::mutex> lock (_mtx_tf);
+	if (_tf_sptr == nullptr || _tf_sptr->get_src_fmt () != fmt)
+	{
+		_tf_sptr = std::make_shared <const fgrn::Transfer> (_curve, fmt);
+	}
+
+	return _tf_sptr;
+}
+
+
+
+// Frames taken from the output caches or synthesized from the atlas don't
+// add any statistics.
+void	GrainProc::process_planes (const fgrn::GenGrain::PlaneArray &plane_arr, int nbr_planes, int w, int h, uint32_t seed, int hist_slot, StatsArray *stats_arr_ptr)
+{
+	assert (nbr_planes > 0);
+	assert (w > 0);
+	assert (h > 0);
+
+	// Exact repetition of an already rendered frame?
+	// The key is computed from the source, but describes the output planes.
+	OutputCache::Key  cache_key;
+	if (_out_cache.is_enabled () || _disk_cache.is_enabled ())
+	{
+		cache_key =
+			OutputCache::compute_key (plane_arr, nbr_planes, w, h, seed);
+		cache_key._w = compute_scaled_size (w, _scale);
+		cache_key._h = compute_scaled_size (h, _scale);
+		if (_out_cache.is_enabled () && _out_cache.fetch (cache_key, plane_arr))
+		{
+			return;
+		}
+		if (_disk_cache.is_enabled () && _disk_cache.fetch (cache_key, plane_arr))
+		{
+			if (_out_cache.is_enabled ())
+			{
+				_out_cache.store (cache_key, plane_arr);
+			}
+			return;
+		}
+	}
+
+	if (_mode == fgrn::RenderMode_ATLAS)
+	{
+		std::call_once (_atlas_once, [this] () { build_atlas (); });
+		for (int p_idx = 0; p_idx < nbr_planes; ++p_idx)
+		{
+			const auto &   plane = plane_arr [p_idx];
+			assert (plane.is_src_direct ());
+			assert (plane.is_dst_direct ());
+			assert (! plane.is_blended ());
+			_atlas.synthesize (
+				static_cast <float *> (plane._dst_ptr), plane._dst_stride,
+				static_cast <const float *> (plane._src_ptr), plane._src_stride,
+				w, h, seed
+			);
+		}
+	}
+	else
 	{
-		std::lock_guard <std::mutex> lock (_mtx_pool);
-		if (_proc_pool.empty ())
+		ProcSPtr       proc_sptr = acquire_proc ();
+		proc_sptr->_stats_arr.clear ();
+		if (has_mask (plane_arr, nbr_planes))
+		{
+			process_planes_masked (*proc_sptr, plane_arr, nbr_planes, w, h, seed);
+		}
+		else if (_cf_flag && _scale == 1)
 		{
-			proc_sptr = std::make_shared <FrameProc> (_simd4_flag, _avx_flag);
+			process_planes_temporal (
+				*proc_sptr, plane_arr, nbr_planes, w, h, seed, hist_slot
+			);
 		}
 		else
 		{
-			proc_sptr = _proc_pool.back ();
-			_proc_pool.pop_back ();
+			render_planes (
+				*proc_sptr, plane_arr, nbr_planes, w, h, seed, _mode, nullptr
+			);
+		}
+		if (stats_arr_ptr != nullptr)
+		{
+			const auto &   src_arr = proc_sptr->_stats_arr;
+			auto &         dst_arr = *stats_arr_ptr;
+			dst_arr.resize (std::max (dst_arr.size (), src_arr.size ()));
+			for (size_t t_idx = 0; t_idx < src_arr.size (); ++t_idx)
+			{
+				dst_arr [t_idx].accumulate (src_arr [t_idx]);
+			}
+		}
+		release_proc (proc_sptr);
+	}
+
+	if (_out_cache.is_enabled ())
+	{
+		_out_cache.store (cache_key, plane_arr);
+	}
+	if (_disk_cache.is_enabled ())
+	{
+		_disk_cache.store (cache_key, plane_arr);
+	}
+}
+
+
+
+// Renders the atlas patches with the complete model. All the levels share
+// the base seed, so they can be rendered jointly.
+void	GrainProc::build_atlas ()
+{
+	_atlas.reset (
+		_atlas_nbr_levels, _atlas_patch_size, _atlas_block_size, _atlas_overlap
+	);
+
+	ProcSPtr       proc_sptr = acquire_proc ();
+	for (int level = 0; level < _atlas_nbr_levels; level += _max_nbr_planes)
+	{
+		const int      nbr_planes =
+			std::min (_atlas_nbr_levels - level, int (_max_nbr_planes));
+		fgrn::GenGrain::PlaneArray plane_arr;
+		for (int p_idx = 0; p_idx < nbr_planes; ++p_idx)
+		{
+			plane_arr [p_idx] = _atlas.use_level_plane (level + p_idx);
+		}
+		render_planes (
+			*proc_sptr, plane_arr, nbr_planes,
+			_atlas_patch_size, _atlas_patch_size,
+			_seed_base, fgrn::RenderMode_FULL, nullptr
+		);
+	}
+	release_proc (proc_sptr);
+}
+
+
+
+// With a constant seed for all frames, a rendered pixel depends only on the
+// source pixels located within the vision filter reach. Therefore we can
+// compare the source with the last rendered frame and render only the tiles
+// affected by the changes. The other tiles are copied from the reference.
+void	GrainProc::process_planes_temporal (FrameProc &proc, const fgrn::GenGrain::PlaneArray &plane_arr, int nbr_planes, int w, int h, uint32_t seed, int hist_slot)
+{
+	assert (_cf_flag);
+
+	HistorySPtr    hist_sptr;
+	{
+		std::lock_guard <std::mutex> lock (_mtx_hist);
+		const auto     it = _hist_map.find (hist_slot);
+		if (it != _hist_map.end ())
+		{
+			hist_sptr = it->second;
+		}
+	}
+
+	auto &         tile_mask = proc._tile_mask;
+	bool           full_flag = true;
+	if (   hist_sptr != nullptr
+	    && hist_sptr->_w          == w
+	    && hist_sptr->_h          == h
+	    && hist_sptr->_nbr_planes == nbr_planes
+	    && hist_sptr->_fmt        == plane_arr [0]._src_fmt)
+	{
+		full_flag = ! find_dirty_tiles (tile_mask, *hist_sptr, plane_arr);
+	}
+
+	if (full_flag)
+	{
+		render_planes (
+			proc, plane_arr, nbr_planes, w, h, seed, _mode, nullptr
+		);
+	}
+	else
+	{
+		if (tile_mask.get_nbr_tiles_set () > 0)
+		{
+			render_planes (
+				proc, plane_arr, nbr_planes, w, h, seed, _mode, &tile_mask
+			);
+		}
+		copy_clean_tiles (plane_arr, tile_mask, *hist_sptr);
+	}
+
+	// Publishes the new reference, unless the picture didn't change at all.
+	// When the map and this thread hold the only references to the current
+	// one, the rendered tiles are copied into it in place. Other threads
+	// take their references from the map while holding _mtx_hist, so none
+	// can start reading it during the update. Otherwise the previous
+	// reference may still be in use and a new one is built.
+	if (full_flag || tile_mask.get_nbr_tiles_set () > 0)
+	{
+		if (! full_flag)
+		{
+			std::lock_guard <std::mutex> lock (_mtx_hist);
+			const auto     it = _hist_map.find (hist_slot);
+			if (   it != _hist_map.end ()
+			    && it->second == hist_sptr
+			    && hist_sptr.use_count () == 2)
+			{
+				update_history (*hist_sptr, plane_arr, tile_mask);
+				return;
+			}
 		}
+
+		hist_sptr = build_history (plane_arr, nbr_planes, w, h);
+		std::lock_guard <std::mutex> lock (_mtx_hist);
+		_hist_map [hist_slot] = hist_sptr;
 	}
+}
+
+
+
+// org_x, org_y: position of the planes in the picture, for a part of it
+void	GrainProc::render_planes (FrameProc &proc, const fgrn::GenGrain::PlaneArray &plane_arr, int nbr_planes, int w, int h, uint32_t seed, fgrn::RenderMode mode, const fgrn::TileMask *tile_mask_ptr, int org_x, int org_y)
+{
+	assert (_nbr_layers == 1 || nbr_planes == 1);
+	assert (_scale == 1 || tile_mask_ptr == nullptr);
+	const auto     layer_arr_ptr = (_nbr_layers > 1) ? &_layer_arr : nullptr;
+	const int      dst_w = compute_scaled_size (w, _scale);
+	const int      dst_h = compute_scaled_size (h, _scale);
 
 #if 0 // Single thread
 
-	proc_sptr->_generator.process (
-		reinterpret_cast <      float *> (dst_ptr),
-		reinterpret_cast <const float *> (src_ptr),
-		w, h,
-		dst_stride / sizeof (float),
-		src_stride / sizeof (float),
-		_filter, seed
+	proc._generator.process (
+		plane_arr, nbr_planes, w, h, *_filter_sptr, seed, mode, tile_mask_ptr,
+		layer_arr_ptr, _nbr_layers, dst_w, dst_h, org_x, org_y
 	);
+	collect_stats (proc, 1);
 
 #elif 0 // Multi-thread, standard
 
 	const int      max_nbr_threads = 32;
 
 	// Pass 1
-	const int      nbr_threads = proc_sptr->_generator.mt_start (
-		reinterpret_cast <      float *> (dst_ptr),
-		reinterpret_cast <const float *> (src_ptr),
-		w, h,
-		dst_stride / sizeof (float),
-		src_stride / sizeof (float),
-		_filter, seed, max_nbr_threads
+	const int      nbr_threads = proc._generator.mt_start (
+		plane_arr, nbr_planes, w, h, *_filter_sptr, seed, mode, max_nbr_threads,
+		tile_mask_ptr, layer_arr_ptr, _nbr_layers, dst_w, dst_h, org_x, org_y
 	);
 
 	std::vector <std::thread> thread_arr (nbr_threads);
 
 	for (int t_cnt = 0; t_cnt < nbr_threads; ++t_cnt)
 	{
-		thread_arr [t_cnt] = std::thread ([t_cnt, &proc_sptr] () {
-			proc_sptr->_generator.mt_proc_pass1 (t_cnt);
+		thread_arr [t_cnt] = std::thread ([t_cnt, &proc] () {
+			proc._generator.mt_proc_pass1 (t_cnt);
 		});
 	}
 	for (auto &thread : thread_arr)
@@ -128,14 +951,14 @@ void	GrainProc::process_plane (uint8_t *dst_ptr, ptrdiff_t dst_stride, const uin
 	std::atomic_thread_fence (std::memory_order_seq_cst);
 
 	// Pass 2
-	if (! _draft_flag)
+	if (mode != fgrn::RenderMode_DRAFT)
 	{
-		proc_sptr->_generator.mt_prepare_pass2 ();
+		proc._generator.mt_prepare_pass2 ();
 
 		for (int t_cnt = 0; t_cnt < nbr_threads; ++t_cnt)
 		{
-			thread_arr [t_cnt] = std::thread ([t_cnt, &proc_sptr] () {
-				proc_sptr->_generator.mt_proc_pass2 (t_cnt);
+			thread_arr [t_cnt] = std::thread ([t_cnt, &proc] () {
+				proc._generator.mt_proc_pass2 (t_cnt);
 			});
 		}
 		for (auto &thread : thread_arr)
@@ -144,6 +967,7 @@ void	GrainProc::process_plane (uint8_t *dst_ptr, ptrdiff_t dst_stride, const uin
 		}
 		std::atomic_thread_fence (std::memory_order_seq_cst);
 	}
+	collect_stats (proc, nbr_threads);
 
 #else // Multi-thread, AVSTP
 
@@ -151,20 +975,16 @@ void	GrainProc::process_plane (uint8_t *dst_ptr, ptrdiff_t dst_stride, const uin
 	AvstpScopedDispatcher   dispatcher (_avstp);
 
 	// Pass 1
-	const int      nbr_threads = proc_sptr->_generator.mt_start (
-		reinterpret_cast <      float *> (dst_ptr),
-		reinterpret_cast <const float *> (src_ptr),
-		w, h,
-		dst_stride / sizeof (float),
-		src_stride / sizeof (float),
-		_filter, seed, _draft_flag, max_nbr_threads
+	const int      nbr_threads = proc._generator.mt_start (
+		plane_arr, nbr_planes, w, h, *_filter_sptr, seed, mode, max_nbr_threads,
+		tile_mask_ptr, layer_arr_ptr, _nbr_layers, dst_w, dst_h, org_x, org_y
 	);
-	proc_sptr->_task_list.resize (nbr_threads);
+	proc._task_list.resize (nbr_threads);
 
 	for (int t_cnt = 0; t_cnt < nbr_threads; ++t_cnt)
 	{
-		auto &      task = proc_sptr->_task_list [t_cnt];
-		task._gen_ptr = &proc_sptr->_generator;
+		auto &      task = proc._task_list [t_cnt];
+		task._gen_ptr = &proc._generator;
 		task._pass    = 1;
 		task._tid     = t_cnt;
 		_avstp.enqueue_task (dispatcher._ptr, &redirect_task, &task);
@@ -172,63 +992,492 @@ void	GrainProc::process_plane (uint8_t *dst_ptr, ptrdiff_t dst_stride, const uin
 	_avstp.wait_completion (dispatcher._ptr);
 
 	// Pass 2
-	if (! _draft_flag)
+	if (mode != fgrn::RenderMode_DRAFT)
 	{
-		proc_sptr->_generator.mt_prepare_pass2 ();
+		proc._generator.mt_prepare_pass2 ();
 
 		for (int t_cnt = 0; t_cnt < nbr_threads; ++t_cnt)
 		{
-			auto &      task = proc_sptr->_task_list [t_cnt];
+			auto &      task = proc._task_list [t_cnt];
 			task._pass = 2;
 			_avstp.enqueue_task (dispatcher._ptr, &redirect_task, &task);
 		}
 		_avstp.wait_completion (dispatcher._ptr);
 	}
+	collect_stats (proc, nbr_threads);
 
 #endif // Threading variants
+}
+
+
+
+// Marks the tiles to render, which are the tiles located in the vision
+// filter reach of the changed source pixels.
+// Returns false if all the tiles have to be rendered.
+bool	GrainProc::find_dirty_tiles (fgrn::TileMask &tile_mask, const History &hist, const fgrn::GenGrain::PlaneArray &plane_arr) const
+{
+	const int      w         = hist._w;
+	const int      h         = hist._h;
+	const int      reach     = _filter_sptr->get_reach ();
+	tile_mask.reset (w, h, _tile_size, false);
+	const int      nbr_tiles =
+		tile_mask.get_nbr_tiles_x () * tile_mask.get_nbr_tiles_y ();
+	const int      spl_size  = hist._fmt.get_size ();
+	const auto     len       = size_t (w * spl_size);
+
+	// Bitwise comparison
+	const auto     same_fnc = [spl_size] (const uint8_t *a_ptr, const uint8_t *b_ptr, int x)
+	{
+		const int      pos = x * spl_size;
+		return (memcmp (a_ptr + pos, b_ptr + pos, spl_size) == 0);
+	};
 
-	// Puts back the generator into the pool
+	for (int y = 0; y < h; ++y)
 	{
-		std::lock_guard <std::mutex> lock (_mtx_pool);
-		_proc_pool.push_back (proc_sptr);
+		for (int p_idx = 0; p_idx < hist._nbr_planes; ++p_idx)
+		{
+			const auto &   plane   = plane_arr [p_idx];
+			const auto     src_ptr = plane.use_src_row (y);
+			const auto     ref_ptr = hist._src_arr [p_idx].data () + y * len;
+			if (memcmp (src_ptr, ref_ptr, len) == 0)
+			{
+				continue;
+			}
+
+			// Finds the changed span within each tile
+			for (int x_beg = 0; x_beg < w; x_beg += _tile_size)
+			{
+				const int      x_end   = std::min (x_beg + _tile_size, w);
+				int            x_first = x_beg;
+				while (x_first < x_end && same_fnc (src_ptr, ref_ptr, x_first))
+				{
+					++ x_first;
+				}
+				if (x_first < x_end)
+				{
+					int            x_last = x_end - 1;
+					while (same_fnc (src_ptr, ref_ptr, x_last))
+					{
+						-- x_last;
+					}
+					tile_mask.set_area (
+						x_first - reach, y - reach,
+						x_last + 1 + reach, y + 1 + reach
+					);
+				}
+			}
+		}
+
+		if (tile_mask.get_nbr_tiles_set () == nbr_tiles)
+		{
+			return false;
+		}
 	}
+
+	return true;
 }
 
 
 
-bool	GrainProc::check_sigma (float sigma) noexcept
+void	GrainProc::copy_clean_tiles (const fgrn::GenGrain::PlaneArray &plane_arr, const fgrn::TileMask &tile_mask, const History &hist)
 {
-	return (sigma >= 0 && sigma <= 1);
+	const int      w         = hist._w;
+	const int      h         = hist._h;
+	const int      tile_size = tile_mask.get_tile_size ();
+	const int      nbr_tx    = tile_mask.get_nbr_tiles_x ();
+	const int      nbr_ty    = tile_mask.get_nbr_tiles_y ();
+	const int      spl_size  = hist._fmt.get_size ();
+	const auto     stride    = size_t (w * spl_size);
+
+	for (int ty = 0; ty < nbr_ty; ++ty)
+	{
+		const int      y_beg = ty * tile_size;
+		const int      y_end = std::min (y_beg + tile_size, h);
+
+		// Finds the runs of clean tiles
+		int            tx = 0;
+		while (tx < nbr_tx)
+		{
+			if (tile_mask.is_tile_set (tx, ty))
+			{
+				++ tx;
+				continue;
+			}
+			const int      tx_beg = tx;
+			do
+			{
+				++ tx;
+			}
+			while (tx < nbr_tx && ! tile_mask.is_tile_set (tx, ty));
+			const int      x_beg = tx_beg * tile_size;
+			const int      x_end = std::min (tx * tile_size, w);
+			const auto     pos   = size_t (x_beg * spl_size);
+			const auto     len   = size_t ((x_end - x_beg) * spl_size);
+
+			for (int p_idx = 0; p_idx < hist._nbr_planes; ++p_idx)
+			{
+				const auto &   plane   = plane_arr [p_idx];
+				const auto &   ref_arr = hist._dst_arr [p_idx];
+				for (int y = y_beg; y < y_end; ++y)
+				{
+					memcpy (
+						plane.use_dst_row (y) + pos,
+						ref_arr.data () + y * stride + pos,
+						len
+					);
+				}
+			}
+		}
+	}
 }
 
 
 
-bool	GrainProc::check_res (int res) noexcept
+// Renders only the tiles containing non-null mask values. The mask values
+// are applied by the generator as a grain amount. Other tiles are copied
+// from the source.
+void	GrainProc::process_planes_masked (FrameProc &proc, const fgrn::GenGrain::PlaneArray &plane_arr, int nbr_planes, int w, int h, uint32_t seed)
 {
-	return (res > 0);
+	assert (_scale == 1);
+
+	auto &         tile_mask = proc._tile_mask;
+	find_mask_tiles (tile_mask, plane_arr, nbr_planes, w, h);
+	if (tile_mask.get_nbr_tiles_set () > 0)
+	{
+		render_planes (
+			proc, plane_arr, nbr_planes, w, h, seed, _mode, &tile_mask
+		);
+	}
+	copy_src_tiles (plane_arr, nbr_planes, tile_mask);
 }
 
 
 
-bool	GrainProc::check_rad (float rad) noexcept
+// Marks the tiles containing at least one positive mask value. Planes
+// without mask are rendered entirely.
+void	GrainProc::find_mask_tiles (fgrn::TileMask &tile_mask, const fgrn::GenGrain::PlaneArray &plane_arr, int nbr_planes, int w, int h)
 {
-	return (rad > 0);
+	tile_mask.reset (w, h, _tile_size, false);
+	const int      nbr_tx = tile_mask.get_nbr_tiles_x ();
+
+	std::vector <float> row (w);
+	for (int p_idx = 0; p_idx < nbr_planes; ++p_idx)
+	{
+		const auto &   plane = plane_arr [p_idx];
+		if (plane._msk_ptr == nullptr)
+		{
+			tile_mask.reset (w, h, _tile_size, true);
+			return;
+		}
+
+		for (int y = 0; y < h; ++y)
+		{
+			const int      ty = y / _tile_size;
+			if (tile_mask.get_nbr_tiles_set_row (ty) == nbr_tx)
+			{
+				continue;
+			}
+			fgrn::SplConv::conv_row_to_float (
+				row.data (), plane.use_msk_row (y), plane._msk_fmt, 0, w
+			);
+			for (int tx = 0; tx < nbr_tx; ++tx)
+			{
+				if (! tile_mask.is_tile_set (tx, ty))
+				{
+					const int      x_beg = tx * _tile_size;
+					const int      x_end = std::min (x_beg + _tile_size, w);
+					const auto     it    = std::find_if (
+						row.begin () + x_beg, row.begin () + x_end,
+						[] (float m) { return (m > 0); }
+					);
+					if (it != row.begin () + x_end)
+					{
+						tile_mask.set_tile (tx, ty, true);
+					}
+				}
+			}
+		}
+	}
 }
 
 
 
-bool	GrainProc::check_dev (float dev) noexcept
+// Copies the source into the tiles which are not set.
+// Source and destination share the format, the output is not scaled.
+void	GrainProc::copy_src_tiles (const fgrn::GenGrain::PlaneArray &plane_arr, int nbr_planes, const fgrn::TileMask &tile_mask)
 {
-	return (dev >= 0 && dev <= 1);
+	const int      w         = tile_mask.get_w ();
+	const int      h         = tile_mask.get_h ();
+	const int      tile_size = tile_mask.get_tile_size ();
+	const int      nbr_tx    = tile_mask.get_nbr_tiles_x ();
+	const int      nbr_ty    = tile_mask.get_nbr_tiles_y ();
+
+	for (int ty = 0; ty < nbr_ty; ++ty)
+	{
+		if (tile_mask.get_nbr_tiles_set_row (ty) == nbr_tx)
+		{
+			continue;
+		}
+		const int      y_beg = ty * tile_size;
+		const int      y_end = std::min (y_beg + tile_size, h);
+
+		// Finds the runs of unset tiles
+		int            tx = 0;
+		while (tx < nbr_tx)
+		{
+			if (tile_mask.is_tile_set (tx, ty))
+			{
+				++ tx;
+				continue;
+			}
+			const int      tx_beg = tx;
+			do
+			{
+				++ tx;
+			}
+			while (tx < nbr_tx && ! tile_mask.is_tile_set (tx, ty));
+			const int      x_beg = tx_beg * tile_size;
+			const int      x_end = std::min (tx * tile_size, w);
+
+			for (int p_idx = 0; p_idx < nbr_planes; ++p_idx)
+			{
+				const auto &   plane    = plane_arr [p_idx];
+				assert (plane._src_fmt == plane._dst_fmt);
+				const int      spl_size = plane._src_fmt.get_size ();
+				const auto     pos      = size_t (x_beg * spl_size);
+				const auto     len      = size_t ((x_end - x_beg) * spl_size);
+				for (int y = y_beg; y < y_end; ++y)
+				{
+					memcpy (
+						plane.use_dst_row (y) + pos,
+						plane.use_src_row (y) + pos,
+						len
+					);
+				}
+			}
+		}
+	}
 }
 
 
 
-/*\\\ PROTECTED \\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\*/
+void	GrainProc::set_mask (fgrn::GenGrain::PlaneDesc &plane, const Mask &mask) noexcept
+{
+	if (mask._ptr != nullptr)
+	{
+		assert (mask._fmt.is_valid ());
+		plane._msk_ptr    = mask._ptr;
+		plane._msk_stride = mask._stride / mask._fmt.get_size ();
+		plane._msk_fmt    = mask._fmt;
+	}
+}
 
 
 
-/*\\\ PRIVATE \\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\*/
+bool	GrainProc::has_mask (const fgrn::GenGrain::PlaneArray &plane_arr, int nbr_planes) noexcept
+{
+	return std::any_of (
+		plane_arr.begin (), plane_arr.begin () + nbr_planes,
+		[] (const fgrn::GenGrain::PlaneDesc &plane) {
+			return (plane._msk_ptr != nullptr);
+		}
+	);
+}
+
+
+
+GrainProc::HistorySPtr	GrainProc::build_history (const fgrn::GenGrain::PlaneArray &plane_arr, int nbr_planes, int w, int h)
+{
+	auto           hist_sptr = std::make_shared <History> ();
+	hist_sptr->_w          = w;
+	hist_sptr->_h          = h;
+	hist_sptr->_nbr_planes = nbr_planes;
+	hist_sptr->_fmt        = plane_arr [0]._src_fmt;
+
+	// Source and destination share the format, the output is not scaled
+	const auto     len = size_t (w * hist_sptr->_fmt.get_size ());
+	for (int p_idx = 0; p_idx < nbr_planes; ++p_idx)
+	{
+		const auto &   plane   = plane_arr [p_idx];
+		assert (plane._src_fmt == hist_sptr->_fmt);
+		assert (plane._dst_fmt == hist_sptr->_fmt);
+		auto &         src_arr = hist_sptr->_src_arr [p_idx];
+		auto &         dst_arr = hist_sptr->_dst_arr [p_idx];
+		src_arr.resize (len * size_t (h));
+		dst_arr.resize (len * size_t (h));
+		for (int y = 0; y < h; ++y)
+		{
+			memcpy (src_arr.data () + y * len, plane.use_src_row (y), len);
+			memcpy (dst_arr.data () + y * len, plane.use_dst_row (y), len);
+		}
+	}
+
+	return hist_sptr;
+}
+
+
+
+// Copies the source and destination of the tiles set in tile_mask into
+// the reference. The changed source pixels are all located in these tiles.
+void	GrainProc::update_history (History &hist, const fgrn::GenGrain::PlaneArray &plane_arr, const fgrn::TileMask &tile_mask)
+{
+	const int      spl_size = hist._fmt.get_size ();
+	const auto     len      = size_t (hist._w * spl_size);
+	for (int y = 0; y < hist._h; ++y)
+	{
+		tile_mask.process_row_spans (y, [&] (int x_beg, int x_end)
+		{
+			const auto     pos_row = size_t (x_beg * spl_size);
+			const auto     pos_ref = y * len + pos_row;
+			const auto     cpy_len = size_t ((x_end - x_beg) * spl_size);
+			for (int p_idx = 0; p_idx < hist._nbr_planes; ++p_idx)
+			{
+				const auto &   plane = plane_arr [p_idx];
+				memcpy (
+					hist._src_arr [p_idx].data () + pos_ref,
+					plane.use_src_row (y) + pos_row,
+					cpy_len
+				);
+				memcpy (
+					hist._dst_arr [p_idx].data () + pos_ref,
+					plane.use_dst_row (y) + pos_row,
+					cpy_len
+				);
+			}
+		});
+	}
+}
+
+
+
+GrainProc::LayerArray	GrainProc::make_single_layer (float rad, float dev) noexcept
+{
+	LayerArray     layer_arr;
+	layer_arr [0]._rad_avg    = rad;
+	layer_arr [0]._rad_stddev = dev;
+	layer_arr [0]._weight     = 1;
+
+	return layer_arr;
+}
+
+
+
+// Returns the layer requiring the largest vision filter reach
+int	GrainProc::find_largest_layer (const LayerArray &layer_arr, int nbr_layers) noexcept
+{
+	assert (nbr_layers > 0);
+	assert (nbr_layers <= _max_nbr_layers);
+
+	int            l_max   = 0;
+	float          rad_max = 0;
+	for (int l_idx = 0; l_idx < nbr_layers; ++l_idx)
+	{
+		const auto &   layer = layer_arr [l_idx];
+		const auto     rad   = fgrn::VisionFilter::compute_grain_rad_max (
+			layer._rad_avg, layer._rad_stddev
+		);
+		if (rad > rad_max)
+		{
+			l_max   = l_idx;
+			rad_max = rad;
+		}
+	}
+
+	return l_max;
+}
+
+
+
+uint32_t	GrainProc::compute_seed (int frame_idx, int plane_idx) const noexcept
+{
+	return make_seed (_seed_base, _cf_flag, _cp_flag, frame_idx, plane_idx);
+}
+
+
+
+// Compares the source planes. The same buffer is accepted without reading
+// it. Otherwise a few rows spread over the picture are checked first, so
+// distinct planes are generally rejected after reading only one or two
+// rows. The full comparison is done only for the remaining candidates.
+// The masks must be the same too, because they change the output.
+bool	GrainProc::is_same_src (const fgrn::GenGrain::PlaneDesc &lhs, const fgrn::GenGrain::PlaneDesc &rhs, int w, int h) noexcept
+{
+	if (lhs._src_fmt != rhs._src_fmt || lhs._msk_ptr != rhs._msk_ptr)
+	{
+		return false;
+	}
+	if (lhs._src_ptr == rhs._src_ptr && lhs._src_stride == rhs._src_stride)
+	{
+		return true;
+	}
+
+	const auto     len = size_t (w) * size_t (lhs._src_fmt.get_size ());
+	const auto     is_same_row = [&lhs, &rhs, len] (int y) {
+		return (memcmp (lhs.use_src_row (y), rhs.use_src_row (y), len) == 0);
+	};
+
+	constexpr int  nbr_probes = 8;
+	for (int p_cnt = 0; p_cnt < nbr_probes; ++p_cnt)
+	{
+		if (! is_same_row ((h - 1) * p_cnt / (nbr_probes - 1)))
+		{
+			return false;
+		}
+	}
+
+	for (int y = 0; y < h; ++y)
+	{
+		if (! is_same_row (y))
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+
+
+// Identifies the rendering parameters for the disk cache. The hash must
+// stay stable across the sessions and the platforms. All the parameters
+// are hashed, whatever their values.
+// The code paths round the results differently, so the selected one is
+// part of the parameters.
+uint64_t	GrainProc::compute_param_hash (float sigma, int res, float scale, const LayerArray &layer_arr, int nbr_layers, uint32_t seed, bool cf_flag, bool cp_flag, fgrn::RenderMode mode, fgrn::Transfer::Curve curve, float amount_blk, float amount_wht, bool simd4_flag, bool avx_flag) noexcept
+{
+	const auto     flt_bits = [] (float x) {
+		uint32_t       b;
+		memcpy (&b, &x, sizeof (b));
+		return uint64_t (b);
+	};
+
+	const int      code_path = (avx_flag) ? 2 : (simd4_flag) ? 1 : 0;
+
+	uint64_t       h_val = OutputCache::_key_version;
+	for (auto x : {
+		flt_bits (sigma), uint64_t (res), flt_bits (scale),
+		uint64_t (seed), uint64_t ((cf_flag ? 1 : 0) + (cp_flag ? 2 : 0)),
+		uint64_t (mode), uint64_t (curve),
+		flt_bits (amount_blk), flt_bits (amount_wht),
+		uint64_t (nbr_layers), uint64_t (code_path)
+	})
+	{
+		h_val = fstb::Hash::hash (h_val ^ x);
+	}
+	for (int l_idx = 0; l_idx < nbr_layers; ++l_idx)
+	{
+		const auto &   layer = layer_arr [l_idx];
+		for (auto x : {
+			flt_bits (layer._rad_avg), flt_bits (layer._rad_stddev),
+			flt_bits (layer._weight)
+		})
+		{
+			h_val = fstb::Hash::hash (h_val ^ x);
+		}
+	}
+
+	return h_val;
+}
 
 
 
@@ -240,6 +1489,26 @@ GrainProc::FrameProc::FrameProc (bool simd4_flag, bool avx_flag)
 
 
 
+// Adds the statistics of the last rendering to the processor ones
+void	GrainProc::collect_stats (FrameProc &proc, int nbr_threads)
+{
+	assert (nbr_threads > 0);
+
+	if (! fgrn::RenderStats::_enabled_flag)
+	{
+		return;
+	}
+
+	auto &         stats_arr = proc._stats_arr;
+	stats_arr.resize (std::max (stats_arr.size (), size_t (nbr_threads)));
+	for (int t_cnt = 0; t_cnt < nbr_threads; ++t_cnt)
+	{
+		stats_arr [t_cnt].accumulate (proc._generator.use_stats (t_cnt));
+	}
+}
+
+
+
 void	GrainProc::redirect_task (avstp_TaskDispatcher *dispatcher_ptr, void *data_ptr)
 {
 	fstb::unused (dispatcher_ptr);
@@ -24,12 +24,24 @@ http://sam.zoy.org/wtfpl/COPYING for more details.
 /*\\\ INCLUDE FILES \\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\*/
 
 #include "chkdr/AvstpScopedDispatcher.h"
+#include "chkdr/DiskCache.h"
+#include "chkdr/OutputCache.h"
 #include "fgrn/GenGrain.h"
+#include "fgrn/GrainAtlas.h"
+#include "fgrn/RenderMode.h"
+#include "fgrn/RenderStats.h"
+#include "fgrn/SplFmt.h"
+#include "fgrn/TileMask.h"
+#include "fgrn/Transfer.h"
 #include "fgrn/VisionFilter.h"
+#include "fgrn/VisionFilterPool.h"
 #include "avstp.h"
 
+#include <array>
+#include <map>
 #include <memory>
 #include <mutex>
+#include <string>
 #include <vector>
 
 
@@ -48,15 +60,84 @@ class GrainProc
 
 public:
 
-	explicit       GrainProc (float sigma, int res, float rad, float dev, uint32_t seed, bool cf_flag, bool cp_flag, bool draft_flag, bool simd4_flag, bool avx_flag);
+	// Output cache size when enabled by default, in MiB. See
+	// compute_def_cache_size().
+	static constexpr int _def_cache_size_mib = 128;
+
+	// Default size limit of the disk cache, in MiB
+	static constexpr int _def_cache_dir_size_mib = 4096;
+
+	static constexpr int _max_nbr_layers = fgrn::GenGrain::_max_nbr_layers;
+	typedef fgrn::GenGrain::LayerArray LayerArray;
+
+	explicit       GrainProc (float sigma, int res, float rad, float dev, uint32_t seed, bool cf_flag, bool cp_flag, fgrn::RenderMode mode, int64_t cache_size, const std::string &cache_dir, int64_t cache_dir_size, bool simd4_flag, bool avx_flag);
+	explicit       GrainProc (float sigma, int res, float scale, const LayerArray &layer_arr, int nbr_layers, uint32_t seed, bool cf_flag, bool cp_flag, fgrn::RenderMode mode, fgrn::Transfer::Curve curve, float amount_blk, float amount_wht, int64_t cache_size, const std::string &cache_dir, int64_t cache_dir_size, bool simd4_flag, bool avx_flag);
 	virtual        ~GrainProc () {}
 
-	void           process_plane (uint8_t *dst_ptr, ptrdiff_t dst_stride, const uint8_t *src_ptr, ptrdiff_t src_stride, int w, int h, int frame_idx, int plane_idx);
+	static constexpr int _max_nbr_planes = fgrn::GenGrain::_max_nbr_planes;
+	typedef std::array <uint8_t *, _max_nbr_planes> DstPtrArray;
+	typedef std::array <const uint8_t *, _max_nbr_planes> SrcPtrArray;
+	typedef std::array <ptrdiff_t, _max_nbr_planes> StrideArray;
+	typedef std::array <uint32_t, _max_nbr_planes> SeedArray;
+
+	// Optional grain mask of a plane, with the source size. Values are in
+	// [0 ; 1] (full range for integers). Stride in bytes.
+	class Mask
+	{
+	public:
+		const uint8_t* _ptr    = nullptr;
+		ptrdiff_t      _stride = 0;
+		fgrn::SplFmt   _fmt;
+	};
+	typedef std::array <Mask, _max_nbr_planes> MaskArray;
+
+	// Rendering statistics, one element per thread. Accumulated by the
+	// processing functions, see fgrn::RenderStats.
+	typedef std::vector <fgrn::RenderStats> StatsArray;
+
+	// Rectangular part of a picture, in pixels
+	typedef fgrn::GenGrain::Rect Rect;
+
+	void           process_plane (uint8_t *dst_ptr, ptrdiff_t dst_stride, const uint8_t *src_ptr, ptrdiff_t src_stride, int w, int h, int frame_idx, int plane_idx, fgrn::SplFmt fmt = fgrn::SplFmt::make_float (), const Mask *msk_ptr = nullptr, StatsArray *stats_arr_ptr = nullptr);
+
+	Rect           compute_rect_src (const Rect &rect_dst, int pic_w, int pic_h) const noexcept;
+	void           process_rect (uint8_t *dst_ptr, ptrdiff_t dst_stride, const uint8_t *src_ptr, ptrdiff_t src_stride, const Rect &rect_dst, int pic_w, int pic_h, int frame_idx, int plane_idx, fgrn::SplFmt fmt = fgrn::SplFmt::make_float (), const Mask *msk_ptr = nullptr);
+
+	bool           can_process_frame () const noexcept;
+	void           process_frame (const DstPtrArray &dst_ptr_arr, const StrideArray &dst_stride_arr, const SrcPtrArray &src_ptr_arr, const StrideArray &src_stride_arr, int w, int h, int frame_idx, int nbr_planes, fgrn::SplFmt fmt = fgrn::SplFmt::make_float (), const MaskArray *msk_arr_ptr = nullptr, StatsArray *stats_arr_ptr = nullptr);
+	void           process_density (const DstPtrArray &dst_ptr_arr, const StrideArray &dst_stride_arr, const SrcPtrArray &q_ptr_arr, const StrideArray &q_stride_arr, int w, int h, const SeedArray &seed_arr, int nbr_planes, fgrn::SplFmt dst_fmt = fgrn::SplFmt::make_float ());
+
+	static fgrn::RenderStats
+	               sum_stats (const StatsArray &stats_arr) noexcept;
+
+	static uint32_t
+	               make_seed (uint32_t seed_base, bool cf_flag, bool cp_flag, int frame_idx, int plane_idx) noexcept;
 
 	static bool    check_sigma (float sigma) noexcept;
 	static bool    check_res (int res) noexcept;
 	static bool    check_rad (float rad) noexcept;
 	static bool    check_dev (float dev) noexcept;
+	static bool    check_mode (int mode) noexcept;
+	static bool    check_nbr_layers (int nbr_layers, int mode) noexcept;
+	static bool    check_weights (const LayerArray &layer_arr, int nbr_layers) noexcept;
+	static bool    check_scale (float scale) noexcept;
+	static bool    check_scale_mode (float scale, int mode, int nbr_layers) noexcept;
+	static bool    check_fmt_mode (fgrn::SplFmt fmt, int mode) noexcept;
+	static bool    check_transfer (int curve) noexcept;
+	static bool    check_transfer_mode (int curve, int mode) noexcept;
+	static bool    check_amount (float amount) noexcept;
+	static bool    check_amount_mode (float amount_blk, float amount_wht, int mode, float scale) noexcept;
+	static bool    check_mask_mode (int mode, float scale) noexcept;
+	static bool    check_rect_mode (int mode, float scale) noexcept;
+	static int     compute_scaled_size (int len, float scale) noexcept;
+	static bool    check_cache_size (int cache_size_mib) noexcept;
+	static int     compute_def_cache_size (int mode, bool cf_flag) noexcept;
+	static bool    check_cache_dir (const std::string &cache_dir);
+
+	const OutputCache &
+	               use_output_cache () const noexcept;
+	const DiskCache &
+	               use_disk_cache () const noexcept;
 
 
 
@@ -86,22 +167,105 @@ private:
 		fgrn::GenGrain _generator;
 		std::vector <TaskInfo>
 		               _task_list;
+		fgrn::TileMask _tile_mask;
+
+		// Statistics of the planes rendered since the acquisition
+		StatsArray     _stats_arr;
 	};
 
 	typedef std::shared_ptr <FrameProc> ProcSPtr;
 
+	// Constant seed for all frames only: the last rendered source and output
+	// planes, used as reference to render only the areas that changed.
+	// Once published, the content is modified only by a thread holding
+	// _mtx_hist and the single reference out of the map.
+	class History
+	{
+	public:
+		int            _w          = 0;
+		int            _h          = 0;
+		int            _nbr_planes = 0;
+		fgrn::SplFmt   _fmt;
+
+		// Stride = _w pixels
+		std::array <std::vector <uint8_t>, _max_nbr_planes>
+		               _src_arr;
+		std::array <std::vector <uint8_t>, _max_nbr_planes>
+		               _dst_arr;
+	};
+
+	typedef std::shared_ptr <History> HistorySPtr;
+
+	typedef std::shared_ptr <const fgrn::Transfer> TransferSPtr;
+
+	// Size of the tiles for the temporal reuse, the masks and the picture
+	// parts, in pixels
+	static constexpr int _tile_size = 32;
+	static_assert (_tile_size % fgrn::GrainDensity::_org_align == 0, "");
+
+	// Texture atlas parameters: number of luminance levels, patch and block
+	// sizes, and cross-fade width between the blocks in pixels.
+	static constexpr int _atlas_nbr_levels = 16;
+	static constexpr int _atlas_patch_size = 128;
+	static constexpr int _atlas_block_size = 32;
+	static constexpr int _atlas_overlap    = 8;
+
+	ProcSPtr       acquire_proc ();
+	void           release_proc (ProcSPtr proc_sptr);
+	TransferSPtr   use_transfer (fgrn::SplFmt fmt);
+	void           process_planes (const fgrn::GenGrain::PlaneArray &plane_arr, int nbr_planes, int w, int h, uint32_t seed, int hist_slot, StatsArray *stats_arr_ptr);
+	void           build_atlas ();
+	void           process_planes_temporal (FrameProc &proc, const fgrn::GenGrain::PlaneArray &plane_arr, int nbr_planes, int w, int h, uint32_t seed, int hist_slot);
+	void           render_planes (FrameProc &proc, const fgrn::GenGrain::PlaneArray &plane_arr, int nbr_planes, int w, int h, uint32_t seed, fgrn::RenderMode mode, const fgrn::TileMask *tile_mask_ptr, int org_x = 0, int org_y = 0);
+	bool           find_dirty_tiles (fgrn::TileMask &tile_mask, const History &hist, const fgrn::GenGrain::PlaneArray &plane_arr) const;
+	static void    copy_clean_tiles (const fgrn::GenGrain::PlaneArray &plane_arr, const fgrn::TileMask &tile_mask, const History &hist);
+	void           process_planes_masked (FrameProc &proc, const fgrn::GenGrain::PlaneArray &plane_arr, int nbr_planes, int w, int h, uint32_t seed);
+	static void    find_mask_tiles (fgrn::TileMask &tile_mask, const fgrn::GenGrain::PlaneArray &plane_arr, int nbr_planes, int w, int h);
+	static void    copy_src_tiles (const fgrn::GenGrain::PlaneArray &plane_arr, int nbr_planes, const fgrn::TileMask &tile_mask);
+	static void    set_mask (fgrn::GenGrain::PlaneDesc &plane, const Mask &mask) noexcept;
+	static bool    has_mask (const fgrn::GenGrain::PlaneArray &plane_arr, int nbr_planes) noexcept;
+	static HistorySPtr
+	               build_history (const fgrn::GenGrain::PlaneArray &plane_arr, int nbr_planes, int w, int h);
+	static void    update_history (History &hist, const fgrn::GenGrain::PlaneArray &plane_arr, const fgrn::TileMask &tile_mask);
+	uint32_t       compute_seed (int frame_idx, int plane_idx) const noexcept;
+	static bool    is_same_src (const fgrn::GenGrain::PlaneDesc &lhs, const fgrn::GenGrain::PlaneDesc &rhs, int w, int h) noexcept;
+	static LayerArray
+	               make_single_layer (float rad, float dev) noexcept;
+	static int     find_largest_layer (const LayerArray &layer_arr, int nbr_layers) noexcept;
+	static uint64_t
+	               compute_param_hash (float sigma, int res, float scale, const LayerArray &layer_arr, int nbr_layers, uint32_t seed, bool cf_flag, bool cp_flag, fgrn::RenderMode mode, fgrn::Transfer::Curve curve, float amount_blk, float amount_wht, bool simd4_flag, bool avx_flag) noexcept;
+
+	static void    collect_stats (FrameProc &proc, int nbr_threads);
+
 	static void    redirect_task (avstp_TaskDispatcher *dispatcher_ptr, void *data_ptr);
 
 	bool           _simd4_flag = false;
 	bool           _avx_flag   = false;
 
-	fgrn::VisionFilter
-	               _filter;
+	// Output size / source size. The grain radius is in source pixels, the
+	// vision filter in output pixels.
+	float          _scale      = 1;
+
+	// Grain layers, with normalized weights
+	LayerArray     _layer_arr;
+	int            _nbr_layers = 1;
+
+	// Built for the layer with the largest grains.
+	// Shared with the other instances using the same parameters
+	fgrn::VisionFilterPool::FilterSPtr
+	               _filter_sptr;
 
 	uint32_t       _seed_base  = 12345;
 	bool           _cf_flag    = false; // Constant seed for all frames
 	bool           _cp_flag    = false; // Constant seed for all planes of a frame
-	bool           _draft_flag = false;
+	fgrn::RenderMode
+	               _mode       = fgrn::RenderMode_FULL;
+	fgrn::Transfer::Curve
+	               _curve      = fgrn::Transfer::Curve_LINEAR;
+
+	// Grain amount for black and white sources, see GenGrain::PlaneDesc
+	float          _amount_blk = 1;
+	float          _amount_wht = 1;
 
 	AvstpWrapper & _avstp;
 
@@ -110,6 +274,32 @@ private:
 	std::vector <ProcSPtr>
 	               _proc_pool;
 
+	// Atlas mode only. Built on the first use.
+	fgrn::GrainAtlas
+	               _atlas;
+	std::once_flag _atlas_once;
+
+	// Mutex to lock before accessing _tf_sptr
+	std::mutex     _mtx_tf;
+
+	// Transfer curve with the tables for the last source format used.
+	// nullptr until the first non-linear processing.
+	TransferSPtr   _tf_sptr;
+
+	// Rendered planes, indexed by source content
+	OutputCache    _out_cache;
+
+	// Same, persistent across the sessions
+	DiskCache      _disk_cache;
+
+	// Mutex to lock before accessing the history map
+	std::mutex     _mtx_hist;
+
+	// Reference frames for the temporal reuse. Key is the plane index, or 0
+	// for the joint processing of the frame planes.
+	std::map <int, HistorySPtr>
+	               _hist_map;
+
 
 
 /*\\\ FORBIDDEN MEMBER FUNCTIONS \\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\*/
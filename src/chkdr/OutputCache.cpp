@@ -0,0 +1,347 @@
+/*****************************************************************************
+
+        OutputCache.cpp
+        Author: Laurent de Soras, 2022
+
+--- Legal stuff ---
+
+This program is free software. It comes without any warranty, to
+the extent permitted by applicable law. You can redistribute it
+and/or modify it under the terms of the Do What The Fuck You Want
+To Public License, Version 2, as published by Sam Hocevar. See
+http://sam.zoy.org/wtfpl/COPYING for more details.
+
+*Tab=3***********************************************************************/
+
+
+
+
+/*\\\ INCLUDE FILES \\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\*/
+
+#include "chkdr/OutputCache.h"
+#include "fstb/Hash.h"
+
+#include <cassert>
+#include <cstring>
+
+
+
+namespace chkdr
+{
+
+
+
+/*\\\ PUBLIC \\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\*/
+
+
+
+// budget: maximum size in bytes of the stored planes. 0 disables the cache.
+OutputCache::OutputCache (int64_t budget)
+:	_budget (budget)
+{
+	assert (budget >= 0);
+}
+
+
+
+bool	OutputCache::is_enabled () const noexcept
+{
+	return (_budget > 0);
+}
+
+
+
+OutputCache::Key	OutputCache::compute_key (const fgrn::GenGrain::PlaneArray &plane_arr, int nbr_planes, int w, int h, uint32_t seed) noexcept
+{
+	assert (nbr_planes > 0);
+	assert (nbr_planes <= _max_nbr_planes);
+	assert (w > 0);
+	assert (h > 0);
+
+	Key            key;
+	key._seed       = seed;
+	key._w          = w;
+	key._h          = h;
+	key._nbr_planes = nbr_planes;
+	key._dst_fmt    = plane_arr [0]._dst_fmt;
+
+	// Both hashes see the same data, from different initial states
+	uint64_t       h_val = _key_version;
+	uint64_t       h_chk = ~uint64_t (_key_version);
+	const auto     mix   = [&h_val, &h_chk] (uint64_t x)
+	{
+		h_val = fstb::Hash::hash (h_val ^ x);
+		h_chk = fstb::Hash::hash (h_chk ^ x);
+	};
+	mix (uint64_t (seed));
+	mix ((uint64_t (w) << 32) | uint64_t (h));
+	mix (uint64_t (nbr_planes));
+	for (int p_idx = 0; p_idx < nbr_planes; ++p_idx)
+	{
+		const auto &   plane    = plane_arr [p_idx];
+		const int      spl_size = plane._src_fmt.get_size ();
+		assert (plane._dst_fmt == key._dst_fmt);
+
+		mix (
+			  (uint64_t (plane._src_fmt.get_id ()) << 16)
+			|  uint64_t (plane._dst_fmt.get_id ())
+		);
+		hash_plane (
+			h_val, h_chk, plane.use_src_row (0), plane._src_stride * spl_size,
+			w * spl_size, h
+		);
+
+		// The mask changes the output
+		const bool     msk_flag = (plane._msk_ptr != nullptr);
+		mix (msk_flag ? uint64_t (plane._msk_fmt.get_id ()) + 1 : 0);
+		if (msk_flag)
+		{
+			const int      msk_size = plane._msk_fmt.get_size ();
+			hash_plane (
+				h_val, h_chk, plane.use_msk_row (0), plane._msk_stride * msk_size,
+				w * msk_size, h
+			);
+		}
+	}
+	key._hash     = h_val;
+	key._hash_chk = h_chk;
+
+	return key;
+}
+
+
+
+// Copies the rendered planes into the destination planes of plane_arr.
+// Returns false if the key was not found.
+bool	OutputCache::fetch (const Key &key, const fgrn::GenGrain::PlaneArray &plane_arr)
+{
+	assert (is_enabled ());
+
+	EntrySPtr      entry_sptr;
+	{
+		std::lock_guard <std::mutex> lock (_mtx);
+		const auto     it = _entry_map.find (key._hash);
+		if (it != _entry_map.end () && is_same_key ((*it->second)->_key, key))
+		{
+			// Moves the entry to the front of the LRU list
+			_lru_list.splice (_lru_list.begin (), _lru_list, it->second);
+			entry_sptr = *it->second;
+		}
+	}
+
+	if (entry_sptr == nullptr)
+	{
+		++ _nbr_misses;
+		return false;
+	}
+
+	// The entry is immutable, we can copy it outside the lock
+	const auto     len = size_t (key._w * key._dst_fmt.get_size ());
+	for (int p_idx = 0; p_idx < key._nbr_planes; ++p_idx)
+	{
+		const auto &   plane   = plane_arr [p_idx];
+		const auto &   ref_arr = entry_sptr->_dst_arr [p_idx];
+		for (int y = 0; y < key._h; ++y)
+		{
+			memcpy (plane.use_dst_row (y), ref_arr.data () + y * len, len);
+		}
+	}
+	++ _nbr_hits;
+
+	return true;
+}
+
+
+
+// Stores the destination planes of plane_arr
+void	OutputCache::store (const Key &key, const fgrn::GenGrain::PlaneArray &plane_arr)
+{
+	assert (is_enabled ());
+
+	const int      h    = key._h;
+	const auto     len  = size_t (key._w * key._dst_fmt.get_size ());
+	const auto     size = int64_t (len) * int64_t (h) * key._nbr_planes;
+	if (size > _budget)
+	{
+		return;
+	}
+
+	auto           entry_sptr = std::make_shared <Entry> ();
+	entry_sptr->_key  = key;
+	entry_sptr->_size = size;
+	for (int p_idx = 0; p_idx < key._nbr_planes; ++p_idx)
+	{
+		const auto &   plane   = plane_arr [p_idx];
+		auto &         dst_arr = entry_sptr->_dst_arr [p_idx];
+		dst_arr.resize (len * size_t (h));
+		for (int y = 0; y < h; ++y)
+		{
+			memcpy (dst_arr.data () + y * len, plane.use_dst_row (y), len);
+		}
+	}
+
+	std::lock_guard <std::mutex> lock (_mtx);
+
+	// Replaces the previous entry with the same hash, if any
+	const auto     it = _entry_map.find (key._hash);
+	if (it != _entry_map.end ())
+	{
+		_size -= (*it->second)->_size;
+		_lru_list.erase (it->second);
+		_entry_map.erase (it);
+	}
+
+	evict (_budget - size);
+
+	_lru_list.push_front (entry_sptr);
+	_entry_map [key._hash] = _lru_list.begin ();
+	_size += size;
+}
+
+
+
+int64_t	OutputCache::get_budget () const noexcept
+{
+	return _budget;
+}
+
+
+
+int64_t	OutputCache::get_size () const
+{
+	std::lock_guard <std::mutex> lock (_mtx);
+
+	return _size;
+}
+
+
+
+int64_t	OutputCache::get_nbr_hits () const noexcept
+{
+	return _nbr_hits.load ();
+}
+
+
+
+int64_t	OutputCache::get_nbr_misses () const noexcept
+{
+	return _nbr_misses.load ();
+}
+
+
+
+/*\\\ PROTECTED \\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\*/
+
+
+
+/*\\\ PRIVATE \\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\*/
+
+
+
+bool	OutputCache::is_same_key (const Key &lhs, const Key &rhs) noexcept
+{
+	return (
+		   lhs._hash       == rhs._hash
+		&& lhs._hash_chk   == rhs._hash_chk
+		&& lhs._seed       == rhs._seed
+		&& lhs._w          == rhs._w
+		&& lhs._h          == rhs._h
+		&& lhs._nbr_planes == rhs._nbr_planes
+		&& lhs._dst_fmt    == rhs._dst_fmt
+	);
+}
+
+
+
+// Updates both hashes with the plane content. Rows are read as 64-bit
+// words, accumulated into 4 independent lanes to keep the multiplier
+// pipeline busy. The check hash uses other constants and rotated words, so
+// it is independent from the main hash. Bitwise data is hashed, so -0 and
+// +0 are different.
+// stride and len (row length) are in bytes. The tail of the rows is read as
+// 32-bit words, then bytes.
+void	OutputCache::hash_plane (uint64_t &h_val, uint64_t &h_chk, const uint8_t *ptr, ptrdiff_t stride, int len, int h) noexcept
+{
+	assert (ptr != nullptr);
+	assert (len > 0);
+	assert (h > 0);
+
+	constexpr uint64_t   mul     = 0x9E3779B97F4A7C15ULL;
+	constexpr uint64_t   mul_chk = 0xC2B2AE3D27D4EB4FULL;
+	constexpr int  nbr_lanes = 4;
+	constexpr int  wrd_size  = int (sizeof (uint32_t));
+	constexpr int  blk_size  = int (sizeof (uint64_t)) * nbr_lanes;
+	const int      len_blk   = len & ~(blk_size - 1);
+	const int      len_wrd   = len & ~(wrd_size - 1);
+
+	std::array <uint64_t, nbr_lanes> lane_arr {
+		h_val, h_val + 1, h_val + 2, h_val + 3
+	};
+	std::array <uint64_t, nbr_lanes> chk_arr {
+		h_chk, h_chk + 1, h_chk + 2, h_chk + 3
+	};
+	const auto     acc = [&lane_arr, &chk_arr] (int l, uint64_t word)
+	{
+		auto &         lane = lane_arr [l];
+		lane  = (lane ^ word) * mul;
+		lane ^= lane >> 29;
+		auto &         chk  = chk_arr [l];
+		chk   = (chk ^ ((word << 32) | (word >> 32))) * mul_chk;
+		chk  ^= chk >> 31;
+	};
+
+	for (int y = 0; y < h; ++y)
+	{
+		const auto     row_ptr = ptr + y * stride;
+		int            pos     = 0;
+		for ( ; pos < len_blk; pos += blk_size)
+		{
+			for (int l = 0; l < nbr_lanes; ++l)
+			{
+				uint64_t       word;
+				memcpy (&word, row_ptr + pos + l * sizeof (word), sizeof (word));
+				acc (l, word);
+			}
+		}
+		for ( ; pos < len; pos += wrd_size)
+		{
+			uint32_t       word = 0;
+			memcpy (
+				&word, row_ptr + pos,
+				(pos < len_wrd) ? size_t (wrd_size) : size_t (len - pos)
+			);
+			acc ((pos / wrd_size) & (nbr_lanes - 1), word);
+		}
+	}
+
+	h_val = 0;
+	h_chk = 0;
+	for (int l = 0; l < nbr_lanes; ++l)
+	{
+		h_val = fstb::Hash::hash (h_val ^ lane_arr [l]);
+		h_chk = fstb::Hash::hash (h_chk ^ chk_arr [l]);
+	}
+}
+
+
+
+// Removes the least recently used entries until the cache size is lower or
+// equal to the target. Call with the mutex locked.
+void	OutputCache::evict (int64_t size_target)
+{
+	while (_size > size_target && ! _lru_list.empty ())
+	{
+		const auto &   entry_sptr = _lru_list.back ();
+		_size -= entry_sptr->_size;
+		_entry_map.erase (entry_sptr->_key._hash);
+		_lru_list.pop_back ();
+	}
+}
+
+
+
+}  // namespace chkdr
+
+
+
+/*\\\ EOF \\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\*/
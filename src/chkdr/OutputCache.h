@@ -0,0 +1,170 @@
+/*****************************************************************************
+
+        OutputCache.h
+        Author: Laurent de Soras, 2022
+
+Content-addressed cache of rendered planes. Keys are computed from the
+source planes and the seed, so an exact repetition of a source frame can be
+served without rendering it again.
+A key contains two independent 64-bit hashes of the source content, and
+both must match for a hit. Different sources giving the same key are not
+detected otherwise, but the probability of such a collision is negligible
+(about 2^-128 for a pair of frames).
+The cache has a byte budget and evicts the least recently used entries.
+All functions are thread-safe.
+
+--- Legal stuff ---
+
+This program is free software. It comes without any warranty, to
+the extent permitted by applicable law. You can redistribute it
+and/or modify it under the terms of the Do What The Fuck You Want
+To Public License, Version 2, as published by Sam Hocevar. See
+http://sam.zoy.org/wtfpl/COPYING for more details.
+
+*Tab=3***********************************************************************/
+
+
+
+#pragma once
+#if ! defined (chkdr_OutputCache_HEADER_INCLUDED)
+#define chkdr_OutputCache_HEADER_INCLUDED
+
+
+
+/*\\\ INCLUDE FILES \\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\*/
+
+#include "fgrn/GenGrain.h"
+
+#include <array>
+#include <atomic>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include <cstdint>
+
+
+
+namespace chkdr
+{
+
+
+
+class OutputCache
+{
+
+/*\\\ PUBLIC \\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\*/
+
+public:
+
+	static constexpr int _max_nbr_planes = fgrn::GenGrain::_max_nbr_planes;
+
+	// Version of the key and parameter hash computations. To be incremented
+	// when they change, so the persistent entries of the previous versions
+	// are not used anymore.
+	static constexpr uint32_t _key_version = 2;
+
+	// Identifies a source frame and its rendering parameters
+	class Key
+	{
+	public:
+		uint64_t       _hash       = 0;
+		uint64_t       _hash_chk   = 0; // Independent hash, checks _hash
+		uint32_t       _seed       = 0;
+		int            _w          = 0;
+		int            _h          = 0;
+		int            _nbr_planes = 0;
+		fgrn::SplFmt   _dst_fmt;
+	};
+
+	explicit       OutputCache (int64_t budget);
+
+	bool           is_enabled () const noexcept;
+	static Key     compute_key (const fgrn::GenGrain::PlaneArray &plane_arr, int nbr_planes, int w, int h, uint32_t seed) noexcept;
+	bool           fetch (const Key &key, const fgrn::GenGrain::PlaneArray &plane_arr);
+	void           store (const Key &key, const fgrn::GenGrain::PlaneArray &plane_arr);
+
+	int64_t        get_budget () const noexcept;
+	int64_t        get_size () const;
+	int64_t        get_nbr_hits () const noexcept;
+	int64_t        get_nbr_misses () const noexcept;
+
+
+
+/*\\\ PROTECTED \\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\*/
+
+protected:
+
+
+
+/*\\\ PRIVATE \\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\*/
+
+private:
+
+	// Rendered planes, stride = _key._w pixels. Immutable once stored.
+	class Entry
+	{
+	public:
+		Key            _key;
+		std::array <std::vector <uint8_t>, _max_nbr_planes>
+		               _dst_arr;
+		int64_t        _size = 0; // Bytes
+	};
+	typedef std::shared_ptr <const Entry> EntrySPtr;
+
+	// Most recently used first
+	typedef std::list <EntrySPtr> EntryList;
+	typedef std::unordered_map <uint64_t, EntryList::iterator> EntryMap;
+
+	static bool    is_same_key (const Key &lhs, const Key &rhs) noexcept;
+	static void    hash_plane (uint64_t &h_val, uint64_t &h_chk, const uint8_t *ptr, ptrdiff_t stride, int len, int h) noexcept;
+	void           evict (int64_t size_target);
+
+	// Maximum size of the stored data, in bytes. 0 = disabled
+	int64_t        _budget = 0;
+
+	// Mutex to lock before accessing the entries
+	mutable std::mutex
+	               _mtx;
+	EntryList      _lru_list;
+	EntryMap       _entry_map;
+	int64_t        _size   = 0; // Bytes
+
+	std::atomic <int64_t>
+	               _nbr_hits   { 0 };
+	std::atomic <int64_t>
+	               _nbr_misses { 0 };
+
+
+
+/*\\\ FORBIDDEN MEMBER FUNCTIONS \\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\*/
+
+private:
+
+	               OutputCache ()                               = delete;
+	               OutputCache (const OutputCache &other)       = delete;
+	               OutputCache (OutputCache &&other)            = delete;
+	OutputCache &  operator = (const OutputCache &other)        = delete;
+	OutputCache &  operator = (OutputCache &&other)             = delete;
+	bool           operator == (const OutputCache &other) const = delete;
+	bool           operator != (const OutputCache &other) const = delete;
+
+}; // class OutputCache
+
+
+
+}  // namespace chkdr
+
+
+
+//#include "chkdr/OutputCache.hpp"
+
+
+
+#endif   // chkdr_OutputCache_HEADER_INCLUDED
+
+
+
+/*\\\ EOF \\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\*/
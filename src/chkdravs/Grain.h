@@ -62,6 +62,14 @@ public:
 		Param_CF,
 		Param_CP,
 		Param_DRAFT,
+		Param_CACHE,
+		Param_CACHE_DIR,
+		Param_CACHE_DIR_SIZE,
+		Param_WEIGHT,
+		Param_SCALE,
+		Param_TRANSFER,
+		Param_AMOUNT,
+		Param_MASK,
 		Param_CPUOPT,
 
 		Param_NBR_ELT,
@@ -95,10 +103,35 @@ private:
 		explicit       CpuOpt (const ::AVSValue &arg);
 	};
 
+	// Frames fetched once in GetFrame() and passed to do_process_plane(),
+	// and statistics collected over the planes
+	class FrameCtx
+	{
+	public:
+		::PVideoFrame  _src_sptr;
+		::PVideoFrame  _msk_sptr; // Can be empty
+		chkdr::GrainProc::StatsArray
+		               _stats_arr;
+	};
+
+	static bool    conv_arg_to_vflt (std::vector <float> &val_arr, const ::AVSValue &arg, float def_val);
+	chkdr::GrainProc::Mask
+	               make_mask (const ::PVideoFrame &msk_sptr, int plane_index) const;
+	static void    set_stats_props (::PVideoFrame &dst_sptr, ::IScriptEnvironment &env, const chkdr::GrainProc::StatsArray &stats_arr);
+	static bool    conv_fmt (fgrn::SplFmt &spl_fmt, const ::VideoInfo &vi) noexcept;
+
 	::PClip        _clip_src_sptr;
 	const ::VideoInfo
 	               _vi_src;
 
+	// Sample format of both clips
+	fgrn::SplFmt   _spl_fmt;
+
+	// Optional grain mask, with the sample format of its clip. A single
+	// plane mask is used for all the planes.
+	::PClip        _clip_msk_sptr;
+	fgrn::SplFmt   _msk_fmt;
+
 	std::unique_ptr <avsutl::PlaneProcessor>
 	               _plane_proc_uptr;
 
@@ -18,12 +18,18 @@ http://sam.zoy.org/wtfpl/COPYING for more details.
 
 /*\\\ INCLUDE FILES \\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\*/
 
+#include "avsutl/CsPlane.h"
 #include "avsutl/fnc.h"
 #include "chkdravs/function_names.h"
 #include "chkdravs/Grain.h"
 #include "fstb/def.h"
 
+#include <algorithm>
+#include <string>
+#include <vector>
+
 #include <cassert>
+#include <cstdlib>
 
 
 
@@ -50,24 +56,40 @@ Grain::Grain (::IScriptEnvironment &env, const ::AVSValue &args)
 		env.ThrowError (chkdravs_GRAIN ": input must be planar.");
 	}
 
-	if (! (avsutl::is_rgb (vi) || vi.IsY ()))
+	if (! (avsutl::is_rgb (vi) || vi.IsY () || vi.IsYUV ()))
 	{
-		env.ThrowError (chkdravs_GRAIN ": only linear RGB and Y colorformats are supported.");
+		env.ThrowError (chkdravs_GRAIN ": only RGB, Y and YUV colorformats are supported.");
 	}
+	// Integer luma is taken as full range, whatever _ColorRange
+	const bool     luma_only_flag = (vi.IsYUV () && ! vi.IsY ());
 
-	if (vi.BitsPerComponent () != 32)
+	// The samples are converted on the fly by the generator, so there is no
+	// need for an intermediate float clip.
+	if (! conv_fmt (_spl_fmt, vi))
 	{
-		env.ThrowError (chkdravs_GRAIN ": only 32-bit float data type is supported.");
+		env.ThrowError (chkdravs_GRAIN ": only 8- to 16-bit integer and 32-bit float data types are supported.");
 	}
 
 	const auto     sigma   = float (args [Param_SIGMA].AsFloat (0.35f));
 	const auto     res     =        args [Param_RES  ].AsInt (1024);
-	const auto     rad     = float (args [Param_RAD  ].AsFloat (0.025f));
-	const auto     dev     = float (args [Param_DEV  ].AsFloat (0));
 	const auto     seed    = uint32_t (args [Param_SEED].AsInt (12345));
 	const auto     cf_flag = args [Param_CF].AsBool (false);
 	const auto     cp_flag = args [Param_CP].AsBool (false);
-	const auto     draft_flag = args [Param_DRAFT].AsBool (false);
+	// draft was initially a boolean, keep accepting it
+	const auto &   draft_arg = args [Param_DRAFT];
+	const auto     mode    =
+		  (draft_arg.IsBool ()) ? ((draft_arg.AsBool ()) ? 1 : 0)
+		:                         draft_arg.AsInt (0);
+	const auto     cache   = args [Param_CACHE].AsInt (
+		chkdr::GrainProc::compute_def_cache_size (mode, cf_flag)
+	);
+	const auto     scale   = float (args [Param_SCALE].AsFloat (1));
+	const std::string cache_dir = args [Param_CACHE_DIR].AsString ("");
+	const auto     cache_dir_size = args [Param_CACHE_DIR_SIZE].AsInt (
+		chkdr::GrainProc::_def_cache_dir_size_mib
+	);
+	const std::string transfer = args [Param_TRANSFER].AsString ("linear");
+	const int      curve   = fgrn::Transfer::find_curve (transfer);
 
 	if (! chkdr::GrainProc::check_sigma (sigma))
 	{
@@ -77,14 +99,152 @@ Grain::Grain (::IScriptEnvironment &env, const ::AVSValue &args)
 	{
 		env.ThrowError (chkdravs_GRAIN ": res must be > 0.");
 	}
-	if (! chkdr::GrainProc::check_rad (rad))
+	// One grain layer per rad element. rad, dev and weight accept a single
+	// number or a string containing a list of numbers. Missing dev and weight
+	// elements are copied from the last specified one.
+	std::vector <float> rad_arr;
+	std::vector <float> dev_arr;
+	std::vector <float> wgt_arr;
+	if (   ! conv_arg_to_vflt (rad_arr, args [Param_RAD   ], 0.025f)
+	    || ! conv_arg_to_vflt (dev_arr, args [Param_DEV   ], 0)
+	    || ! conv_arg_to_vflt (wgt_arr, args [Param_WEIGHT], 1))
+	{
+		env.ThrowError (chkdravs_GRAIN ": rad, dev or weight: invalid number list.");
+	}
+	const int      nbr_layers = int (rad_arr.size ());
+	if (nbr_layers > chkdr::GrainProc::_max_nbr_layers)
+	{
+		env.ThrowError (chkdravs_GRAIN ": rad must have 1 to 3 elements.");
+	}
+	if (   int (dev_arr.size ()) > nbr_layers
+	    || int (wgt_arr.size ()) > nbr_layers)
+	{
+		env.ThrowError (chkdravs_GRAIN ": dev and weight cannot have more elements than rad.");
+	}
+	chkdr::GrainProc::LayerArray layer_arr;
+	for (int l_idx = 0; l_idx < nbr_layers; ++l_idx)
+	{
+		auto &         layer = layer_arr [l_idx];
+		layer._rad_avg    = rad_arr [l_idx];
+		layer._rad_stddev = dev_arr [std::min (l_idx, int (dev_arr.size ()) - 1)];
+		layer._weight     = wgt_arr [std::min (l_idx, int (wgt_arr.size ()) - 1)];
+		if (! chkdr::GrainProc::check_rad (layer._rad_avg))
+		{
+			env.ThrowError (chkdravs_GRAIN ": rad must be > 0.");
+		}
+		if (! chkdr::GrainProc::check_dev (layer._rad_stddev))
+		{
+			env.ThrowError (chkdravs_GRAIN ": dev must be in range [0 ; 1]");
+		}
+	}
+	if (! chkdr::GrainProc::check_weights (layer_arr, nbr_layers))
+	{
+		env.ThrowError (chkdravs_GRAIN ": weight must be >= 0, with a positive sum.");
+	}
+	if (! chkdr::GrainProc::check_mode (mode))
+	{
+		env.ThrowError (chkdravs_GRAIN ": draft must be in range [0 ; 3]");
+	}
+	if (! chkdr::GrainProc::check_nbr_layers (nbr_layers, mode))
+	{
+		env.ThrowError (chkdravs_GRAIN ": several grain layers require draft = 0.");
+	}
+	if (! chkdr::GrainProc::check_scale (scale))
+	{
+		env.ThrowError (chkdravs_GRAIN ": scale must be in range [0.125 ; 8].");
+	}
+	if (! chkdr::GrainProc::check_scale_mode (scale, mode, nbr_layers))
+	{
+		env.ThrowError (chkdravs_GRAIN ": scale requires draft = 0 and a single grain layer.");
+	}
+	if (luma_only_flag && scale != 1)
+	{
+		env.ThrowError (chkdravs_GRAIN ": scale is not available for YUV clips.");
+	}
+	if (! chkdr::GrainProc::check_fmt_mode (_spl_fmt, mode))
+	{
+		env.ThrowError (chkdravs_GRAIN ": draft = 3 requires 32-bit float data.");
+	}
+	if (! chkdr::GrainProc::check_transfer (curve))
+	{
+		env.ThrowError (chkdravs_GRAIN ": transfer must be \"linear\", \"srgb\", \"bt1886\" or \"pq\".");
+	}
+	if (! chkdr::GrainProc::check_transfer_mode (curve, mode))
+	{
+		env.ThrowError (chkdravs_GRAIN ": draft = 3 requires transfer = \"linear\".");
+	}
+	// Grain amount for black and white sources, a number or a string of
+	// 2 numbers. A single value is used for both.
+	std::vector <float> amt_arr;
+	if (! conv_arg_to_vflt (amt_arr, args [Param_AMOUNT], 1))
+	{
+		env.ThrowError (chkdravs_GRAIN ": amount: invalid number list.");
+	}
+	if (amt_arr.size () > 2)
+	{
+		env.ThrowError (chkdravs_GRAIN ": amount must have 1 or 2 elements.");
+	}
+	const auto     amount_blk = amt_arr.front ();
+	const auto     amount_wht = amt_arr.back ();
+	// Mask clip
+	if (args [Param_MASK].Defined ())
+	{
+		_clip_msk_sptr = args [Param_MASK].AsClip ();
+		const auto &   vi_msk = _clip_msk_sptr->GetVideoInfo ();
+		if (   ! vi_msk.IsPlanar ()
+		    || vi_msk.width  != vi.width
+		    || vi_msk.height != vi.height)
+		{
+			env.ThrowError (chkdravs_GRAIN ": mask must be planar, with the size of the clip.");
+		}
+		// Subsampled planes must match
+		const bool     sub_flag = (vi.IsYUV () && ! vi.IsY ());
+		const bool     same_flag =
+			   vi_msk.NumComponents () == vi.NumComponents ()
+			&& (   ! sub_flag
+			    || (   vi_msk.IsYUV ()
+			        &&    vi_msk.GetPlaneWidthSubsampling (PLANAR_U)
+			           == vi.GetPlaneWidthSubsampling (PLANAR_U)
+			        &&    vi_msk.GetPlaneHeightSubsampling (PLANAR_U)
+			           == vi.GetPlaneHeightSubsampling (PLANAR_U)));
+		if (! vi_msk.IsY () && ! same_flag)
+		{
+			env.ThrowError (chkdravs_GRAIN ": mask must be Y or have the same planes as the clip.");
+		}
+		if (! conv_fmt (_msk_fmt, vi_msk))
+		{
+			env.ThrowError (chkdravs_GRAIN ": mask has an unsupported data type.");
+		}
+		if (! chkdr::GrainProc::check_mask_mode (mode, scale))
+		{
+			env.ThrowError (chkdravs_GRAIN ": mask requires draft != 3 and scale = 1.");
+		}
+	}
+	if (   ! chkdr::GrainProc::check_amount (amount_blk)
+	    || ! chkdr::GrainProc::check_amount (amount_wht))
+	{
+		env.ThrowError (chkdravs_GRAIN ": amount must be in range [0 ; 1].");
+	}
+	if (! chkdr::GrainProc::check_amount_mode (amount_blk, amount_wht, mode, scale))
+	{
+		env.ThrowError (chkdravs_GRAIN ": amount < 1 requires draft != 3 and scale = 1.");
+	}
+	if (! chkdr::GrainProc::check_cache_size (cache))
 	{
-		env.ThrowError (chkdravs_GRAIN ": rad must be > 0.");
+		env.ThrowError (chkdravs_GRAIN ": cache must be >= 0.");
 	}
-	if (! chkdr::GrainProc::check_dev (dev))
+	if (! chkdr::GrainProc::check_cache_dir (cache_dir))
 	{
-		env.ThrowError (chkdravs_GRAIN ": dev must be in range [0 ; 1]");
+		env.ThrowError (chkdravs_GRAIN ": cache_dir must be an existing directory.");
 	}
+	if (! chkdr::GrainProc::check_cache_size (cache_dir_size))
+	{
+		env.ThrowError (chkdravs_GRAIN ": cache_dir_size must be >= 0.");
+	}
+
+	// Output size
+	vi.width  = chkdr::GrainProc::compute_scaled_size (vi.width , scale);
+	vi.height = chkdr::GrainProc::compute_scaled_size (vi.height, scale);
 
 	// Configures the plane processor
 	_plane_proc_uptr =
@@ -93,9 +253,25 @@ Grain::Grain (::IScriptEnvironment &env, const ::AVSValue &args)
 		avsutl::PlaneProcessor::ClipIdx_SRC1, _clip_src_sptr
 	);
 	_plane_proc_uptr->set_proc_mode ("all");
+	if (luma_only_flag)
+	{
+		// YUV: grain on the luma plane only, the other planes are copied
+		const int      nbr_planes = _plane_proc_uptr->get_nbr_planes ();
+		for (int plane_index = 1; plane_index < nbr_planes; ++plane_index)
+		{
+			_plane_proc_uptr->set_proc_mode (
+				plane_index, double (avsutl::PlaneProcMode_COPY1)
+			);
+		}
+	}
 
 	_proc_uptr = std::make_unique <chkdr::GrainProc> (
-		sigma, res, rad, dev, seed, cf_flag, cp_flag, draft_flag,
+		sigma, res, scale, layer_arr, nbr_layers, seed, cf_flag, cp_flag,
+		static_cast <fgrn::RenderMode> (mode),
+		static_cast <fgrn::Transfer::Curve> (curve),
+		amount_blk, amount_wht,
+		int64_t (cache) << 20,
+		cache_dir, int64_t (cache_dir_size) << 20,
 		simd4_flag, avx_flag
 	);
 }
@@ -104,10 +280,71 @@ Grain::Grain (::IScriptEnvironment &env, const ::AVSValue &args)
 
 ::PVideoFrame __stdcall	Grain::GetFrame (int n, ::IScriptEnvironment *env_ptr)
 {
-	::PVideoFrame  src_sptr = _clip_src_sptr->GetFrame (n, env_ptr);
-	::PVideoFrame	dst_sptr = build_new_frame (*env_ptr, vi, &src_sptr);
+	// The source and mask frames are fetched only once for all the planes
+	FrameCtx       ctx;
+	ctx._src_sptr = _clip_src_sptr->GetFrame (n, env_ptr);
+	if (_clip_msk_sptr)
+	{
+		ctx._msk_sptr = _clip_msk_sptr->GetFrame (n, env_ptr);
+	}
+	const ::PVideoFrame &   src_sptr = ctx._src_sptr;
+	const ::PVideoFrame &   msk_sptr = ctx._msk_sptr;
+	::PVideoFrame	dst_sptr = build_new_frame (*env_ptr, vi, &ctx._src_sptr);
+
+	const int      nbr_planes = avsutl::PlaneProcessor::get_nbr_planes (vi);
+	if (   _proc_uptr->can_process_frame ()
+	    && avsutl::is_rgb (vi)
+	    && nbr_planes == chkdr::GrainProc::_max_nbr_planes)
+	{
+		// All the planes share the same grains, render them at once
+		chkdr::GrainProc::DstPtrArray dst_ptr_arr {};
+		chkdr::GrainProc::SrcPtrArray src_ptr_arr {};
+		chkdr::GrainProc::StrideArray dst_stride_arr {};
+		chkdr::GrainProc::StrideArray src_stride_arr {};
+		chkdr::GrainProc::MaskArray   msk_arr;
+		for (int plane_index = 0; plane_index < nbr_planes; ++plane_index)
+		{
+			msk_arr [plane_index]        = make_mask (msk_sptr, plane_index);
+			const int      plane_id =
+				avsutl::CsPlane::get_plane_id (plane_index, vi);
+			dst_ptr_arr [plane_index]    = dst_sptr->GetWritePtr (plane_id);
+			dst_stride_arr [plane_index] = dst_sptr->GetPitch (plane_id);
+			src_ptr_arr [plane_index]    = src_sptr->GetReadPtr (plane_id);
+			src_stride_arr [plane_index] = src_sptr->GetPitch (plane_id);
+		}
+		const int      w = vi.width;
+		const int      h = vi.height;
+
+		try
+		{
+			_proc_uptr->process_frame (
+				dst_ptr_arr, dst_stride_arr,
+				src_ptr_arr, src_stride_arr,
+				w, h,
+				n, nbr_planes,
+				_spl_fmt,
+				(msk_sptr) ? &msk_arr : nullptr,
+				&ctx._stats_arr
+			);
+		}
+
+		catch (...)
+		{
+			assert (false);
+		}
+	}
+	else
+	{
+		// The copied planes use the fetched source frame too
+		avsutl::PlaneProcessor::FrameArray src_arr;
+		src_arr [avsutl::PlaneProcessor::ClipIdx_SRC1] = ctx._src_sptr;
+		_plane_proc_uptr->process_frame (dst_sptr, n, *env_ptr, &ctx, &src_arr);
+	}
 
-	_plane_proc_uptr->process_frame (dst_sptr, n, *env_ptr, nullptr);
+	if (fgrn::RenderStats::_enabled_flag && supports_props ())
+	{
+		set_stats_props (dst_sptr, *env_ptr, ctx._stats_arr);
+	}
 
 	return dst_sptr;
 }
@@ -120,18 +357,22 @@ Grain::Grain (::IScriptEnvironment &env, const ::AVSValue &args)
 
 void	Grain::do_process_plane (::PVideoFrame &dst_sptr, int n, ::IScriptEnvironment &env, int plane_index, int plane_id, void *ctx_ptr)
 {
-	fstb::unused (ctx_ptr);
+	fstb::unused (env);
+	assert (ctx_ptr != nullptr);
 
-	::PVideoFrame  src_sptr     = _clip_src_sptr->GetFrame (n, &env);
+	auto &         ctx          = *static_cast <FrameCtx *> (ctx_ptr);
+	const ::PVideoFrame &   src_sptr = ctx._src_sptr;
+	const auto     mask         = make_mask (ctx._msk_sptr, plane_index);
 
 	uint8_t *      data_dst_ptr = dst_sptr->GetWritePtr (plane_id);
 	const int      stride_dst   = dst_sptr->GetPitch (plane_id);
 	const uint8_t* data_src_ptr = src_sptr->GetReadPtr (plane_id);
 	const int      stride_src   = src_sptr->GetPitch (plane_id);
+	// Source size, the output may be scaled
 	const int      w = _plane_proc_uptr->get_width (
-		dst_sptr, plane_id, avsutl::PlaneProcessor::ClipIdx_DST
+		src_sptr, plane_id, avsutl::PlaneProcessor::ClipIdx_SRC1
 	);
-	const int      h = _plane_proc_uptr->get_height (dst_sptr, plane_id);
+	const int      h = _plane_proc_uptr->get_height (src_sptr, plane_id);
 
 	try
 	{
@@ -139,7 +380,10 @@ void	Grain::do_process_plane (::PVideoFrame &dst_sptr, int n, ::IScriptEnvironme
 			data_dst_ptr, stride_dst,
 			data_src_ptr, stride_src,
 			w, h,
-			n, plane_index
+			n, plane_index,
+			_spl_fmt,
+			(mask._ptr != nullptr) ? &mask : nullptr,
+			&ctx._stats_arr
 		);
 	}
 
@@ -164,6 +408,123 @@ Grain::CpuOpt::CpuOpt (const ::AVSValue &arg)
 
 
 
+// Counter totals, and pass times per thread in s
+void	Grain::set_stats_props (::PVideoFrame &dst_sptr, ::IScriptEnvironment &env, const chkdr::GrainProc::StatsArray &stats_arr)
+{
+	::AVSMap *     props_ptr = env.getFramePropsRW (dst_sptr);
+	const auto     stats     = chkdr::GrainProc::sum_stats (stats_arr);
+	for (int cnt = 0; cnt < fgrn::RenderStats::Cnt_NBR_ELT; ++cnt)
+	{
+		const auto     cnt_e = static_cast <fgrn::RenderStats::Cnt> (cnt);
+		const auto     name  =
+			std::string ("_ChkdrStats") + fgrn::RenderStats::get_name (cnt_e);
+		env.propSetInt (
+			props_ptr, name.c_str (), stats._cnt_arr [cnt],
+			::PROPAPPENDMODE_REPLACE
+		);
+	}
+
+	if (! stats_arr.empty ())
+	{
+		std::vector <double> pass1_arr;
+		std::vector <double> pass2_arr;
+		for (const auto &stats_thr : stats_arr)
+		{
+			pass1_arr.push_back (stats_thr._pass1_s);
+			pass2_arr.push_back (stats_thr._pass2_s);
+		}
+		const int      nbr_threads = int (stats_arr.size ());
+		env.propSetFloatArray (props_ptr, "_ChkdrStatsPass1", pass1_arr.data (), nbr_threads);
+		env.propSetFloatArray (props_ptr, "_ChkdrStatsPass2", pass2_arr.data (), nbr_threads);
+	}
+}
+
+
+
+// Returns an empty mask if msk_sptr is null
+chkdr::GrainProc::Mask	Grain::make_mask (const ::PVideoFrame &msk_sptr, int plane_index) const
+{
+	chkdr::GrainProc::Mask  mask;
+	if (msk_sptr)
+	{
+		const auto &   vi_msk   = _clip_msk_sptr->GetVideoInfo ();
+		const int      m_idx    = std::min (
+			plane_index, avsutl::PlaneProcessor::get_nbr_planes (vi_msk) - 1
+		);
+		const int      plane_id = avsutl::CsPlane::get_plane_id (m_idx, vi_msk);
+		mask._ptr    = msk_sptr->GetReadPtr (plane_id);
+		mask._stride = msk_sptr->GetPitch (plane_id);
+		mask._fmt    = _msk_fmt;
+	}
+
+	return mask;
+}
+
+
+
+// Returns false if the format is not supported. AviSynth has no half-float
+// type.
+bool	Grain::conv_fmt (fgrn::SplFmt &spl_fmt, const ::VideoInfo &vi) noexcept
+{
+	const int      bits = vi.BitsPerComponent ();
+	if (bits == 32)
+	{
+		spl_fmt = fgrn::SplFmt::make_float ();
+	}
+	else if (bits >= 8 && bits <= 16)
+	{
+		spl_fmt = fgrn::SplFmt::make_int (bits);
+	}
+	else
+	{
+		return false;
+	}
+
+	return true;
+}
+
+
+
+// Accepts a number or a string of numbers separated with spaces or commas.
+// Undefined argument: returns def_val only.
+// Returns false if the string is empty or contains something else.
+bool	Grain::conv_arg_to_vflt (std::vector <float> &val_arr, const ::AVSValue &arg, float def_val)
+{
+	val_arr.clear ();
+
+	if (arg.IsString ())
+	{
+		const char *   cur_0 = arg.AsString ();
+		for ( ; ; )
+		{
+			while (*cur_0 == ' ' || *cur_0 == ',' || *cur_0 == '\t')
+			{
+				++ cur_0;
+			}
+			if (*cur_0 == '\0')
+			{
+				break;
+			}
+			char *         end_0 = nullptr;
+			const auto     val   = strtod (cur_0, &end_0);
+			if (end_0 == cur_0)
+			{
+				return false;
+			}
+			val_arr.push_back (float (val));
+			cur_0 = end_0;
+		}
+	}
+	else
+	{
+		val_arr.push_back (float (arg.AsFloat (def_val)));
+	}
+
+	return (! val_arr.empty ());
+}
+
+
+
 }  // namespace chkdravs
 
 
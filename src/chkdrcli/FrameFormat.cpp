@@ -0,0 +1,160 @@
+/*****************************************************************************
+
+        FrameFormat.cpp
+        Author: Laurent de Soras, 2022
+
+--- Legal stuff ---
+
+This program is free software. It comes without any warranty, to
+the extent permitted by applicable law. You can redistribute it
+and/or modify it under the terms of the Do What The Fuck You Want
+To Public License, Version 2, as published by Sam Hocevar. See
+http://sam.zoy.org/wtfpl/COPYING for more details.
+
+*Tab=3***********************************************************************/
+
+
+
+/*\\\ INCLUDE FILES \\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\*/
+
+#include "chkdrcli/FrameFormat.h"
+
+#include <cassert>
+#include <cstdlib>
+
+
+
+namespace chkdrcli
+{
+
+
+
+/*\\\ PUBLIC \\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\*/
+
+
+
+const char *	FrameFormat::_y4m_stream_0 = "YUV4MPEG2";
+const char *	FrameFormat::_y4m_frame_0  = "FRAME";
+
+
+
+bool	FrameFormat::is_valid () const noexcept
+{
+	return (
+		   _w > 0 && _h > 0
+		&& (_nbr_planes == 1 || _nbr_planes == _max_nbr_planes)
+	);
+}
+
+
+
+// In pixels
+int64_t	FrameFormat::get_plane_size () const noexcept
+{
+	assert (is_valid ());
+
+	return int64_t (_w) * int64_t (_h);
+}
+
+
+
+// In bytes, without the Y4M frame header
+int64_t	FrameFormat::get_frame_size () const noexcept
+{
+	assert (is_valid ());
+
+	return get_plane_size () * _nbr_planes * int64_t (sizeof (float));
+}
+
+
+
+// line: stream header, without the terminating line feed.
+// Returns false if the header is invalid or the colorspace is not supported.
+bool	FrameFormat::parse_y4m_header (const std::string &line)
+{
+	_w          = 0;
+	_h          = 0;
+	_nbr_planes = 0;
+	_y4m_flag   = true;
+	_y4m_tags.clear ();
+
+	size_t         pos = line.find (' ');
+	if (line.substr (0, pos) != _y4m_stream_0)
+	{
+		return false;
+	}
+
+	while (pos != std::string::npos)
+	{
+		const size_t   beg = pos + 1;
+		pos = line.find (' ', beg);
+		const auto     tag = line.substr (beg, pos - beg);
+		if (tag.empty ())
+		{
+			continue;
+		}
+
+		const auto     val = tag.substr (1);
+		switch (tag [0])
+		{
+		case 'W':
+			_w = atoi (val.c_str ());
+			break;
+		case 'H':
+			_h = atoi (val.c_str ());
+			break;
+		case 'C':
+			if (val == "grayf32")
+			{
+				_nbr_planes = 1;
+			}
+			else if (val == "gbrpf32")
+			{
+				_nbr_planes = 3;
+			}
+			else
+			{
+				return false;
+			}
+			break;
+		default:
+			_y4m_tags += ' ';
+			_y4m_tags += tag;
+			break;
+		}
+	}
+
+	// The default colorspace (4:2:0) is not supported
+	return is_valid ();
+}
+
+
+
+// Without the terminating line feed
+std::string	FrameFormat::build_y4m_header () const
+{
+	assert (is_valid ());
+
+	return
+		  std::string (_y4m_stream_0)
+		+ " W" + std::to_string (_w)
+		+ " H" + std::to_string (_h)
+		+ ((_nbr_planes == 1) ? " Cgrayf32" : " Cgbrpf32")
+		+ _y4m_tags;
+}
+
+
+
+/*\\\ PROTECTED \\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\*/
+
+
+
+/*\\\ PRIVATE \\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\*/
+
+
+
+}  // namespace chkdrcli
+
+
+
+/*\\\ EOF \\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\*/
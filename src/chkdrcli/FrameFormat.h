@@ -0,0 +1,115 @@
+/*****************************************************************************
+
+        FrameFormat.h
+        Author: Laurent de Soras, 2022
+
+Layout of a stream of 32-bit float planar frames, either raw or Y4M.
+
+Raw streams are frames stored one after the other, without any header.
+Each frame is made of planes of w * h pixels, with stride = w.
+
+Y4M streams use the float colorspace extensions:
+- Cgrayf32: single plane
+- Cgbrpf32: 3 planes, in the G, B, R order
+The other stream header tags are kept unchanged.
+
+--- Legal stuff ---
+
+This program is free software. It comes without any warranty, to
+the extent permitted by applicable law. You can redistribute it
+and/or modify it under the terms of the Do What The Fuck You Want
+To Public License, Version 2, as published by Sam Hocevar. See
+http://sam.zoy.org/wtfpl/COPYING for more details.
+
+*Tab=3***********************************************************************/
+
+
+
+#pragma once
+#if ! defined (chkdrcli_FrameFormat_HEADER_INCLUDED)
+#define chkdrcli_FrameFormat_HEADER_INCLUDED
+
+
+
+/*\\\ INCLUDE FILES \\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\*/
+
+#include <string>
+
+#include <cstdint>
+
+
+
+namespace chkdrcli
+{
+
+
+
+class FrameFormat
+{
+
+/*\\\ PUBLIC \\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\*/
+
+public:
+
+	static constexpr int _max_nbr_planes = 3;
+
+	// Signatures of the stream and frame headers
+	static const char *
+	               _y4m_stream_0;
+	static const char *
+	               _y4m_frame_0;
+
+	int            _w          = 0;
+	int            _h          = 0;
+	int            _nbr_planes = 1;
+	bool           _y4m_flag   = false;
+
+	// Y4M only: stream header tags other than W, H and C, each one with its
+	// leading space.
+	std::string    _y4m_tags;
+
+	bool           is_valid () const noexcept;
+	int64_t        get_plane_size () const noexcept;
+	int64_t        get_frame_size () const noexcept;
+
+	bool           parse_y4m_header (const std::string &line);
+	std::string    build_y4m_header () const;
+
+
+
+/*\\\ PROTECTED \\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\*/
+
+protected:
+
+
+
+/*\\\ PRIVATE \\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\*/
+
+private:
+
+
+
+/*\\\ FORBIDDEN MEMBER FUNCTIONS \\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\*/
+
+private:
+
+	bool           operator == (const FrameFormat &other) const = delete;
+	bool           operator != (const FrameFormat &other) const = delete;
+
+}; // class FrameFormat
+
+
+
+}  // namespace chkdrcli
+
+
+
+//#include "chkdrcli/FrameFormat.hpp"
+
+
+
+#endif   // chkdrcli_FrameFormat_HEADER_INCLUDED
+
+
+
+/*\\\ EOF \\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\*/
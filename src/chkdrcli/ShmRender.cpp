@@ -0,0 +1,383 @@
+/*****************************************************************************
+
+        ShmRender.cpp
+        Author: Laurent de Soras, 2022
+
+--- Legal stuff ---
+
+This program is free software. It comes without any warranty, to
+the extent permitted by applicable law. You can redistribute it
+and/or modify it under the terms of the Do What The Fuck You Want
+To Public License, Version 2, as published by Sam Hocevar. See
+http://sam.zoy.org/wtfpl/COPYING for more details.
+
+*Tab=3***********************************************************************/
+
+
+
+/*\\\ INCLUDE FILES \\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\*/
+
+#include "chkdrcli/ShmRender.h"
+
+#if fstb_SYS != fstb_SYS_WIN
+
+#include "chkdr/GrainProc.h"
+
+#if defined (__linux__)
+	#include <sys/prctl.h>
+#endif
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <signal.h>
+#include <unistd.h>
+
+#include <new>
+#include <stdexcept>
+
+#include <cassert>
+#include <cerrno>
+#include <ctime>
+
+
+
+namespace chkdrcli
+{
+
+
+
+/*\\\ PUBLIC \\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\*/
+
+
+
+// proc should be fully set up, it is duplicated in each worker.
+// Throws std::runtime_error if the shared area or the workers cannot be
+// created.
+ShmRender::ShmRender (chkdr::GrainProc &proc, const FrameFormat &fmt, int nbr_procs)
+:	_proc (proc)
+,	_fmt (fmt)
+,	_nbr_procs (nbr_procs)
+{
+	assert (fmt.is_valid ());
+	assert (nbr_procs > 0);
+
+	const auto     round_up = [] (size_t x) {
+		return (x + _align - 1) & ~(_align - 1);
+	};
+	const auto     frame_len = size_t (_fmt.get_frame_size ());
+	_ofs_src = round_up (
+		sizeof (Control) + sizeof (WorkerCtl) * size_t (_nbr_procs)
+	);
+	_ofs_dst = _ofs_src + round_up (frame_len);
+	_map_len = _ofs_dst + round_up (frame_len);
+
+	void *         map_ptr = mmap (
+		nullptr, _map_len, PROT_READ | PROT_WRITE,
+		MAP_SHARED | MAP_ANONYMOUS, -1, 0
+	);
+	if (map_ptr == MAP_FAILED)
+	{
+		throw std::runtime_error ("cannot allocate the shared memory.");
+	}
+	_map_ptr = static_cast <uint8_t *> (map_ptr);
+
+	_ctl_ptr = new (_map_ptr) Control;
+	for (int w_idx = 0; w_idx < _nbr_procs; ++w_idx)
+	{
+		new (&use_worker_ctl (w_idx)) WorkerCtl;
+	}
+
+	bool           ok_flag = (sem_init (&_ctl_ptr->_sem_done, 1, 0) == 0);
+	if (ok_flag)
+	{
+		++ _nbr_sem;
+	}
+	for (int w_idx = 0; w_idx < _nbr_procs && ok_flag; ++w_idx)
+	{
+		ok_flag = (sem_init (&use_worker_ctl (w_idx)._sem_start, 1, 0) == 0);
+		if (ok_flag)
+		{
+			++ _nbr_sem;
+		}
+	}
+	if (! ok_flag)
+	{
+		release_shm ();
+		throw std::runtime_error ("cannot create the shared semaphores.");
+	}
+
+	_pid_arr.reserve (_nbr_procs);
+	for (int w_idx = 0; w_idx < _nbr_procs; ++w_idx)
+	{
+		const pid_t    pid = fork ();
+		if (pid == 0)
+		{
+			worker_loop (w_idx);
+		}
+		else if (pid < 0)
+		{
+			stop_workers ();
+			release_shm ();
+			throw std::runtime_error ("cannot create the worker processes.");
+		}
+		_pid_arr.push_back (pid);
+	}
+}
+
+
+
+ShmRender::~ShmRender ()
+{
+	stop_workers ();
+	release_shm ();
+}
+
+
+
+// Source frame to fill before calling process_frame(), planes contiguous,
+// without padding.
+float *	ShmRender::use_src () const noexcept
+{
+	return reinterpret_cast <float *> (_map_ptr + _ofs_src);
+}
+
+
+
+// Frame rendered by the last process_frame() call, same layout as the source
+const float *	ShmRender::use_dst () const noexcept
+{
+	return reinterpret_cast <const float *> (_map_ptr + _ofs_dst);
+}
+
+
+
+// Throws std::runtime_error if a worker fails
+void	ShmRender::process_frame (int frame_idx)
+{
+	assert (frame_idx >= 0);
+
+	if (_pid_arr.empty ())
+	{
+		throw std::runtime_error ("worker processes stopped.");
+	}
+
+	_ctl_ptr->_frame_idx = frame_idx;
+	for (int w_idx = 0; w_idx < _nbr_procs; ++w_idx)
+	{
+		auto &         w_ctl = use_worker_ctl (w_idx);
+		w_ctl._err_flag = 0;
+		sem_post (&w_ctl._sem_start);
+	}
+
+	wait_completion ();
+
+	for (int w_idx = 0; w_idx < _nbr_procs; ++w_idx)
+	{
+		if (use_worker_ctl (w_idx)._err_flag != 0)
+		{
+			throw std::runtime_error ("worker process failed to render a frame.");
+		}
+	}
+}
+
+
+
+/*\\\ PROTECTED \\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\*/
+
+
+
+/*\\\ PRIVATE \\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\*/
+
+
+
+ShmRender::WorkerCtl &	ShmRender::use_worker_ctl (int w_idx) const noexcept
+{
+	assert (w_idx >= 0);
+	assert (w_idx < _nbr_procs);
+
+	return reinterpret_cast <WorkerCtl *> (_map_ptr + sizeof (Control)) [w_idx];
+}
+
+
+
+// Runs in the forked process, never returns. Only the shared area is
+// modified, the process exits without running the destructors.
+void	ShmRender::worker_loop (int w_idx) noexcept
+{
+#if defined (__linux__)
+	// Exits if the coordinator dies without stopping the workers
+	prctl (PR_SET_PDEATHSIG, SIGTERM);
+#endif
+
+	auto &         w_ctl = use_worker_ctl (w_idx);
+	for ( ; ; )
+	{
+		while (sem_wait (&w_ctl._sem_start) != 0)
+		{
+			if (errno != EINTR)
+			{
+				_exit (1);
+			}
+		}
+
+		const int      frame_idx = _ctl_ptr->_frame_idx;
+		if (frame_idx < 0)
+		{
+			_exit (0);
+		}
+
+		try
+		{
+			render_band (w_idx, frame_idx);
+		}
+		catch (...)
+		{
+			w_ctl._err_flag = 1;
+		}
+
+		sem_post (&_ctl_ptr->_sem_done);
+	}
+}
+
+
+
+// Band of full-width rows, for all the planes
+void	ShmRender::render_band (int w_idx, int frame_idx)
+{
+	const int      w     = _fmt._w;
+	const int      h     = _fmt._h;
+	const int      y_beg = int (int64_t (h) *  w_idx      / _nbr_procs);
+	const int      y_end = int (int64_t (h) * (w_idx + 1) / _nbr_procs);
+	if (y_end <= y_beg)
+	{
+		return;
+	}
+
+	chkdr::GrainProc::Rect  rect_dst;
+	rect_dst._x = 0;
+	rect_dst._y = y_beg;
+	rect_dst._w = w;
+	rect_dst._h = y_end - y_beg;
+	const auto     rect_src   = _proc.compute_rect_src (rect_dst, w, h);
+	const auto     plane_size = _fmt.get_plane_size ();
+	const auto     stride     = ptrdiff_t (w * sizeof (float));
+	const float *  src_ptr    = use_src ();
+	float *        dst_ptr    = reinterpret_cast <float *> (_map_ptr + _ofs_dst);
+	for (int plane_idx = 0; plane_idx < _fmt._nbr_planes; ++plane_idx)
+	{
+		const auto     ofs = plane_idx * plane_size;
+		_proc.process_rect (
+			reinterpret_cast <uint8_t *> (dst_ptr + ofs + y_beg * w),
+			stride,
+			reinterpret_cast <const uint8_t *> (
+				src_ptr + ofs + rect_src._y * w + rect_src._x
+			),
+			stride,
+			rect_dst, w, h, frame_idx, plane_idx
+		);
+	}
+}
+
+
+
+// Waits for one completion per worker. Throws std::runtime_error if a
+// worker has terminated meanwhile.
+void	ShmRender::wait_completion ()
+{
+	int            nbr_done = 0;
+	while (nbr_done < _nbr_procs)
+	{
+		timespec       ts;
+		clock_gettime (CLOCK_REALTIME, &ts);
+		ts.tv_nsec += long (_poll_ms) * 1000000L;
+		if (ts.tv_nsec >= 1000000000L)
+		{
+			ts.tv_nsec -= 1000000000L;
+			++ ts.tv_sec;
+		}
+
+		if (sem_timedwait (&_ctl_ptr->_sem_done, &ts) == 0)
+		{
+			++ nbr_done;
+		}
+		else if (errno == ETIMEDOUT)
+		{
+			for (const auto pid : _pid_arr)
+			{
+				int            status = 0;
+				if (waitpid (pid, &status, WNOHANG) != 0)
+				{
+					// The other workers cannot be resynchronised
+					stop_workers ();
+					throw std::runtime_error (
+						"worker process terminated unexpectedly."
+					);
+				}
+			}
+		}
+		else if (errno != EINTR)
+		{
+			throw std::runtime_error ("cannot wait for the worker processes.");
+		}
+	}
+}
+
+
+
+void	ShmRender::stop_workers () noexcept
+{
+	if (_pid_arr.empty ())
+	{
+		return;
+	}
+
+	_ctl_ptr->_frame_idx = -1;
+	for (int w_idx = 0; w_idx < int (_pid_arr.size ()); ++w_idx)
+	{
+		sem_post (&use_worker_ctl (w_idx)._sem_start);
+	}
+	for (const auto pid : _pid_arr)
+	{
+		int            status = 0;
+		while (waitpid (pid, &status, 0) < 0 && errno == EINTR)
+		{
+			continue;
+		}
+	}
+	_pid_arr.clear ();
+}
+
+
+
+void	ShmRender::release_shm () noexcept
+{
+	if (_map_ptr == nullptr)
+	{
+		return;
+	}
+
+	if (_nbr_sem > 0)
+	{
+		sem_destroy (&_ctl_ptr->_sem_done);
+	}
+	for (int w_idx = 0; w_idx < _nbr_sem - 1; ++w_idx)
+	{
+		sem_destroy (&use_worker_ctl (w_idx)._sem_start);
+	}
+	_nbr_sem = 0;
+
+	munmap (_map_ptr, _map_len);
+	_map_ptr = nullptr;
+	_ctl_ptr = nullptr;
+}
+
+
+
+}  // namespace chkdrcli
+
+
+
+#endif   // fstb_SYS
+
+
+
+/*\\\ EOF \\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\*/
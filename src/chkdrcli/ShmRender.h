@@ -0,0 +1,176 @@
+/*****************************************************************************
+
+        ShmRender.h
+        Author: Laurent de Soras, 2022
+
+Renders frames with several worker processes on the same machine. POSIX
+only.
+
+The source frame, the output frame and a small control block are located
+in a shared memory area, mapped before the workers are forked. Each frame
+is split into horizontal bands, one per worker, rendered with
+GrainProc::process_rect() directly into the shared output. The band
+sources overlap by the vision filter reach, so each worker computes the
+grain density of its own area and the workers don't exchange any data.
+
+Completion protocol, with process-shared semaphores: the coordinator posts
+the start semaphore of each worker, which renders its band, reports its
+status and posts the completion semaphore. The coordinator waits for one
+completion per worker. A negative frame index makes the workers exit.
+
+The workers are forked during the construction, so the coordinator should
+not have started any other thread at this point.
+
+--- Legal stuff ---
+
+This program is free software. It comes without any warranty, to
+the extent permitted by applicable law. You can redistribute it
+and/or modify it under the terms of the Do What The Fuck You Want
+To Public License, Version 2, as published by Sam Hocevar. See
+http://sam.zoy.org/wtfpl/COPYING for more details.
+
+*Tab=3***********************************************************************/
+
+
+
+#pragma once
+#if ! defined (chkdrcli_ShmRender_HEADER_INCLUDED)
+#define chkdrcli_ShmRender_HEADER_INCLUDED
+
+
+
+/*\\\ INCLUDE FILES \\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\*/
+
+#include "chkdrcli/FrameFormat.h"
+#include "fstb/def.h"
+
+#if fstb_SYS != fstb_SYS_WIN
+
+#include <semaphore.h>
+#include <sys/types.h>
+
+#include <vector>
+
+#include <cstddef>
+#include <cstdint>
+
+
+
+namespace chkdr
+{
+	class GrainProc;
+}
+
+namespace chkdrcli
+{
+
+
+
+class ShmRender
+{
+
+/*\\\ PUBLIC \\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\*/
+
+public:
+
+	explicit       ShmRender (chkdr::GrainProc &proc, const FrameFormat &fmt, int nbr_procs);
+	               ~ShmRender ();
+
+	float *        use_src () const noexcept;
+	const float *  use_dst () const noexcept;
+	void           process_frame (int frame_idx);
+
+
+
+/*\\\ PROTECTED \\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\*/
+
+protected:
+
+
+
+/*\\\ PRIVATE \\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\*/
+
+private:
+
+	// Alignment of the shared frames, in bytes
+	static constexpr size_t _align = 64;
+
+	// Time between two checks of the worker states while waiting, in ms
+	static constexpr int _poll_ms = 100;
+
+	// Located at the beginning of the shared area
+	class Control
+	{
+	public:
+		int            _frame_idx = 0; // < 0: the workers exit
+		sem_t          _sem_done;
+	};
+
+	// One per worker, just after the Control block
+	class WorkerCtl
+	{
+	public:
+		sem_t          _sem_start;
+		int            _err_flag = 0;
+	};
+
+	WorkerCtl &    use_worker_ctl (int w_idx) const noexcept;
+	[[noreturn]] void
+	               worker_loop (int w_idx) noexcept;
+	void           render_band (int w_idx, int frame_idx);
+	void           wait_completion ();
+	void           stop_workers () noexcept;
+	void           release_shm () noexcept;
+
+	chkdr::GrainProc &
+	               _proc;
+	const FrameFormat
+	               _fmt;
+	const int      _nbr_procs;
+
+	// Shared area
+	uint8_t *      _map_ptr = nullptr;
+	size_t         _map_len = 0;
+	Control *      _ctl_ptr = nullptr;
+	size_t         _ofs_src = 0; // Bytes from _map_ptr
+	size_t         _ofs_dst = 0;
+
+	// Number of semaphores initialised, the done semaphore first
+	int            _nbr_sem = 0;
+
+	std::vector <pid_t>
+	               _pid_arr;
+
+
+
+/*\\\ FORBIDDEN MEMBER FUNCTIONS \\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\*/
+
+private:
+
+	               ShmRender ()                               = delete;
+	               ShmRender (const ShmRender &other)         = delete;
+	               ShmRender (ShmRender &&other)              = delete;
+	ShmRender &    operator = (const ShmRender &other)        = delete;
+	ShmRender &    operator = (ShmRender &&other)             = delete;
+	bool           operator == (const ShmRender &other) const = delete;
+	bool           operator != (const ShmRender &other) const = delete;
+
+}; // class ShmRender
+
+
+
+}  // namespace chkdrcli
+
+
+
+//#include "chkdrcli/ShmRender.hpp"
+
+
+
+#endif   // fstb_SYS
+
+#endif   // chkdrcli_ShmRender_HEADER_INCLUDED
+
+
+
+/*\\\ EOF \\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\*/
@@ -0,0 +1,462 @@
+/*****************************************************************************
+
+        StreamProc.cpp
+        Author: Laurent de Soras, 2022
+
+--- Legal stuff ---
+
+This program is free software. It comes without any warranty, to
+the extent permitted by applicable law. You can redistribute it
+and/or modify it under the terms of the Do What The Fuck You Want
+To Public License, Version 2, as published by Sam Hocevar. See
+http://sam.zoy.org/wtfpl/COPYING for more details.
+
+*Tab=3***********************************************************************/
+
+
+
+/*\\\ INCLUDE FILES \\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\*/
+
+#include "chkdr/GrainProc.h"
+#include "chkdrcli/ShmRender.h"
+#include "chkdrcli/StreamProc.h"
+
+#include <chrono>
+#include <exception>
+#include <stdexcept>
+#include <thread>
+
+#include <cassert>
+#include <cstring>
+
+
+
+namespace chkdrcli
+{
+
+
+
+/*\\\ PUBLIC \\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\*/
+
+
+
+// fmt_dst: same as fmt_src, with the output size.
+// The stream headers should have been read and written by the caller.
+// shm_ptr: optional multi-process renderer, set up for fmt_src. Requires a
+// single worker and an output of the same size.
+StreamProc::StreamProc (chkdr::GrainProc &proc, const FrameFormat &fmt_src, const FrameFormat &fmt_dst, FILE &f_src, FILE &f_dst, int nbr_workers, bool verbose_flag, ShmRender *shm_ptr)
+:	_proc (proc)
+,	_fmt_src (fmt_src)
+,	_fmt_dst (fmt_dst)
+,	_f_src (f_src)
+,	_f_dst (f_dst)
+,	_nbr_workers (nbr_workers)
+,	_verbose_flag (verbose_flag)
+,	_shm_ptr (shm_ptr)
+,	_slot_arr (nbr_workers + 2)
+{
+	assert (fmt_src.is_valid ());
+	assert (fmt_dst.is_valid ());
+	assert (fmt_dst._nbr_planes == fmt_src._nbr_planes);
+	assert (fmt_dst._y4m_flag == fmt_src._y4m_flag);
+	assert (nbr_workers > 0);
+	assert (shm_ptr == nullptr || nbr_workers == 1);
+	assert (
+		   shm_ptr == nullptr
+		|| fmt_dst.get_plane_size () == fmt_src.get_plane_size ()
+	);
+
+	for (auto &slot : _slot_arr)
+	{
+		slot._src.resize (size_t (_fmt_src.get_plane_size () * _fmt_src._nbr_planes));
+		slot._dst.resize (size_t (_fmt_dst.get_plane_size () * _fmt_dst._nbr_planes));
+	}
+}
+
+
+
+// Processes the whole stream. Throws std::runtime_error on failure.
+void	StreamProc::run ()
+{
+	std::vector <std::thread> thread_arr;
+	thread_arr.emplace_back (&StreamProc::read_loop, this);
+	for (int w_idx = 0; w_idx < _nbr_workers; ++w_idx)
+	{
+		thread_arr.emplace_back (&StreamProc::render_loop, this);
+	}
+	write_loop ();
+	for (auto &t : thread_arr)
+	{
+		t.join ();
+	}
+
+	if (! _err_msg.empty ())
+	{
+		throw std::runtime_error (_err_msg);
+	}
+	if (fflush (&_f_dst) != 0)
+	{
+		throw std::runtime_error ("cannot write the output stream.");
+	}
+}
+
+
+
+int	StreamProc::get_nbr_frames () const noexcept
+{
+	return _nbr_written;
+}
+
+
+
+// Reads a text line and removes the line feed.
+// Returns false if the end of the file is reached before any character.
+bool	StreamProc::read_line (std::string &line, FILE &f)
+{
+	// Y4M headers are short, this is only a safety limit
+	constexpr size_t  max_len = 4096;
+
+	line.clear ();
+	int            c = fgetc (&f);
+	if (c == EOF)
+	{
+		return false;
+	}
+	while (c != '\n')
+	{
+		if (c == EOF || line.size () >= max_len)
+		{
+			throw std::runtime_error ("invalid or truncated Y4M header.");
+		}
+		line += char (c);
+		c = fgetc (&f);
+	}
+
+	return true;
+}
+
+
+
+/*\\\ PROTECTED \\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\*/
+
+
+
+/*\\\ PRIVATE \\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\*/
+
+
+
+typedef std::chrono::high_resolution_clock StreamProc_ClkType;
+
+static double	StreamProc_get_duration_s (StreamProc_ClkType::time_point t_beg, StreamProc_ClkType::time_point t_end)
+{
+	return std::chrono::duration <double> (t_end - t_beg).count ();
+}
+
+
+
+void	StreamProc::read_loop () noexcept
+{
+	const int      nbr_slots = int (_slot_arr.size ());
+	try
+	{
+		for (int frame_idx = 0; ; ++frame_idx)
+		{
+			auto &         slot = _slot_arr [frame_idx % nbr_slots];
+			{
+				std::unique_lock <std::mutex> lock (_mtx);
+				_cond.wait (lock, [&] () {
+					return (slot._state == SlotState_FREE || ! _err_msg.empty ());
+				});
+				if (! _err_msg.empty ())
+				{
+					break;
+				}
+			}
+
+			const auto     t_beg    = StreamProc_ClkType::now ();
+			const bool     eof_flag = ! read_frame (slot);
+			slot._dur_read = StreamProc_get_duration_s (
+				t_beg, StreamProc_ClkType::now ()
+			);
+
+			std::lock_guard <std::mutex> lock (_mtx);
+			if (eof_flag)
+			{
+				_eof_flag = true;
+			}
+			else
+			{
+				slot._state = SlotState_READ;
+				_nbr_read   = frame_idx + 1;
+			}
+			_cond.notify_all ();
+			if (eof_flag)
+			{
+				break;
+			}
+		}
+	}
+	catch (std::exception &e)
+	{
+		set_error (e.what ());
+	}
+	catch (...)
+	{
+		set_error ("exception while reading a frame.");
+	}
+}
+
+
+
+void	StreamProc::render_loop () noexcept
+{
+	const int      nbr_slots = int (_slot_arr.size ());
+	try
+	{
+		for ( ; ; )
+		{
+			int            frame_idx = 0;
+			{
+				std::unique_lock <std::mutex> lock (_mtx);
+				_cond.wait (lock, [&] () {
+					return (
+						   _next_render < _nbr_read || _eof_flag
+						|| ! _err_msg.empty ()
+					);
+				});
+				if (! _err_msg.empty () || _next_render >= _nbr_read)
+				{
+					break;
+				}
+				frame_idx = _next_render;
+				++ _next_render;
+			}
+
+			auto &         slot  = _slot_arr [frame_idx % nbr_slots];
+			const auto     t_beg = StreamProc_ClkType::now ();
+			render_frame (slot, frame_idx);
+			slot._dur_render = StreamProc_get_duration_s (
+				t_beg, StreamProc_ClkType::now ()
+			);
+
+			std::lock_guard <std::mutex> lock (_mtx);
+			slot._state = SlotState_RENDERED;
+			_cond.notify_all ();
+		}
+	}
+	catch (std::exception &e)
+	{
+		set_error (e.what ());
+	}
+	catch (...)
+	{
+		set_error ("exception while rendering a frame.");
+	}
+}
+
+
+
+void	StreamProc::write_loop () noexcept
+{
+	const int      nbr_slots = int (_slot_arr.size ());
+	try
+	{
+		for (int frame_idx = 0; ; ++frame_idx)
+		{
+			auto &         slot = _slot_arr [frame_idx % nbr_slots];
+			{
+				std::unique_lock <std::mutex> lock (_mtx);
+				_cond.wait (lock, [&] () {
+					return (
+						   slot._state == SlotState_RENDERED
+						|| (_eof_flag && frame_idx >= _nbr_read)
+						|| ! _err_msg.empty ()
+					);
+				});
+				if (! _err_msg.empty () || slot._state != SlotState_RENDERED)
+				{
+					break;
+				}
+			}
+
+			const auto     t_beg     = StreamProc_ClkType::now ();
+			write_frame (slot);
+			const auto     dur_write = StreamProc_get_duration_s (
+				t_beg, StreamProc_ClkType::now ()
+			);
+			if (_verbose_flag)
+			{
+				fprintf (
+					stderr,
+					"Frame %6d: read %8.2f ms, render %8.2f ms, write %8.2f ms\n",
+					frame_idx,
+					slot._dur_read * 1000, slot._dur_render * 1000, dur_write * 1000
+				);
+			}
+
+			std::lock_guard <std::mutex> lock (_mtx);
+			slot._state  = SlotState_FREE;
+			_nbr_written = frame_idx + 1;
+			_cond.notify_all ();
+		}
+	}
+	catch (std::exception &e)
+	{
+		set_error (e.what ());
+	}
+	catch (...)
+	{
+		set_error ("exception while writing a frame.");
+	}
+}
+
+
+
+// Returns false at the end of the stream
+bool	StreamProc::read_frame (Slot &slot)
+{
+	slot._frame_tags.clear ();
+	if (_fmt_src._y4m_flag)
+	{
+		std::string    line;
+		if (! read_line (line, _f_src))
+		{
+			return false;
+		}
+		const auto     len = strlen (FrameFormat::_y4m_frame_0);
+		if (line.compare (0, len, FrameFormat::_y4m_frame_0) != 0)
+		{
+			throw std::runtime_error ("invalid Y4M frame header.");
+		}
+		slot._frame_tags = line.substr (len);
+	}
+
+	const auto     len_pix = slot._src.size ();
+	const auto     nbr_pix = fread (slot._src.data (), sizeof (float), len_pix, &_f_src);
+	if (nbr_pix == 0 && ! _fmt_src._y4m_flag && feof (&_f_src))
+	{
+		return false;
+	}
+	if (nbr_pix != len_pix)
+	{
+		throw std::runtime_error ("truncated frame in the input stream.");
+	}
+
+	return true;
+}
+
+
+
+void	StreamProc::render_frame (Slot &slot, int frame_idx)
+{
+	const int      nbr_planes  = _fmt_src._nbr_planes;
+	const auto     plane_src   = _fmt_src.get_plane_size ();
+	const auto     plane_dst   = _fmt_dst.get_plane_size ();
+	const auto     stride_src  = ptrdiff_t (_fmt_src._w * sizeof (float));
+	const auto     stride_dst  = ptrdiff_t (_fmt_dst._w * sizeof (float));
+
+#if fstb_SYS != fstb_SYS_WIN
+	if (_shm_ptr != nullptr)
+	{
+		memcpy (
+			_shm_ptr->use_src (), slot._src.data (),
+			slot._src.size () * sizeof (float)
+		);
+		_shm_ptr->process_frame (frame_idx);
+		memcpy (
+			slot._dst.data (), _shm_ptr->use_dst (),
+			slot._dst.size () * sizeof (float)
+		);
+		return;
+	}
+#endif
+
+	if (nbr_planes > 1 && _proc.can_process_frame ())
+	{
+		chkdr::GrainProc::DstPtrArray dst_ptr_arr {};
+		chkdr::GrainProc::SrcPtrArray src_ptr_arr {};
+		chkdr::GrainProc::StrideArray dst_stride_arr {};
+		chkdr::GrainProc::StrideArray src_stride_arr {};
+		for (int plane_idx = 0; plane_idx < nbr_planes; ++plane_idx)
+		{
+			dst_ptr_arr [plane_idx] = reinterpret_cast <uint8_t *> (
+				slot._dst.data () + plane_idx * plane_dst
+			);
+			src_ptr_arr [plane_idx] = reinterpret_cast <const uint8_t *> (
+				slot._src.data () + plane_idx * plane_src
+			);
+			dst_stride_arr [plane_idx] = stride_dst;
+			src_stride_arr [plane_idx] = stride_src;
+		}
+		_proc.process_frame (
+			dst_ptr_arr, dst_stride_arr, src_ptr_arr, src_stride_arr,
+			_fmt_src._w, _fmt_src._h, frame_idx, nbr_planes
+		);
+	}
+	else
+	{
+		for (int plane_idx = 0; plane_idx < nbr_planes; ++plane_idx)
+		{
+			_proc.process_plane (
+				reinterpret_cast <uint8_t *> (
+					slot._dst.data () + plane_idx * plane_dst
+				),
+				stride_dst,
+				reinterpret_cast <const uint8_t *> (
+					slot._src.data () + plane_idx * plane_src
+				),
+				stride_src,
+				_fmt_src._w, _fmt_src._h, frame_idx, plane_idx
+			);
+		}
+	}
+}
+
+
+
+void	StreamProc::write_frame (const Slot &slot)
+{
+	bool           ok_flag = true;
+	if (_fmt_dst._y4m_flag)
+	{
+		ok_flag = (fprintf (
+			&_f_dst, "%s%s\n", FrameFormat::_y4m_frame_0, slot._frame_tags.c_str ()
+		) > 0);
+	}
+	const auto     len_pix = slot._dst.size ();
+	if (   ! ok_flag
+	    || fwrite (slot._dst.data (), sizeof (float), len_pix, &_f_dst) != len_pix)
+	{
+		throw std::runtime_error ("cannot write the output stream.");
+	}
+}
+
+
+
+// Keeps only the first error
+void	StreamProc::set_error (const char *msg_0) noexcept
+{
+	assert (msg_0 != nullptr);
+
+	std::lock_guard <std::mutex> lock (_mtx);
+	if (_err_msg.empty ())
+	{
+		try
+		{
+			_err_msg = msg_0;
+		}
+		catch (...)
+		{
+			// Nothing
+		}
+	}
+	_cond.notify_all ();
+}
+
+
+
+}  // namespace chkdrcli
+
+
+
+/*\\\ EOF \\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\*/
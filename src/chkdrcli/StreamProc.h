@@ -0,0 +1,178 @@
+/*****************************************************************************
+
+        StreamProc.h
+        Author: Laurent de Soras, 2022
+
+Adds grain to a stream of frames read from a file and writes the result to
+another file, with the stream headers already processed.
+
+The reading, the rendering and the writing run in separate threads and
+overlap. Frames go through a ring of slots: a slot is filled by the reader,
+rendered by one of the workers, then written and released by the writer.
+There are two slots more than workers, so a frame can be read and another
+one written while all the workers are busy. Frames are written in order.
+
+With a ShmRender object, the frames are rendered by its worker processes.
+There is a single render thread, feeding the shared frames.
+
+Timings of each frame are reported on stderr once it is written.
+
+--- Legal stuff ---
+
+This program is free software. It comes without any warranty, to
+the extent permitted by applicable law. You can redistribute it
+and/or modify it under the terms of the Do What The Fuck You Want
+To Public License, Version 2, as published by Sam Hocevar. See
+http://sam.zoy.org/wtfpl/COPYING for more details.
+
+*Tab=3***********************************************************************/
+
+
+
+#pragma once
+#if ! defined (chkdrcli_StreamProc_HEADER_INCLUDED)
+#define chkdrcli_StreamProc_HEADER_INCLUDED
+
+
+
+/*\\\ INCLUDE FILES \\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\*/
+
+#include "chkdrcli/FrameFormat.h"
+
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <cstdio>
+
+
+
+namespace chkdr
+{
+	class GrainProc;
+}
+
+namespace chkdrcli
+{
+
+
+
+class ShmRender;
+
+class StreamProc
+{
+
+/*\\\ PUBLIC \\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\*/
+
+public:
+
+	explicit       StreamProc (chkdr::GrainProc &proc, const FrameFormat &fmt_src, const FrameFormat &fmt_dst, FILE &f_src, FILE &f_dst, int nbr_workers, bool verbose_flag, ShmRender *shm_ptr = nullptr);
+
+	void           run ();
+	int            get_nbr_frames () const noexcept;
+
+	static bool    read_line (std::string &line, FILE &f);
+
+
+
+/*\\\ PROTECTED \\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\*/
+
+protected:
+
+
+
+/*\\\ PRIVATE \\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\*/
+
+private:
+
+	enum SlotState
+	{
+		SlotState_FREE = 0,
+		SlotState_READ,
+		SlotState_RENDERED
+	};
+
+	class Slot
+	{
+	public:
+		SlotState      _state = SlotState_FREE;
+		std::vector <float>
+		               _src;
+		std::vector <float>
+		               _dst;
+
+		// Y4M only: frame header tags, each one with its leading space
+		std::string    _frame_tags;
+
+		// Durations in seconds
+		double         _dur_read   = 0;
+		double         _dur_render = 0;
+	};
+
+	void           read_loop () noexcept;
+	void           render_loop () noexcept;
+	void           write_loop () noexcept;
+	bool           read_frame (Slot &slot);
+	void           render_frame (Slot &slot, int frame_idx);
+	void           write_frame (const Slot &slot);
+	void           set_error (const char *msg_0) noexcept;
+
+	chkdr::GrainProc &
+	               _proc;
+	const FrameFormat
+	               _fmt_src;
+	const FrameFormat
+	               _fmt_dst;
+	FILE &         _f_src;
+	FILE &         _f_dst;
+	const int      _nbr_workers;
+	const bool     _verbose_flag;
+	ShmRender *    _shm_ptr; // Can be null
+
+	// Mutex to lock before accessing the fields below. Threads wait on
+	// _cond for any state change.
+	std::mutex     _mtx;
+	std::condition_variable
+	               _cond;
+	std::vector <Slot>
+	               _slot_arr;
+	int            _nbr_read    = 0; // Number of frames fully read
+	int            _next_render = 0; // Next frame to render
+	int            _nbr_written = 0;
+	bool           _eof_flag    = false;
+
+	// Empty = no error
+	std::string    _err_msg;
+
+
+
+/*\\\ FORBIDDEN MEMBER FUNCTIONS \\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\*/
+
+private:
+
+	               StreamProc ()                               = delete;
+	               StreamProc (const StreamProc &other)        = delete;
+	               StreamProc (StreamProc &&other)             = delete;
+	StreamProc &   operator = (const StreamProc &other)        = delete;
+	StreamProc &   operator = (StreamProc &&other)             = delete;
+	bool           operator == (const StreamProc &other) const = delete;
+	bool           operator != (const StreamProc &other) const = delete;
+
+}; // class StreamProc
+
+
+
+}  // namespace chkdrcli
+
+
+
+//#include "chkdrcli/StreamProc.hpp"
+
+
+
+#endif   // chkdrcli_StreamProc_HEADER_INCLUDED
+
+
+
+/*\\\ EOF \\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\*/
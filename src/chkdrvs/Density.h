@@ -0,0 +1,126 @@
+/*****************************************************************************
+
+        Density.h
+        Author: Laurent de Soras, 2022
+
+First stage of the split rendering: computes the grain count maps from a
+linear clip. The output is a 32-bit integer clip with the same color family.
+Each frame carries the seed of each plane and the grain radius parameters
+as properties, for chkdr.render.
+
+--- Legal stuff ---
+
+This program is free software. It comes without any warranty, to
+the extent permitted by applicable law. You can redistribute it
+and/or modify it under the terms of the Do What The Fuck You Want
+To Public License, Version 2, as published by Sam Hocevar. See
+http://sam.zoy.org/wtfpl/COPYING for more details.
+
+*Tab=3***********************************************************************/
+
+
+
+#pragma once
+#if ! defined (chkdrvs_Density_HEADER_INCLUDED)
+#define chkdrvs_Density_HEADER_INCLUDED
+
+
+
+/*\\\ INCLUDE FILES \\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\*/
+
+#include "chkdr/CpuOptBase.h"
+#include "chkdr/DensityProc.h"
+#include "vsutl/FilterBase.h"
+#include "vsutl/NodeRefSPtr.h"
+#include "VapourSynth4.h"
+
+#include <memory>
+#include <vector>
+
+
+
+
+namespace chkdrvs
+{
+
+
+
+class Density
+:	public vsutl::FilterBase
+{
+
+/*\\\ PUBLIC \\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\*/
+
+public:
+
+	typedef	Density	ThisType;
+
+	explicit       Density (const ::VSMap &in, ::VSMap &out, void *user_data_ptr, ::VSCore &core, const ::VSAPI &vsapi);
+	virtual        ~Density () {}
+
+	// vsutl::FilterBase
+	virtual ::VSVideoInfo
+	               get_video_info () const;
+	virtual std::vector <::VSFilterDependency>
+	               get_dependencies () const;
+	virtual const ::VSFrame *
+	               get_frame (int n, int activation_reason, void * &frame_data_ptr, ::VSFrameContext &frame_ctx, ::VSCore &core);
+
+
+
+/*\\\ PROTECTED \\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\*/
+
+protected:
+
+
+
+/*\\\ PRIVATE \\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\*/
+
+private:
+
+	class CpuOpt : public chkdr::CpuOptBase
+	{
+	public:
+		explicit       CpuOpt (vsutl::FilterBase &filter, const ::VSMap &in, ::VSMap &out, const char *param_name_0 = "cpuopt");
+	};
+
+	vsutl::NodeRefSPtr
+	               _clip_src_sptr;
+	const ::VSVideoInfo
+	               _vi_in;        // Input. Must be declared after _clip_src_sptr because of initialisation order.
+	::VSVideoInfo  _vi_out;       // Output. Must be declared after _vi_in.
+
+	std::unique_ptr <chkdr::DensityProc>
+	               _proc_uptr;
+
+
+
+/*\\\ FORBIDDEN MEMBER FUNCTIONS \\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\*/
+
+private:
+
+	               Density ()                               = delete;
+	               Density (const Density &other)           = delete;
+	               Density (Density &&other)                = delete;
+	Density &      operator = (const Density &other)        = delete;
+	Density &      operator = (Density &&other)             = delete;
+	bool           operator == (const Density &other) const = delete;
+	bool           operator != (const Density &other) const = delete;
+
+}; // class Density
+
+
+
+}  // namespace chkdrvs
+
+
+
+//#include "chkdrvs/Density.hpp"
+
+
+
+#endif   // chkdrvs_Density_HEADER_INCLUDED
+
+
+
+/*\\\ EOF \\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\*/
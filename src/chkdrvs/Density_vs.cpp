@@ -0,0 +1,209 @@
+/*****************************************************************************
+
+        Density.cpp
+        Author: Laurent de Soras, 2022
+
+--- Legal stuff ---
+
+This program is free software. It comes without any warranty, to
+the extent permitted by applicable law. You can redistribute it
+and/or modify it under the terms of the Do What The Fuck You Want
+To Public License, Version 2, as published by Sam Hocevar. See
+http://sam.zoy.org/wtfpl/COPYING for more details.
+
+*Tab=3***********************************************************************/
+
+
+
+
+/*\\\ INCLUDE FILES \\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\*/
+
+#include "chkdr/GrainProc.h"
+#include "chkdrvs/Density.h"
+#include "fstb/def.h"
+#include "vsutl/FrameRefSPtr.h"
+#include "vsutl/fnc.h"
+
+#include <array>
+
+#include <cassert>
+
+
+
+namespace chkdrvs
+{
+
+
+
+/*\\\ PUBLIC \\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\*/
+
+
+
+Density::Density (const ::VSMap &in, ::VSMap &out, void *user_data_ptr, ::VSCore &core, const ::VSAPI &vsapi)
+:	vsutl::FilterBase (vsapi, "density", ::fmParallel)
+,	_clip_src_sptr (vsapi.mapGetNode (&in, "clip", 0, nullptr), vsapi)
+,	_vi_in (*_vsapi.getVideoInfo (_clip_src_sptr.get ()))
+,	_vi_out (_vi_in)
+{
+	fstb::unused (user_data_ptr);
+
+	const CpuOpt   cpu_opt (*this, in, out);
+	const bool     simd4_flag = cpu_opt.has_sse2 ();
+
+	// Checks the input clip
+	if (! vsutl::is_constant_format (_vi_in))
+	{
+		throw_inval_arg ("only constant pixel formats are supported.");
+	}
+
+	// Source colorspace
+	const auto &   fmt_src = _vi_in.format;
+	if (fmt_src.bitsPerSample != 32)
+	{
+		throw_inval_arg ("only 32-bit float data type is supported.");
+	}
+	if (fmt_src.colorFamily != ::cfGray && fmt_src.colorFamily != ::cfRGB)
+	{
+		throw_inval_arg ("only linear RGB and Y colorformats are supported.");
+	}
+	assert (fmt_src.numPlanes <= chkdr::GrainProc::_max_nbr_planes);
+
+	// Grain counts are stored as 32-bit integers
+	register_format (
+		_vi_out.format,
+		fmt_src.colorFamily, ::stInteger, 32,
+		fmt_src.subSamplingW, fmt_src.subSamplingH,
+		core
+	);
+
+	const auto     rad     = float (get_arg_flt (in, out, "rad"  , 0.025f));
+	const auto     dev     = float (get_arg_flt (in, out, "dev"  , 0));
+	const auto     seed    = uint32_t (get_arg_int (in, out, "seed" , 12345));
+	const auto     cf_flag = (get_arg_int (in, out, "cf", 0) != 0);
+	const auto     cp_flag = (get_arg_int (in, out, "cp", 0) != 0);
+
+	if (! chkdr::GrainProc::check_rad (rad))
+	{
+		throw_inval_arg (": rad must be > 0.");
+	}
+	if (! chkdr::GrainProc::check_dev (dev))
+	{
+		throw_inval_arg (": dev must be in range [0 ; 1]");
+	}
+
+	_proc_uptr = std::make_unique <chkdr::DensityProc> (
+		rad, dev, seed, cf_flag, cp_flag, simd4_flag
+	);
+}
+
+
+
+::VSVideoInfo	Density::get_video_info () const
+{
+	return _vi_out;
+}
+
+
+
+std::vector <::VSFilterDependency>	Density::get_dependencies () const
+{
+	return std::vector <::VSFilterDependency> {
+		{ &*_clip_src_sptr, ::rpStrictSpatial }
+	};
+}
+
+
+
+const ::VSFrame *	Density::get_frame (int n, int activation_reason, void * &frame_data_ptr, ::VSFrameContext &frame_ctx, ::VSCore &core)
+{
+	fstb::unused (frame_data_ptr);
+	assert (n >= 0);
+
+	::VSFrame *    dst_ptr = nullptr;
+	::VSNode &     node    = *_clip_src_sptr;
+
+	if (activation_reason == ::arInitial)
+	{
+		_vsapi.requestFrameFilter (n, &node, &frame_ctx);
+	}
+
+	else if (activation_reason == ::arAllFramesReady)
+	{
+		vsutl::FrameRefSPtr	src_sptr (
+			_vsapi.getFrameFilter (n, &node, &frame_ctx),
+			_vsapi
+		);
+		const ::VSFrame & src = *src_sptr;
+
+		const int      w = _vsapi.getFrameWidth (&src, 0);
+		const int      h = _vsapi.getFrameHeight (&src, 0);
+		dst_ptr = _vsapi.newVideoFrame (&_vi_out.format, w, h, &src, &core);
+
+		const int      nbr_planes = _vi_in.format.numPlanes;
+		std::array <int64_t, chkdr::GrainProc::_max_nbr_planes> seed_arr {};
+		try
+		{
+			for (int plane_index = 0; plane_index < nbr_planes; ++plane_index)
+			{
+				_proc_uptr->process_plane (
+					_vsapi.getWritePtr (dst_ptr, plane_index),
+					_vsapi.getStride (dst_ptr, plane_index),
+					_vsapi.getReadPtr (&src, plane_index),
+					_vsapi.getStride (&src, plane_index),
+					_vsapi.getFrameWidth (&src, plane_index),
+					_vsapi.getFrameHeight (&src, plane_index),
+					n, plane_index
+				);
+				seed_arr [plane_index] =
+					int64_t (_proc_uptr->compute_seed (n, plane_index));
+			}
+
+			// Information required by chkdr.render
+			::VSMap &      props = *_vsapi.getFramePropertiesRW (dst_ptr);
+			_vsapi.mapSetIntArray (&props, "ChkdrSeed", seed_arr.data (), nbr_planes);
+			_vsapi.mapSetFloat (&props, "ChkdrRad", _proc_uptr->get_rad (), ::maReplace);
+			_vsapi.mapSetFloat (&props, "ChkdrDev", _proc_uptr->get_dev (), ::maReplace);
+		}
+
+		catch (std::exception &e)
+		{
+			_vsapi.setFilterError (e.what (), &frame_ctx);
+			_vsapi.freeFrame (dst_ptr);
+			dst_ptr = nullptr;
+		}
+		catch (...)
+		{
+			_vsapi.setFilterError ("density: exception.", &frame_ctx);
+			_vsapi.freeFrame (dst_ptr);
+			dst_ptr = nullptr;
+		}
+	}
+
+	return dst_ptr;
+}
+
+
+
+/*\\\ PROTECTED \\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\*/
+
+
+
+/*\\\ PRIVATE \\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\*/
+
+
+
+Density::CpuOpt::CpuOpt (vsutl::FilterBase &filter, const ::VSMap &in, ::VSMap &out, const char *param_name_0)
+{
+	assert (param_name_0 != 0);
+	set_level (static_cast <Level> (filter.get_arg_int (
+		in, out, param_name_0, Level_ANY_AVAILABLE
+	) & Level_MASK));
+}
+
+
+
+}  // namespace chkdrvs
+
+
+
+/*\\\ EOF \\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\*/
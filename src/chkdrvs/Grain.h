@@ -86,12 +86,45 @@ private:
 		explicit       CpuOpt (vsutl::FilterBase &filter, const ::VSMap &in, ::VSMap &out, const char *param_name_0 = "cpuopt");
 	};
 
+	// Frames fetched once in get_frame() and passed to do_process_plane(),
+	// and statistics collected over the planes
+	class FrameCtx
+	{
+	public:
+		const ::VSFrame *
+		               _src_ptr = nullptr;
+		const ::VSFrame *
+		               _msk_ptr = nullptr; // Can be null
+		chkdr::GrainProc::StatsArray
+		               _stats_arr;
+	};
+
+	int            process_frame_joint (::VSFrame &dst, FrameCtx &ctx, int n, ::VSFrameContext &frame_ctx);
+	void           set_stats_props (::VSFrame &dst, const chkdr::GrainProc::StatsArray &stats_arr) const;
+	chkdr::GrainProc::Mask
+	               make_mask (const ::VSFrame *msk_ptr, int plane_index) const;
+	static bool    conv_fmt (fgrn::SplFmt &spl_fmt, const ::VSVideoFormat &fmt) noexcept;
+
 	vsutl::NodeRefSPtr
 	               _clip_src_sptr;
 	const ::VSVideoInfo             
 	               _vi_in;        // Input. Must be declared after _clip_src_sptr because of initialisation order.
 	::VSVideoInfo  _vi_out;       // Output. Must be declared after _vi_in.
 
+	// Sample format of both clips
+	fgrn::SplFmt   _spl_fmt;
+
+	// YUV input: the grain is rendered on the luma plane only, the chroma
+	// planes are shared with the source frame. Integer luma is taken as full
+	// range, whatever _ColorRange.
+	bool           _luma_only_flag = false;
+
+	// Optional grain mask, with the sample format of its clip. A single
+	// plane mask is used for all the planes.
+	vsutl::NodeRefSPtr
+	               _clip_msk_sptr;
+	fgrn::SplFmt   _msk_fmt;
+
 	vsutl::PlaneProcessor
 	               _plane_processor;
 
@@ -22,6 +22,10 @@ http://sam.zoy.org/wtfpl/COPYING for more details.
 #include "fstb/def.h"
 #include "vsutl/fnc.h"
 
+#include <algorithm>
+#include <string>
+#include <vector>
+
 #include <cassert>
 
 
@@ -61,27 +65,76 @@ Grain::Grain (const ::VSMap &in, ::VSMap &out, void *user_data_ptr, ::VSCore &co
 		throw_inval_arg ("only constant pixel formats are supported.");
 	}
 
-	// Source colorspace
+	// Source colorspace. The samples are converted on the fly by the
+	// generator, so there is no need for an intermediate float clip.
 	const auto &   fmt_src = _vi_in.format;
-	if (fmt_src.bitsPerSample != 32)
+	if (! conv_fmt (_spl_fmt, fmt_src))
 	{
-		throw_inval_arg ("only 32-bit float data type is supported.");
+		throw_inval_arg (
+			"only 8- to 16-bit integer and 16- or 32-bit float data types "
+			"are supported."
+		);
 	}
-	if (fmt_src.colorFamily != ::cfGray && fmt_src.colorFamily != ::cfRGB)
+	if (   fmt_src.colorFamily != ::cfGray && fmt_src.colorFamily != ::cfRGB
+	    && fmt_src.colorFamily != ::cfYUV)
 	{
-		throw_inval_arg ("only linear RGB and Y colorformats are supported.");
+		throw_inval_arg ("only RGB, Y and YUV colorformats are supported.");
+	}
+	_luma_only_flag = (fmt_src.colorFamily == ::cfYUV);
+
+	// Mask clip
+	int            err = 0;
+	::VSNode *     msk_node_ptr = vsapi.mapGetNode (&in, "mask", 0, &err);
+	if (msk_node_ptr != nullptr)
+	{
+		_clip_msk_sptr = vsutl::NodeRefSPtr (msk_node_ptr, vsapi);
+		const auto &   vi_msk  = *vsapi.getVideoInfo (msk_node_ptr);
+		const auto &   fmt_msk = vi_msk.format;
+		if (   ! vsutl::is_constant_format (vi_msk)
+		    || vi_msk.width  != _vi_in.width
+		    || vi_msk.height != _vi_in.height)
+		{
+			throw_inval_arg (
+				": mask must have a constant format and the size of the clip."
+			);
+		}
+		if (   fmt_msk.colorFamily != ::cfGray
+		    && (   fmt_msk.numPlanes        != fmt_src.numPlanes
+		        || fmt_msk.subSamplingW     != fmt_src.subSamplingW
+		        || fmt_msk.subSamplingH     != fmt_src.subSamplingH))
+		{
+			throw_inval_arg (
+				": mask must be Gray or have the same planes as the clip."
+			);
+		}
+		if (! conv_fmt (_msk_fmt, fmt_msk))
+		{
+			throw_inval_arg (": mask has an unsupported data type.");
+		}
 	}
 
 	_plane_processor.set_filter (in, out, _vi_out, true);
 
 	const auto     sigma   = float (get_arg_flt (in, out, "sigma", 0.35f));
 	const auto     res     =        get_arg_int (in, out, "res"  , 1024);
-	const auto     rad     = float (get_arg_flt (in, out, "rad"  , 0.025f));
-	const auto     dev     = float (get_arg_flt (in, out, "dev"  , 0));
+	const auto     rad_arr = get_arg_vflt (in, out, "rad"   , { 0.025 });
+	const auto     dev_arr = get_arg_vflt (in, out, "dev"   , { 0 });
+	const auto     wgt_arr = get_arg_vflt (in, out, "weight", { 1 });
+	const auto     scale   = float (get_arg_flt (in, out, "scale", 1));
 	const auto     seed    = uint32_t (get_arg_int (in, out, "seed" , 12345));
 	const auto     cf_flag = (get_arg_int (in, out, "cf", 0) != 0);
 	const auto     cp_flag = (get_arg_int (in, out, "cp", 0) != 0);
-	const auto     draft_flag = (get_arg_int (in, out, "draft", 0) != 0);
+	const auto     mode    = get_arg_int (in, out, "draft", 0);
+	const auto     cache   = get_arg_int (in, out, "cache",
+		chkdr::GrainProc::compute_def_cache_size (mode, cf_flag)
+	);
+	const auto     cache_dir = get_arg_str (in, out, "cache_dir", "");
+	const auto     cache_dir_size = get_arg_int (in, out, "cache_dir_size",
+		chkdr::GrainProc::_def_cache_dir_size_mib
+	);
+	const auto     transfer = get_arg_str (in, out, "transfer", "linear");
+	const int      curve    = fgrn::Transfer::find_curve (transfer);
+	const auto     amt_arr  = get_arg_vflt (in, out, "amount", { 1 });
 
 	if (! chkdr::GrainProc::check_sigma (sigma))
 	{
@@ -91,17 +144,118 @@ Grain::Grain (const ::VSMap &in, ::VSMap &out, void *user_data_ptr, ::VSCore &co
 	{
 		throw_inval_arg (": res must be > 0.");
 	}
-	if (! chkdr::GrainProc::check_rad (rad))
+	// One grain layer per rad element. Missing dev and weight elements are
+	// copied from the last specified one.
+	const int      nbr_layers = int (rad_arr.size ());
+	if (nbr_layers < 1 || nbr_layers > chkdr::GrainProc::_max_nbr_layers)
+	{
+		throw_inval_arg (": rad must have 1 to 3 elements.");
+	}
+	if (   int (dev_arr.size ()) > nbr_layers
+	    || int (wgt_arr.size ()) > nbr_layers)
 	{
-		throw_inval_arg (": rad must be > 0.");
+		throw_inval_arg (": dev and weight cannot have more elements than rad.");
 	}
-	if (! chkdr::GrainProc::check_dev (dev))
+	chkdr::GrainProc::LayerArray layer_arr;
+	for (int l_idx = 0; l_idx < nbr_layers; ++l_idx)
 	{
-		throw_inval_arg (": dev must be in range [0 ; 1]");
+		auto &         layer = layer_arr [l_idx];
+		layer._rad_avg    = float (rad_arr [l_idx]);
+		layer._rad_stddev = float (dev_arr [std::min (l_idx, int (dev_arr.size ()) - 1)]);
+		layer._weight     = float (wgt_arr [std::min (l_idx, int (wgt_arr.size ()) - 1)]);
+		if (! chkdr::GrainProc::check_rad (layer._rad_avg))
+		{
+			throw_inval_arg (": rad must be > 0.");
+		}
+		if (! chkdr::GrainProc::check_dev (layer._rad_stddev))
+		{
+			throw_inval_arg (": dev must be in range [0 ; 1]");
+		}
 	}
+	if (! chkdr::GrainProc::check_weights (layer_arr, nbr_layers))
+	{
+		throw_inval_arg (": weight must be >= 0, with a positive sum.");
+	}
+	if (! chkdr::GrainProc::check_mode (mode))
+	{
+		throw_inval_arg (": draft must be in range [0 ; 3]");
+	}
+	if (! chkdr::GrainProc::check_nbr_layers (nbr_layers, mode))
+	{
+		throw_inval_arg (": several grain layers require draft = 0.");
+	}
+	if (! chkdr::GrainProc::check_scale (scale))
+	{
+		throw_inval_arg (": scale must be in range [0.125 ; 8].");
+	}
+	if (! chkdr::GrainProc::check_scale_mode (scale, mode, nbr_layers))
+	{
+		throw_inval_arg (": scale requires draft = 0 and a single grain layer.");
+	}
+	if (_luma_only_flag && scale != 1)
+	{
+		throw_inval_arg (": scale is not available for YUV clips.");
+	}
+	if (! chkdr::GrainProc::check_fmt_mode (_spl_fmt, mode))
+	{
+		throw_inval_arg (": draft = 3 requires 32-bit float data.");
+	}
+	if (! chkdr::GrainProc::check_transfer (curve))
+	{
+		throw_inval_arg (
+			": transfer must be \"linear\", \"srgb\", \"bt1886\" or \"pq\"."
+		);
+	}
+	if (! chkdr::GrainProc::check_transfer_mode (curve, mode))
+	{
+		throw_inval_arg (": draft = 3 requires transfer = \"linear\".");
+	}
+	// Grain amount for black and white sources. A single value is used
+	// for both.
+	if (amt_arr.empty () || amt_arr.size () > 2)
+	{
+		throw_inval_arg (": amount must have 1 or 2 elements.");
+	}
+	const auto     amount_blk = float (amt_arr.front ());
+	const auto     amount_wht = float (amt_arr.back ());
+	if (   ! chkdr::GrainProc::check_amount (amount_blk)
+	    || ! chkdr::GrainProc::check_amount (amount_wht))
+	{
+		throw_inval_arg (": amount must be in range [0 ; 1].");
+	}
+	if (! chkdr::GrainProc::check_amount_mode (amount_blk, amount_wht, mode, scale))
+	{
+		throw_inval_arg (": amount < 1 requires draft != 3 and scale = 1.");
+	}
+	if (   _clip_msk_sptr.get () != nullptr
+	    && ! chkdr::GrainProc::check_mask_mode (mode, scale))
+	{
+		throw_inval_arg (": mask requires draft != 3 and scale = 1.");
+	}
+	if (! chkdr::GrainProc::check_cache_size (cache))
+	{
+		throw_inval_arg (": cache must be >= 0.");
+	}
+	if (! chkdr::GrainProc::check_cache_dir (cache_dir))
+	{
+		throw_inval_arg (": cache_dir must be an existing directory.");
+	}
+	if (! chkdr::GrainProc::check_cache_size (cache_dir_size))
+	{
+		throw_inval_arg (": cache_dir_size must be >= 0.");
+	}
+
+	// Output size
+	_vi_out.width  = chkdr::GrainProc::compute_scaled_size (_vi_in.width , scale);
+	_vi_out.height = chkdr::GrainProc::compute_scaled_size (_vi_in.height, scale);
 
 	_proc_uptr = std::make_unique <chkdr::GrainProc> (
-		sigma, res, rad, dev, seed, cf_flag, cp_flag, draft_flag,
+		sigma, res, scale, layer_arr, nbr_layers, seed, cf_flag, cp_flag,
+		static_cast <fgrn::RenderMode> (mode),
+		static_cast <fgrn::Transfer::Curve> (curve),
+		amount_blk, amount_wht,
+		int64_t (cache) << 20,
+		cache_dir, int64_t (cache_dir_size) << 20,
 		simd4_flag, avx_flag
 	);
 }
@@ -117,15 +271,22 @@ Grain::Grain (const ::VSMap &in, ::VSMap &out, void *user_data_ptr, ::VSCore &co
 
 std::vector <::VSFilterDependency>	Grain::get_dependencies () const
 {
-	return std::vector <::VSFilterDependency> {
+	std::vector <::VSFilterDependency> dep_arr {
 		{ &*_clip_src_sptr, ::rpStrictSpatial }
 	};
+	if (_clip_msk_sptr.get () != nullptr)
+	{
+		dep_arr.push_back ({ &*_clip_msk_sptr, ::rpStrictSpatial });
+	}
+
+	return dep_arr;
 }
 
 
 
 const ::VSFrame *	Grain::get_frame (int n, int activation_reason, void * &frame_data_ptr, ::VSFrameContext &frame_ctx, ::VSCore &core)
 {
+	fstb::unused (frame_data_ptr);
 	assert (n >= 0);
 
 	::VSFrame *    dst_ptr = nullptr;
@@ -134,28 +295,77 @@ const ::VSFrame *	Grain::get_frame (int n, int activation_reason, void * &frame_
 	if (activation_reason == ::arInitial)
 	{
 		_vsapi.requestFrameFilter (n, &node, &frame_ctx);
+		if (_clip_msk_sptr.get () != nullptr)
+		{
+			_vsapi.requestFrameFilter (n, _clip_msk_sptr.get (), &frame_ctx);
+		}
 	}
 
 	else if (activation_reason == ::arAllFramesReady)
 	{
+		// The source and mask frames are fetched only once for all the planes
 		vsutl::FrameRefSPtr	src_sptr (
 			_vsapi.getFrameFilter (n, &node, &frame_ctx),
 			_vsapi
 		);
 		const ::VSFrame & src = *src_sptr;
+		vsutl::FrameRefSPtr	msk_sptr;
+		if (_clip_msk_sptr.get () != nullptr)
+		{
+			msk_sptr = vsutl::FrameRefSPtr (
+				_vsapi.getFrameFilter (n, _clip_msk_sptr.get (), &frame_ctx),
+				_vsapi
+			);
+		}
+		FrameCtx       ctx;
+		ctx._src_ptr = &src;
+		ctx._msk_ptr = msk_sptr.get ();
 
-		const int      w = _vsapi.getFrameWidth (&src, 0);
-		const int      h = _vsapi.getFrameHeight (&src, 0);
-		dst_ptr = _vsapi.newVideoFrame (&_vi_out.format, w, h, &src, &core);
-
-		const int      ret_val = _plane_processor.process_frame (
-			*dst_ptr, n, frame_data_ptr, frame_ctx, core, _clip_src_sptr
-		);
+		int            ret_val = 0;
+		if (_luma_only_flag)
+		{
+			// YUV: the chroma planes reference the source ones, without copy
+			const ::VSFrame * plane_src_arr [3] = { nullptr, &src, &src };
+			static const int  plane_arr [3]     = { 0, 1, 2 };
+			dst_ptr = _vsapi.newVideoFrame2 (
+				&_vi_out.format, _vi_out.width, _vi_out.height,
+				plane_src_arr, plane_arr, &src, &core
+			);
+			ret_val = do_process_plane (
+				*dst_ptr, n, 0, &ctx, frame_ctx, core,
+				_clip_src_sptr, vsutl::NodeRefSPtr (), vsutl::NodeRefSPtr ()
+			);
+		}
+		else
+		{
+			dst_ptr = _vsapi.newVideoFrame (
+				&_vi_out.format, _vi_out.width, _vi_out.height, &src, &core
+			);
+			if (   _proc_uptr->can_process_frame ()
+			    && _vi_in.format.colorFamily == ::cfRGB
+			    && _plane_processor.get_mode (0) == vsutl::PlaneProcMode_PROCESS
+			    && _plane_processor.get_mode (1) == vsutl::PlaneProcMode_PROCESS
+			    && _plane_processor.get_mode (2) == vsutl::PlaneProcMode_PROCESS)
+			{
+				// All the planes share the same grains, render them at once
+				ret_val = process_frame_joint (*dst_ptr, ctx, n, frame_ctx);
+			}
+			else
+			{
+				ret_val = _plane_processor.process_frame (
+					*dst_ptr, n, &ctx, frame_ctx, core, _clip_src_sptr
+				);
+			}
+		}
 		if (ret_val != 0)
 		{
 			_vsapi.freeFrame (dst_ptr);
 			dst_ptr = nullptr;
 		}
+		else if (fgrn::RenderStats::_enabled_flag)
+		{
+			set_stats_props (*dst_ptr, ctx._stats_arr);
+		}
 	}
 
 	return dst_ptr;
@@ -169,7 +379,8 @@ const ::VSFrame *	Grain::get_frame (int n, int activation_reason, void * &frame_
 
 int	Grain::do_process_plane (::VSFrame &dst, int n, int plane_index, void *frame_data_ptr, ::VSFrameContext &frame_ctx, ::VSCore &core, const vsutl::NodeRefSPtr &src_node1_sptr, const vsutl::NodeRefSPtr &src_node2_sptr, const vsutl::NodeRefSPtr &src_node3_sptr)
 {
-	fstb::unused (frame_data_ptr, core, src_node2_sptr, src_node3_sptr);
+	fstb::unused (core, src_node1_sptr, src_node2_sptr, src_node3_sptr);
+	assert (frame_data_ptr != nullptr);
 	assert (src_node1_sptr.get () != nullptr);
 
 	int            ret_val = 0;
@@ -179,11 +390,9 @@ int	Grain::do_process_plane (::VSFrame &dst, int n, int plane_index, void *frame
 
 	if (proc_mode == vsutl::PlaneProcMode_PROCESS)
 	{
-		vsutl::FrameRefSPtr	src_sptr (
-			_vsapi.getFrameFilter (n, src_node1_sptr.get (), &frame_ctx),
-			_vsapi
-		);
-		const ::VSFrame & src = *src_sptr;
+		auto &         ctx  = *static_cast <FrameCtx *> (frame_data_ptr);
+		const ::VSFrame & src = *ctx._src_ptr;
+		const auto     mask = make_mask (ctx._msk_ptr, plane_index);
 
 		const int      w = _vsapi.getFrameWidth (&src, plane_index);
 		const int      h = _vsapi.getFrameHeight (&src, plane_index);
@@ -199,7 +408,10 @@ int	Grain::do_process_plane (::VSFrame &dst, int n, int plane_index, void *frame
 				data_dst_ptr, stride_dst,
 				data_src_ptr, stride_src,
 				w, h,
-				n, plane_index
+				n, plane_index,
+				_spl_fmt,
+				(mask._ptr != nullptr) ? &mask : nullptr,
+				&ctx._stats_arr
 			);
 		}
 
@@ -224,6 +436,133 @@ int	Grain::do_process_plane (::VSFrame &dst, int n, int plane_index, void *frame
 
 
 
+int	Grain::process_frame_joint (::VSFrame &dst, FrameCtx &ctx, int n, ::VSFrameContext &frame_ctx)
+{
+	const ::VSFrame & src = *ctx._src_ptr;
+
+	int            ret_val = 0;
+
+	const int      nbr_planes = _vi_in.format.numPlanes;
+	assert (nbr_planes <= chkdr::GrainProc::_max_nbr_planes);
+	chkdr::GrainProc::DstPtrArray dst_ptr_arr {};
+	chkdr::GrainProc::SrcPtrArray src_ptr_arr {};
+	chkdr::GrainProc::StrideArray dst_stride_arr {};
+	chkdr::GrainProc::StrideArray src_stride_arr {};
+	chkdr::GrainProc::MaskArray   msk_arr;
+	for (int plane_index = 0; plane_index < nbr_planes; ++plane_index)
+	{
+		msk_arr [plane_index]        = make_mask (ctx._msk_ptr, plane_index);
+		src_ptr_arr [plane_index]    = _vsapi.getReadPtr (&src, plane_index);
+		src_stride_arr [plane_index] = _vsapi.getStride (&src, plane_index);
+		dst_ptr_arr [plane_index]    = _vsapi.getWritePtr (&dst, plane_index);
+		dst_stride_arr [plane_index] = _vsapi.getStride (&dst, plane_index);
+	}
+	const int      w = _vsapi.getFrameWidth (&src, 0);
+	const int      h = _vsapi.getFrameHeight (&src, 0);
+
+	try
+	{
+		_proc_uptr->process_frame (
+			dst_ptr_arr, dst_stride_arr,
+			src_ptr_arr, src_stride_arr,
+			w, h,
+			n, nbr_planes,
+			_spl_fmt,
+			(ctx._msk_ptr != nullptr) ? &msk_arr : nullptr,
+			&ctx._stats_arr
+		);
+	}
+
+	catch (std::exception &e)
+	{
+		_vsapi.setFilterError (e.what (), &frame_ctx);
+		ret_val = -1;
+	}
+	catch (...)
+	{
+		_vsapi.setFilterError ("grain: exception.", &frame_ctx);
+		ret_val = -1;
+	}
+
+	return ret_val;
+}
+
+
+
+// Counter totals, and pass times per thread in s
+void	Grain::set_stats_props (::VSFrame &dst, const chkdr::GrainProc::StatsArray &stats_arr) const
+{
+	::VSMap &      props = *_vsapi.getFramePropertiesRW (&dst);
+	const auto     stats = chkdr::GrainProc::sum_stats (stats_arr);
+	for (int cnt = 0; cnt < fgrn::RenderStats::Cnt_NBR_ELT; ++cnt)
+	{
+		const auto     cnt_e = static_cast <fgrn::RenderStats::Cnt> (cnt);
+		const auto     name  =
+			std::string ("_ChkdrStats") + fgrn::RenderStats::get_name (cnt_e);
+		_vsapi.mapSetInt (&props, name.c_str (), stats._cnt_arr [cnt], ::maReplace);
+	}
+
+	if (! stats_arr.empty ())
+	{
+		std::vector <double> pass1_arr;
+		std::vector <double> pass2_arr;
+		for (const auto &stats_thr : stats_arr)
+		{
+			pass1_arr.push_back (stats_thr._pass1_s);
+			pass2_arr.push_back (stats_thr._pass2_s);
+		}
+		const int      nbr_threads = int (stats_arr.size ());
+		_vsapi.mapSetFloatArray (&props, "_ChkdrStatsPass1", pass1_arr.data (), nbr_threads);
+		_vsapi.mapSetFloatArray (&props, "_ChkdrStatsPass2", pass2_arr.data (), nbr_threads);
+	}
+}
+
+
+
+// Returns an empty mask if msk_ptr is null
+chkdr::GrainProc::Mask	Grain::make_mask (const ::VSFrame *msk_ptr, int plane_index) const
+{
+	chkdr::GrainProc::Mask  mask;
+	if (msk_ptr != nullptr)
+	{
+		const auto *   fmt_ptr = _vsapi.getVideoFrameFormat (msk_ptr);
+		const int      m_idx   = std::min (plane_index, fmt_ptr->numPlanes - 1);
+		mask._ptr    = _vsapi.getReadPtr (msk_ptr, m_idx);
+		mask._stride = _vsapi.getStride (msk_ptr, m_idx);
+		mask._fmt    = _msk_fmt;
+	}
+
+	return mask;
+}
+
+
+
+// Returns false if the format is not supported
+bool	Grain::conv_fmt (fgrn::SplFmt &spl_fmt, const ::VSVideoFormat &fmt) noexcept
+{
+	if (fmt.sampleType == ::stFloat && fmt.bitsPerSample == 32)
+	{
+		spl_fmt = fgrn::SplFmt::make_float ();
+	}
+	else if (fmt.sampleType == ::stFloat && fmt.bitsPerSample == 16)
+	{
+		spl_fmt = fgrn::SplFmt::make_half ();
+	}
+	else if (   fmt.sampleType == ::stInteger
+	         && fmt.bitsPerSample >= 8 && fmt.bitsPerSample <= 16)
+	{
+		spl_fmt = fgrn::SplFmt::make_int (fmt.bitsPerSample);
+	}
+	else
+	{
+		return false;
+	}
+
+	return true;
+}
+
+
+
 Grain::CpuOpt::CpuOpt (vsutl::FilterBase &filter, const ::VSMap &in, ::VSMap &out, const char *param_name_0)
 {
 	assert (param_name_0 != 0);
@@ -0,0 +1,128 @@
+/*****************************************************************************
+
+        Render.h
+        Author: Laurent de Soras, 2022
+
+Second stage of the split rendering: renders the grain from the maps
+computed by chkdr.density, with a given vision filter.
+
+--- Legal stuff ---
+
+This program is free software. It comes without any warranty, to
+the extent permitted by applicable law. You can redistribute it
+and/or modify it under the terms of the Do What The Fuck You Want
+To Public License, Version 2, as published by Sam Hocevar. See
+http://sam.zoy.org/wtfpl/COPYING for more details.
+
+*Tab=3***********************************************************************/
+
+
+
+#pragma once
+#if ! defined (chkdrvs_Render_HEADER_INCLUDED)
+#define chkdrvs_Render_HEADER_INCLUDED
+
+
+
+/*\\\ INCLUDE FILES \\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\*/
+
+#include "chkdr/CpuOptBase.h"
+#include "chkdr/GrainProc.h"
+#include "vsutl/FilterBase.h"
+#include "vsutl/NodeRefSPtr.h"
+#include "VapourSynth4.h"
+
+#include <memory>
+#include <vector>
+
+
+
+
+namespace chkdrvs
+{
+
+
+
+class Render
+:	public vsutl::FilterBase
+{
+
+/*\\\ PUBLIC \\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\*/
+
+public:
+
+	typedef	Render	ThisType;
+
+	explicit       Render (const ::VSMap &in, ::VSMap &out, void *user_data_ptr, ::VSCore &core, const ::VSAPI &vsapi);
+	virtual        ~Render () {}
+
+	// vsutl::FilterBase
+	virtual ::VSVideoInfo
+	               get_video_info () const;
+	virtual std::vector <::VSFilterDependency>
+	               get_dependencies () const;
+	virtual const ::VSFrame *
+	               get_frame (int n, int activation_reason, void * &frame_data_ptr, ::VSFrameContext &frame_ctx, ::VSCore &core);
+
+
+
+/*\\\ PROTECTED \\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\*/
+
+protected:
+
+
+
+/*\\\ PRIVATE \\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\*/
+
+private:
+
+	class CpuOpt : public chkdr::CpuOptBase
+	{
+	public:
+		explicit       CpuOpt (vsutl::FilterBase &filter, const ::VSMap &in, ::VSMap &out, const char *param_name_0 = "cpuopt");
+	};
+
+	vsutl::NodeRefSPtr
+	               _clip_src_sptr;
+	const ::VSVideoInfo
+	               _vi_in;        // Input. Must be declared after _clip_src_sptr because of initialisation order.
+	::VSVideoInfo  _vi_out;       // Output. Must be declared after _vi_in.
+
+	// Grain radius, to check against the density clip properties
+	float          _rad = 0;
+	float          _dev = 0;
+
+	std::unique_ptr <chkdr::GrainProc>
+	               _proc_uptr;
+
+
+
+/*\\\ FORBIDDEN MEMBER FUNCTIONS \\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\*/
+
+private:
+
+	               Render ()                               = delete;
+	               Render (const Render &other)            = delete;
+	               Render (Render &&other)                 = delete;
+	Render &       operator = (const Render &other)        = delete;
+	Render &       operator = (Render &&other)             = delete;
+	bool           operator == (const Render &other) const = delete;
+	bool           operator != (const Render &other) const = delete;
+
+}; // class Render
+
+
+
+}  // namespace chkdrvs
+
+
+
+//#include "chkdrvs/Render.hpp"
+
+
+
+#endif   // chkdrvs_Render_HEADER_INCLUDED
+
+
+
+/*\\\ EOF \\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\*/
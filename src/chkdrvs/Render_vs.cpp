@@ -0,0 +1,257 @@
+/*****************************************************************************
+
+        Render.cpp
+        Author: Laurent de Soras, 2022
+
+--- Legal stuff ---
+
+This program is free software. It comes without any warranty, to
+the extent permitted by applicable law. You can redistribute it
+and/or modify it under the terms of the Do What The Fuck You Want
+To Public License, Version 2, as published by Sam Hocevar. See
+http://sam.zoy.org/wtfpl/COPYING for more details.
+
+*Tab=3***********************************************************************/
+
+
+
+
+/*\\\ INCLUDE FILES \\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\*/
+
+#include "chkdrvs/Render.h"
+#include "fstb/def.h"
+#include "vsutl/FrameRefSPtr.h"
+#include "vsutl/fnc.h"
+
+#include <cassert>
+
+
+
+namespace chkdrvs
+{
+
+
+
+/*\\\ PUBLIC \\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\*/
+
+
+
+Render::Render (const ::VSMap &in, ::VSMap &out, void *user_data_ptr, ::VSCore &core, const ::VSAPI &vsapi)
+:	vsutl::FilterBase (vsapi, "render", ::fmParallel)
+,	_clip_src_sptr (vsapi.mapGetNode (&in, "clip", 0, nullptr), vsapi)
+,	_vi_in (*_vsapi.getVideoInfo (_clip_src_sptr.get ()))
+,	_vi_out (_vi_in)
+{
+	fstb::unused (user_data_ptr);
+
+	const CpuOpt   cpu_opt (*this, in, out);
+	const bool     simd4_flag = cpu_opt.has_sse2 ();
+	const bool     avx_flag   = cpu_opt.has_avx ();
+
+	// Checks the input clip
+	if (! vsutl::is_constant_format (_vi_in))
+	{
+		throw_inval_arg ("only constant pixel formats are supported.");
+	}
+
+	// Source colorspace
+	const auto &   fmt_src = _vi_in.format;
+	if (fmt_src.sampleType != ::stInteger || fmt_src.bitsPerSample != 32)
+	{
+		throw_inval_arg ("only 32-bit integer data type (chkdr.density output) is supported.");
+	}
+	if (fmt_src.colorFamily != ::cfGray && fmt_src.colorFamily != ::cfRGB)
+	{
+		throw_inval_arg ("only RGB and Y colorformats are supported.");
+	}
+	assert (fmt_src.numPlanes <= chkdr::GrainProc::_max_nbr_planes);
+
+	register_format (
+		_vi_out.format,
+		fmt_src.colorFamily, ::stFloat, 32,
+		fmt_src.subSamplingW, fmt_src.subSamplingH,
+		core
+	);
+
+	const auto     sigma   = float (get_arg_flt (in, out, "sigma", 0.35f));
+	const auto     res     =        get_arg_int (in, out, "res"  , 1024);
+	_rad = float (get_arg_flt (in, out, "rad"  , 0.025f));
+	_dev = float (get_arg_flt (in, out, "dev"  , 0));
+	const auto     mode    = get_arg_int (in, out, "draft", 0);
+
+	if (! chkdr::GrainProc::check_sigma (sigma))
+	{
+		throw_inval_arg (": sigma must be in range [0 ; 1].");
+	}
+	if (! chkdr::GrainProc::check_res (res))
+	{
+		throw_inval_arg (": res must be > 0.");
+	}
+	if (! chkdr::GrainProc::check_rad (_rad))
+	{
+		throw_inval_arg (": rad must be > 0.");
+	}
+	if (! chkdr::GrainProc::check_dev (_dev))
+	{
+		throw_inval_arg (": dev must be in range [0 ; 1]");
+	}
+	// The atlas mode does not use the grain count maps
+	if (   ! chkdr::GrainProc::check_mode (mode)
+	    || mode == fgrn::RenderMode_ATLAS)
+	{
+		throw_inval_arg (": draft must be in range [0 ; 2]");
+	}
+
+	// Seeds come from the frame properties
+	_proc_uptr = std::make_unique <chkdr::GrainProc> (
+		sigma, res, _rad, _dev, 0, false, false,
+		static_cast <fgrn::RenderMode> (mode),
+		0, "", 0,
+		simd4_flag, avx_flag
+	);
+}
+
+
+
+::VSVideoInfo	Render::get_video_info () const
+{
+	return _vi_out;
+}
+
+
+
+std::vector <::VSFilterDependency>	Render::get_dependencies () const
+{
+	return std::vector <::VSFilterDependency> {
+		{ &*_clip_src_sptr, ::rpStrictSpatial }
+	};
+}
+
+
+
+const ::VSFrame *	Render::get_frame (int n, int activation_reason, void * &frame_data_ptr, ::VSFrameContext &frame_ctx, ::VSCore &core)
+{
+	fstb::unused (frame_data_ptr);
+	assert (n >= 0);
+
+	::VSFrame *    dst_ptr = nullptr;
+	::VSNode &     node    = *_clip_src_sptr;
+
+	if (activation_reason == ::arInitial)
+	{
+		_vsapi.requestFrameFilter (n, &node, &frame_ctx);
+	}
+
+	else if (activation_reason == ::arAllFramesReady)
+	{
+		vsutl::FrameRefSPtr	src_sptr (
+			_vsapi.getFrameFilter (n, &node, &frame_ctx),
+			_vsapi
+		);
+		const ::VSFrame & src = *src_sptr;
+
+		// Checks the parameters used to compute the maps
+		const int      nbr_planes = _vi_in.format.numPlanes;
+		const ::VSMap& props      = *_vsapi.getFramePropertiesRO (&src);
+		int            err_seed   = 0;
+		int            err_rad    = 0;
+		int            err_dev    = 0;
+		const auto     seed_ptr   =
+			_vsapi.mapGetIntArray (&props, "ChkdrSeed", &err_seed);
+		const auto     rad        =
+			float (_vsapi.mapGetFloat (&props, "ChkdrRad", 0, &err_rad));
+		const auto     dev        =
+			float (_vsapi.mapGetFloat (&props, "ChkdrDev", 0, &err_dev));
+		if (   err_seed != 0 || err_rad != 0 || err_dev != 0
+		    || _vsapi.mapNumElements (&props, "ChkdrSeed") != nbr_planes)
+		{
+			_vsapi.setFilterError (
+				"render: clip must be the output of chkdr.density.", &frame_ctx
+			);
+			return nullptr;
+		}
+		if (rad != _rad || dev != _dev)
+		{
+			_vsapi.setFilterError (
+				"render: rad and dev must match the values used for chkdr.density.",
+				&frame_ctx
+			);
+			return nullptr;
+		}
+
+		const int      w = _vsapi.getFrameWidth (&src, 0);
+		const int      h = _vsapi.getFrameHeight (&src, 0);
+		dst_ptr = _vsapi.newVideoFrame (&_vi_out.format, w, h, &src, &core);
+
+		chkdr::GrainProc::DstPtrArray dst_ptr_arr {};
+		chkdr::GrainProc::SrcPtrArray q_ptr_arr {};
+		chkdr::GrainProc::StrideArray dst_stride_arr {};
+		chkdr::GrainProc::StrideArray q_stride_arr {};
+		chkdr::GrainProc::SeedArray   seed_arr {};
+		for (int plane_index = 0; plane_index < nbr_planes; ++plane_index)
+		{
+			q_ptr_arr [plane_index]      = _vsapi.getReadPtr (&src, plane_index);
+			q_stride_arr [plane_index]   = _vsapi.getStride (&src, plane_index);
+			dst_ptr_arr [plane_index]    = _vsapi.getWritePtr (dst_ptr, plane_index);
+			dst_stride_arr [plane_index] = _vsapi.getStride (dst_ptr, plane_index);
+			seed_arr [plane_index]       = uint32_t (seed_ptr [plane_index]);
+		}
+
+		try
+		{
+			_proc_uptr->process_density (
+				dst_ptr_arr, dst_stride_arr,
+				q_ptr_arr, q_stride_arr,
+				w, h,
+				seed_arr, nbr_planes
+			);
+
+			// Not a density map anymore
+			::VSMap &      props_dst = *_vsapi.getFramePropertiesRW (dst_ptr);
+			_vsapi.mapDeleteKey (&props_dst, "ChkdrSeed");
+			_vsapi.mapDeleteKey (&props_dst, "ChkdrRad");
+			_vsapi.mapDeleteKey (&props_dst, "ChkdrDev");
+		}
+
+		catch (std::exception &e)
+		{
+			_vsapi.setFilterError (e.what (), &frame_ctx);
+			_vsapi.freeFrame (dst_ptr);
+			dst_ptr = nullptr;
+		}
+		catch (...)
+		{
+			_vsapi.setFilterError ("render: exception.", &frame_ctx);
+			_vsapi.freeFrame (dst_ptr);
+			dst_ptr = nullptr;
+		}
+	}
+
+	return dst_ptr;
+}
+
+
+
+/*\\\ PROTECTED \\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\*/
+
+
+
+/*\\\ PRIVATE \\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\*/
+
+
+
+Render::CpuOpt::CpuOpt (vsutl::FilterBase &filter, const ::VSMap &in, ::VSMap &out, const char *param_name_0)
+{
+	assert (param_name_0 != 0);
+	set_level (static_cast <Level> (filter.get_arg_int (
+		in, out, param_name_0, Level_ANY_AVAILABLE
+	) & Level_MASK));
+}
+
+
+
+}  // namespace chkdrvs
+
+
+
+/*\\\ EOF \\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\*/
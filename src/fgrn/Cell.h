@@ -29,6 +29,8 @@ http://sam.zoy.org/wtfpl/COPYING for more details.
 #include "fgrn/PointList.h"
 #include "fstb/def.h"
 
+#include <array>
+
 
 
 namespace fgrn
@@ -45,7 +47,22 @@ public:
 
 	typedef PointList::VectF32Align VectF32Align;
 
+	// Grain arrays are padded to a multiple of this size, so the SIMD code
+	// never has to process a partial vector. Padding grains have a null
+	// radius and never intersect anything.
+	static constexpr int _pad = 8;
+
+	// Maximum number of grain layers. Each layer starts on a padded position.
+	static constexpr int _max_nbr_layers = 3;
+
+	// Number of horizontal bands for the grain sorting (see sort_bands() and
+	// bin_layers())
+	static constexpr int _nbr_bands = 32;
+
 	inline void    resize (int sz);
+	inline void    resize_layers (const int sz_arr [], int nbr_layers);
+	inline int     get_nbr_grains () const noexcept;
+	inline int     get_nbr_grains_pad () const noexcept;
 	fstb_FORCEINLINE bool
 	               check_intersect_fpu (float tx, float ty) const noexcept;
 	fstb_FORCEINLINE bool
@@ -55,6 +72,45 @@ public:
 	               check_intersect_avx (float tx, float ty) const noexcept;
 #endif
 
+	fstb_FORCEINLINE int
+	               find_first_hit_fpu (float tx, float ty) const noexcept;
+	fstb_FORCEINLINE int
+	               find_first_hit_simd4 (float tx, float ty) const noexcept;
+#if fstb_ARCHI == fstb_ARCHI_X86
+	fstb_FORCEINLINE int
+	               find_first_hit_avx (float tx, float ty) const noexcept;
+#endif
+
+	inline int     get_layer_beg (int layer) const noexcept;
+
+	inline void    sort_bands ();
+	inline void    find_span_y (int &pos_beg, int &pos_end, float ty, float rad) const noexcept;
+	static inline void
+	               find_bands_y (int &band_beg, int &band_end, float ty, float rad) noexcept;
+	fstb_FORCEINLINE void
+	               get_span_bands (int &pos_beg, int &pos_end, int band_beg, int band_end) const noexcept;
+	fstb_FORCEINLINE bool
+	               check_intersect_span_fpu (float tx, float ty, int pos_beg, int pos_end) const noexcept;
+	fstb_FORCEINLINE bool
+	               check_intersect_span_simd4 (float tx, float ty, int pos_beg, int pos_end) const noexcept;
+#if fstb_ARCHI == fstb_ARCHI_X86
+	fstb_FORCEINLINE bool
+	               check_intersect_span_avx (float tx, float ty, int pos_beg, int pos_end) const noexcept;
+#endif
+
+	inline void    bin_layers ();
+	fstb_FORCEINLINE int
+	               find_bin (float ty) const noexcept;
+	inline int     get_bin_size (int bin) const noexcept;
+	fstb_FORCEINLINE unsigned int
+	               check_intersect_bin_fpu (float tx, float ty, int bin, unsigned int mask_chk) const noexcept;
+	fstb_FORCEINLINE unsigned int
+	               check_intersect_bin_simd4 (float tx, float ty, int bin, unsigned int mask_chk) const noexcept;
+#if fstb_ARCHI == fstb_ARCHI_X86
+	fstb_FORCEINLINE unsigned int
+	               check_intersect_bin_avx (float tx, float ty, int bin, unsigned int mask_chk) const noexcept;
+#endif
+
 	// Grain coordinates in pixels, relative to the pixel origin (its center)
 	PointList      _centers;
 
@@ -73,6 +129,30 @@ protected:
 
 private:
 
+	// Number of actual grains, without the padding
+	int            _nbr_grains = 0;
+
+	// Number of grain layers, see resize_layers()
+	int            _nbr_layers = 1;
+
+	// Start position of each layer in the grain arrays. The last element is
+	// the padded number of grains.
+	std::array <int, _max_nbr_layers + 1>
+	               _layer_pos {};
+
+	typedef std::array <int, _nbr_bands + 1> BandPosArray;
+	typedef std::array <int, 2> Span;
+
+	// Grains sorted in bands only: start position of each band in the grain
+	// arrays. The last element is the number of grains.
+	BandPosArray   _band_pos {};
+
+	// Several layers binned with bin_layers(): for each band and each layer
+	// (index band * _nbr_layers + layer), span of the grains possibly
+	// intersecting a point of the band. The bounds are multiple of _pad.
+	std::array <Span, _nbr_bands * _max_nbr_layers>
+	               _bin_span_arr {};
+
 	fstb_FORCEINLINE static bool
 	               check_intersect_fpu (float tx, float ty, int nbr_grains, const float * fstb_RESTRICT cx_ptr, const float * fstb_RESTRICT cy_ptr, const float * fstb_RESTRICT r2_ptr) noexcept;
 	fstb_FORCEINLINE static bool
@@ -81,6 +161,14 @@ private:
 	fstb_FORCEINLINE static bool
 	               check_intersect_avx (float tx, float ty, int nbr_grains, const float * fstb_RESTRICT cx_ptr, const float * fstb_RESTRICT cy_ptr, const float * fstb_RESTRICT r2_ptr) noexcept;
 #endif
+	template <typename F>
+	fstb_FORCEINLINE unsigned int
+	               check_intersect_bin (float tx, float ty, int bin, unsigned int mask_chk, F check_grains) const noexcept;
+	inline void    sort_range (BandPosArray &band_pos, int pos_beg, int pos_end);
+	fstb_FORCEINLINE static int
+	               compute_bin (float y) noexcept;
+	fstb_FORCEINLINE static int
+	               find_lowest_lane (unsigned int mask) noexcept;
 
 
 
@@ -29,7 +29,11 @@ http://www.wtfpl.net/ for more details.
 # include <immintrin.h>
 #endif
 
+#include <algorithm>
+#include <vector>
+
 #include <cassert>
+#include <cmath>
 
 
 
@@ -42,13 +46,63 @@ namespace fgrn
 
 
 
+// The content of the arrays is undefined after a resize, including the
+// padding grains.
 void	Cell::resize (int sz)
 {
 	assert (sz >= 0);
 
-	_centers._x_arr.resize (sz);
-	_centers._y_arr.resize (sz);
-	_r2_arr.resize (sz);
+	_nbr_grains = sz;
+	const auto     sz_pad = (sz + _pad - 1) & ~(_pad - 1);
+	_centers._x_arr.resize (sz_pad);
+	_centers._y_arr.resize (sz_pad);
+	_r2_arr.resize (sz_pad);
+	_nbr_layers    = 1;
+	_layer_pos [0] = 0;
+	_layer_pos [1] = sz_pad;
+}
+
+
+
+// Same as resize(), with several layers of grains stored one after the
+// other. Each layer is padded separately.
+void	Cell::resize_layers (const int sz_arr [], int nbr_layers)
+{
+	assert (sz_arr != nullptr);
+	assert (nbr_layers > 0);
+	assert (nbr_layers <= _max_nbr_layers);
+
+	_nbr_layers = nbr_layers;
+	_nbr_grains = 0;
+	int            pos = 0;
+	for (int layer = 0; layer < nbr_layers; ++layer)
+	{
+		const auto     sz = sz_arr [layer];
+		assert (sz >= 0);
+		_layer_pos [layer] = pos;
+		_nbr_grains += sz;
+		pos         += (sz + _pad - 1) & ~(_pad - 1);
+	}
+	_layer_pos [nbr_layers] = pos;
+	_centers._x_arr.resize (pos);
+	_centers._y_arr.resize (pos);
+	_r2_arr.resize (pos);
+}
+
+
+
+int	Cell::get_nbr_grains () const noexcept
+{
+	return _nbr_grains;
+}
+
+
+
+int	Cell::get_nbr_grains_pad () const noexcept
+{
+	assert (_centers.get_size () == int (_r2_arr.size ()));
+
+	return int (_r2_arr.size ());
 }
 
 
@@ -57,8 +111,7 @@ void	Cell::resize (int sz)
 // This is the "intensive loop" of the algorithm.
 bool	Cell::check_intersect_fpu (float tx, float ty) const noexcept
 {
-	const auto     nbr_grains = int (_r2_arr.size ());
-	assert (_centers.get_size () == nbr_grains);
+	const auto     nbr_grains = get_nbr_grains ();
 
 	return check_intersect_fpu (
 		tx, ty, nbr_grains,
@@ -72,8 +125,7 @@ bool	Cell::check_intersect_fpu (float tx, float ty) const noexcept
 
 bool	Cell::check_intersect_simd4 (float tx, float ty) const noexcept
 {
-	const auto     nbr_grains = int (_r2_arr.size ());
-	assert (_centers.get_size () == nbr_grains);
+	const auto     nbr_grains = get_nbr_grains_pad ();
 
 	return check_intersect_simd4 (
 		tx, ty, nbr_grains,
@@ -91,8 +143,7 @@ bool	Cell::check_intersect_simd4 (float tx, float ty) const noexcept
 
 bool	Cell::check_intersect_avx (float tx, float ty) const noexcept
 {
-	const auto     nbr_grains = int (_r2_arr.size ());
-	assert (_centers.get_size () == nbr_grains);
+	const auto     nbr_grains = get_nbr_grains_pad ();
 
 	return check_intersect_avx (
 		tx, ty, nbr_grains,
@@ -107,6 +158,355 @@ bool	Cell::check_intersect_avx (float tx, float ty) const noexcept
 #endif
 
 
+// Returns the index of the first grain intersecting the filter point, or
+// the number of grains if there is no intersection.
+int	Cell::find_first_hit_fpu (float tx, float ty) const noexcept
+{
+	const auto     cx_ptr = _centers._x_arr.data ();
+	const auto     cy_ptr = _centers._y_arr.data ();
+	const auto     r2_ptr = _r2_arr.data ();
+	for (int pos = 0; pos < _nbr_grains; ++pos)
+	{
+		const auto     dx = tx - cx_ptr [pos];
+		const auto     dy = ty - cy_ptr [pos];
+		const auto     d2 = fstb::sq (dx) + fstb::sq (dy);
+		if (d2 < r2_ptr [pos])
+		{
+			return pos;
+		}
+	}
+
+	return _nbr_grains;
+}
+
+
+
+int	Cell::find_first_hit_simd4 (float tx, float ty) const noexcept
+{
+	constexpr int  simd_w = fstb::Vf32::_length;
+	const auto     nbr_grains = get_nbr_grains_pad ();
+	assert (nbr_grains % simd_w == 0);
+
+	const auto     cx_ptr = _centers._x_arr.data ();
+	const auto     cy_ptr = _centers._y_arr.data ();
+	const auto     r2_ptr = _r2_arr.data ();
+	const auto     txv = fstb::Vf32 (tx);
+	const auto     tyv = fstb::Vf32 (ty);
+	for (int pos = 0; pos < nbr_grains; pos += simd_w)
+	{
+		const auto     cxv = fstb::Vf32::load (cx_ptr + pos);
+		const auto     cyv = fstb::Vf32::load (cy_ptr + pos);
+		const auto     r2v = fstb::Vf32::load (r2_ptr + pos);
+		const auto     dxv = txv - cxv;
+		const auto     dyv = tyv - cyv;
+		const auto     d2v = fstb::sq (dxv) + fstb::sq (dyv);
+		const auto     hit = (d2v < r2v);
+		if (hit.or_h ())
+		{
+			return pos + find_lowest_lane (hit.movemask ());
+		}
+	}
+
+	return _nbr_grains;
+}
+
+
+
+#if fstb_ARCHI == fstb_ARCHI_X86
+
+
+
+int	Cell::find_first_hit_avx (float tx, float ty) const noexcept
+{
+	constexpr int  simd_w = 8;
+	const auto     nbr_grains = get_nbr_grains_pad ();
+	assert (nbr_grains % simd_w == 0);
+
+	const auto     cx_ptr = _centers._x_arr.data ();
+	const auto     cy_ptr = _centers._y_arr.data ();
+	const auto     r2_ptr = _r2_arr.data ();
+	const auto     txv = _mm256_set1_ps (tx);
+	const auto     tyv = _mm256_set1_ps (ty);
+	for (int pos = 0; pos < nbr_grains; pos += simd_w)
+	{
+		const auto     cxv = _mm256_load_ps (cx_ptr + pos);
+		const auto     cyv = _mm256_load_ps (cy_ptr + pos);
+		const auto     r2v = _mm256_load_ps (r2_ptr + pos);
+		const auto     dxv = _mm256_sub_ps (txv, cxv);
+		const auto     dyv = _mm256_sub_ps (tyv, cyv);
+		const auto     d2v = _mm256_add_ps (
+			_mm256_mul_ps (dxv, dxv),
+			_mm256_mul_ps (dyv, dyv)
+		);
+		const auto     hit  = _mm256_cmp_ps (d2v, r2v, _CMP_LT_OQ);
+		const auto     mask = _mm256_movemask_ps (hit);
+		if (mask != 0)
+		{
+			_mm256_zeroupper ();	// Back to SSE state
+			return pos + find_lowest_lane (unsigned (mask));
+		}
+	}
+
+	_mm256_zeroupper ();	// Back to SSE state
+
+	return _nbr_grains;
+}
+
+
+
+#endif
+
+
+
+// Position of the first grain of the layer. Can be called with the number
+// of layers, to get the end of the last layer.
+int	Cell::get_layer_beg (int layer) const noexcept
+{
+	assert (layer >= 0);
+	assert (layer <= _max_nbr_layers);
+
+	return _layer_pos [layer];
+}
+
+
+
+// Single layer only. Sorts the grains in horizontal bands according to
+// their vertical position, so the grains possibly intersecting a point can
+// be restricted to a span (see find_span_y()). The order within a band is
+// preserved. The padding grains stay at the end.
+void	Cell::sort_bands ()
+{
+	assert (_nbr_layers == 1);
+
+	sort_range (_band_pos, 0, _nbr_grains);
+}
+
+
+
+// Requires the grains to be sorted with sort_bands(). Finds the span of
+// grains whose center could be located vertically within rad of ty.
+// The span bounds are expanded to the padding boundaries, so it can be
+// checked with any check_intersect_span_*() function.
+void	Cell::find_span_y (int &pos_beg, int &pos_end, float ty, float rad) const noexcept
+{
+	int            band_beg;
+	int            band_end;
+	find_bands_y (band_beg, band_end, ty, rad);
+	get_span_bands (pos_beg, pos_end, band_beg, band_end);
+}
+
+
+
+// Finds the range of bands [band_beg ; band_end[ overlapping ty +/- rad.
+// Does not depend on the cell content.
+void	Cell::find_bands_y (int &band_beg, int &band_end, float ty, float rad) noexcept
+{
+	assert (rad >= 0);
+
+	band_beg = fstb::limit (
+		fstb::floor_int ((ty - rad + 0.5f) * float (_nbr_bands)),
+		0, _nbr_bands
+	);
+	band_end = fstb::limit (
+		fstb::floor_int ((ty + rad + 0.5f) * float (_nbr_bands)) + 1,
+		band_beg, _nbr_bands
+	);
+}
+
+
+
+// Requires the grains to be sorted with sort_bands(). Span of the grains
+// located in the bands [band_beg ; band_end[, expanded to the padding
+// boundaries.
+void	Cell::get_span_bands (int &pos_beg, int &pos_end, int band_beg, int band_end) const noexcept
+{
+	assert (band_beg >= 0);
+	assert (band_beg <= band_end);
+	assert (band_end <= _nbr_bands);
+
+	pos_beg = _band_pos [band_beg] & ~(_pad - 1);
+	pos_end = (_band_pos [band_end] + _pad - 1) & ~(_pad - 1);
+}
+
+
+
+// Several layers. Sorts the grains of each layer in horizontal bands, then
+// finds for each band and each layer the span of grains whose disk could
+// overlap the band, from the largest radius of the layer. Thus a point
+// needs a single band lookup for all the layers (see find_bin()). The
+// padding grains are sorted with the others, they have a null radius and
+// never intersect anything.
+void	Cell::bin_layers ()
+{
+	const auto     r2_ptr = _r2_arr.data ();
+
+	for (int layer = 0; layer < _nbr_layers; ++layer)
+	{
+		const auto     pos_beg = _layer_pos [layer    ];
+		const auto     pos_end = _layer_pos [layer + 1];
+		BandPosArray   band_pos;
+		sort_range (band_pos, pos_beg, pos_end);
+
+		// Number of bands reached by the largest grain beyond its own band
+		float          r2_max = 0;
+		for (int pos = pos_beg; pos < pos_end; ++pos)
+		{
+			r2_max = std::max (r2_max, r2_ptr [pos]);
+		}
+		const auto     ext =
+			fstb::floor_int (sqrtf (r2_max) * float (_nbr_bands)) + 1;
+
+		// The layers start on padded positions, so the spans expanded to the
+		// padding boundaries stay within the layer.
+		for (int band = 0; band < _nbr_bands; ++band)
+		{
+			const auto     band_beg = std::max (band - ext, 0);
+			const auto     band_end = std::min (band + ext + 1, _nbr_bands);
+			auto &         span     = _bin_span_arr [band * _nbr_layers + layer];
+			span [0] = band_pos [band_beg] & ~(_pad - 1);
+			span [1] = (band_pos [band_end] + _pad - 1) & ~(_pad - 1);
+		}
+	}
+}
+
+
+
+// Requires the grains to be binned with bin_layers(). Returns the bin of a
+// point located at ty.
+int	Cell::find_bin (float ty) const noexcept
+{
+	return compute_bin (ty);
+}
+
+
+
+// Requires the grains to be binned with bin_layers(). Number of grains in
+// the spans of a bin, for all the layers.
+int	Cell::get_bin_size (int bin) const noexcept
+{
+	assert (bin >= 0);
+	assert (bin < _nbr_bands);
+
+	int            sz = 0;
+	for (int layer = 0; layer < _nbr_layers; ++layer)
+	{
+		const auto &   span = _bin_span_arr [bin * _nbr_layers + layer];
+		sz += span [1] - span [0];
+	}
+
+	return sz;
+}
+
+
+
+// Requires the grains to be binned with bin_layers(). Checks a filter point
+// against the spans of a bin, for the layers of mask_chk. The scan of a
+// layer span stops at the first hit. Returns the bits of the layers hit.
+unsigned int	Cell::check_intersect_bin_fpu (float tx, float ty, int bin, unsigned int mask_chk) const noexcept
+{
+	return check_intersect_bin (
+		tx, ty, bin, mask_chk,
+		[] (float x, float y, int n, const float *cx_ptr, const float *cy_ptr, const float *r2_ptr)
+		{
+			return check_intersect_fpu (x, y, n, cx_ptr, cy_ptr, r2_ptr);
+		}
+	);
+}
+
+
+
+unsigned int	Cell::check_intersect_bin_simd4 (float tx, float ty, int bin, unsigned int mask_chk) const noexcept
+{
+	return check_intersect_bin (
+		tx, ty, bin, mask_chk,
+		[] (float x, float y, int n, const float *cx_ptr, const float *cy_ptr, const float *r2_ptr)
+		{
+			return check_intersect_simd4 (x, y, n, cx_ptr, cy_ptr, r2_ptr);
+		}
+	);
+}
+
+
+
+#if fstb_ARCHI == fstb_ARCHI_X86
+
+
+
+unsigned int	Cell::check_intersect_bin_avx (float tx, float ty, int bin, unsigned int mask_chk) const noexcept
+{
+	return check_intersect_bin (
+		tx, ty, bin, mask_chk,
+		[] (float x, float y, int n, const float *cx_ptr, const float *cy_ptr, const float *r2_ptr)
+		{
+			return check_intersect_avx (x, y, n, cx_ptr, cy_ptr, r2_ptr);
+		}
+	);
+}
+
+
+
+#endif // fstb_ARCHI_X86
+
+
+
+// pos_beg and pos_end must be multiples of _pad.
+bool	Cell::check_intersect_span_fpu (float tx, float ty, int pos_beg, int pos_end) const noexcept
+{
+	assert (pos_beg >= 0);
+	assert (pos_beg <= pos_end);
+	assert (pos_end <= get_nbr_grains_pad ());
+
+	return check_intersect_fpu (
+		tx, ty, pos_end - pos_beg,
+		_centers._x_arr.data () + pos_beg,
+		_centers._y_arr.data () + pos_beg,
+		_r2_arr.data () + pos_beg
+	);
+}
+
+
+
+bool	Cell::check_intersect_span_simd4 (float tx, float ty, int pos_beg, int pos_end) const noexcept
+{
+	assert (pos_beg >= 0);
+	assert (pos_beg % _pad == 0);
+	assert (pos_beg <= pos_end);
+	assert (pos_end <= get_nbr_grains_pad ());
+
+	return check_intersect_simd4 (
+		tx, ty, pos_end - pos_beg,
+		_centers._x_arr.data () + pos_beg,
+		_centers._y_arr.data () + pos_beg,
+		_r2_arr.data () + pos_beg
+	);
+}
+
+
+
+#if fstb_ARCHI == fstb_ARCHI_X86
+
+
+
+bool	Cell::check_intersect_span_avx (float tx, float ty, int pos_beg, int pos_end) const noexcept
+{
+	assert (pos_beg >= 0);
+	assert (pos_beg % _pad == 0);
+	assert (pos_beg <= pos_end);
+	assert (pos_end <= get_nbr_grains_pad ());
+
+	return check_intersect_avx (
+		tx, ty, pos_end - pos_beg,
+		_centers._x_arr.data () + pos_beg,
+		_centers._y_arr.data () + pos_beg,
+		_r2_arr.data () + pos_beg
+	);
+}
+
+
+
+#endif // fstb_ARCHI_X86
+
+
 
 /*\\\ PROTECTED \\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\*/
 
@@ -138,11 +538,12 @@ bool	Cell::check_intersect_fpu (float tx, float ty, int nbr_grains, const float
 bool	Cell::check_intersect_simd4 (float tx, float ty, int nbr_grains, const float * fstb_RESTRICT cx_ptr, const float * fstb_RESTRICT cy_ptr, const float * fstb_RESTRICT r2_ptr) noexcept
 {
 	constexpr int  simd_w = fstb::Vf32::_length;
-	const auto     nx     = nbr_grains & ~(simd_w - 1);
+	static_assert (_pad % simd_w == 0, "");
+	assert (nbr_grains % simd_w == 0);
 
 	const auto     txv = fstb::Vf32 (tx);
 	const auto     tyv = fstb::Vf32 (ty);
-	for (int pos = 0; pos < nx; pos += simd_w)
+	for (int pos = 0; pos < nbr_grains; pos += simd_w)
 	{
 		const auto     cxv = fstb::Vf32::load (cx_ptr + pos);
 		const auto     cyv = fstb::Vf32::load (cy_ptr + pos);
@@ -157,9 +558,7 @@ bool	Cell::check_intersect_simd4 (float tx, float ty, int nbr_grains, const floa
 		}
 	}
 
-	return check_intersect_fpu (
-		tx, ty, nbr_grains - nx, cx_ptr + nx, cy_ptr + nx, r2_ptr + nx
-	);
+	return false;
 }
 
 
@@ -171,11 +570,12 @@ bool	Cell::check_intersect_simd4 (float tx, float ty, int nbr_grains, const floa
 bool	Cell::check_intersect_avx (float tx, float ty, int nbr_grains, const float * fstb_RESTRICT cx_ptr, const float * fstb_RESTRICT cy_ptr, const float * fstb_RESTRICT r2_ptr) noexcept
 {
 	constexpr int  simd_w = 8;
-	const auto     nx     = nbr_grains & ~(simd_w - 1);
+	static_assert (_pad % simd_w == 0, "");
+	assert (nbr_grains % simd_w == 0);
 
 	const auto     txv = _mm256_set1_ps (tx);
 	const auto     tyv = _mm256_set1_ps (ty);
-	for (int pos = 0; pos < nx; pos += simd_w)
+	for (int pos = 0; pos < nbr_grains; pos += simd_w)
 	{
 		const auto     cxv = _mm256_load_ps (cx_ptr + pos);
 		const auto     cyv = _mm256_load_ps (cy_ptr + pos);
@@ -196,9 +596,7 @@ bool	Cell::check_intersect_avx (float tx, float ty, int nbr_grains, const float
 
 	_mm256_zeroupper ();	// Back to SSE state
 
-	return check_intersect_fpu (
-		tx, ty, nbr_grains - nx, cx_ptr + nx, cy_ptr + nx, r2_ptr + nx
-	);
+	return false;
 }
 
 
@@ -207,6 +605,112 @@ bool	Cell::check_intersect_avx (float tx, float ty, int nbr_grains, const float
 
 
 
+// Scans the spans of a bin for the layers of mask_chk, with
+// check_grains (tx, ty, nbr_grains, cx_ptr, cy_ptr, r2_ptr) -> bool
+template <typename F>
+unsigned int	Cell::check_intersect_bin (float tx, float ty, int bin, unsigned int mask_chk, F check_grains) const noexcept
+{
+	assert (bin >= 0);
+	assert (bin < _nbr_bands);
+
+	const auto     cx_ptr   = _centers._x_arr.data ();
+	const auto     cy_ptr   = _centers._y_arr.data ();
+	const auto     r2_ptr   = _r2_arr.data ();
+	const auto     span_ptr = _bin_span_arr.data () + bin * _nbr_layers;
+	unsigned int   mask_hit = 0;
+	for (int layer = 0; layer < _nbr_layers; ++layer)
+	{
+		const auto     tag = 1u << layer;
+		if ((mask_chk & tag) != 0)
+		{
+			const auto     pos_beg = span_ptr [layer] [0];
+			if (check_grains (
+				tx, ty, span_ptr [layer] [1] - pos_beg,
+				cx_ptr + pos_beg, cy_ptr + pos_beg, r2_ptr + pos_beg
+			))
+			{
+				mask_hit |= tag;
+			}
+		}
+	}
+
+	return mask_hit;
+}
+
+
+
+// Counting sort of the grains in [pos_beg ; pos_end[ according to their
+// vertical position, preserving the order within a band. band_pos receives
+// the start position of each band, the last element is pos_end.
+void	Cell::sort_range (BandPosArray &band_pos, int pos_beg, int pos_end)
+{
+	assert (pos_beg >= 0);
+	assert (pos_beg <= pos_end);
+	assert (pos_end <= get_nbr_grains_pad ());
+
+	const auto     x_ptr  = _centers._x_arr.data ();
+	const auto     y_ptr  = _centers._y_arr.data ();
+	const auto     r2_ptr = _r2_arr.data ();
+
+	band_pos.fill (0);
+	for (int pos = pos_beg; pos < pos_end; ++pos)
+	{
+		++ band_pos [compute_bin (y_ptr [pos]) + 1];
+	}
+	band_pos [0] = pos_beg;
+	for (int band = 0; band < _nbr_bands; ++band)
+	{
+		band_pos [band + 1] += band_pos [band];
+	}
+
+	std::vector <std::array <float, 3> > grain_arr (pos_end - pos_beg);
+	std::array <int, _nbr_bands> dst_pos_arr;
+	std::copy (band_pos.begin (), band_pos.end () - 1, dst_pos_arr.begin ());
+	for (int pos = pos_beg; pos < pos_end; ++pos)
+	{
+		const auto     y   = y_ptr [pos];
+		const auto     dst = dst_pos_arr [compute_bin (y)] ++ - pos_beg;
+		grain_arr [dst] = { x_ptr [pos], y, r2_ptr [pos] };
+	}
+	for (int pos = pos_beg; pos < pos_end; ++pos)
+	{
+		const auto &   grain = grain_arr [pos - pos_beg];
+		x_ptr [pos]  = grain [0];
+		y_ptr [pos]  = grain [1];
+		r2_ptr [pos] = grain [2];
+	}
+}
+
+
+
+// Bin of a vertical position, relative to the pixel center. The positions
+// out of the pixel are clipped to the first or last bin.
+int	Cell::compute_bin (float y) noexcept
+{
+	return fstb::limit (
+		fstb::floor_int ((y + 0.5f) * float (_nbr_bands)), 0, _nbr_bands - 1
+	);
+}
+
+
+
+// mask != 0
+int	Cell::find_lowest_lane (unsigned int mask) noexcept
+{
+	assert (mask != 0);
+
+	int            lane = 0;
+	while ((mask & 1) == 0)
+	{
+		mask >>= 1;
+		++ lane;
+	}
+
+	return lane;
+}
+
+
+
 }  // namespace fgrn
 
 
@@ -56,7 +56,7 @@ void	CellCache::reset (int w, int h)
 
 
 
-const Cell &	CellCache::use_cell (int px, int py, GenGrain &cell_provider)
+const Cell &	CellCache::use_cell (int px, int py, GenGrain &cell_provider, RenderStats &stats)
 {
 	assert (_w > 0);
 	assert (_h > 0);
@@ -121,6 +121,12 @@ const Cell &	CellCache::use_cell (int px, int py, GenGrain &cell_provider)
 	{
 		cell_provider.build_cell (entry._cell, px, py);
 		entry._cached_flag = true;
+		stats.add (RenderStats::Cnt_CACHE_MISSES, 1);
+		stats.add (RenderStats::Cnt_Q_TOTAL, entry._cell.get_nbr_grains ());
+	}
+	else
+	{
+		stats.add (RenderStats::Cnt_CACHE_HITS, 1);
 	}
 
 	return entry._cell;
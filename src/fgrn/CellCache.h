@@ -24,6 +24,7 @@ http://sam.zoy.org/wtfpl/COPYING for more details.
 /*\\\ INCLUDE FILES \\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\*/
 
 #include "fgrn/Cell.h"
+#include "fgrn/RenderStats.h"
 
 #include <vector>
 
@@ -44,7 +45,7 @@ class CellCache
 public:
 
 		void           reset (int w, int h);
-		const Cell &   use_cell (int px, int py, GenGrain &cell_provider);
+		const Cell &   use_cell (int px, int py, GenGrain &cell_provider, RenderStats &stats);
 
 
 /*\\\ PROTECTED \\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\*/
@@ -21,12 +21,14 @@ http://sam.zoy.org/wtfpl/COPYING for more details.
 #include "fgrn/GenGrain.h"
 #include "fgrn/UtilPrng.h"
 #include "fstb/fnc.h"
-#include "fstb/Hash.h"
+#include "fstb/ToolsSimd.h"
 #include "fstb/Vs32.h"
 
 #include <algorithm>
+#include <array>
 
 #include <cassert>
+#include <cmath>
 
 
 
@@ -42,31 +44,44 @@ namespace fgrn
 GenGrain::GenGrain (bool simd4_flag, bool avx_flag)
 :	_simd4_flag (simd4_flag)
 ,	_avx_flag (avx_flag)
-,	_density (simd4_flag)
 ,	_render_part_ptr (&ThisType::render_part_fpu)
+,	_render_part_multi_ptr (&ThisType::render_part_multi_fpu)
+,	_render_part_layers_ptr (&ThisType::render_part_layers_fpu)
+,	_render_part_scaled_ptr (&ThisType::render_part_scaled_fpu)
 {
+	for (auto &density_uptr : _density_arr)
+	{
+		density_uptr = std::make_unique <GrainDensity> (simd4_flag);
+	}
+
 	if (_simd4_flag)
 	{
-		_render_part_ptr = &ThisType::render_part_simd4;
+		_render_part_ptr        = &ThisType::render_part_simd4;
+		_render_part_multi_ptr  = &ThisType::render_part_multi_simd4;
+		_render_part_layers_ptr = &ThisType::render_part_layers_simd4;
+		_render_part_scaled_ptr = &ThisType::render_part_scaled_simd4;
 	}
 	if (_avx_flag)
 	{
-		_render_part_ptr = &ThisType::render_part_avx;
+		_render_part_ptr        = &ThisType::render_part_avx;
+		_render_part_multi_ptr  = &ThisType::render_part_multi_avx;
+		_render_part_layers_ptr = &ThisType::render_part_layers_avx;
+		_render_part_scaled_ptr = &ThisType::render_part_scaled_avx;
 	}
 }
 
 
 
-void	GenGrain::process (float *dst_ptr, const float *src_ptr, int w, int h, ptrdiff_t src_stride, ptrdiff_t dst_stride, const VisionFilter &filter, uint32_t pic_seed, bool draft_flag)
+void	GenGrain::process (float *dst_ptr, const float *src_ptr, int w, int h, ptrdiff_t src_stride, ptrdiff_t dst_stride, const VisionFilter &filter, uint32_t pic_seed, RenderMode mode)
 {
 	mt_start (
 		dst_ptr, src_ptr,
 		w, h,
 		src_stride, dst_stride,
-		filter, pic_seed, draft_flag, 1
+		filter, pic_seed, mode, 1
 	);
 	mt_proc_pass1 (0);
-	if (! draft_flag)
+	if (mode != RenderMode_DRAFT)
 	{
 		mt_prepare_pass2 ();
 		mt_proc_pass2 (0);
@@ -75,31 +90,186 @@ void	GenGrain::process (float *dst_ptr, const float *src_ptr, int w, int h, ptrd
 
 
 
-int	GenGrain::mt_start (float *dst_ptr, const float *src_ptr, int w, int h, ptrdiff_t src_stride, ptrdiff_t dst_stride, const VisionFilter &filter, uint32_t pic_seed, bool draft_flag, int max_nbr_threads)
+void	GenGrain::process (const PlaneArray &plane_arr, int nbr_planes, int w, int h, const VisionFilter &filter, uint32_t pic_seed, RenderMode mode, const TileMask *tile_mask_ptr, const LayerArray *layer_arr_ptr, int nbr_layers, int dst_w, int dst_h, int org_x, int org_y)
 {
+	mt_start (
+		plane_arr, nbr_planes, w, h, filter, pic_seed, mode, 1, tile_mask_ptr,
+		layer_arr_ptr, nbr_layers, dst_w, dst_h, org_x, org_y
+	);
+	mt_proc_pass1 (0);
+	if (mode != RenderMode_DRAFT)
+	{
+		mt_prepare_pass2 ();
+		mt_proc_pass2 (0);
+	}
+}
+
+
+
+int	GenGrain::mt_start (float *dst_ptr, const float *src_ptr, int w, int h, ptrdiff_t src_stride, ptrdiff_t dst_stride, const VisionFilter &filter, uint32_t pic_seed, RenderMode mode, int max_nbr_threads)
+{
+	PlaneArray     plane_arr;
+	auto &         plane = plane_arr [0];
+	plane._dst_ptr    = dst_ptr;
+	plane._src_ptr    = src_ptr;
+	plane._dst_stride = dst_stride;
+	plane._src_stride = src_stride;
+
+	return mt_start (
+		plane_arr, 1, w, h, filter, pic_seed, mode, max_nbr_threads
+	);
+}
+
+
+
+// layer_arr_ptr: optional grain layers. nullptr: single layer, using the
+// grain characteristics of the vision filter. With several layers, the
+// filter should have been built for the layer with the largest grains.
+// dst_w, dst_h: output size, 0 = same as the source. A different size
+// requires the full rendering mode, a single plane, a single layer and no
+// tile mask. The destination planes have the output size.
+// org_x, org_y: position of the planes in a larger picture, in pixels, see
+// GrainDensity::reset() for the constraints. Requires the source size for
+// the output.
+int	GenGrain::mt_start (const PlaneArray &plane_arr, int nbr_planes, int w, int h, const VisionFilter &filter, uint32_t pic_seed, RenderMode mode, int max_nbr_threads, const TileMask *tile_mask_ptr, const LayerArray *layer_arr_ptr, int nbr_layers, int dst_w, int dst_h, int org_x, int org_y)
+{
+	if (dst_w <= 0)
+	{
+		dst_w = w;
+	}
+	if (dst_h <= 0)
+	{
+		dst_h = h;
+	}
+
+	assert (nbr_planes > 0);
+	assert (nbr_planes <= _max_nbr_planes);
 	assert (w > 0);
 	assert (h != 0);
-	assert (src_ptr != nullptr);
-	assert (dst_ptr != nullptr);
-	assert (src_ptr != dst_ptr);
+	assert (mode >= 0);
+	assert (mode < RenderMode_NBR_ELT);
+	assert (mode != RenderMode_ATLAS);
+	assert (nbr_planes == 1 || mode == RenderMode_FULL);
+	assert (nbr_layers > 0);
+	assert (nbr_layers <= _max_nbr_layers);
+	assert (nbr_layers == 1 || layer_arr_ptr != nullptr);
+	assert (nbr_layers == 1 || (nbr_planes == 1 && mode == RenderMode_FULL));
+	assert (
+		   (dst_w == w && dst_h == h)
+		|| (   mode == RenderMode_FULL && nbr_planes == 1 && nbr_layers == 1
+		    && tile_mask_ptr == nullptr)
+	);
+	assert ((org_x == 0 && org_y == 0) || (dst_w == w && dst_h == h));
+	for (int p_idx = 0; p_idx < nbr_planes; ++p_idx)
+	{
+		const auto &   plane = plane_arr [p_idx];
+		assert (plane._src_ptr != nullptr || plane._q_ptr != nullptr);
+		assert (plane._dst_ptr != nullptr);
+		assert (plane._src_ptr != plane._dst_ptr);
+		assert (plane._src_fmt.is_valid ());
+		assert (plane._dst_fmt.is_valid ());
+		assert (plane._msk_ptr == nullptr || plane._msk_fmt.is_valid ());
+		assert (
+			   ! plane.is_blended ()
+			|| (plane._q_ptr == nullptr && dst_w == w && dst_h == h)
+		);
+		fstb::unused (plane);
+	}
+	assert (
+		   tile_mask_ptr == nullptr
+		|| (tile_mask_ptr->get_w () == w && tile_mask_ptr->get_h () == h)
+	);
 
 	_pic_w      = w;
 	_pic_h      = h;
-	_src_ptr    = src_ptr;
-	_src_stride = src_stride;
-	_dst_ptr    = dst_ptr;
-	_dst_stride = dst_stride;
+	_dst_w      = dst_w;
+	_dst_h      = dst_h;
+	_scaled_flag = (dst_w != w || dst_h != h);
+	_src_step_x = float (w) / float (dst_w);
+	_src_step_y = float (h) / float (dst_h);
+	_plane_arr  = plane_arr;
+	_nbr_planes = nbr_planes;
 	_filter_ptr = &filter;
+	_mode       = mode;
+	_tile_mask_ptr = tile_mask_ptr;
 
 	const int      nbr_points = _filter_ptr->get_nbr_points ();
 	_out_scale  = 1.f / float (nbr_points);
 
-	_g_rad_mu   = filter.get_grain_radius_avg ();
-	_g_rad_s    = filter.get_grain_radius_stddev ();
+	_nbr_layers = nbr_layers;
+	for (int l_idx = 0; l_idx < _nbr_layers; ++l_idx)
+	{
+		auto &         layer = _layer_arr [l_idx];
+		if (layer_arr_ptr == nullptr)
+		{
+			layer._rad_mu = filter.get_grain_radius_avg ();
+			layer._rad_s  = filter.get_grain_radius_stddev ();
+			layer._weight = 1;
+		}
+		else
+		{
+			const auto &   desc = (*layer_arr_ptr) [l_idx];
+			assert (desc._rad_avg > 0);
+			assert (desc._rad_stddev >= 0);
+			layer._rad_mu = desc._rad_avg;
+			layer._rad_s  = desc._rad_stddev;
+			layer._weight = desc._weight;
+		}
+		layer._rad_max =
+			VisionFilter::compute_grain_rad_max (layer._rad_mu, layer._rad_s);
+		if (mode == RenderMode_FULL && layer._rad_s > 0)
+		{
+			update_r2_table (layer);
+		}
+	}
+	if (_nbr_layers > 1)
+	{
+		build_layer_masks ();
+	}
+	_rad_max = _layer_arr [0]._rad_max;
+	if (_scaled_flag)
+	{
+		build_phases ();
+	}
 
-	_density.reset (w, h, _g_rad_mu, _g_rad_s, pic_seed, draft_flag);
+	// In statistical mode, the draft output of the pass 1 is the coverage map
+	const bool     stat_flag  = (mode == RenderMode_STAT);
+	const auto     output     =
+		  (stat_flag                ) ? GrainDensity::Output_COV
+		: (mode == RenderMode_DRAFT) ? GrainDensity::Output_DRAFT
+		:                              GrainDensity::Output_NONE;
+	_nbr_dens = std::max (_nbr_planes, _nbr_layers);
+	for (int d_idx = 0; d_idx < _nbr_dens; ++d_idx)
+	{
+		const auto &   layer = _layer_arr [(_nbr_layers > 1) ? d_idx : 0];
+		_density_arr [d_idx]->reset (
+			w, h, layer._rad_mu, layer._rad_s,
+			compute_layer_seed (pic_seed, (_nbr_layers > 1) ? d_idx : 0),
+			output, org_x, org_y
+		);
+	}
+	if (stat_flag)
+	{
+		constexpr int  align_pix = GrainDensity::_align / sizeof (float);
+		_cov_stride = (w + align_pix - 1) & ~(align_pix - 1);
+		_cov_arr.resize (size_t (_cov_stride * h));
+	}
 
-	_nbr_threads = std::min (max_nbr_threads, h);
+	// Rows required by the pass 1: cells can be used by any pixel located
+	// in the filter reach.
+	if (_tile_mask_ptr != nullptr)
+	{
+		const int      reach = filter.get_reach ();
+		_row_p1_arr.resize (h);
+		for (int y = 0; y < h; ++y)
+		{
+			_row_p1_arr [y] = uint8_t (
+				_tile_mask_ptr->is_row_range_set (y - reach, y + reach + 1)
+			);
+		}
+	}
+
+	_nbr_threads = std::min (max_nbr_threads, std::min (h, dst_h));
 	_ctx_arr.resize (_nbr_threads);
 
 	// Precomputes base data for each source pixel
@@ -109,6 +279,25 @@ int	GenGrain::mt_start (float *dst_ptr, const float *src_ptr, int w, int h, ptrd
 		ctx._y_beg = h *  t_cnt      / _nbr_threads;
 		ctx._y_end = h * (t_cnt + 1) / _nbr_threads;
 		assert (ctx._y_beg < ctx._y_end);
+		ctx._stats.clear ();
+
+		// Conversion rows, for the planes not stored as linear float
+		for (int p_idx = 0; p_idx < _nbr_planes; ++p_idx)
+		{
+			const auto &   plane = _plane_arr [p_idx];
+			if (plane._q_ptr == nullptr && ! plane.is_src_direct ())
+			{
+				ctx._src_buf.resize (w);
+			}
+			if (! plane.is_dst_direct ())
+			{
+				ctx._dst_buf_arr [p_idx].resize (std::max (w, dst_w));
+			}
+			if (plane._msk_ptr != nullptr && ! plane._msk_fmt.is_float32 ())
+			{
+				ctx._msk_buf.resize (w);
+			}
+		}
 	}
 
 	return _nbr_threads;
@@ -122,42 +311,87 @@ void	GenGrain::mt_proc_pass1 (int idx)
 	assert (idx < _nbr_threads);
 
 	auto &         ctx = _ctx_arr [idx];
-	_density.process_area (
-		ctx._y_beg, ctx._y_end,
-		_src_ptr, _src_stride,
-		_dst_ptr, _dst_stride
-	);
+	RenderStats::ScopedTimer   timer (ctx._stats._pass1_s);
+	if (_tile_mask_ptr == nullptr)
+	{
+		proc_rows_pass1 (ctx, ctx._y_beg, ctx._y_end);
+	}
+
+	// Processes only the runs of required rows
+	else
+	{
+		int            y = ctx._y_beg;
+		while (y < ctx._y_end)
+		{
+			if (_row_p1_arr [y] == 0)
+			{
+				++ y;
+			}
+			else
+			{
+				const int      y_beg = y;
+				do
+				{
+					++ y;
+				}
+				while (y < ctx._y_end && _row_p1_arr [y] != 0);
+				proc_rows_pass1 (ctx, y_beg, y);
+			}
+		}
+	}
 }
 
 
 
 void	GenGrain::mt_prepare_pass2 ()
 {
-	_density_info = _density.get_result ();
+	int64_t        load_tot = 0;
+	for (int d_idx = 0; d_idx < _nbr_dens; ++d_idx)
+	{
+		_density_info_arr [d_idx] = _density_arr [d_idx]->get_result ();
+		load_tot += _density_info_arr [d_idx]._load_total;
+	}
+	if (_tile_mask_ptr != nullptr || _scaled_flag)
+	{
+		load_tot = 0;
+		for (int y = 0; y < _dst_h; ++y)
+		{
+			load_tot += compute_load_row_dst (y);
+		}
+	}
+
+	// The statistical renderer cost doesn't depend on the grain density,
+	// therefore we keep the even split from the pass 1.
+	if (_mode == RenderMode_STAT)
+	{
+		return;
+	}
 
 	// Evenly spreads the CPU load across threads
-	const auto     load_tot = _density_info._load_total;
 	int64_t        load_sum = 0;
 	int            y        = 0;
 	for (int t_cnt = 0; t_cnt < _nbr_threads; ++t_cnt)
 	{
-		assert (y < _pic_h);
+		assert (y < _dst_h);
 
 		auto &         ctx = _ctx_arr [t_cnt];
 		ctx._y_beg = y;
 
+		// Leaves at least one row to each remaining thread, and makes the last
+		// thread finish the picture (there may be rows without load).
+		const bool     last_flag   = (t_cnt == _nbr_threads - 1);
+		const int      y_max       = _dst_h - (_nbr_threads - 1 - t_cnt);
 		const auto     load_target = load_tot * (t_cnt + 1) / _nbr_threads;
 		do
 		{
-			const auto     load_row = _density.get_load_row (y);
-			load_sum += load_row;
+			load_sum += compute_load_row_dst (y);
 			++ y;
 		}
-		while (load_sum < load_target && y < _pic_h);
+		while ((load_sum < load_target || last_flag) && y < y_max);
 
 		ctx._y_end = y;
 	}
-	assert (y == _pic_h);
+	assert (y == _dst_h);
 	assert (std::abs (load_sum - load_tot) < _nbr_threads); // Tolerance for rounding errors
 }
 
@@ -168,11 +402,45 @@ void	GenGrain::mt_proc_pass2 (int idx)
 	assert (idx >= 0);
 	assert (idx < _nbr_threads);
 
-	const int      filter_h = _filter_ptr->get_h ();
-	auto &         ctx      = _ctx_arr [idx];
-	ctx._cell_cache.reset (_pic_w, filter_h);
+	auto &         ctx = _ctx_arr [idx];
+	RenderStats::ScopedTimer   timer (ctx._stats._pass2_s);
+	if (_mode == RenderMode_STAT)
+	{
+		render_part_stat (ctx);
+	}
+	else
+	{
+		ctx._cell_cache.reset (_pic_w, compute_cache_h ());
+
+		if (_scaled_flag)
+		{
+			(this->*_render_part_scaled_ptr) (ctx);
+		}
+		else if (_nbr_layers > 1)
+		{
+			(this->*_render_part_layers_ptr) (ctx);
+		}
+		else if (_nbr_planes > 1)
+		{
+			(this->*_render_part_multi_ptr) (ctx);
+		}
+		else
+		{
+			(this->*_render_part_ptr) (ctx);
+		}
+	}
+}
+
+
+
+// Statistics of the thread idx for the last rendered picture. Valid once
+// the passes are finished.
+const RenderStats &	GenGrain::use_stats (int idx) const noexcept
+{
+	assert (idx >= 0);
+	assert (idx < _nbr_threads);
 
-	(this->*_render_part_ptr) (ctx);
+	return _ctx_arr [idx]._stats;
 }
 
 
@@ -181,82 +449,165 @@ void	GenGrain::mt_proc_pass2 (int idx)
 void	GenGrain::build_cell (Cell &cell, int px, int py) const
 {
 	assert (px >= 0);
-	assert (py < _pic_w);
-	assert (px >= 0);
+	assert (px < _pic_w);
+	assert (py >= 0);
 	assert (py < _pic_h);
 
-	const auto     d_index   = py * _density_info._stride + px;
-	const auto     q         = _density_info._q_ptr [d_index];
-	auto           rnd_state = _density_info._seed_ptr [d_index];
-	cell.resize (q);
-
-	constexpr int  simd_w = fstb::Vf32::_length;
-	const auto     nx     = q & ~(simd_w - 1);
+	const auto &   info    = _density_info_arr [0];
+	const auto     d_index = py * info._stride + px;
 
-	// Generates the center coordinates
-
-	const auto     vhalf = fstb::Vf32 (0.5f);
-	const auto     vone  = fstb::Vu32 (1);
-	const auto     vstep = fstb::Vs32 (simd_w * 2);
-	auto           vrnd  = fstb::Vu32 (
-		rnd_state, rnd_state + 2, rnd_state + 4, rnd_state + 6
-	);
-	for (int pos = 0; pos < nx; pos += simd_w)
+	// Each layer has its own grains, stored one after the other
+	if (_nbr_layers > 1)
 	{
-		const auto     cx = UtilPrng::gen_uniform (vrnd       ) - vhalf;
-		const auto     cy = UtilPrng::gen_uniform (vrnd + vone) - vhalf;
-		vrnd += vstep;
-		cx.store (&cell._centers._x_arr [pos]);
-		cy.store (&cell._centers._y_arr [pos]);
-	}
-
-	for (int pos = nx; pos < q; ++pos)
-	{
-		const auto     cx = UtilPrng::gen_uniform (rnd_state + pos * 2    ) - 0.5f;
-		const auto     cy = UtilPrng::gen_uniform (rnd_state + pos * 2 + 1) - 0.5f;
-		cell._centers._x_arr [pos] = cx;
-		cell._centers._y_arr [pos] = cy;
-	}
+		std::array <int, _max_nbr_layers> q_arr {};
+		for (int l_idx = 0; l_idx < _nbr_layers; ++l_idx)
+		{
+			const auto &   info_l = _density_info_arr [l_idx];
+			assert (info_l._stride == info._stride);
+			q_arr [l_idx] = info_l._q_ptr [d_index];
+		}
+		cell.resize_layers (q_arr.data (), _nbr_layers);
+		for (int l_idx = 0; l_idx < _nbr_layers; ++l_idx)
+		{
+			gen_grains (
+				cell, cell.get_layer_beg (l_idx), q_arr [l_idx],
+				_density_info_arr [l_idx]._seed_ptr [d_index],
+				_layer_arr [l_idx]
+			);
+		}
 
-	// Constant radius
-	if (_g_rad_s <= 0)
-	{
-		std::fill (
-			cell._r2_arr.begin (), cell._r2_arr.end (), fstb::sq (_g_rad_mu)
-		);
+		// The layers are checked together, on a single bin per point
+		cell.bin_layers ();
 	}
 
-	// Variable radius
+	// With several planes, the cell contains the grains for the largest
+	// density. The seeds are the same for all the planes.
 	else
 	{
-		rnd_state = fstb::Hash::hash (rnd_state);
-
-		const auto     mu_log = logf (_g_rad_mu);
-
-		vrnd = fstb::Vu32 (
-			rnd_state, rnd_state + 2, rnd_state + 4, rnd_state + 6
-		);
-		const auto     vmu_log = fstb::Vf32 (mu_log);
-		const auto     vrad_s  = fstb::Vf32 (_g_rad_s);
-		for (int pos = 0; pos < nx; pos += simd_w)
+		auto           q         = info._q_ptr [d_index];
+		const auto     rnd_state = info._seed_ptr [d_index];
+		for (int p_idx = 1; p_idx < _nbr_planes; ++p_idx)
 		{
-			const auto     rad = UtilPrng::gen_log_norm (vrnd, vmu_log, vrad_s);
-			vrnd += vstep;
-			const auto     rad_sq = rad * rad;
-			rad_sq.store (&cell._r2_arr [pos]);
+			const auto &   info_p = _density_info_arr [p_idx];
+			assert (info_p._stride == info._stride);
+			assert (info_p._seed_ptr [d_index] == rnd_state);
+			q = std::max (q, info_p._q_ptr [d_index]);
 		}
+		cell.resize (q);
+		gen_grains (cell, 0, q, rnd_state, _layer_arr [0]);
 
-		for (int pos = nx; pos < q; ++pos)
+		// Scaled output: the cells are larger than the output pixels, the
+		// grains are sorted to restrict the checks to the useful ones.
+		if (_scaled_flag)
 		{
-			const auto     rad =
-				UtilPrng::gen_log_norm (rnd_state + pos * 2, mu_log, _g_rad_s);
-			cell._r2_arr [pos] = fstb::sq (rad);
+			cell.sort_bands ();
 		}
 	}
 }
 
 
 
+uint32_t	GenGrain::compute_layer_seed (uint32_t pic_seed, int layer_idx) noexcept
+{
+	assert (layer_idx >= 0);
+	assert (layer_idx < _max_nbr_layers);
+
+	return pic_seed + uint32_t (layer_idx) * _layer_seed_step;
+}
+
+
+
+// Returns the source area required to render the rect_dst part of a
+// picture of size pic_w * pic_h, so the part is identical to the same area
+// of the whole rendered picture: the vision filter reach around rect_dst,
+// extended to the alignment boundaries and clipped to the picture.
+// align_x must be a multiple of GrainDensity::_org_align, so the pixels are
+// processed with the same code paths as the whole picture.
+GenGrain::Rect	GenGrain::compute_rect_src (const Rect &rect_dst, int pic_w, int pic_h, int reach, int align_x, int align_y) noexcept
+{
+	assert (pic_w > 0);
+	assert (pic_h > 0);
+	assert (rect_dst._w > 0);
+	assert (rect_dst._h > 0);
+	assert (rect_dst._x >= 0);
+	assert (rect_dst._y >= 0);
+	assert (rect_dst._x + rect_dst._w <= pic_w);
+	assert (rect_dst._y + rect_dst._h <= pic_h);
+	assert (reach >= 0);
+	assert (align_x > 0);
+	assert (align_x % GrainDensity::_org_align == 0);
+	assert (align_y > 0);
+
+	const int      x_beg = std::max (rect_dst._x - reach, 0);
+	const int      y_beg = std::max (rect_dst._y - reach, 0);
+	const int      x_end = rect_dst._x + rect_dst._w + reach + align_x - 1;
+	const int      y_end = rect_dst._y + rect_dst._h + reach + align_y - 1;
+
+	Rect           rect_src;
+	rect_src._x = x_beg - x_beg % align_x;
+	rect_src._y = y_beg - y_beg % align_y;
+	rect_src._w = std::min (x_end - x_end % align_x, pic_w) - rect_src._x;
+	rect_src._h = std::min (y_end - y_end % align_y, pic_h) - rect_src._y;
+
+	return rect_src;
+}
+
+
+
+// Upper estimate of the memory allocated by the object to process a single
+// plane with a single layer and no scaling, in bytes. The vision filter is
+// not included. The number of grains of a cell follows a Poisson
+// distribution; the estimate assumes a white picture and keeps a margin of
+// a few standard deviations over the mean count.
+int64_t	GenGrain::estimate_mem_size (int w, int h, const VisionFilter &filter, RenderMode mode, int max_nbr_threads) noexcept
+{
+	assert (w > 0);
+	assert (h > 0);
+	assert (mode >= 0);
+	assert (mode < RenderMode_NBR_ELT);
+	assert (mode != RenderMode_ATLAS);
+	assert (max_nbr_threads > 0);
+
+	constexpr int  align_pix   = GrainDensity::_align / sizeof (float);
+	const auto     stride      = int64_t ((w + align_pix - 1) & ~(align_pix - 1));
+	const int      nbr_threads = std::min (max_nbr_threads, h);
+
+	int64_t        mem_size    = GrainDensity::compute_mem_size (w, h);
+	mem_size += nbr_threads * int64_t (sizeof (Context));
+
+	const double   lambda_max  = GrainDensity::compute_lambda_max (
+		filter.get_grain_radius_avg (), filter.get_grain_radius_stddev ()
+	);
+	const int      q_max       =
+		fstb::ceil_int (lambda_max + 5 * sqrt (lambda_max));
+
+	if (mode == RenderMode_STAT)
+	{
+		mem_size += stride * h * int64_t (sizeof (float));
+		mem_size += nbr_threads * w * int64_t (sizeof (float));
+
+		// Coverage deviation table
+		mem_size += (q_max + 1) * int64_t (sizeof (float));
+	}
+	else if (mode == RenderMode_FULL)
+	{
+		constexpr int  pad        = Cell::_pad;
+		const int      q_max_pad  = (q_max + pad - 1) & ~(pad - 1);
+
+		// Coordinates and squared radius, with the alignment overhead
+		const int64_t  cell_size  =
+			  int64_t (sizeof (Cell)) + int64_t (sizeof (bool))
+			+ q_max_pad * int64_t (3 * sizeof (float))
+			+ 3 * GrainDensity::_align;
+		const int64_t  nbr_cells  = int64_t (w) * filter.get_h ();
+		mem_size += nbr_threads * nbr_cells * cell_size;
+	}
+
+	return mem_size;
+}
+
+
+
 /*\\\ PROTECTED \\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\*/
 
 
@@ -265,6 +616,73 @@ void	GenGrain::build_cell (Cell &cell, int px, int py) const
 
 
 
+// Convolves the coverage map with the vision filter kernel, giving the
+// probability of a filter point to hit a grain. Then the actual number of
+// hits is drawn from a binomial distribution. This ignores the correlations
+// between the filter points of a given pixel, but the correlations between
+// adjacent pixels are preserved through the shared coverage map, which
+// contains the covered fraction of each pixel drawn in the pass 1 (see
+// GrainDensity::Output_COV). The two first states of the pixel seeds are
+// used by this draw.
+void	GenGrain::render_part_stat (Context &ctx)
+{
+	const auto &   kernel     = _filter_ptr->use_kernel ();
+	const int      nbr_points = _filter_ptr->get_nbr_points ();
+	const auto &   info       = _density_info_arr [0];
+
+	auto &         acc_arr = ctx._row_buf;
+	acc_arr.resize (_pic_w);
+	auto           acc_ptr = acc_arr.data ();
+
+	for (int y = ctx._y_beg; y < ctx._y_end; ++y)
+	{
+		// Whole rows are rendered, the cost is low anyway.
+		if (_tile_mask_ptr != nullptr && ! _tile_mask_ptr->is_row_set (y))
+		{
+			continue;
+		}
+
+		std::fill (acc_arr.begin (), acc_arr.end (), 0.f);
+
+		for (const auto &tap : kernel)
+		{
+			const auto     dx      = tap._dx;
+			const auto     wt      = tap._w;
+			const auto     sy      = fstb::limit (y + tap._dy, 0, _pic_h - 1);
+			const auto     cov_ptr = _cov_arr.data () + sy * _cov_stride;
+
+			// Pixels out of the picture are clipped to the borders
+			const auto     x_beg   = fstb::limit (    -dx, 0, _pic_w);
+			const auto     x_end   = fstb::limit (_pic_w - dx, x_beg, _pic_w);
+			for (int x = 0; x < x_beg; ++x)
+			{
+				acc_ptr [x] += wt * cov_ptr [0];
+			}
+			for (int x = x_beg; x < x_end; ++x)
+			{
+				acc_ptr [x] += wt * cov_ptr [x + dx];
+			}
+			for (int x = x_end; x < _pic_w; ++x)
+			{
+				acc_ptr [x] += wt * cov_ptr [_pic_w - 1];
+			}
+		}
+
+		const auto     seed_ptr = info._seed_ptr + y * info._stride;
+		const auto     dst_ptr  = use_dst_row_flt (ctx, 0, y);
+		for (int x = 0; x < _pic_w; ++x)
+		{
+			const auto     p   = fstb::limit (acc_ptr [x], 0.f, 1.f);
+			const auto     lum =
+				UtilPrng::gen_binomial (seed_ptr [x] + 2, nbr_points, p);
+			dst_ptr [x] = float (lum) * _out_scale;
+		}
+		flush_dst_row (ctx, 0, y, 0, _pic_w);
+	}
+}
+
+
+
 void	GenGrain::render_part_fpu (Context &ctx)
 {
 	render_part (ctx,
@@ -289,6 +707,284 @@ void	GenGrain::render_part_simd4 (Context &ctx)
 
 
 
+void	GenGrain::render_part_multi_fpu (Context &ctx)
+{
+	render_part_multi (ctx,
+		[] (const Cell &cell, float px, float py)
+		{
+			return cell.find_first_hit_fpu (px, py);
+		}
+	);
+}
+
+
+
+void	GenGrain::render_part_multi_simd4 (Context &ctx)
+{
+	render_part_multi (ctx,
+		[] (const Cell &cell, float px, float py)
+		{
+			return cell.find_first_hit_simd4 (px, py);
+		}
+	);
+}
+
+
+
+void	GenGrain::render_part_layers_fpu (Context &ctx)
+{
+	render_part_layers (ctx,
+		[] (const Cell &cell, float px, float py, int bin, unsigned int mask_chk)
+		{
+			return cell.check_intersect_bin_fpu (px, py, bin, mask_chk);
+		}
+	);
+}
+
+
+
+void	GenGrain::render_part_layers_simd4 (Context &ctx)
+{
+	render_part_layers (ctx,
+		[] (const Cell &cell, float px, float py, int bin, unsigned int mask_chk)
+		{
+			return cell.check_intersect_bin_simd4 (px, py, bin, mask_chk);
+		}
+	);
+}
+
+
+
+void	GenGrain::render_part_scaled_fpu (Context &ctx)
+{
+	render_part_scaled (ctx,
+		[] (const Cell &cell, float px, float py, int pos_beg, int pos_end)
+		{
+			return cell.check_intersect_span_fpu (px, py, pos_beg, pos_end);
+		}
+	);
+}
+
+
+
+void	GenGrain::render_part_scaled_simd4 (Context &ctx)
+{
+	render_part_scaled (ctx,
+		[] (const Cell &cell, float px, float py, int pos_beg, int pos_end)
+		{
+			return cell.check_intersect_span_simd4 (px, py, pos_beg, pos_end);
+		}
+	);
+}
+
+
+
+void	GenGrain::proc_rows_pass1 (Context &ctx, int y_beg, int y_end)
+{
+	assert (y_beg >= 0);
+	assert (y_beg < y_end);
+	assert (y_end <= _pic_h);
+
+	// Layers share the source plane
+	const bool     stat_flag  = (_mode == RenderMode_STAT);
+	const bool     draft_flag = (_mode == RenderMode_DRAFT);
+	const int      nbr_dens   = (stat_flag) ? 1 : _nbr_dens;
+	for (int d_idx = 0; d_idx < nbr_dens; ++d_idx)
+	{
+		const int      p_idx   = (_nbr_layers > 1) ? 0 : d_idx;
+		const auto &   plane   = _plane_arr [p_idx];
+		auto &         density = *_density_arr [d_idx];
+		if (   (plane._q_ptr == nullptr && ! plane.is_src_direct ())
+		    || (draft_flag && (! plane.is_dst_direct () || plane.is_blended ())))
+		{
+			proc_rows_pass1_conv (ctx, y_beg, y_end, p_idx, density);
+			continue;
+		}
+
+		const auto     dst_ptr    = (stat_flag)
+			? _cov_arr.data () : static_cast <float *> (plane._dst_ptr);
+		const auto     dst_stride = (stat_flag) ? _cov_stride : plane._dst_stride;
+		if (plane._q_ptr != nullptr)
+		{
+			density.import_area (
+				y_beg, y_end,
+				plane._q_ptr, plane._q_stride,
+				dst_ptr, dst_stride
+			);
+		}
+		else
+		{
+			density.process_area (
+				y_beg, y_end,
+				static_cast <const float *> (plane._src_ptr), plane._src_stride,
+				dst_ptr, dst_stride
+			);
+		}
+	}
+}
+
+
+
+// Same as proc_rows_pass1() for a single plane, when the source or the draft
+// output requires a conversion, or when the draft output is mixed with the
+// source. Rows are processed one by one through the context conversion rows
+// (null stride), so the data stays in the cache between the conversion, the
+// density calculation and the mix.
+void	GenGrain::proc_rows_pass1_conv (Context &ctx, int y_beg, int y_end, int p_idx, GrainDensity &density)
+{
+	const auto &   plane      = _plane_arr [p_idx];
+	const bool     stat_flag  = (_mode == RenderMode_STAT);
+	const bool     draft_flag = (_mode == RenderMode_DRAFT);
+	for (int y = y_beg; y < y_end; ++y)
+	{
+		float *        dst_ptr    = nullptr;
+		ptrdiff_t      dst_stride = 0;
+		if (stat_flag)
+		{
+			dst_ptr    = _cov_arr.data ();
+			dst_stride = _cov_stride;
+		}
+		else if (draft_flag)
+		{
+			dst_ptr    = use_dst_row_flt (ctx, p_idx, y);
+		}
+
+		if (plane._q_ptr != nullptr)
+		{
+			density.import_area (
+				y, y + 1, plane._q_ptr, plane._q_stride, dst_ptr, dst_stride
+			);
+		}
+		else
+		{
+			const auto     lum_ptr = use_src_row_flt (ctx, p_idx, y, 0, _pic_w);
+			density.process_area (y, y + 1, lum_ptr, 0, dst_ptr, dst_stride);
+			if (draft_flag && plane.is_blended ())
+			{
+				blend_row (
+					plane, dst_ptr, lum_ptr,
+					use_msk_row_flt (ctx, p_idx, y, 0, _pic_w), 0, _pic_w
+				);
+			}
+		}
+
+		if (draft_flag)
+		{
+			store_dst_row (ctx, p_idx, y, 0, _pic_w);
+		}
+	}
+}
+
+
+
+// Mixes the rendered values in dst_ptr with the linear source values in
+// lum_ptr, according to the grain amount of the plane and the optional
+// mask values in msk_ptr. Source and mask values are clipped to the nominal
+// range, as for the rendering.
+void	GenGrain::blend_row (const PlaneDesc &plane, float * fstb_RESTRICT dst_ptr, const float * fstb_RESTRICT lum_ptr, const float * fstb_RESTRICT msk_ptr, int x_beg, int x_end) noexcept
+{
+	assert (dst_ptr != nullptr);
+	assert (lum_ptr != nullptr);
+	assert (x_beg >= 0);
+	assert (x_beg <= x_end);
+
+	const float    a_blk = plane._amount_blk;
+	const float    a_dif = plane._amount_wht - plane._amount_blk;
+	if (msk_ptr == nullptr)
+	{
+		for (int x = x_beg; x < x_end; ++x)
+		{
+			const float    lum    = fstb::limit (lum_ptr [x], 0.f, 1.f);
+			const float    amount = a_blk + a_dif * lum;
+			dst_ptr [x] = lum + amount * (dst_ptr [x] - lum);
+		}
+	}
+	else
+	{
+		for (int x = x_beg; x < x_end; ++x)
+		{
+			const float    lum    = fstb::limit (lum_ptr [x], 0.f, 1.f);
+			const float    msk    = fstb::limit (msk_ptr [x], 0.f, 1.f);
+			const float    amount = (a_blk + a_dif * lum) * msk;
+			dst_ptr [x] = lum + amount * (dst_ptr [x] - lum);
+		}
+	}
+}
+
+
+
+// Pass 2 CPU load for a given row, for all the planes or layers. With a tile
+// mask, the load is prorated to the number of set tiles.
+int64_t	GenGrain::compute_load_row (int y) const noexcept
+{
+	assert (y >= 0);
+	assert (y < _pic_h);
+
+	int64_t        load = 0;
+	if (_tile_mask_ptr == nullptr || _tile_mask_ptr->is_row_set (y))
+	{
+		for (int d_idx = 0; d_idx < _nbr_dens; ++d_idx)
+		{
+			load += _density_arr [d_idx]->get_load_row (y);
+		}
+		if (_tile_mask_ptr != nullptr)
+		{
+			const int      ty = y / _tile_mask_ptr->get_tile_size ();
+			load = load * _tile_mask_ptr->get_nbr_tiles_set_row (ty)
+			     / _tile_mask_ptr->get_nbr_tiles_x ();
+		}
+	}
+
+	return load;
+}
+
+
+
+// Same as compute_load_row(), for an output row. When the output is scaled,
+// this is the load of the source row located at the same place, prorated
+// to the output pixel area.
+int64_t	GenGrain::compute_load_row_dst (int y) const noexcept
+{
+	assert (y >= 0);
+	assert (y < _dst_h);
+
+	if (! _scaled_flag)
+	{
+		return compute_load_row (y);
+	}
+
+	const int      y_src = fstb::limit (
+		int ((float (y) + 0.5f) * _src_step_y), 0, _pic_h - 1
+	);
+
+	return int64_t (
+		float (compute_load_row (y_src)) * (_src_step_x * _src_step_y)
+	);
+}
+
+
+
+// Number of cell rows in the cache, covering the filter height
+int	GenGrain::compute_cache_h () const noexcept
+{
+	assert (_filter_ptr != nullptr);
+
+	if (! _scaled_flag)
+	{
+		return _filter_ptr->get_h ();
+	}
+
+	// The filter reach is in output pixels, from the pixel center (the
+	// square filter covers half a pixel more). The cells are located up to
+	// the grain radius beyond the filter points.
+	const auto     reach_src =
+		(float (_filter_ptr->get_reach ()) + 0.5f) * _src_step_y + _rad_max;
+
+	return 2 * fstb::ceil_int (reach_src) + 2;
+}
+
+
+
 const Cell &	GenGrain::use_cell (Context &ctx, int cx, int cy)
 {
 	assert (cx >= 0);
@@ -296,7 +992,283 @@ const Cell &	GenGrain::use_cell (Context &ctx, int cx, int cy)
 	assert (cy >= 0);
 	assert (cy < _pic_h);
 
-	return ctx._cell_cache.use_cell (cx, cy, *this);
+	return ctx._cell_cache.use_cell (cx, cy, *this, ctx._stats);
+}
+
+
+
+// Generates the q grains of a layer, starting at position pos_beg in the
+// cell arrays. Grains are generated up to the next padding boundary.
+void	GenGrain::gen_grains (Cell &cell, int pos_beg, int q, uint32_t rnd_state, const Layer &layer) const
+{
+	assert (pos_beg >= 0);
+	assert (pos_beg % Cell::_pad == 0);
+	assert (q >= 0);
+
+	const auto     q_pad  = (q + Cell::_pad - 1) & ~(Cell::_pad - 1);
+	assert (pos_beg + q_pad <= cell.get_nbr_grains_pad ());
+	const auto     x_ptr  = cell._centers._x_arr.data () + pos_beg;
+	const auto     y_ptr  = cell._centers._y_arr.data () + pos_beg;
+	const auto     r2_ptr = cell._r2_arr.data () + pos_beg;
+
+	// All the grains are generated by full vectors, including the padding
+	// grains. Therefore the sequence of the actual grains does not depend on
+	// the vector size.
+	constexpr int  simd_w = fstb::Vf32::_length;
+	static_assert (Cell::_pad % simd_w == 0, "");
+
+	// The per-lane initialisations (lane indexes, PRNG states, radius
+	// table lookups) are written for 4 lanes.
+	static_assert (simd_w == 4, "");
+	static_assert (fstb::Vs32::_length == simd_w, "");
+	static_assert (fstb::Vu32::_length == simd_w, "");
+
+	// Generates the center coordinates
+
+	const auto     vhalf = fstb::Vf32 (0.5f);
+	const auto     vone  = fstb::Vu32 (1);
+	const auto     vstep = fstb::Vu32 (simd_w * 2);
+	auto           vrnd  = fstb::Vu32 (
+		rnd_state, rnd_state + 2, rnd_state + 4, rnd_state + 6
+	);
+	for (int pos = 0; pos < q_pad; pos += simd_w)
+	{
+		const auto     cx = UtilPrng::gen_uniform (vrnd       ) - vhalf;
+		const auto     cy = UtilPrng::gen_uniform (vrnd + vone) - vhalf;
+		vrnd += vstep;
+		cx.store (&x_ptr [pos]);
+		cy.store (&y_ptr [pos]);
+	}
+
+	// Radii. Padding grains are masked out with a null radius.
+	const auto     vq     = fstb::Vs32 (q);
+	const auto     vpstep = fstb::Vs32 (simd_w);
+	auto           vpos   = fstb::Vs32 (0, 1, 2, 3);
+	const auto     zero   = fstb::Vf32::zero ();
+
+	// Constant radius
+	if (layer._rad_s <= 0)
+	{
+		const auto     vr2 = fstb::Vf32 (fstb::sq (layer._rad_mu));
+		for (int pos = 0; pos < q_pad; pos += simd_w)
+		{
+			const auto     keep = fstb::ToolsSimd::cast_f32 (vpos < vq);
+			const auto     r2   = select (keep, vr2, zero);
+			vpos += vpstep;
+			r2.store (&r2_ptr [pos]);
+		}
+	}
+
+	// Variable radius
+	else
+	{
+		assert (layer._r2_tab_mu == layer._rad_mu);
+		assert (layer._r2_tab_s  == layer._rad_s);
+
+		rnd_state = UtilPrng::hash (rnd_state);
+
+		vrnd = fstb::Vu32 (
+			rnd_state, rnd_state + 2, rnd_state + 4, rnd_state + 6
+		);
+		const auto     r2_tab_ptr = layer._r2_table.data ();
+		alignas (16) std::array <int32_t, simd_w> idx;
+		for (int pos = 0; pos < q_pad; pos += simd_w)
+		{
+			UtilPrng::gen_norm_trunc_int (vrnd).store (idx.data ());
+			vrnd += vstep;
+			const auto     r2_t = fstb::Vf32 (
+				r2_tab_ptr [idx [0]],
+				r2_tab_ptr [idx [1]],
+				r2_tab_ptr [idx [2]],
+				r2_tab_ptr [idx [3]]
+			);
+			const auto     keep = fstb::ToolsSimd::cast_f32 (vpos < vq);
+			const auto     r2   = select (keep, r2_t, zero);
+			vpos += vpstep;
+			r2.store (&r2_ptr [pos]);
+		}
+	}
+}
+
+
+
+void	GenGrain::build_layer_masks ()
+{
+	assert (_filter_ptr != nullptr);
+	assert (_nbr_layers > 1);
+	static_assert (_max_nbr_layers <= 8, "Masks are stored on 8 bits");
+
+	_layer_mask_arr.clear ();
+	const auto &   fmap = _filter_ptr->use_map ();
+	for (const auto &f_p : fmap)
+	{
+		const auto &   cell_list  = f_p.first;
+		const auto &   point_list = f_p.second;
+		const auto     nbr_points = point_list.get_size ();
+		for (int p_cnt = 0; p_cnt < nbr_points; ++p_cnt)
+		{
+			const auto     fx = point_list._x_arr [p_cnt];
+			const auto     fy = point_list._y_arr [p_cnt];
+			for (const auto &cell_coord : cell_list)
+			{
+				uint8_t        mask = 0;
+				for (int l_idx = 0; l_idx < _nbr_layers; ++l_idx)
+				{
+					if (_filter_ptr->is_cell_in_reach (
+						fx, fy, cell_coord [0], cell_coord [1], _layer_arr [l_idx]._rad_max
+					))
+					{
+						mask |= uint8_t (1 << l_idx);
+					}
+				}
+				_layer_mask_arr.push_back (mask);
+			}
+		}
+	}
+}
+
+
+
+// Scaled output only. Tabulates the mapping of the filter points on the
+// source grid for each phase (see Phase). The computations are the same as
+// in render_pixel_scaled(). Nothing is tabulated when the period is too
+// long.
+void	GenGrain::build_phases ()
+{
+	assert (_filter_ptr != nullptr);
+
+	_phase_arr.clear ();
+	const std::array <int, 2>   src_len_arr { _pic_w, _pic_h };
+	const std::array <int, 2>   dst_len_arr { _dst_w, _dst_h };
+	for (int dir = 0; dir < 2; ++dir)
+	{
+		int            a = src_len_arr [dir];
+		int            b = dst_len_arr [dir];
+		while (b != 0)
+		{
+			a %= b;
+			std::swap (a, b);
+		}
+		_phase_len [dir] = dst_len_arr [dir] / a;
+		_phase_src [dir] = src_len_arr [dir] / a;
+	}
+	if (_phase_len [0] * _phase_len [1] > _max_nbr_phases)
+	{
+		return;
+	}
+
+	_phase_arr.resize (_phase_len [0] * _phase_len [1]);
+	const auto &   fmap = _filter_ptr->use_map ();
+	for (int py = 0; py < _phase_len [1]; ++py)
+	{
+		for (int px = 0; px < _phase_len [0]; ++px)
+		{
+			auto &         phase = _phase_arr [py * _phase_len [0] + px];
+
+			// Output pixel center on the source grid
+			const auto     xs  = (double (px) + 0.5) * _src_step_x - 0.5;
+			const auto     ys  = (double (py) + 0.5) * _src_step_y - 0.5;
+			phase._ix = fstb::round_int (xs);
+			phase._iy = fstb::round_int (ys);
+			const auto     ofx = float (xs - double (phase._ix));
+			const auto     ofy = float (ys - double (phase._iy));
+
+			FilterMap      phase_map;
+			for (const auto &f_p : fmap)
+			{
+				const auto &   point_list = f_p.second;
+				const auto     nbr_points = point_list.get_size ();
+				for (int p_cnt = 0; p_cnt < nbr_points; ++p_cnt)
+				{
+					const auto     fx = ofx + point_list._x_arr [p_cnt] * _src_step_x;
+					const auto     fy = ofy + point_list._y_arr [p_cnt] * _src_step_y;
+
+					// Cells where the centers of the potentially intersecting
+					// grains could be located
+					const auto     x_min = fstb::round_int (fx - _rad_max);
+					const auto     x_max = fstb::round_int (fx + _rad_max);
+					const auto     y_min = fstb::round_int (fy - _rad_max);
+					const auto     y_max = fstb::round_int (fy + _rad_max);
+					PixSet         cell_set;
+					for (int cy_r = y_min; cy_r <= y_max; ++cy_r)
+					{
+						for (int cx_r = x_min; cx_r <= x_max; ++cx_r)
+						{
+							cell_set.insert (C2di { cx_r, cy_r });
+						}
+					}
+
+					auto &         dst_list = phase_map [cell_set];
+					dst_list._x_arr.push_back (fx);
+					dst_list._y_arr.push_back (fy);
+				}
+			}
+
+			PixSet         cell_set;
+			for (const auto &f_p : phase_map)
+			{
+				cell_set.insert (f_p.first.begin (), f_p.first.end ());
+			}
+			phase._cell_arr.assign (cell_set.begin (), cell_set.end ());
+			for (const auto &f_p : phase_map)
+			{
+				Group          group;
+				for (const auto &cell_coord : f_p.first)
+				{
+					const auto     it = std::lower_bound (
+						phase._cell_arr.begin (), phase._cell_arr.end (), cell_coord
+					);
+					group._cell_idx_arr.push_back (
+						int (it - phase._cell_arr.begin ())
+					);
+				}
+				group._point_list = f_p.second;
+				const auto     nbr_points = group._point_list.get_size ();
+				for (int p_cnt = 0; p_cnt < nbr_points; ++p_cnt)
+				{
+					const auto     fy = group._point_list._y_arr [p_cnt];
+					for (const auto &cell_coord : f_p.first)
+					{
+						C2di           band_rng;
+						Cell::find_bands_y (
+							band_rng [0], band_rng [1],
+							fy - float (cell_coord [1]), _rad_max
+						);
+						group._band_arr.push_back (band_rng);
+					}
+				}
+				phase._group_arr.push_back (std::move (group));
+			}
+		}
+	}
+}
+
+
+
+// Radius: r = exp (mu_log + sigma * norm), with norm the truncated normal
+// variable.
+void	GenGrain::update_r2_table (Layer &layer)
+{
+	assert (layer._rad_s > 0);
+
+	if (layer._rad_mu == layer._r2_tab_mu && layer._rad_s == layer._r2_tab_s)
+	{
+		return;
+	}
+
+	constexpr int  tab_len = UtilPrng::_norm_trunc_max + 1;
+	layer._r2_table.resize (tab_len);
+	const auto     mu_log = log (double (layer._rad_mu));
+	for (int k = 0; k < tab_len; ++k)
+	{
+		const auto     norm =
+			double (k - UtilPrng::_norm_trunc_avg) * UtilPrng::_norm_trunc_mul;
+		const auto     r_log = mu_log + norm * double (layer._rad_s);
+		layer._r2_table [k] = float (exp (r_log * 2));
+	}
+
+	layer._r2_tab_mu = layer._rad_mu;
+	layer._r2_tab_s  = layer._rad_s;
 }
 
 
@@ -13,11 +13,26 @@ Usage for the multi-threaded interface:
 - mt_start (), returns the actual number of threads N
 - In parallel: N times mt_proc_pass1 (i)
 - Wait for all the threads to finish + fence
-Then, when not in draft mode:
+Then, when not in draft mode (RenderMode_FULL or RenderMode_STAT):
 - mt_prepare_pass2 ()
 - In parallel: N times mt_proc_pass2 (i)
 - Wait for all the threads to finish + fence
 
+The interface taking a PlaneArray renders jointly up to _max_nbr_planes
+planes with the same seed (RenderMode_FULL only). The result is the same as
+rendering the planes separately with this seed, but the cells and the grain
+intersections are shared, so it is about twice faster for RGB.
+
+An optional TileMask restricts the rendering to its set tiles. The rendered
+pixels are identical to a full rendering. Other pixels are not guaranteed:
+they may be left untouched or be overwritten with temporary data.
+
+The picture may be a part of a larger one, located at a given origin. The
+rendered pixels are identical to the rendering of the larger picture if the
+part contains all the source pixels in the vision filter reach (clipped to
+the larger picture). Combined with a TileMask, this allows rendering a
+rectangle of a large picture from a source of limited size.
+
 Algorithm from:
 Alasdair Newson, Julie Delon, Bruno Galerne,
 A Stochastic Film Grain Model for Resolution-Independent Rendering,
@@ -48,6 +63,11 @@ http://sam.zoy.org/wtfpl/COPYING for more details.
 #include "fgrn/CellCache.h"
 #include "fgrn/GrainDensity.h"
 #include "fgrn/PointList.h"
+#include "fgrn/RenderMode.h"
+#include "fgrn/RenderStats.h"
+#include "fgrn/SplFmt.h"
+#include "fgrn/Transfer.h"
+#include "fgrn/TileMask.h"
 #include "fstb/VecAlign.h"
 #include "fstb/Vf32.h"
 #include "fstb/Vu32.h"
@@ -79,20 +99,110 @@ public:
 
 	typedef GenGrain ThisType;
 
+	// Maximum number of planes rendered jointly
+	static constexpr int _max_nbr_planes = 3;
+
+	// Source and destination of a plane. Strides are in pixels.
+	// Samples are stored in the given formats. Other formats than 32-bit
+	// float are converted on the fly, row by row, during the passes.
+	// _tf_ptr is optional: the transfer curve of both planes, for encoded
+	// (non-linear) data. The source is linearized and the output re-encoded
+	// during the same conversions.
+	// _amount_blk and _amount_wht set the grain amount, as a mix of the
+	// rendered and source values in linear light: 1 = grain only, 0 = source
+	// only. The amount is interpolated between _amount_blk for a null source
+	// value and _amount_wht for a full-scale one. The mix requires the
+	// source picture at the output size.
+	// _msk_ptr is optional: a mask plane of the source size, in [0 ; 1],
+	// stored in the _msk_fmt format. The amount is multiplied by the mask
+	// value, so null mask pixels get the source.
+	// _q_ptr is optional: a grain count map previously computed for the same
+	// seed and grain radius (see GrainDensity::get_result()). When set, the
+	// pass 1 uses it instead of the source picture and _src_ptr is ignored.
+	class PlaneDesc
+	{
+	public:
+		inline uint8_t *
+		               use_dst_row (int y) const noexcept;
+		inline const uint8_t *
+		               use_src_row (int y) const noexcept;
+		inline const uint8_t *
+		               use_msk_row (int y) const noexcept;
+		inline bool    is_src_direct () const noexcept;
+		inline bool    is_dst_direct () const noexcept;
+		inline bool    is_blended () const noexcept;
+
+		void *         _dst_ptr    = nullptr;
+		const void *   _src_ptr    = nullptr;
+		ptrdiff_t      _dst_stride = 0;
+		ptrdiff_t      _src_stride = 0;
+		SplFmt         _dst_fmt;
+		SplFmt         _src_fmt;
+		const int32_t* _q_ptr      = nullptr;
+		ptrdiff_t      _q_stride   = 0;
+		const Transfer *
+		               _tf_ptr     = nullptr;
+		float          _amount_blk = 1;
+		float          _amount_wht = 1;
+		const void *   _msk_ptr    = nullptr;
+		ptrdiff_t      _msk_stride = 0;
+		SplFmt         _msk_fmt;
+	};
+	typedef std::array <PlaneDesc, _max_nbr_planes> PlaneArray;
+
+	// Maximum number of grain layers rendered jointly. A layer uses the
+	// resources of a plane, so layers are limited to single planes.
+	static constexpr int _max_nbr_layers = Cell::_max_nbr_layers;
+	static_assert (_max_nbr_layers <= _max_nbr_planes, "");
+
+	// Grain layer. The output is the weighted sum of the layers, each one
+	// rendered as if it were alone, with its own seed (see
+	// compute_layer_seed()).
+	class LayerDesc
+	{
+	public:
+		float          _rad_avg    = 0.025f; // Pixels, > 0
+		float          _rad_stddev = 0;      // [0 ; 1]
+		float          _weight     = 1;
+	};
+	typedef std::array <LayerDesc, _max_nbr_layers> LayerArray;
+
+	// Seed offset between two consecutive layers
+	static constexpr uint32_t _layer_seed_step = 1 << 24;
+
+	// Rectangular part of a picture, in pixels
+	class Rect
+	{
+	public:
+		int            _x = 0;
+		int            _y = 0;
+		int            _w = 0;
+		int            _h = 0;
+	};
+
 	explicit       GenGrain (bool simd4_flag, bool avx_flag);
 
 	// Single thread interface
-	void           process (float *dst_ptr, const float *src_ptr, int w, int h, ptrdiff_t src_stride, ptrdiff_t dst_stride, const VisionFilter &filter, uint32_t pic_seed, bool draft_flag);
+	void           process (float *dst_ptr, const float *src_ptr, int w, int h, ptrdiff_t src_stride, ptrdiff_t dst_stride, const VisionFilter &filter, uint32_t pic_seed, RenderMode mode);
+	void           process (const PlaneArray &plane_arr, int nbr_planes, int w, int h, const VisionFilter &filter, uint32_t pic_seed, RenderMode mode, const TileMask *tile_mask_ptr = nullptr, const LayerArray *layer_arr_ptr = nullptr, int nbr_layers = 1, int dst_w = 0, int dst_h = 0, int org_x = 0, int org_y = 0);
 
 	// Multi-thread interface
-	int            mt_start (float *dst_ptr, const float *src_ptr, int w, int h, ptrdiff_t src_stride, ptrdiff_t dst_stride, const VisionFilter &filter, uint32_t pic_seed, bool draft_flag, int max_nbr_threads);
+	int            mt_start (float *dst_ptr, const float *src_ptr, int w, int h, ptrdiff_t src_stride, ptrdiff_t dst_stride, const VisionFilter &filter, uint32_t pic_seed, RenderMode mode, int max_nbr_threads);
+	int            mt_start (const PlaneArray &plane_arr, int nbr_planes, int w, int h, const VisionFilter &filter, uint32_t pic_seed, RenderMode mode, int max_nbr_threads, const TileMask *tile_mask_ptr = nullptr, const LayerArray *layer_arr_ptr = nullptr, int nbr_layers = 1, int dst_w = 0, int dst_h = 0, int org_x = 0, int org_y = 0);
 	void           mt_proc_pass1 (int idx);
 	void           mt_prepare_pass2 ();
 	void           mt_proc_pass2 (int idx);
+	const RenderStats &
+	               use_stats (int idx) const noexcept;
 
 	// Reserved for the cache manager
 	void           build_cell (Cell &cell, int px, int py) const;
 
+	static uint32_t
+	               compute_layer_seed (uint32_t pic_seed, int layer_idx) noexcept;
+	static int64_t estimate_mem_size (int w, int h, const VisionFilter &filter, RenderMode mode, int max_nbr_threads) noexcept;
+	static Rect    compute_rect_src (const Rect &rect_dst, int pic_w, int pic_h, int reach, int align_x, int align_y) noexcept;
+
 
 
 /*\\\ PROTECTED \\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\*/
@@ -114,6 +224,31 @@ private:
 		int            _y_end = 0;
 
 		CellCache      _cell_cache;
+
+		// Hot path counters and pass times of the thread for the current
+		// picture. Null unless enabled at compile time.
+		RenderStats    _stats;
+
+		// Temporary row for the statistical renderer
+		std::vector <float>
+		               _row_buf;
+
+		// Conversion rows for the planes not stored as linear 32-bit float.
+		// The source row is converted before the pass 1, and the rendered
+		// rows are converted to the destination format.
+		fstb::VecAlign <float, GrainDensity::_align>
+		               _src_buf;
+		std::array <fstb::VecAlign <float, GrainDensity::_align>, _max_nbr_planes>
+		               _dst_buf_arr;
+
+		// Mask row, for the masks not stored as 32-bit float
+		std::vector <float>
+		               _msk_buf;
+
+		// Scaled output only. Cells of the current pixel, matching
+		// Phase::_cell_arr.
+		std::vector <const Cell *>
+		               _cell_ptr_arr;
 	};
 
 	typedef std::array <int, 2> C2di; // Integer 2D coordinates
@@ -123,17 +258,125 @@ private:
 	// All coordinates are in pixels and relative to the filter center.
 	typedef std::map <PixSet, PointList> FilterMap;
 
+	typedef std::array <int, _max_nbr_planes> LumArray;
+
+	// Grain characteristics of a layer
+	class Layer
+	{
+	public:
+		// Grain radius average value in pixels and standard deviation
+		float          _rad_mu = 0.04f; // > 0
+		float          _rad_s  = 0.25f; // >= 0
+
+		float          _weight = 1;
+
+		// Upper bound of the grain radius, in pixels
+		float          _rad_max = 0;
+
+		// Variable radius only: squared grain radius for each value of the
+		// integer truncated normal variable (see
+		// UtilPrng::gen_norm_trunc_int()). _r2_tab_mu and _r2_tab_s are the
+		// parameters used to build the current table, -1 if not built yet.
+		std::vector <float>
+		               _r2_table;
+		float          _r2_tab_mu = -1;
+		float          _r2_tab_s  = -1;
+	};
+
+	// Scaled output only. Filter points sharing the same set of cells.
+	class Group
+	{
+	public:
+		// Cells as indexes in the Phase::_cell_arr table
+		std::vector <int>
+		               _cell_idx_arr;
+		PointList      _point_list;
+
+		// Band range of each point in each cell (see Cell::find_bands_y()),
+		// at index p_cnt * _cell_idx_arr.size () + cell
+		std::vector <C2di>
+		               _band_arr;
+	};
+
+	// Scaled output only. The output and source sizes have a rational
+	// ratio, so the mapping of the filter points on the source grid is
+	// periodic. A phase is the position of an output pixel in the period.
+	class Phase
+	{
+	public:
+		// Nearest source cell of the output pixel center, relative to the
+		// period origin
+		int            _ix = 0;
+		int            _iy = 0;
+
+		// All the cells where the centers of the grains intersecting the
+		// filter could be located, relative to the nearest cell
+		std::vector <C2di>
+		               _cell_arr;
+
+		// Filter points relative to the nearest cell, grouped by the cells
+		// to check. Same content as a FilterMap.
+		std::vector <Group>
+		               _group_arr;
+	};
+
+	// Longest period for the tabulated scaled output, in phases
+	static constexpr int _max_nbr_phases = 64;
+
+	void           render_part_stat (Context &ctx);
 	void           render_part_fpu (Context &ctx);
 	void           render_part_simd4 (Context &ctx);
+	void           render_part_multi_fpu (Context &ctx);
+	void           render_part_multi_simd4 (Context &ctx);
+	void           render_part_layers_fpu (Context &ctx);
+	void           render_part_layers_simd4 (Context &ctx);
+	void           render_part_scaled_fpu (Context &ctx);
+	void           render_part_scaled_simd4 (Context &ctx);
 #if fstb_ARCHI == fstb_ARCHI_X86
 	void           render_part_avx (Context &ctx);
+	void           render_part_multi_avx (Context &ctx);
+	void           render_part_layers_avx (Context &ctx);
+	void           render_part_scaled_avx (Context &ctx);
 #endif
 
 	template <typename F>
 	void           render_part (Context &ctx, F check_inter);
 	template <typename F>
 	float          render_pixel (Context &ctx, int px, int py, F check_inter);
+	template <typename F>
+	void           render_part_multi (Context &ctx, F find_hit);
+	template <typename F>
+	void           render_pixel_multi (LumArray &lum_arr, Context &ctx, int px, int py, F find_hit);
+	template <typename F>
+	void           render_part_layers (Context &ctx, F check_inter);
+	template <typename F>
+	float          render_pixel_layers (Context &ctx, int px, int py, F check_inter);
+	template <typename F>
+	void           render_part_scaled (Context &ctx, F check_inter);
+	template <typename F>
+	float          render_pixel_scaled (Context &ctx, int px, int py, F check_inter);
+	template <typename F>
+	float          render_pixel_phased (Context &ctx, int px, int py, F check_inter);
+	template <typename F>
+	void           process_row_spans (int y, F fnc) const;
+	inline float * use_dst_row_flt (Context &ctx, int p_idx, int y) const noexcept;
+	inline void    flush_dst_row (Context &ctx, int p_idx, int y, int x_beg, int x_end) const noexcept;
+	inline void    store_dst_row (Context &ctx, int p_idx, int y, int x_beg, int x_end) const noexcept;
+	inline const float *
+	               use_src_row_flt (Context &ctx, int p_idx, int y, int x_beg, int x_end) const noexcept;
+	void           proc_rows_pass1 (Context &ctx, int y_beg, int y_end);
+	void           proc_rows_pass1_conv (Context &ctx, int y_beg, int y_end, int p_idx, GrainDensity &density);
+	inline const float *
+	               use_msk_row_flt (Context &ctx, int p_idx, int y, int x_beg, int x_end) const noexcept;
+	static void    blend_row (const PlaneDesc &plane, float * fstb_RESTRICT dst_ptr, const float * fstb_RESTRICT lum_ptr, const float * fstb_RESTRICT msk_ptr, int x_beg, int x_end) noexcept;
+	int64_t        compute_load_row (int y) const noexcept;
+	int64_t        compute_load_row_dst (int y) const noexcept;
+	int            compute_cache_h () const noexcept;
 	const Cell &   use_cell (Context &ctx, int px, int py);
+	void           gen_grains (Cell &cell, int pos_beg, int q, uint32_t rnd_state, const Layer &layer) const;
+	void           build_layer_masks ();
+	void           build_phases ();
+	static void    update_r2_table (Layer &layer);
 
 	bool           _simd4_flag = false;
 	bool           _avx_flag   = false;
@@ -142,26 +385,87 @@ private:
 	int            _pic_w = 0;
 	int            _pic_h = 0;
 
-	const float *  _src_ptr    = nullptr;
-	ptrdiff_t      _src_stride = 0; // In pixels!
-
-	float *        _dst_ptr    = nullptr;
-	ptrdiff_t      _dst_stride = 0; // In pixels!
+	// Output size in pixels. Same as the picture size, unless the output is
+	// scaled. In this case, the pass 1 runs on the source grid and the
+	// vision filter points of each output pixel are mapped to the source
+	// cells during the pass 2. The filter coordinates are in output pixels.
+	int            _dst_w = 0;
+	int            _dst_h = 0;
+	bool           _scaled_flag = false;
+
+	// Scaled output only: size of an output pixel, in source pixels
+	float          _src_step_x = 1;
+	float          _src_step_y = 1;
+
+	// Scaled output only: upper bound for the grain radius, in source pixels
+	float          _rad_max = 0;
+
+	// Scaled output only: the filter point mapping for each phase, in
+	// rows. Output pixel (px, py) has the phase (px % _phase_len [0],
+	// py % _phase_len [1]), and its period origin is located at
+	// (px / _phase_len [0] * _phase_src [0], py / _phase_len [1] *
+	// _phase_src [1]) on the source grid. Empty when the period is too long
+	// to be tabulated.
+	std::vector <Phase>
+	               _phase_arr;
+	std::array <int, 2>
+	               _phase_len {};
+	std::array <int, 2>
+	               _phase_src {};
+
+	// Planes to process. When there are several planes, they share the same
+	// seed, so the grains of a cell for a given plane are a prefix of the
+	// grains generated for the plane with the largest density. Cells are
+	// built once for all the planes and the first intersecting grain tells
+	// which planes are hit.
+	PlaneArray     _plane_arr;
+	int            _nbr_planes = 1;
 
 	const VisionFilter *
 	               _filter_ptr = nullptr;
 
+	// Optional. When set, only the pixels located in the set tiles are
+	// rendered, the other ones are left untouched (or receive a partial
+	// result in draft mode). nullptr = whole picture.
+	const TileMask *
+	               _tile_mask_ptr = nullptr;
+
+	// Tile mask only: indicates the rows required during the pass 1 (0 or 1),
+	// that is the rows located in the vision filter reach of any set tile.
+	std::vector <uint8_t>
+	               _row_p1_arr;
+
+	RenderMode     _mode       = RenderMode_FULL;
+
 	// Multiplier to convert the number of intersections into a [0 ; 1] pixel
 	// value
 	float          _out_scale  = 0;
 
-	// Grain radius average value in pixels and standard deviation
-	float          _g_rad_mu = 0.04f; // > 0
-	float          _g_rad_s  = 0.25f; // >= 0
-
-	GrainDensity   _density;
-	GrainDensity::DataGrain
-	               _density_info;
+	// Grain layers. There is a single layer, unless specified otherwise.
+	// Several layers require a single plane.
+	std::array <Layer, _max_nbr_layers>
+	               _layer_arr;
+	int            _nbr_layers = 1;
+
+	// Several layers only. For each filter point and each source pixel of
+	// its group, in the filter map order: bit l is set when the source pixel
+	// is in the reach of the layer l. The filter is built for the largest
+	// layer, so the other layers need only a part of the group.
+	std::vector <uint8_t>
+	               _layer_mask_arr;
+
+	// One object per plane or per layer
+	std::array <std::unique_ptr <GrainDensity>, _max_nbr_planes>
+	               _density_arr;
+	int            _nbr_dens   = 1;
+	std::array <GrainDensity::DataGrain, _max_nbr_planes>
+	               _density_info_arr;
+
+	// Statistical mode only: expected grain coverage for each pixel, as
+	// computed during the pass 1.
+	fstb::VecAlign <float, GrainDensity::_align>
+	               _cov_arr;
+	ptrdiff_t      _cov_stride = 0; // In pixels
 
 	int            _nbr_threads = 0;
 	std::vector <Context>
@@ -169,6 +473,12 @@ private:
 
 	void (ThisType::*                   // 0 = not set
 	               _render_part_ptr) (Context &ctx) = nullptr;
+	void (ThisType::*                   // 0 = not set
+	               _render_part_multi_ptr) (Context &ctx) = nullptr;
+	void (ThisType::*                   // 0 = not set
+	               _render_part_layers_ptr) (Context &ctx) = nullptr;
+	void (ThisType::*                   // 0 = not set
+	               _render_part_scaled_ptr) (Context &ctx) = nullptr;
 
 
 
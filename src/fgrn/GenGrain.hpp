@@ -22,8 +22,11 @@ http://www.wtfpl.net/ for more details.
 
 /*\\\ INCLUDE FILES \\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\*/
 
+#include "fgrn/SplConv.h"
 #include "fgrn/VisionFilter.h"
 
+#include <algorithm>
+
 #include <cassert>
 
 
@@ -37,6 +40,69 @@ namespace fgrn
 
 
 
+uint8_t *	GenGrain::PlaneDesc::use_dst_row (int y) const noexcept
+{
+	assert (_dst_ptr != nullptr);
+
+	return
+		  static_cast <uint8_t *> (_dst_ptr)
+		+ y * _dst_stride * _dst_fmt.get_size ();
+}
+
+
+
+const uint8_t *	GenGrain::PlaneDesc::use_src_row (int y) const noexcept
+{
+	assert (_src_ptr != nullptr);
+
+	return
+		  static_cast <const uint8_t *> (_src_ptr)
+		+ y * _src_stride * _src_fmt.get_size ();
+}
+
+
+
+const uint8_t *	GenGrain::PlaneDesc::use_msk_row (int y) const noexcept
+{
+	assert (_msk_ptr != nullptr);
+
+	return
+		  static_cast <const uint8_t *> (_msk_ptr)
+		+ y * _msk_stride * _msk_fmt.get_size ();
+}
+
+
+
+// True if the source samples can be used in place, without conversion
+bool	GenGrain::PlaneDesc::is_src_direct () const noexcept
+{
+	return (
+		   _src_fmt.is_float32 ()
+		&& (_tf_ptr == nullptr || _tf_ptr->is_linear ())
+	);
+}
+
+
+
+// True if the rendered values can be written in place, without conversion
+bool	GenGrain::PlaneDesc::is_dst_direct () const noexcept
+{
+	return (
+		   _dst_fmt.is_float32 ()
+		&& (_tf_ptr == nullptr || _tf_ptr->is_linear ())
+	);
+}
+
+
+
+// True if the rendered values are mixed with the source
+bool	GenGrain::PlaneDesc::is_blended () const noexcept
+{
+	return (_amount_blk != 1 || _amount_wht != 1 || _msk_ptr != nullptr);
+}
+
+
+
 /*\\\ PROTECTED \\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\*/
 
 
@@ -45,16 +111,149 @@ namespace fgrn
 
 
 
+// Row receiving the rendered float values of the plane p_idx: the
+// destination row itself for linear 32-bit float planes, otherwise a
+// temporary row converted by flush_dst_row().
+float *	GenGrain::use_dst_row_flt (Context &ctx, int p_idx, int y) const noexcept
+{
+	const auto &   plane = _plane_arr [p_idx];
+	if (plane.is_dst_direct ())
+	{
+		return reinterpret_cast <float *> (plane.use_dst_row (y));
+	}
+
+	return ctx._dst_buf_arr [p_idx].data ();
+}
+
+
+
+// Mixes the [x_beg ; x_end[ part of the row returned by use_dst_row_flt()
+// with the source if required, and stores it into the destination plane.
+void	GenGrain::flush_dst_row (Context &ctx, int p_idx, int y, int x_beg, int x_end) const noexcept
+{
+	const auto &   plane = _plane_arr [p_idx];
+	if (plane.is_blended ())
+	{
+		blend_row (
+			plane, use_dst_row_flt (ctx, p_idx, y),
+			use_src_row_flt (ctx, p_idx, y, x_beg, x_end),
+			use_msk_row_flt (ctx, p_idx, y, x_beg, x_end), x_beg, x_end
+		);
+	}
+	store_dst_row (ctx, p_idx, y, x_beg, x_end);
+}
+
+
+
+// Same as flush_dst_row(), without the mix
+void	GenGrain::store_dst_row (Context &ctx, int p_idx, int y, int x_beg, int x_end) const noexcept
+{
+	const auto &   plane = _plane_arr [p_idx];
+	if (! plane.is_dst_direct ())
+	{
+		const auto     dst_ptr = plane.use_dst_row (y);
+		const auto     buf_ptr = ctx._dst_buf_arr [p_idx].data ();
+		if (plane._tf_ptr != nullptr)
+		{
+			plane._tf_ptr->conv_row_from_linear (
+				dst_ptr, buf_ptr, plane._dst_fmt, x_beg, x_end
+			);
+		}
+		else
+		{
+			SplConv::conv_row_from_float (
+				dst_ptr, buf_ptr, plane._dst_fmt, x_beg, x_end
+			);
+		}
+	}
+}
+
+
+
+// Linear float source values of the plane p_idx: the source row itself for
+// linear 32-bit float planes, otherwise the [x_beg ; x_end[ part of the
+// context source row, converted.
+const float *	GenGrain::use_src_row_flt (Context &ctx, int p_idx, int y, int x_beg, int x_end) const noexcept
+{
+	const auto &   plane = _plane_arr [p_idx];
+	if (plane.is_src_direct ())
+	{
+		return reinterpret_cast <const float *> (plane.use_src_row (y));
+	}
+
+	const auto     lum_ptr = ctx._src_buf.data ();
+	if (plane._tf_ptr != nullptr)
+	{
+		plane._tf_ptr->conv_row_to_linear (
+			lum_ptr, plane.use_src_row (y), plane._src_fmt, x_beg, x_end
+		);
+	}
+	else
+	{
+		SplConv::conv_row_to_float (
+			lum_ptr, plane.use_src_row (y), plane._src_fmt, x_beg, x_end
+		);
+	}
+
+	return lum_ptr;
+}
+
+
+
+// Mask values of the plane p_idx, or nullptr if there is no mask. Same as
+// use_src_row_flt(), without transfer curve.
+const float *	GenGrain::use_msk_row_flt (Context &ctx, int p_idx, int y, int x_beg, int x_end) const noexcept
+{
+	const auto &   plane = _plane_arr [p_idx];
+	if (plane._msk_ptr == nullptr)
+	{
+		return nullptr;
+	}
+	if (plane._msk_fmt.is_float32 ())
+	{
+		return reinterpret_cast <const float *> (plane.use_msk_row (y));
+	}
+
+	const auto     msk_ptr = ctx._msk_buf.data ();
+	SplConv::conv_row_to_float (
+		msk_ptr, plane.use_msk_row (y), plane._msk_fmt, x_beg, x_end
+	);
+
+	return msk_ptr;
+}
+
+
+
+// Calls fnc (x_beg, x_end) for each span of pixels to render on row y.
+template <typename F>
+void	GenGrain::process_row_spans (int y, F fnc) const
+{
+	if (_tile_mask_ptr == nullptr)
+	{
+		fnc (0, _pic_w);
+	}
+	else
+	{
+		_tile_mask_ptr->process_row_spans (y, fnc);
+	}
+}
+
+
+
 template <typename F>
 void	GenGrain::render_part (Context &ctx, F check_inter)
 {
 	for (int y = ctx._y_beg; y < ctx._y_end; ++y)
 	{
-		for (int x = 0; x < _pic_w; ++x)
+		const auto     dst_ptr = use_dst_row_flt (ctx, 0, y);
+		process_row_spans (y, [&] (int x_beg, int x_end)
 		{
-			const auto     v = render_pixel (ctx, x, y, check_inter);
-			_dst_ptr [y * _dst_stride + x] = v;
-		}
+			for (int x = x_beg; x < x_end; ++x)
+			{
+				dst_ptr [x] = render_pixel (ctx, x, y, check_inter);
+			}
+			flush_dst_row (ctx, 0, y, x_beg, x_end);
+		});
 	}
 }
 
@@ -64,8 +263,8 @@ template <typename F>
 float	GenGrain::render_pixel (Context &ctx, int px, int py, F check_inter)
 {
 	assert (px >= 0);
-	assert (py < _pic_w);
-	assert (px >= 0);
+	assert (px < _pic_w);
+	assert (py >= 0);
 	assert (py < _pic_h);
 
 	int            lum = 0;
@@ -99,9 +298,14 @@ float	GenGrain::render_pixel (Context &ctx, int px, int py, F check_inter)
 				// current cell center.
 				const auto     tst_x = fx - float (cx_r);
 				const auto     tst_y = fy - float (cy_r);
+				ctx._stats.add (RenderStats::Cnt_CHECKS, 1);
+				ctx._stats.add (
+					RenderStats::Cnt_GRAINS_TESTED, cell.get_nbr_grains ()
+				);
 				if (check_inter (cell, tst_x, tst_y))
 				{
 					++ lum;
+					ctx._stats.add (RenderStats::Cnt_EARLY_EXITS, 1);
 					break; // Escapes to the loop over filter points
 				}
 			}
@@ -113,6 +317,393 @@ float	GenGrain::render_pixel (Context &ctx, int px, int py, F check_inter)
 
 
 
+template <typename F>
+void	GenGrain::render_part_multi (Context &ctx, F find_hit)
+{
+	LumArray       lum_arr;
+	std::array <float *, _max_nbr_planes> dst_ptr_arr {};
+	for (int y = ctx._y_beg; y < ctx._y_end; ++y)
+	{
+		for (int p_idx = 0; p_idx < _nbr_planes; ++p_idx)
+		{
+			dst_ptr_arr [p_idx] = use_dst_row_flt (ctx, p_idx, y);
+		}
+		process_row_spans (y, [&] (int x_beg, int x_end)
+		{
+			for (int x = x_beg; x < x_end; ++x)
+			{
+				render_pixel_multi (lum_arr, ctx, x, y, find_hit);
+				for (int p_idx = 0; p_idx < _nbr_planes; ++p_idx)
+				{
+					dst_ptr_arr [p_idx] [x] = float (lum_arr [p_idx]) * _out_scale;
+				}
+			}
+			for (int p_idx = 0; p_idx < _nbr_planes; ++p_idx)
+			{
+				flush_dst_row (ctx, p_idx, y, x_beg, x_end);
+			}
+		});
+	}
+}
+
+
+
+// Same as render_pixel(), for all the planes at once.
+// Cells contain the grains of the plane with the largest density. A plane
+// is hit by a filter point if the index of the first grain intersecting the
+// point is lower than the number of grains of this plane in the cell.
+template <typename F>
+void	GenGrain::render_pixel_multi (LumArray &lum_arr, Context &ctx, int px, int py, F find_hit)
+{
+	assert (px >= 0);
+	assert (px < _pic_w);
+	assert (py >= 0);
+	assert (py < _pic_h);
+
+	lum_arr.fill (0);
+
+	const auto     mask_all = (1u << _nbr_planes) - 1;
+	const auto     q_stride = _density_info_arr [0]._stride;
+
+	const auto &   fmap = _filter_ptr->use_map ();
+	for (auto &f_p : fmap)
+	{
+		const auto &   cell_list  = f_p.first;
+		const auto &   point_list = f_p.second;
+
+		const auto     nbr_points = point_list.get_size ();
+		for (int p_cnt = 0; p_cnt < nbr_points; ++p_cnt)
+		{
+			const auto     fx = point_list._x_arr [p_cnt];
+			const auto     fy = point_list._y_arr [p_cnt];
+
+			// Bit p is set when plane p is hit
+			unsigned int   mask_hit = 0;
+			for (const auto &cell_coord : cell_list)
+			{
+				const auto     cx_r  = cell_coord [0];
+				const auto     cy_r  = cell_coord [1];
+				const auto     cx    = fstb::limit (px + cx_r, 0, _pic_w - 1);
+				const auto     cy    = fstb::limit (py + cy_r, 0, _pic_h - 1);
+				const auto &   cell  = use_cell (ctx, cx, cy);
+				const auto     tst_x = fx - float (cx_r);
+				const auto     tst_y = fy - float (cy_r);
+				const int      g_idx = find_hit (cell, tst_x, tst_y);
+				ctx._stats.add (RenderStats::Cnt_CHECKS, 1);
+				ctx._stats.add (
+					RenderStats::Cnt_GRAINS_TESTED,
+					std::min (g_idx + 1, cell.get_nbr_grains ())
+				);
+				if (g_idx < cell.get_nbr_grains ())
+				{
+					const auto     d_index = cy * q_stride + cx;
+					for (int p_idx = 0; p_idx < _nbr_planes; ++p_idx)
+					{
+						if (g_idx < _density_info_arr [p_idx]._q_ptr [d_index])
+						{
+							mask_hit |= 1u << p_idx;
+						}
+					}
+					if (mask_hit == mask_all)
+					{
+						ctx._stats.add (RenderStats::Cnt_EARLY_EXITS, 1);
+						break;
+					}
+				}
+			}
+
+			for (int p_idx = 0; p_idx < _nbr_planes; ++p_idx)
+			{
+				lum_arr [p_idx] += int ((mask_hit >> p_idx) & 1);
+			}
+		}
+	}
+}
+
+
+
+template <typename F>
+void	GenGrain::render_part_layers (Context &ctx, F check_inter)
+{
+	for (int y = ctx._y_beg; y < ctx._y_end; ++y)
+	{
+		const auto     dst_ptr = use_dst_row_flt (ctx, 0, y);
+		process_row_spans (y, [&] (int x_beg, int x_end)
+		{
+			for (int x = x_beg; x < x_end; ++x)
+			{
+				dst_ptr [x] = render_pixel_layers (ctx, x, y, check_inter);
+			}
+			flush_dst_row (ctx, 0, y, x_beg, x_end);
+		});
+	}
+}
+
+
+
+// Same as render_pixel(), for all the layers at once. The filter points
+// and the cells are visited once. In each cell, a single band lookup gives
+// the grain spans of all the layers (see Cell::bin_layers()), and only the
+// layers in reach and not hit yet are checked. The hits are accumulated in
+// a mask, one bit per layer.
+// The result is the weighted sum of the layer values.
+template <typename F>
+float	GenGrain::render_pixel_layers (Context &ctx, int px, int py, F check_inter)
+{
+	assert (px >= 0);
+	assert (px < _pic_w);
+	assert (py >= 0);
+	assert (py < _pic_h);
+
+	LumArray       lum_arr {};
+
+	const auto     mask_all = (1u << _nbr_layers) - 1;
+	const uint8_t* mask_ptr = _layer_mask_arr.data ();
+
+	const auto &   fmap = _filter_ptr->use_map ();
+	for (auto &f_p : fmap)
+	{
+		const auto &   cell_list  = f_p.first;
+		const auto &   point_list = f_p.second;
+		const int      nbr_cells  = int (cell_list.size ());
+
+		const auto     nbr_points = point_list.get_size ();
+		for (int p_cnt = 0; p_cnt < nbr_points; ++p_cnt)
+		{
+			const auto     fx = point_list._x_arr [p_cnt];
+			const auto     fy = point_list._y_arr [p_cnt];
+
+			// Bit l is set when layer l is hit
+			unsigned int   mask_hit = 0;
+			int            c_idx    = 0;
+			for (const auto &cell_coord : cell_list)
+			{
+				// Layers in reach and not hit yet
+				const auto     mask_chk = mask_ptr [c_idx] & ~mask_hit;
+				++ c_idx;
+				if (mask_chk == 0)
+				{
+					continue;
+				}
+				const auto     cx_r  = cell_coord [0];
+				const auto     cy_r  = cell_coord [1];
+				const auto     cx    = fstb::limit (px + cx_r, 0, _pic_w - 1);
+				const auto     cy    = fstb::limit (py + cy_r, 0, _pic_h - 1);
+				const auto &   cell  = use_cell (ctx, cx, cy);
+				const auto     tst_x = fx - float (cx_r);
+				const auto     tst_y = fy - float (cy_r);
+				const auto     bin   = cell.find_bin (tst_y);
+				ctx._stats.add (RenderStats::Cnt_CHECKS, 1);
+				ctx._stats.add (
+					RenderStats::Cnt_GRAINS_TESTED, cell.get_bin_size (bin)
+				);
+				mask_hit |= check_inter (cell, tst_x, tst_y, bin, mask_chk);
+				if (mask_hit == mask_all)
+				{
+					ctx._stats.add (RenderStats::Cnt_EARLY_EXITS, 1);
+					break;
+				}
+			}
+			mask_ptr += nbr_cells;
+
+			for (int l_idx = 0; l_idx < _nbr_layers; ++l_idx)
+			{
+				lum_arr [l_idx] += int ((mask_hit >> l_idx) & 1);
+			}
+		}
+	}
+
+	float          sum = 0;
+	for (int l_idx = 0; l_idx < _nbr_layers; ++l_idx)
+	{
+		sum += _layer_arr [l_idx]._weight * (float (lum_arr [l_idx]) * _out_scale);
+	}
+
+	return sum;
+}
+
+
+
+// Scaled output. The output pixels are not aligned on the source cells,
+// so the cells possibly containing grains intersecting a filter point are
+// found for each point, from its location on the source grid and the grain
+// radius upper bound. The vision filter groups are not used.
+// Within a cell, only the grains located vertically in the radius bound are
+// checked (the grains are sorted in bands, see build_cell()).
+template <typename F>
+void	GenGrain::render_part_scaled (Context &ctx, F check_inter)
+{
+	for (int y = ctx._y_beg; y < ctx._y_end; ++y)
+	{
+		const auto     dst_ptr = use_dst_row_flt (ctx, 0, y);
+		if (! _phase_arr.empty ())
+		{
+			for (int x = 0; x < _dst_w; ++x)
+			{
+				dst_ptr [x] = render_pixel_phased (ctx, x, y, check_inter);
+			}
+		}
+		else
+		{
+			for (int x = 0; x < _dst_w; ++x)
+			{
+				dst_ptr [x] = render_pixel_scaled (ctx, x, y, check_inter);
+			}
+		}
+		flush_dst_row (ctx, 0, y, 0, _dst_w);
+	}
+}
+
+
+
+// px, py: output pixel coordinates
+template <typename F>
+float	GenGrain::render_pixel_scaled (Context &ctx, int px, int py, F check_inter)
+{
+	assert (px >= 0);
+	assert (px < _dst_w);
+	assert (py >= 0);
+	assert (py < _dst_h);
+
+	// Center of the output pixel on the source grid, split into the nearest
+	// cell and the offset relative to this cell center. Further coordinates
+	// are relative to this cell to preserve the accuracy on large pictures.
+	const auto     xs  = (double (px) + 0.5) * _src_step_x - 0.5;
+	const auto     ys  = (double (py) + 0.5) * _src_step_y - 0.5;
+	const int      ix  = fstb::round_int (xs);
+	const int      iy  = fstb::round_int (ys);
+	const auto     ofx = float (xs - double (ix));
+	const auto     ofy = float (ys - double (iy));
+
+	int            lum = 0;
+
+	const auto &   fmap = _filter_ptr->use_map ();
+	for (auto &f_p : fmap)
+	{
+		const auto &   point_list = f_p.second;
+
+		const auto     nbr_points = point_list.get_size ();
+		for (int p_cnt = 0; p_cnt < nbr_points; ++p_cnt)
+		{
+			// Filter point location, in source pixels
+			const auto     fx = ofx + point_list._x_arr [p_cnt] * _src_step_x;
+			const auto     fy = ofy + point_list._y_arr [p_cnt] * _src_step_y;
+
+			// Inclusive range of the cells where the centers of the
+			// potentially intersecting grains could be located
+			const auto     x_min = fstb::round_int (fx - _rad_max);
+			const auto     x_max = fstb::round_int (fx + _rad_max);
+			const auto     y_min = fstb::round_int (fy - _rad_max);
+			const auto     y_max = fstb::round_int (fy + _rad_max);
+
+			bool           hit_flag = false;
+			for (int cy_r = y_min; cy_r <= y_max && ! hit_flag; ++cy_r)
+			{
+				const auto     cy    = fstb::limit (iy + cy_r, 0, _pic_h - 1);
+				const auto     tst_y = fy - float (cy_r);
+				for (int cx_r = x_min; cx_r <= x_max && ! hit_flag; ++cx_r)
+				{
+					const auto     cx    = fstb::limit (ix + cx_r, 0, _pic_w - 1);
+					const auto &   cell  = use_cell (ctx, cx, cy);
+					const auto     tst_x = fx - float (cx_r);
+					int            pos_beg;
+					int            pos_end;
+					cell.find_span_y (pos_beg, pos_end, tst_y, _rad_max);
+					ctx._stats.add (RenderStats::Cnt_CHECKS, 1);
+					ctx._stats.add (
+						RenderStats::Cnt_GRAINS_TESTED, pos_end - pos_beg
+					);
+					hit_flag = check_inter (cell, tst_x, tst_y, pos_beg, pos_end);
+				}
+			}
+			ctx._stats.add (RenderStats::Cnt_EARLY_EXITS, int (hit_flag));
+			lum += int (hit_flag);
+		}
+	}
+
+	return float (lum) * _out_scale;
+}
+
+
+
+// Scaled output, with the filter point mapping read from the phase tables
+// (see build_phases()). Same result as render_pixel_scaled(), with the
+// structure of render_pixel(). The cells of the pixel are fetched once,
+// before checking the points. They stay all available in the cache because
+// it covers the whole filter footprint (see compute_cache_h()).
+template <typename F>
+float	GenGrain::render_pixel_phased (Context &ctx, int px, int py, F check_inter)
+{
+	assert (px >= 0);
+	assert (px < _dst_w);
+	assert (py >= 0);
+	assert (py < _dst_h);
+	assert (! _phase_arr.empty ());
+
+	const auto &   phase = _phase_arr [
+		  (py % _phase_len [1]) * _phase_len [0]
+		+  px % _phase_len [0]
+	];
+	const int      ix    = (px / _phase_len [0]) * _phase_src [0] + phase._ix;
+	const int      iy    = (py / _phase_len [1]) * _phase_src [1] + phase._iy;
+
+	const auto     nbr_cells = int (phase._cell_arr.size ());
+	auto &         cell_ptr_arr = ctx._cell_ptr_arr;
+	cell_ptr_arr.resize (nbr_cells);
+	for (int c_idx = 0; c_idx < nbr_cells; ++c_idx)
+	{
+		const auto &   cell_coord = phase._cell_arr [c_idx];
+		const auto     cx = fstb::limit (ix + cell_coord [0], 0, _pic_w - 1);
+		const auto     cy = fstb::limit (iy + cell_coord [1], 0, _pic_h - 1);
+		cell_ptr_arr [c_idx] = &use_cell (ctx, cx, cy);
+	}
+
+	int            lum = 0;
+
+	for (const auto &group : phase._group_arr)
+	{
+		const auto &   cell_idx_arr = group._cell_idx_arr;
+		const auto &   point_list   = group._point_list;
+		const int      nbr_p_cells  = int (cell_idx_arr.size ());
+
+		const auto     nbr_points = point_list.get_size ();
+		for (int p_cnt = 0; p_cnt < nbr_points; ++p_cnt)
+		{
+			const auto     fx = point_list._x_arr [p_cnt];
+			const auto     fy = point_list._y_arr [p_cnt];
+
+			const auto     band_ptr = &group._band_arr [p_cnt * nbr_p_cells];
+
+			for (int k = 0; k < nbr_p_cells; ++k)
+			{
+				const auto     c_idx = cell_idx_arr [k];
+				const auto &   cell_coord = phase._cell_arr [c_idx];
+				const auto &   cell  = *(cell_ptr_arr [c_idx]);
+				const auto     tst_x = fx - float (cell_coord [0]);
+				const auto     tst_y = fy - float (cell_coord [1]);
+				const auto &   bands = band_ptr [k];
+				int            pos_beg;
+				int            pos_end;
+				cell.get_span_bands (pos_beg, pos_end, bands [0], bands [1]);
+				ctx._stats.add (RenderStats::Cnt_CHECKS, 1);
+				ctx._stats.add (
+					RenderStats::Cnt_GRAINS_TESTED, pos_end - pos_beg
+				);
+				if (check_inter (cell, tst_x, tst_y, pos_beg, pos_end))
+				{
+					++ lum;
+					ctx._stats.add (RenderStats::Cnt_EARLY_EXITS, 1);
+					break;
+				}
+			}
+		}
+	}
+
+	return float (lum) * _out_scale;
+}
+
+
+
 }  // namespace fgrn
 
 
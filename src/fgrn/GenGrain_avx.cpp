@@ -45,6 +45,42 @@ void	GenGrain::render_part_avx (Context &ctx)
 
 
 
+void	GenGrain::render_part_multi_avx (Context &ctx)
+{
+	render_part_multi (ctx,
+		[] (const Cell &cell, float px, float py)
+		{
+			return cell.find_first_hit_avx (px, py);
+		}
+	);
+}
+
+
+
+void	GenGrain::render_part_layers_avx (Context &ctx)
+{
+	render_part_layers (ctx,
+		[] (const Cell &cell, float px, float py, int bin, unsigned int mask_chk)
+		{
+			return cell.check_intersect_bin_avx (px, py, bin, mask_chk);
+		}
+	);
+}
+
+
+
+void	GenGrain::render_part_scaled_avx (Context &ctx)
+{
+	render_part_scaled (ctx,
+		[] (const Cell &cell, float px, float py, int pos_beg, int pos_end)
+		{
+			return cell.check_intersect_span_avx (px, py, pos_beg, pos_end);
+		}
+	);
+}
+
+
+
 /*\\\ PROTECTED \\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\*/
 
 
@@ -0,0 +1,216 @@
+/*****************************************************************************
+
+        GrainAtlas.cpp
+        Author: Laurent de Soras, 2022
+
+--- Legal stuff ---
+
+This program is free software. It comes without any warranty, to
+the extent permitted by applicable law. You can redistribute it
+and/or modify it under the terms of the Do What The Fuck You Want
+To Public License, Version 2, as published by Sam Hocevar. See
+http://sam.zoy.org/wtfpl/COPYING for more details.
+
+*Tab=3***********************************************************************/
+
+
+
+
+/*\\\ INCLUDE FILES \\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\*/
+
+#include "fgrn/GrainAtlas.h"
+#include "fgrn/UtilPrng.h"
+#include "fstb/fnc.h"
+
+#include <algorithm>
+
+#include <cassert>
+#include <cmath>
+
+
+
+namespace fgrn
+{
+
+
+
+/*\\\ PUBLIC \\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\*/
+
+
+
+void	GrainAtlas::reset (int nbr_levels, int patch_size, int block_size, int overlap)
+{
+	assert (nbr_levels >= 2);
+	assert (block_size > 0);
+	assert (overlap >= 0);
+	assert (overlap <= block_size);
+	assert (patch_size >= block_size + overlap);
+
+	_nbr_levels = nbr_levels;
+	_patch_size = patch_size;
+	_block_size = block_size;
+	_overlap    = overlap;
+	_patch_len  = ptrdiff_t (patch_size) * patch_size;
+
+	// sin^2 + cos^2 = 1: uncorrelated blocks keep the grain variance
+	_fade_arr.resize (overlap);
+	for (int pos = 0; pos < overlap; ++pos)
+	{
+		const auto     t = (double (pos) + 0.5) / double (overlap);
+		_fade_arr [pos] = float (sin (t * fstb::PI * 0.5));
+	}
+
+	const auto     len = size_t (_patch_len * nbr_levels);
+	_src_arr.resize (len);
+	_patch_arr.assign (len, 0.f);
+	for (int level = 0; level < nbr_levels; ++level)
+	{
+		const auto     lum = float (level) / float (nbr_levels - 1);
+		const auto     it  = _src_arr.begin () + level * _patch_len;
+		std::fill (it, it + _patch_len, lum);
+	}
+}
+
+
+
+int	GrainAtlas::get_nbr_levels () const noexcept
+{
+	return _nbr_levels;
+}
+
+
+
+int	GrainAtlas::get_patch_size () const noexcept
+{
+	return _patch_size;
+}
+
+
+
+// Source and destination of the patch to render for the given level
+GenGrain::PlaneDesc	GrainAtlas::use_level_plane (int level) noexcept
+{
+	assert (level >= 0);
+	assert (level < _nbr_levels);
+
+	GenGrain::PlaneDesc  plane;
+	plane._src_ptr    = _src_arr.data ()   + level * _patch_len;
+	plane._dst_ptr    = _patch_arr.data () + level * _patch_len;
+	plane._src_stride = _patch_size;
+	plane._dst_stride = _patch_size;
+
+	return plane;
+}
+
+
+
+// Strides in pixels. Source values are clipped to [0 ; 1].
+// The output is first the sum of the weighted deviations of the blocks from
+// the source level, then the level is added.
+void	GrainAtlas::synthesize (float *dst_ptr, ptrdiff_t dst_stride, const float *src_ptr, ptrdiff_t src_stride, int w, int h, uint32_t pic_seed) const noexcept
+{
+	assert (_nbr_levels >= 2);
+	assert (dst_ptr != nullptr);
+	assert (src_ptr != nullptr);
+	assert (w > 0);
+	assert (h > 0);
+
+	const auto     lvl_mul   = float (_nbr_levels - 1);
+	const int      lvl_max   = _nbr_levels - 2;
+	const int      ext_len   = _block_size + _overlap;
+	const int      ext_bef   = _overlap / 2; // Extension before the block
+	const auto     ofs_range = uint32_t (_patch_size - ext_len + 1);
+	const auto     patch_ptr = _patch_arr.data ();
+	const auto     fade_ptr  = _fade_arr.data ();
+
+	const auto     get_lum   = [] (float x) { return fstb::limit (x, 0.f, 1.f); };
+
+	// Weight of a block starting at blk_pos, for the pixel at ext_pos in the
+	// extended block. len is the picture size in the same direction. There
+	// is no cross-fade at the picture borders.
+	const auto     get_weight = [&] (int ext_pos, int blk_pos, int len) {
+		if (ext_pos < _overlap && blk_pos > 0)
+		{
+			return fade_ptr [ext_pos];
+		}
+		else if (ext_pos >= _block_size && blk_pos + _block_size < len)
+		{
+			return fade_ptr [ext_len - 1 - ext_pos];
+		}
+		return 1.f;
+	};
+
+	for (int y = 0; y < h; ++y)
+	{
+		std::fill (dst_ptr + y * dst_stride, dst_ptr + y * dst_stride + w, 0.f);
+	}
+
+	for (int blk_y = 0; blk_y < h; blk_y += _block_size)
+	{
+		const int      ext_y = blk_y - ext_bef;
+		const int      y_beg = std::max (ext_y, 0);
+		const int      y_end = std::min (ext_y + ext_len, h);
+		for (int blk_x = 0; blk_x < w; blk_x += _block_size)
+		{
+			const int      ext_x = blk_x - ext_bef;
+			const int      x_beg = std::max (ext_x, 0);
+			const int      x_end = std::min (ext_x + ext_len, w);
+
+			// Patch offset for this block
+			const auto     rnd   = UtilPrng::hash (
+				pic_seed + (uint32_t (blk_y) << 16) + uint32_t (blk_x)
+			);
+			const auto     ofs_x = int ((rnd & 0xFFFF) % ofs_range);
+			const auto     ofs_y = int ((rnd >> 16   ) % ofs_range);
+
+			for (int y = y_beg; y < y_end; ++y)
+			{
+				const auto     w_y   = get_weight (y - ext_y, blk_y, h);
+				const auto     s_ptr = src_ptr + y * src_stride;
+				auto           d_ptr = dst_ptr + y * dst_stride;
+				const auto     p_ptr =
+					  patch_ptr + (ofs_y + y - ext_y) * _patch_size
+					+ ofs_x - ext_x;
+				for (int x = x_beg; x < x_end; ++x)
+				{
+					const auto     lum    = get_lum (s_ptr [x]);
+					const auto     pos    = lum * lvl_mul;
+					const auto     level  = std::min (int (pos), lvl_max);
+					const auto     frac   = pos - float (level);
+					const auto     v0_ptr = p_ptr + level * _patch_len + x;
+					const auto     v0     = v0_ptr [0];
+					const auto     v1     = v0_ptr [_patch_len];
+					const auto     v      = v0 + (v1 - v0) * frac;
+					const auto     wgt    = w_y * get_weight (x - ext_x, blk_x, w);
+					d_ptr [x] += wgt * (v - lum);
+				}
+			}
+		}
+	}
+
+	for (int y = 0; y < h; ++y)
+	{
+		const auto     s_ptr = src_ptr + y * src_stride;
+		auto           d_ptr = dst_ptr + y * dst_stride;
+		for (int x = 0; x < w; ++x)
+		{
+			d_ptr [x] = fstb::limit (d_ptr [x] + get_lum (s_ptr [x]), 0.f, 1.f);
+		}
+	}
+}
+
+
+
+/*\\\ PROTECTED \\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\*/
+
+
+
+/*\\\ PRIVATE \\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\*/
+
+
+
+}  // namespace fgrn
+
+
+
+/*\\\ EOF \\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\*/
@@ -0,0 +1,143 @@
+/*****************************************************************************
+
+        GrainAtlas.h
+        Author: Laurent de Soras, 2022
+
+Grain texture atlas: a set of square grain patches rendered with the
+complete model for regularly spaced luminance levels, and the synthesis of
+a grained picture from these patches.
+
+All the patches are rendered with the same seed, so the grains of a patch
+are a subset of the grains of the next, brighter patch. Therefore a linear
+interpolation between two consecutive patches is close to an actual
+rendering at the intermediate level.
+
+The picture is split into blocks. Each block reads the patches at a
+random offset depending on the picture seed. The blocks are extended so
+neighbours overlap, and they are cross-faded in the overlapping areas to
+hide the seams. The weights keep the sum of their squares constant, so the
+grain variance is preserved across the transitions.
+
+Usage:
+- reset ()
+- Render all the planes given by use_level_plane () with GenGrain
+  (RenderMode_FULL, same seed for all the planes)
+- synthesize () for each picture, possibly from several threads.
+
+--- Legal stuff ---
+
+This program is free software. It comes without any warranty, to
+the extent permitted by applicable law. You can redistribute it
+and/or modify it under the terms of the Do What The Fuck You Want
+To Public License, Version 2, as published by Sam Hocevar. See
+http://sam.zoy.org/wtfpl/COPYING for more details.
+
+*Tab=3***********************************************************************/
+
+
+
+#pragma once
+#if ! defined (fgrn_GrainAtlas_HEADER_INCLUDED)
+#define fgrn_GrainAtlas_HEADER_INCLUDED
+
+
+
+/*\\\ INCLUDE FILES \\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\*/
+
+#include "fgrn/GenGrain.h"
+
+#include <vector>
+
+#include <cstddef>
+#include <cstdint>
+
+
+
+namespace fgrn
+{
+
+
+
+class GrainAtlas
+{
+
+/*\\\ PUBLIC \\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\*/
+
+public:
+
+	void           reset (int nbr_levels, int patch_size, int block_size, int overlap);
+
+	int            get_nbr_levels () const noexcept;
+	int            get_patch_size () const noexcept;
+	GenGrain::PlaneDesc
+	               use_level_plane (int level) noexcept;
+
+	void           synthesize (float *dst_ptr, ptrdiff_t dst_stride, const float *src_ptr, ptrdiff_t src_stride, int w, int h, uint32_t pic_seed) const noexcept;
+
+
+
+/*\\\ PROTECTED \\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\*/
+
+protected:
+
+
+
+/*\\\ PRIVATE \\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\*/
+
+private:
+
+	// Number of luminance levels, >= 2. Level k corresponds to the
+	// luminance k / (_nbr_levels - 1).
+	int            _nbr_levels = 0;
+
+	// Patch width and height, in pixels
+	int            _patch_size = 0;
+
+	// Block width and height, in pixels
+	int            _block_size = 0;
+
+	// Width of the cross-fade between two blocks, in pixels.
+	// _block_size + _overlap <= _patch_size
+	int            _overlap    = 0;
+
+	// Number of pixels of a patch
+	ptrdiff_t      _patch_len  = 0;
+
+	// Constant source pictures, then rendered patches, for all the levels.
+	// Stride = _patch_size, one patch after the other.
+	std::vector <float>
+	               _src_arr;
+	std::vector <float>
+	               _patch_arr;
+
+	// Fade-in weights of the overlapping areas, _overlap elements. The
+	// fade-out weights are the same in reverse order.
+	std::vector <float>
+	               _fade_arr;
+
+
+
+/*\\\ FORBIDDEN MEMBER FUNCTIONS \\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\*/
+
+private:
+
+	bool           operator == (const GrainAtlas &other) const = delete;
+	bool           operator != (const GrainAtlas &other) const = delete;
+
+}; // class GrainAtlas
+
+
+
+}  // namespace fgrn
+
+
+
+//#include "fgrn/GrainAtlas.hpp"
+
+
+
+#endif   // fgrn_GrainAtlas_HEADER_INCLUDED
+
+
+
+/*\\\ EOF \\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\*/
@@ -22,6 +22,9 @@ http://sam.zoy.org/wtfpl/COPYING for more details.
 #include "fgrn/GrainDensity.h"
 #include "fgrn/UtilPrng.h"
 
+#include <algorithm>
+#include <array>
+
 #include <cassert>
 #include <cmath>
 
@@ -41,7 +44,8 @@ constexpr int	GrainDensity::_align;
 
 
 GrainDensity::GrainDensity (bool simd4_flag)
-:	_process_area_ptr (&ThisType::process_area_fpu)
+:	_simd4_flag (simd4_flag)
+,	_process_area_ptr (&ThisType::process_area_fpu)
 {
 	if (simd4_flag)
 	{
@@ -51,17 +55,32 @@ GrainDensity::GrainDensity (bool simd4_flag)
 
 
 
-void	GrainDensity::reset (int w, int h, float grain_radius_avg, float grain_radius_stddev, uint32_t pic_rnd_seed, bool draft_flag)
+// org_x, org_y: position of the picture when it is a part of a larger one.
+// The seeds depend on the absolute pixel coordinates, so rendering the part
+// gives the same grains. The part must end on a multiple of _org_align or on
+// the right border of the larger picture.
+void	GrainDensity::reset (int w, int h, float grain_radius_avg, float grain_radius_stddev, uint32_t pic_rnd_seed, Output output, int org_x, int org_y)
 {
 	assert (w > 0);
 	assert (h > 0);
 	assert (grain_radius_avg > 0);
 	assert (grain_radius_stddev >= 0);
+	assert (output >= 0);
+	assert (output < Output_NBR_ELT);
+	assert (org_x >= 0);
+	assert (org_x % _org_align == 0);
+	assert (org_y >= 0);
 
 	_w = w;
 	_h = h;
-	_draft_flag   = draft_flag;
-	_pic_rnd_seed = pic_rnd_seed;
+	_draft_flag   = (output != Output_NONE);
+	_cov_flag     = (output == Output_COV);
+
+	// Same as adding the origin to the coordinates in compute_q()
+	_pic_rnd_seed =
+		  pic_rnd_seed
+		+ (uint32_t (org_y) << 20)
+		+ (uint32_t (org_x) <<  8);
 	constexpr int  align_pix = _align / sizeof (int32_t);
 	_stride = (w + align_pix - 1) & ~(align_pix - 1);
 	const auto     len = size_t (_stride * h);
@@ -71,17 +90,15 @@ void	GrainDensity::reset (int w, int h, float grain_radius_avg, float grain_radi
 
 	_load_total.store (0);
 
-	// There is probably an error in the paper in the algorithm description
-	// about the inclusion of grain_radius_stddev in the formula.
-	// Expected value of a log-norm variable is exp (log_mu + 0.5 * sigma^2)
-	// Expected value for its square is exp (2 * log_mu + 2 * sigma^2)
-	// (found by integrating x^2 * PDF_lognorm(x) from 0 to +inf)
 	const auto     inv_lambda_mul =
-		  -fstb::PI
-		* fstb::sq (grain_radius_avg)
-		* expf (2 * fstb::sq (grain_radius_stddev));
+		compute_inv_lambda_mul (grain_radius_avg, grain_radius_stddev);
 	_inv_lambda_mul = float (      inv_lambda_mul);
 	_lambda_mul     = float (1.0 / inv_lambda_mul);
+
+	if (_cov_flag)
+	{
+		update_cov_dev_table (-inv_lambda_mul);
+	}
 }
 
 
@@ -107,6 +124,65 @@ void	GrainDensity::process_area (int y_beg, int y_end, const float *lum_ptr, ptr
 
 
 
+// Same as process_area(), but the grain counts are taken from a map
+// previously computed with the same parameters and seed (see get_result()).
+// The seeds are generated again, and the CPU load is estimated from the
+// grain counts, so the thread balance may slightly differ.
+void	GrainDensity::import_area (int y_beg, int y_end, const int32_t *q_ptr, ptrdiff_t stride_q, float *dst_ptr, ptrdiff_t stride_dst) noexcept
+{
+	assert (_w > 0);
+	assert (y_beg >= 0);
+	assert (y_beg < y_end);
+	assert (y_end <= _h);
+	assert (q_ptr != nullptr);
+	assert (dst_ptr != nullptr || ! _draft_flag);
+
+	int64_t        load_block = 0;
+
+	q_ptr   += y_beg * stride_q;
+	dst_ptr += y_beg * stride_dst;
+	auto           q_dst_ptr = &_q_arr [y_beg * _stride];
+	auto           seed_ptr  = &_seed_arr [y_beg * _stride];
+	for (int y = y_beg; y < y_end; ++y)
+	{
+		float          load_row = 0;
+		for (int x = 0; x < _w; ++x)
+		{
+			// Same as compute_q()
+			auto           rnd_state = _pic_rnd_seed;
+			rnd_state += uint32_t (y) << 20;
+			rnd_state += uint32_t (x) <<  8;
+			rnd_state  = UtilPrng::hash (rnd_state) + 2;
+
+			const auto     q       = q_ptr [x];
+			const auto     lum_neg = fstb::limit (
+				expf (float (q) * _inv_lambda_mul), _eps_val, 1.f
+			);
+			q_dst_ptr [x] = q;
+			seed_ptr [x]  = rnd_state;
+			load_row     += 1.09f - lum_neg;
+		}
+
+		if (_draft_flag)
+		{
+			conv_row (dst_ptr, q_dst_ptr, seed_ptr);
+			dst_ptr += stride_dst;
+		}
+
+		const auto     load_row_int = fstb::round_int64 (load_row * _load_mul);
+		_load_row_arr [y] = load_row_int;
+
+		q_ptr      += stride_q;
+		q_dst_ptr  += _stride;
+		seed_ptr   += _stride;
+		load_block += load_row_int;
+	}
+
+	_load_total.fetch_add (load_block);
+}
+
+
+
 int64_t	GrainDensity::get_load_row (int y) const noexcept
 {
 	assert (y >= 0);
@@ -127,6 +203,37 @@ GrainDensity::DataGrain	GrainDensity::get_result () const noexcept
 
 
 
+// Memory used by the object for a picture of the given size, in bytes
+int64_t	GrainDensity::compute_mem_size (int w, int h) noexcept
+{
+	assert (w > 0);
+	assert (h > 0);
+
+	constexpr int  align_pix = _align / sizeof (int32_t);
+	const auto     stride    = int64_t ((w + align_pix - 1) & ~(align_pix - 1));
+
+	return
+		  stride * h * int64_t (sizeof (int32_t) + sizeof (uint32_t))
+		+ h * int64_t (sizeof (int64_t))
+		+ 2 * _align;
+}
+
+
+
+// Mean number of grains per pixel for the brightest pixel value
+float	GrainDensity::compute_lambda_max (float grain_radius_avg, float grain_radius_stddev) noexcept
+{
+	assert (grain_radius_avg > 0);
+	assert (grain_radius_stddev >= 0);
+
+	return float (
+		  log (double (_eps_def))
+		/ compute_inv_lambda_mul (grain_radius_avg, grain_radius_stddev)
+	);
+}
+
+
+
 /*\\\ PROTECTED \\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\*/
 
 
@@ -136,6 +243,7 @@ GrainDensity::DataGrain	GrainDensity::get_result () const noexcept
 
 
 constexpr double	GrainDensity::_load_mul;
+constexpr float	GrainDensity::_eps_def;
 
 
 
@@ -163,7 +271,7 @@ void	GrainDensity::process_area_fpu (int y_beg, int y_end, const float *lum_ptr,
 
 		if (_draft_flag)
 		{
-			conv_row_q_to_lum_fpu (0, dst_ptr, q_ptr, _inv_lambda_mul);
+			conv_row (dst_ptr, q_ptr, seed_ptr);
 			dst_ptr += stride_dst;
 		}
 
@@ -225,7 +333,7 @@ void	GrainDensity::process_area_simd4 (int y_beg, int y_end, const float *lum_pt
 
 		if (_draft_flag)
 		{
-			conv_row_q_to_lum_simd4 (dst_ptr, q_ptr, _inv_lambda_mul);
+			conv_row (dst_ptr, q_ptr, seed_ptr);
 			dst_ptr += stride_dst;
 		}
 
@@ -243,6 +351,56 @@ void	GrainDensity::process_area_simd4 (int y_beg, int y_end, const float *lum_pt
 
 
 
+// Converts a row of grain counts into the draft output
+void	GrainDensity::conv_row (float * fstb_RESTRICT dst_ptr, const int32_t * fstb_RESTRICT q_ptr, const uint32_t * fstb_RESTRICT seed_ptr) noexcept
+{
+	if (_cov_flag)
+	{
+		conv_row_q_to_cov (dst_ptr, q_ptr, seed_ptr);
+	}
+	else if (_simd4_flag)
+	{
+		conv_row_q_to_lum_simd4 (dst_ptr, q_ptr, _inv_lambda_mul);
+	}
+	else
+	{
+		conv_row_q_to_lum_fpu (0, dst_ptr, q_ptr, _inv_lambda_mul);
+	}
+}
+
+
+
+// Draws the fraction of each pixel covered by its q grains. Given q grains
+// of area a placed uniformly, a point is uncovered with probability
+// (1 - a) ^ q, whose expectation over the Poisson distribution of q is
+// exp (-lambda * a), so the coverage is an unbiased estimate of the source
+// level. The actual fraction fluctuates around this value depending on the
+// grain positions. This part of the variance is shared by the filter
+// points located in the pixel, therefore it correlates the adjacent output
+// pixels too. It is drawn from a truncated normal distribution.
+void	GrainDensity::conv_row_q_to_cov (float * fstb_RESTRICT cov_ptr, const int32_t * fstb_RESTRICT q_ptr, const uint32_t * fstb_RESTRICT seed_ptr) noexcept
+{
+	assert (_w > 0);
+	assert (cov_ptr != nullptr);
+	assert (q_ptr != nullptr);
+	assert (seed_ptr != nullptr);
+
+	const auto     dev_ptr = _cov_dev_arr.data ();
+	const auto     tab_len = int (_cov_dev_arr.size ());
+	for (int x = 0; x < _w; ++x)
+	{
+		const auto     q   = q_ptr [x];
+		auto           cov = 1.f - expf (float (q) * _cov_mul);
+		if (q < tab_len)
+		{
+			cov += dev_ptr [q] * UtilPrng::gen_norm_trunc (seed_ptr [x]);
+		}
+		cov_ptr [x] = fstb::limit (cov, 0.f, 1.f);
+	}
+}
+
+
+
 void	GrainDensity::conv_row_q_to_lum_fpu (int x_beg, float * fstb_RESTRICT lum_ptr, const int32_t * fstb_RESTRICT q_ptr, float inv_lambda_mul) noexcept
 {
 	assert (_w > 0);
@@ -282,7 +440,8 @@ void	GrainDensity::conv_row_q_to_lum_simd4 (float * fstb_RESTRICT lum_ptr, const
 		const auto     qf  = fstb::ToolsSimd::conv_s32_to_f32 (q);
 		auto           lum = one - exp2 (qf * inv_lambda_mul_log2cst);
 		lum = max (lum, zero);
-		lum.store (lum_ptr + x);
+		// Destination rows are not always aligned, depending on the stride
+		lum.storeu (lum_ptr + x);
 	}
 
 	if (nx < _w)
@@ -326,7 +485,7 @@ float	GrainDensity::compute_q (int32_t * fstb_RESTRICT q_ptr, uint32_t * fstb_RE
 	// We need another hash, because sequences may be long, and keeping the
 	// original state could lead to similar sequence parts for neighbour pixels,
 	// giving a feel of directional blur at high luminance.
-	rnd_state  = fstb::Hash::hash (rnd_state);
+	rnd_state  = UtilPrng::hash (rnd_state);
 
 	const auto     luminance = *lum_ptr;
 	const auto     lum_neg   = fstb::limit (1.f - luminance, eps_val, 1.f);
@@ -349,7 +508,7 @@ fstb::Vf32	GrainDensity::compute_q (int32_t * fstb_RESTRICT q_ptr, uint32_t * fs
 	auto           rnd_state = pic_rnd_seed;
 	rnd_state += y << 20;
 	rnd_state += x <<  8;
-	rnd_state  = fstb::Hash::hash (rnd_state);
+	rnd_state  = UtilPrng::hash (rnd_state);
 
 	const auto     luminance = fstb::Vf32::loadu (lum_ptr);
 	const auto     one       = fstb::Vf32 (1.f);
@@ -372,6 +531,87 @@ fstb::Vf32	GrainDensity::compute_q (int32_t * fstb_RESTRICT q_ptr, uint32_t * fs
 
 
 
+// Variance of the covered fraction F of a pixel containing q grains of
+// area a = pi * r^2, r being the radius of the grains considered as
+// constant. The pixel is assumed to be large compared to the grains.
+// Var (F) is the integral of the covariance of the coverage for all the
+// point pairs of the pixel. Two points at a distance d are both uncovered
+// with the probability (1 - 2 * a + l (d)) ^ q, with l the area of the lens
+// shaped intersection of the grains centered on the points (null for
+// d >= 2 * r). Thus:
+// Var (F) = (1 - 2 * a) ^ q - (1 - a) ^ (2 * q)
+//         + integral over |d| < 2 * r of (1 - 2 * a + l (d)) ^ q - (1 - 2 * a) ^ q
+// The table covers the counts up to the maximum density. Large grains
+// (a >= 1/2) don't fit this model, their coverage is not randomized.
+void	GrainDensity::update_cov_dev_table (double area)
+{
+	assert (area > 0);
+
+	_cov_mul = float (log (std::max (1 - area, 1e-30)));
+	if (area == _cov_area)
+	{
+		return;
+	}
+	_cov_area = area;
+	_cov_dev_arr.clear ();
+	if (area >= 0.5)
+	{
+		return;
+	}
+
+	const auto     rad      = sqrt (area / fstb::PI);
+	const auto     log_1a   = log (1 - area);
+	const auto     log_12a  = log (1 - 2 * area);
+	const auto     lmax     = log (double (_eps_def)) / -area;
+	const int      tab_len  = fstb::ceil_int (lmax + 5 * sqrt (lmax)) + 1;
+	_cov_dev_arr.resize (tab_len);
+
+	// Midpoint integration over the distance. The lens areas don't depend
+	// on the count, we store log (1 - 2 * a + l (d)).
+	constexpr int  nbr_steps = 32;
+	const auto     step      = 2 * rad / nbr_steps;
+	std::array <double, nbr_steps> log_lens_arr;
+	std::array <double, nbr_steps> ring_arr;
+	for (int k = 0; k < nbr_steps; ++k)
+	{
+		const auto     d    = (k + 0.5) * step;
+		const auto     lens =
+			  2 * rad * rad * acos (d / (2 * rad))
+			- 0.5 * d * sqrt (4 * rad * rad - d * d);
+		log_lens_arr [k] = log (1 - 2 * area + lens);
+		ring_arr [k]     = 2 * fstb::PI * d * step;
+	}
+
+	for (int q = 0; q < tab_len; ++q)
+	{
+		const auto     p2 = exp (q * log_12a);
+		double         v  = p2 - exp (2 * q * log_1a);
+		for (int k = 0; k < nbr_steps; ++k)
+		{
+			v += ring_arr [k] * (exp (q * log_lens_arr [k]) - p2);
+		}
+		_cov_dev_arr [q] = float (sqrt (std::max (v, 0.0)));
+	}
+}
+
+
+
+// Returns -1 / lambda_mul
+double	GrainDensity::compute_inv_lambda_mul (float grain_radius_avg, float grain_radius_stddev) noexcept
+{
+	// There is probably an error in the paper in the algorithm description
+	// about the inclusion of grain_radius_stddev in the formula.
+	// Expected value of a log-norm variable is exp (log_mu + 0.5 * sigma^2)
+	// Expected value for its square is exp (2 * log_mu + 2 * sigma^2)
+	// (found by integrating x^2 * PDF_lognorm(x) from 0 to +inf)
+	return
+		  -fstb::PI
+		* fstb::sq (grain_radius_avg)
+		* expf (2 * fstb::sq (grain_radius_stddev));
+}
+
+
+
 }  // namespace fgrn
 
 
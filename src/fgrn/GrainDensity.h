@@ -29,6 +29,7 @@ http://sam.zoy.org/wtfpl/COPYING for more details.
 #include "fstb/Vu32.h"
 
 #include <atomic>
+#include <vector>
 
 #include <cstdint>
 
@@ -64,11 +65,40 @@ public:
 	// Alignment in bytes
 	static constexpr int _align = 32;
 
-	void           reset (int w, int h, float grain_radius_avg, float grain_radius_stddev, uint32_t pic_rnd_seed, bool draft_flag);
+	// Optional per-pixel output of the passes, computed from the grain counts
+	enum Output
+	{
+		// Grain counts and seeds only
+		Output_NONE = 0,
+
+		// Draft rendering: luminance for the grain density estimated from the
+		// grain count
+		Output_DRAFT,
+
+		// Grain coverage: fraction of the pixel area covered by its grains,
+		// drawn for the grain count (see conv_row_q_to_cov()). Its expected
+		// value is the source level. Consumes the two first states of the
+		// seeds.
+		Output_COV,
+
+		Output_NBR_ELT
+
+	}; // enum Output
+
+	// Horizontal alignment of the origin of a picture part, in pixels. The
+	// vector and scalar paths don't give exactly the same result, so a part
+	// must process each pixel with the same path as the whole picture.
+	static constexpr int _org_align = fstb::Vf32::_length;
+
+	void           reset (int w, int h, float grain_radius_avg, float grain_radius_stddev, uint32_t pic_rnd_seed, Output output, int org_x = 0, int org_y = 0);
 	void           process_area (int y_beg, int y_end, const float *lum_ptr, ptrdiff_t stride_src, float *dst_ptr, ptrdiff_t stride_dst) noexcept;
+	void           import_area (int y_beg, int y_end, const int32_t *q_ptr, ptrdiff_t stride_q, float *dst_ptr, ptrdiff_t stride_dst) noexcept;
 	int64_t        get_load_row (int y) const noexcept;
 	DataGrain      get_result () const noexcept;
 
+	static int64_t compute_mem_size (int w, int h) noexcept;
+	static float   compute_lambda_max (float grain_radius_avg, float grain_radius_stddev) noexcept;
+
 
 
 /*\\\ PROTECTED \\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\*/
@@ -94,6 +124,8 @@ private:
 	void           process_area_fpu (int y_beg, int y_end, const float *lum_ptr, ptrdiff_t stride_src, float *dst_ptr, ptrdiff_t stride_dst) noexcept;
 	void           process_area_simd4 (int y_beg, int y_end, const float *lum_ptr, ptrdiff_t stride_src, float *dst_ptr, ptrdiff_t stride_dst) noexcept;
 
+	void           conv_row (float * fstb_RESTRICT dst_ptr, const int32_t * fstb_RESTRICT q_ptr, const uint32_t * fstb_RESTRICT seed_ptr) noexcept;
+	void           conv_row_q_to_cov (float * fstb_RESTRICT cov_ptr, const int32_t * fstb_RESTRICT q_ptr, const uint32_t * fstb_RESTRICT seed_ptr) noexcept;
 	void           conv_row_q_to_lum_fpu (int x_beg, float * fstb_RESTRICT lum_ptr, const int32_t * fstb_RESTRICT q_ptr, float inv_lambda_mul) noexcept;
 	void           conv_row_q_to_lum_simd4 (float * fstb_RESTRICT lum_ptr, const int32_t * fstb_RESTRICT q_ptr, float inv_lambda_mul) noexcept;
 
@@ -103,6 +135,8 @@ private:
 	               compute_q (int32_t * fstb_RESTRICT q_ptr, uint32_t * fstb_RESTRICT seed_ptr, uint32_t pic_rnd_seed, const float * fstb_RESTRICT lum_ptr, int x, int y, float lambda_mul, float eps_val) noexcept;
 	static fstb_FORCEINLINE fstb::Vf32
 	               compute_q (int32_t * fstb_RESTRICT q_ptr, uint32_t * fstb_RESTRICT seed_ptr, fstb::Vu32 pic_rnd_seed, const float * fstb_RESTRICT lum_ptr, fstb::Vu32 x, fstb::Vu32 y, fstb::Vf32 lambda_mul_log2cst, fstb::Vf32 eps_val) noexcept;
+	static double  compute_inv_lambda_mul (float grain_radius_avg, float grain_radius_stddev) noexcept;
+	void           update_cov_dev_table (double area);
 
 	fstb::VecAlign <int32_t, _align>
 	               _q_arr;
@@ -122,9 +156,11 @@ private:
 	int            _w = 0;
 	int            _h = 0;
 
-	// Indicates we are in draft mode. In this case, the caller must provide
-	// information for the destination picture in the process_area() call.
+	// Indicates we are in draft or coverage mode. In this case, the caller
+	// must provide information for the destination picture in the
+	// process_area() call.
 	bool           _draft_flag   = false;
+	bool           _cov_flag     = false;
 
 	uint32_t       _pic_rnd_seed = 0;
 
@@ -132,13 +168,26 @@ private:
 	float          _lambda_mul     = -1;
 	float          _inv_lambda_mul = -1;
 
+	// Coverage only. _cov_mul = log (1 - a), with a the average grain area.
+	// _cov_dev_arr is the standard deviation of the covered fraction of a
+	// pixel for each grain count, computed for the area _cov_area. Grain
+	// counts beyond the table have a null deviation.
+	float          _cov_mul        = 0;
+	std::vector <float>
+	               _cov_dev_arr;
+	double         _cov_area       = -1;
+
 	// Positive value (relative to 1) to avoid div/0 and too large grain amount
 	// for the brightest pixel value.
-	float          _eps_val = 4e-4f;
+	static constexpr float _eps_def = 4e-4f;
+	float          _eps_val = _eps_def;
 
 	// In pixels
 	ptrdiff_t      _stride  = 0;
 
+	// Same SIMD level as _process_area_ptr, for the draft conversions
+	bool           _simd4_flag = false;
+
 	void (ThisType::*                   // 0 = not set
 	               _process_area_ptr) (int y_beg, int y_end, const float *lum_ptr, ptrdiff_t stride_src, float *dst_ptr, ptrdiff_t stride_dst) = nullptr;
 
@@ -0,0 +1,102 @@
+/*****************************************************************************
+
+        PrngHashMul.h
+        Author: Laurent de Soras, 2022
+
+Reference hash backend for UtilPrng. Uses fstb::Hash, two multiplications
+and three xor-shifts, and a plain integer-to-float conversion.
+
+--- Legal stuff ---
+
+This program is free software. It comes without any warranty, to
+the extent permitted by applicable law. You can redistribute it
+and/or modify it under the terms of the Do What The Fuck You Want
+To Public License, Version 2, as published by Sam Hocevar. See
+http://www.wtfpl.net/ for more details.
+
+*Tab=3***********************************************************************/
+
+
+
+#pragma once
+#if ! defined (fgrn_PrngHashMul_HEADER_INCLUDED)
+#define fgrn_PrngHashMul_HEADER_INCLUDED
+
+
+
+/*\\\ INCLUDE FILES \\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\*/
+
+#include "fstb/def.h"
+#include "fstb/Vf32.h"
+#include "fstb/Vu32.h"
+
+#include <cstdint>
+
+
+
+
+namespace fgrn
+{
+
+
+
+class PrngHashMul
+{
+
+/*\\\ PUBLIC \\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\*/
+
+public:
+
+	static fstb_FORCEINLINE uint32_t
+	               hash (uint32_t x) noexcept;
+	static fstb_FORCEINLINE fstb::Vu32
+	               hash (fstb::Vu32 x) noexcept;
+	static fstb_FORCEINLINE float
+	               conv_uni (uint32_t x) noexcept;
+	static fstb_FORCEINLINE fstb::Vf32
+	               conv_uni (fstb::Vu32 x) noexcept;
+
+
+
+
+/*\\\ PROTECTED \\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\*/
+
+protected:
+
+
+
+/*\\\ PRIVATE \\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\*/
+
+private:
+
+
+
+/*\\\ FORBIDDEN MEMBER FUNCTIONS \\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\*/
+
+private:
+
+	               PrngHashMul ()                               = delete;
+	               PrngHashMul (const PrngHashMul &other)          = delete;
+	               PrngHashMul (PrngHashMul &&other)               = delete;
+	PrngHashMul &     operator = (const PrngHashMul &other)        = delete;
+	PrngHashMul &     operator = (PrngHashMul &&other)             = delete;
+	bool           operator == (const PrngHashMul &other) const = delete;
+	bool           operator != (const PrngHashMul &other) const = delete;
+
+}; // class PrngHashMul
+
+
+
+}  // namespace fgrn
+
+
+
+#include "fgrn/PrngHashMul.hpp"
+
+
+
+#endif   // fgrn_PrngHashMul_HEADER_INCLUDED
+
+
+
+/*\\\ EOF \\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\*/
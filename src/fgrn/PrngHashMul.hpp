@@ -0,0 +1,99 @@
+/*****************************************************************************
+
+        PrngHashMul.hpp
+        Author: Laurent de Soras, 2022
+
+--- Legal stuff ---
+
+This program is free software. It comes without any warranty, to
+the extent permitted by applicable law. You can redistribute it
+and/or modify it under the terms of the Do What The Fuck You Want
+To Public License, Version 2, as published by Sam Hocevar. See
+http://www.wtfpl.net/ for more details.
+
+*Tab=3***********************************************************************/
+
+
+
+#if ! defined (fgrn_PrngHashMul_CODEHEADER_INCLUDED)
+#define fgrn_PrngHashMul_CODEHEADER_INCLUDED
+
+
+
+/*\\\ INCLUDE FILES \\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\*/
+
+#include "fstb/Hash.h"
+#include "fstb/ToolsSimd.h"
+#include "fstb/Vs32.h"
+
+#include <climits>
+
+
+
+
+namespace fgrn
+{
+
+
+
+/*\\\ PUBLIC \\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\*/
+
+
+
+uint32_t	PrngHashMul::hash (uint32_t x) noexcept
+{
+	return fstb::Hash::hash (x);
+}
+
+
+
+fstb::Vu32	PrngHashMul::hash (fstb::Vu32 x) noexcept
+{
+	return fstb::Hash::hash (x);
+}
+
+
+
+// Returns a number in range [0 ; 1]
+float	PrngHashMul::conv_uni (uint32_t x) noexcept
+{
+	constexpr auto mul = float (1.0 / double (UINT32_MAX));
+
+	return float (x) * mul;
+}
+
+
+
+fstb::Vf32	PrngHashMul::conv_uni (fstb::Vu32 x) noexcept
+{
+	// _mm_cvtepi32_ps works only on signed data, so we divide everything
+	// by 2 to fit in the positive part. Resulting difference with the
+	// scalar code is tiny, but does exist for some values.
+	x >>= 1;
+	auto           f   = fstb::ToolsSimd::conv_s32_to_f32 (fstb::Vs32 (x));
+	const auto     mul = fstb::Vf32 (float (1.0 / double (UINT32_MAX >> 1)));
+	f *= mul;
+
+	return f;
+}
+
+
+
+
+/*\\\ PROTECTED \\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\*/
+
+
+
+/*\\\ PRIVATE \\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\*/
+
+
+
+}  // namespace fgrn
+
+
+
+#endif   // fgrn_PrngHashMul_CODEHEADER_INCLUDED
+
+
+
+/*\\\ EOF \\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\*/
@@ -0,0 +1,109 @@
+/*****************************************************************************
+
+        PrngHashShift.h
+        Author: Laurent de Soras, 2022
+
+Cheap hash backend for UtilPrng, without any multiplication.
+Hash: Bob Jenkins, 6-shift integer hash, http://burtleburtle.net/bob/hash/integer.html
+The integer-to-float conversion directly builds the mantissa of a float in
+[1 ; 2[ from the 23 upper bits of the hash.
+The 3-operation half-avalanche hash from the same page was evaluated first,
+but consecutive states give almost identical outputs.
+This backend is still not good enough for the grain coordinates (they
+are consumed as consecutive states), see test_prng_backend() in the test
+program.
+
+--- Legal stuff ---
+
+This program is free software. It comes without any warranty, to
+the extent permitted by applicable law. You can redistribute it
+and/or modify it under the terms of the Do What The Fuck You Want
+To Public License, Version 2, as published by Sam Hocevar. See
+http://www.wtfpl.net/ for more details.
+
+*Tab=3***********************************************************************/
+
+
+
+#pragma once
+#if ! defined (fgrn_PrngHashShift_HEADER_INCLUDED)
+#define fgrn_PrngHashShift_HEADER_INCLUDED
+
+
+
+/*\\\ INCLUDE FILES \\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\*/
+
+#include "fstb/def.h"
+#include "fstb/Vf32.h"
+#include "fstb/Vu32.h"
+
+#include <cstdint>
+
+
+
+
+namespace fgrn
+{
+
+
+
+class PrngHashShift
+{
+
+/*\\\ PUBLIC \\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\*/
+
+public:
+
+	static fstb_FORCEINLINE uint32_t
+	               hash (uint32_t x) noexcept;
+	static fstb_FORCEINLINE fstb::Vu32
+	               hash (fstb::Vu32 x) noexcept;
+	static fstb_FORCEINLINE float
+	               conv_uni (uint32_t x) noexcept;
+	static fstb_FORCEINLINE fstb::Vf32
+	               conv_uni (fstb::Vu32 x) noexcept;
+
+
+
+
+/*\\\ PROTECTED \\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\*/
+
+protected:
+
+
+
+/*\\\ PRIVATE \\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\*/
+
+private:
+
+
+
+/*\\\ FORBIDDEN MEMBER FUNCTIONS \\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\*/
+
+private:
+
+	               PrngHashShift ()                               = delete;
+	               PrngHashShift (const PrngHashShift &other)          = delete;
+	               PrngHashShift (PrngHashShift &&other)               = delete;
+	PrngHashShift &     operator = (const PrngHashShift &other)        = delete;
+	PrngHashShift &     operator = (PrngHashShift &&other)             = delete;
+	bool           operator == (const PrngHashShift &other) const = delete;
+	bool           operator != (const PrngHashShift &other) const = delete;
+
+}; // class PrngHashShift
+
+
+
+}  // namespace fgrn
+
+
+
+#include "fgrn/PrngHashShift.hpp"
+
+
+
+#endif   // fgrn_PrngHashShift_HEADER_INCLUDED
+
+
+
+/*\\\ EOF \\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\*/
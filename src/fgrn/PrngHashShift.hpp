@@ -0,0 +1,110 @@
+/*****************************************************************************
+
+        PrngHashShift.hpp
+        Author: Laurent de Soras, 2022
+
+--- Legal stuff ---
+
+This program is free software. It comes without any warranty, to
+the extent permitted by applicable law. You can redistribute it
+and/or modify it under the terms of the Do What The Fuck You Want
+To Public License, Version 2, as published by Sam Hocevar. See
+http://www.wtfpl.net/ for more details.
+
+*Tab=3***********************************************************************/
+
+
+
+#if ! defined (fgrn_PrngHashShift_CODEHEADER_INCLUDED)
+#define fgrn_PrngHashShift_CODEHEADER_INCLUDED
+
+
+
+/*\\\ INCLUDE FILES \\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\*/
+
+#include "fstb/ToolsSimd.h"
+#include "fstb/Vs32.h"
+
+#include <cstring>
+
+
+
+
+namespace fgrn
+{
+
+
+
+/*\\\ PUBLIC \\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\*/
+
+
+
+uint32_t	PrngHashShift::hash (uint32_t x) noexcept
+{
+	x = (x + 0x7ED55D16u) + (x << 12);
+	x = (x ^ 0xC761C23Cu) ^ (x >> 19);
+	x = (x + 0x165667B1u) + (x <<  5);
+	x = (x + 0xD3A2646Cu) ^ (x <<  9);
+	x = (x + 0xFD7046C5u) + (x <<  3);
+	x = (x ^ 0xB55A4F09u) ^ (x >> 16);
+
+	return x;
+}
+
+
+
+fstb::Vu32	PrngHashShift::hash (fstb::Vu32 x) noexcept
+{
+	x = (x + fstb::Vu32 (0x7ED55D16u)) + (x << 12);
+	x = (x ^ fstb::Vu32 (0xC761C23Cu)) ^ (x >> 19);
+	x = (x + fstb::Vu32 (0x165667B1u)) + (x <<  5);
+	x = (x + fstb::Vu32 (0xD3A2646Cu)) ^ (x <<  9);
+	x = (x + fstb::Vu32 (0xFD7046C5u)) + (x <<  3);
+	x = (x ^ fstb::Vu32 (0xB55A4F09u)) ^ (x >> 16);
+
+	return x;
+}
+
+
+
+// Returns a number in range [0 ; 1[
+float	PrngHashShift::conv_uni (uint32_t x) noexcept
+{
+	const auto     m = (uint32_t (127) << 23) | (x >> 9);
+	float          f;
+	memcpy (&f, &m, sizeof (f));
+
+	return f - 1.f;
+}
+
+
+
+// Same result as the scalar version
+fstb::Vf32	PrngHashShift::conv_uni (fstb::Vu32 x) noexcept
+{
+	const auto     m = fstb::Vu32 (uint32_t (127) << 23) | (x >> 9);
+	const auto     f = fstb::ToolsSimd::cast_f32 (fstb::Vs32 (m));
+
+	return f - fstb::Vf32 (1.f);
+}
+
+
+
+
+/*\\\ PROTECTED \\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\*/
+
+
+
+/*\\\ PRIVATE \\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\*/
+
+
+
+}  // namespace fgrn
+
+
+
+#endif   // fgrn_PrngHashShift_CODEHEADER_INCLUDED
+
+
+
+/*\\\ EOF \\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\*/
@@ -0,0 +1,71 @@
+/*****************************************************************************
+
+        RenderMode.h
+        Author: Laurent de Soras, 2022
+
+Rendering engines, from the fastest and least accurate to the slowest and
+physically exact one.
+
+--- Legal stuff ---
+
+This program is free software. It comes without any warranty, to
+the extent permitted by applicable law. You can redistribute it
+and/or modify it under the terms of the Do What The Fuck You Want
+To Public License, Version 2, as published by Sam Hocevar. See
+http://sam.zoy.org/wtfpl/COPYING for more details.
+
+*Tab=3***********************************************************************/
+
+
+
+#pragma once
+#if ! defined (fgrn_RenderMode_HEADER_INCLUDED)
+#define fgrn_RenderMode_HEADER_INCLUDED
+
+
+
+/*\\\ INCLUDE FILES \\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\*/
+
+
+
+namespace fgrn
+{
+
+
+
+enum RenderMode
+{
+	// Full rendering: the vision filter is evaluated on each grain. Slow.
+	RenderMode_FULL = 0,
+
+	// Pass 1 only. The grain count of each pixel is directly converted into
+	// a luminance. Valid only for sigma = 0 and tiny grains.
+	RenderMode_DRAFT,
+
+	// Statistical rendering. The grain coverage of each pixel, drawn from
+	// its grain count, is convolved with the vision filter kernel, then the
+	// number of filter points hitting a grain is drawn from a binomial
+	// distribution.
+	RenderMode_STAT,
+
+	// Synthesis from a texture atlas. Grain patches are rendered once for a
+	// set of luminance levels, then the output is interpolated between the
+	// patches, with random offsets per block. Not handled by GenGrain, see
+	// GrainAtlas.
+	RenderMode_ATLAS,
+
+	RenderMode_NBR_ELT
+
+}; // enum RenderMode
+
+
+
+}  // namespace fgrn
+
+
+
+#endif   // fgrn_RenderMode_HEADER_INCLUDED
+
+
+
+/*\\\ EOF \\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\*/
@@ -0,0 +1,90 @@
+/*****************************************************************************
+
+        RenderStats.cpp
+        Author: Laurent de Soras, 2022
+
+--- Legal stuff ---
+
+This program is free software. It comes without any warranty, to
+the extent permitted by applicable law. You can redistribute it
+and/or modify it under the terms of the Do What The Fuck You Want
+To Public License, Version 2, as published by Sam Hocevar. See
+http://sam.zoy.org/wtfpl/COPYING for more details.
+
+*Tab=3***********************************************************************/
+
+
+
+
+/*\\\ INCLUDE FILES \\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\*/
+
+#include "fgrn/RenderStats.h"
+
+#include <cassert>
+
+
+
+namespace fgrn
+{
+
+
+
+/*\\\ PUBLIC \\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\*/
+
+
+
+void	RenderStats::clear () noexcept
+{
+	_cnt_arr.fill (0);
+	_pass1_s = 0;
+	_pass2_s = 0;
+}
+
+
+
+void	RenderStats::accumulate (const RenderStats &other) noexcept
+{
+	for (int cnt = 0; cnt < Cnt_NBR_ELT; ++cnt)
+	{
+		_cnt_arr [cnt] += other._cnt_arr [cnt];
+	}
+	_pass1_s += other._pass1_s;
+	_pass2_s += other._pass2_s;
+}
+
+
+
+// CamelCase name, for the frame properties
+const char *	RenderStats::get_name (Cnt cnt) noexcept
+{
+	assert (cnt >= 0);
+	assert (cnt < Cnt_NBR_ELT);
+
+	static const char * const  name_0_arr [Cnt_NBR_ELT] =
+	{
+		"CacheHits",
+		"CacheMisses",
+		"Checks",
+		"GrainsTested",
+		"EarlyExits",
+		"QTotal"
+	};
+
+	return name_0_arr [cnt];
+}
+
+
+
+/*\\\ PROTECTED \\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\*/
+
+
+
+/*\\\ PRIVATE \\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\*/
+
+
+
+}  // namespace fgrn
+
+
+
+/*\\\ EOF \\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\*/
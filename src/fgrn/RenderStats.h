@@ -0,0 +1,138 @@
+/*****************************************************************************
+
+        RenderStats.h
+        Author: Laurent de Soras, 2022
+
+Counters for the hot paths of the grain generator, for a single thread.
+Only the full rendering mode updates the counters. The pass durations are
+measured in all modes.
+
+They are updated only when fgrn_RenderStats_ENABLED is defined at compile
+time (configure --enable-stats). Otherwise the updates are empty inline
+functions and the counters stay null.
+
+--- Legal stuff ---
+
+This program is free software. It comes without any warranty, to
+the extent permitted by applicable law. You can redistribute it
+and/or modify it under the terms of the Do What The Fuck You Want
+To Public License, Version 2, as published by Sam Hocevar. See
+http://sam.zoy.org/wtfpl/COPYING for more details.
+
+*Tab=3***********************************************************************/
+
+
+
+#pragma once
+#if ! defined (fgrn_RenderStats_HEADER_INCLUDED)
+#define fgrn_RenderStats_HEADER_INCLUDED
+
+
+
+/*\\\ INCLUDE FILES \\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\*/
+
+#include "fstb/def.h"
+
+#include <array>
+#include <chrono>
+
+#include <cstdint>
+
+
+
+namespace fgrn
+{
+
+
+
+class RenderStats
+{
+
+/*\\\ PUBLIC \\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\*/
+
+public:
+
+#if defined (fgrn_RenderStats_ENABLED)
+	static constexpr bool _enabled_flag = true;
+#else
+	static constexpr bool _enabled_flag = false;
+#endif
+
+	enum Cnt
+	{
+		Cnt_CACHE_HITS = 0,  // Cells found in the cache
+		Cnt_CACHE_MISSES,    // Cells generated
+		Cnt_CHECKS,          // Intersection checks of a point with a cell
+		Cnt_GRAINS_TESTED,   // Grains in the checked ranges, upper bound
+		Cnt_EARLY_EXITS,     // Cell scans stopped on a hit
+		Cnt_Q_TOTAL,         // Grains in the generated cells
+
+		Cnt_NBR_ELT
+	};
+
+	// Adds the duration of its scope to a pass time
+	class ScopedTimer
+	{
+	public:
+		explicit inline
+		               ScopedTimer (double &dur_s) noexcept;
+		inline         ~ScopedTimer ();
+	private:
+		double &       _dur_s;
+		std::chrono::steady_clock::time_point
+		               _t_beg;
+	};
+
+	fstb_FORCEINLINE void
+	               add (Cnt cnt, int64_t val) noexcept;
+	void           clear () noexcept;
+	void           accumulate (const RenderStats &other) noexcept;
+
+	static const char *
+	               get_name (Cnt cnt) noexcept;
+
+	std::array <int64_t, Cnt_NBR_ELT>
+	               _cnt_arr {};
+
+	// Durations in s
+	double         _pass1_s = 0;
+	double         _pass2_s = 0;
+
+
+
+/*\\\ PROTECTED \\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\*/
+
+protected:
+
+
+
+/*\\\ PRIVATE \\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\*/
+
+private:
+
+
+
+/*\\\ FORBIDDEN MEMBER FUNCTIONS \\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\*/
+
+private:
+
+	bool           operator == (const RenderStats &other) const = delete;
+	bool           operator != (const RenderStats &other) const = delete;
+
+}; // class RenderStats
+
+
+
+}  // namespace fgrn
+
+
+
+#include "fgrn/RenderStats.hpp"
+
+
+
+#endif   // fgrn_RenderStats_HEADER_INCLUDED
+
+
+
+/*\\\ EOF \\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\*/
@@ -0,0 +1,90 @@
+/*****************************************************************************
+
+        RenderStats.hpp
+        Author: Laurent de Soras, 2022
+
+--- Legal stuff ---
+
+This program is free software. It comes without any warranty, to
+the extent permitted by applicable law. You can redistribute it
+and/or modify it under the terms of the Do What The Fuck You Want
+To Public License, Version 2, as published by Sam Hocevar. See
+http://sam.zoy.org/wtfpl/COPYING for more details.
+
+*Tab=3***********************************************************************/
+
+
+
+#if ! defined (fgrn_RenderStats_CODEHEADER_INCLUDED)
+#define fgrn_RenderStats_CODEHEADER_INCLUDED
+
+
+
+/*\\\ INCLUDE FILES \\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\*/
+
+#include <cassert>
+
+
+
+namespace fgrn
+{
+
+
+
+/*\\\ PUBLIC \\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\*/
+
+
+
+RenderStats::ScopedTimer::ScopedTimer (double &dur_s) noexcept
+:	_dur_s (dur_s)
+{
+	if (_enabled_flag)
+	{
+		_t_beg = std::chrono::steady_clock::now ();
+	}
+}
+
+
+
+RenderStats::ScopedTimer::~ScopedTimer ()
+{
+	if (_enabled_flag)
+	{
+		_dur_s += std::chrono::duration <double> (
+			std::chrono::steady_clock::now () - _t_beg
+		).count ();
+	}
+}
+
+
+
+void	RenderStats::add (Cnt cnt, int64_t val) noexcept
+{
+	assert (cnt >= 0);
+	assert (cnt < Cnt_NBR_ELT);
+
+	if (_enabled_flag)
+	{
+		_cnt_arr [cnt] += val;
+	}
+}
+
+
+
+/*\\\ PROTECTED \\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\*/
+
+
+
+/*\\\ PRIVATE \\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\*/
+
+
+
+}  // namespace fgrn
+
+
+
+#endif   // fgrn_RenderStats_CODEHEADER_INCLUDED
+
+
+
+/*\\\ EOF \\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\*/
@@ -0,0 +1,253 @@
+/*****************************************************************************
+
+        SplConv.cpp
+        Author: Laurent de Soras, 2022
+
+--- Legal stuff ---
+
+This program is free software. It comes without any warranty, to
+the extent permitted by applicable law. You can redistribute it
+and/or modify it under the terms of the Do What The Fuck You Want
+To Public License, Version 2, as published by Sam Hocevar. See
+http://sam.zoy.org/wtfpl/COPYING for more details.
+
+*Tab=3***********************************************************************/
+
+
+
+#if defined (_MSC_VER)
+	#pragma warning (1 : 4130 4223 4705 4706)
+	#pragma warning (4 : 4355 4786 4800)
+#endif
+
+
+
+/*\\\ INCLUDE FILES \\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\*/
+
+#include "fgrn/SplConv.h"
+#include "fstb/fnc.h"
+
+#include <cassert>
+#include <cstring>
+
+
+
+namespace fgrn
+{
+
+
+
+/*\\\ PUBLIC \\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\*/
+
+
+
+void	SplConv::conv_row_to_float (float * fstb_RESTRICT dst_ptr, const uint8_t * fstb_RESTRICT src_ptr, SplFmt fmt, int x_beg, int x_end) noexcept
+{
+	assert (dst_ptr != nullptr);
+	assert (src_ptr != nullptr);
+	assert (fmt.is_valid ());
+	assert (x_beg >= 0);
+	assert (x_beg <= x_end);
+
+	switch (fmt._type)
+	{
+	case SplFmt::Type_FLOAT:
+		memcpy (
+			dst_ptr + x_beg,
+			src_ptr + x_beg * sizeof (float),
+			size_t (x_end - x_beg) * sizeof (float)
+		);
+		break;
+
+	case SplFmt::Type_HALF:
+		{
+			const auto     s16_ptr = reinterpret_cast <const uint16_t *> (src_ptr);
+			for (int x = x_beg; x < x_end; ++x)
+			{
+				dst_ptr [x] = conv_half_to_float (s16_ptr [x]);
+			}
+		}
+		break;
+
+	case SplFmt::Type_INT:
+		if (fmt._res <= 8)
+		{
+			conv_row_int_to_float (dst_ptr, src_ptr, fmt._res, x_beg, x_end);
+		}
+		else
+		{
+			conv_row_int_to_float (
+				dst_ptr, reinterpret_cast <const uint16_t *> (src_ptr),
+				fmt._res, x_beg, x_end
+			);
+		}
+		break;
+
+	default:
+		assert (false);
+		break;
+	}
+}
+
+
+
+void	SplConv::conv_row_from_float (uint8_t * fstb_RESTRICT dst_ptr, const float * fstb_RESTRICT src_ptr, SplFmt fmt, int x_beg, int x_end) noexcept
+{
+	assert (dst_ptr != nullptr);
+	assert (src_ptr != nullptr);
+	assert (fmt.is_valid ());
+	assert (x_beg >= 0);
+	assert (x_beg <= x_end);
+
+	switch (fmt._type)
+	{
+	case SplFmt::Type_FLOAT:
+		memcpy (
+			dst_ptr + x_beg * sizeof (float),
+			src_ptr + x_beg,
+			size_t (x_end - x_beg) * sizeof (float)
+		);
+		break;
+
+	case SplFmt::Type_HALF:
+		{
+			const auto     d16_ptr = reinterpret_cast <uint16_t *> (dst_ptr);
+			for (int x = x_beg; x < x_end; ++x)
+			{
+				d16_ptr [x] = conv_float_to_half (src_ptr [x]);
+			}
+		}
+		break;
+
+	case SplFmt::Type_INT:
+		if (fmt._res <= 8)
+		{
+			conv_row_float_to_int (dst_ptr, src_ptr, fmt._res, x_beg, x_end);
+		}
+		else
+		{
+			conv_row_float_to_int (
+				reinterpret_cast <uint16_t *> (dst_ptr), src_ptr,
+				fmt._res, x_beg, x_end
+			);
+		}
+		break;
+
+	default:
+		assert (false);
+		break;
+	}
+}
+
+
+
+float	SplConv::conv_half_to_float (uint16_t h) noexcept
+{
+	const uint32_t sign = uint32_t (h & 0x8000) << 16;
+	const int      e    = (h >> 10) & 0x1F;
+	const uint32_t m    = h & 0x3FF;
+
+	uint32_t       bits = 0;
+	if (e == 0)
+	{
+		// Zero or denormal: m * 2^-24, exact in single precision
+		float          val = float (m) * (1.f / float (1 << 24));
+		memcpy (&bits, &val, sizeof (bits));
+		bits |= sign;
+	}
+	else if (e == 0x1F)
+	{
+		// Infinity or NaN
+		bits = sign | 0x7F800000U | (m << 13);
+	}
+	else
+	{
+		bits = sign | (uint32_t (e + 127 - 15) << 23) | (m << 13);
+	}
+
+	float          x;
+	memcpy (&x, &bits, sizeof (x));
+
+	return x;
+}
+
+
+
+// Rounds to the nearest value, ties to even
+uint16_t	SplConv::conv_float_to_half (float x) noexcept
+{
+	uint32_t       bits;
+	memcpy (&bits, &x, sizeof (bits));
+	const auto     sign = uint16_t ((bits >> 16) & 0x8000);
+	const uint32_t a    = bits & 0x7FFFFFFFU;
+
+	uint16_t       h = 0;
+	if (a >= 0x47800000U)
+	{
+		// 65536 or more, infinity or NaN
+		h = (a > 0x7F800000U) ? 0x7E00 : 0x7C00;
+	}
+	else if (a >= 0x38800000U)
+	{
+		// Normal. The rounding may carry into the exponent, up to infinity
+		// for the values from 65520.
+		h = uint16_t (
+			(a - 0x38000000U + 0x0FFFU + ((a >> 13) & 1)) >> 13
+		);
+	}
+	else
+	{
+		// Denormal or zero. Adding 0.5 aligns the denormal steps (2^-24) on
+		// the float LSB, so the FPU does the rounding.
+		float          ax;
+		memcpy (&ax, &a, sizeof (ax));
+		ax += 0.5f;
+		uint32_t       ab;
+		memcpy (&ab, &ax, sizeof (ab));
+		h = uint16_t (ab - 0x3F000000U);
+	}
+
+	return uint16_t (h | sign);
+}
+
+
+
+/*\\\ PROTECTED \\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\*/
+
+
+
+/*\\\ PRIVATE \\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\*/
+
+
+
+template <typename T>
+void	SplConv::conv_row_int_to_float (float * fstb_RESTRICT dst_ptr, const T * fstb_RESTRICT src_ptr, int res, int x_beg, int x_end) noexcept
+{
+	const float    mul = 1.f / float ((1 << res) - 1);
+	for (int x = x_beg; x < x_end; ++x)
+	{
+		dst_ptr [x] = float (src_ptr [x]) * mul;
+	}
+}
+
+
+
+template <typename T>
+void	SplConv::conv_row_float_to_int (T * fstb_RESTRICT dst_ptr, const float * fstb_RESTRICT src_ptr, int res, int x_beg, int x_end) noexcept
+{
+	const float    mul = float ((1 << res) - 1);
+	for (int x = x_beg; x < x_end; ++x)
+	{
+		// Positive after clipping, so truncation is a rounding
+		const float    val = fstb::limit (src_ptr [x], 0.f, 1.f) * mul + 0.5f;
+		dst_ptr [x] = T (int (val));
+	}
+}
+
+
+
+}  // namespace fgrn
+
+
+
+/*\\\ EOF \\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\*/
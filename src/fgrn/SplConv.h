@@ -0,0 +1,107 @@
+/*****************************************************************************
+
+        SplConv.h
+        Author: Laurent de Soras, 2022
+
+Row conversions between the storage formats and the 32-bit float values
+used for the computations. Row pointers point on the pixel 0, only the
+[x_beg ; x_end[ range is converted.
+
+Integers are rounded to the nearest value, without dithering: the grain
+output is already a random quantization of the source, at a much coarser
+level than the integer steps. Out-of-range values are clipped.
+
+--- Legal stuff ---
+
+This program is free software. It comes without any warranty, to
+the extent permitted by applicable law. You can redistribute it
+and/or modify it under the terms of the Do What The Fuck You Want
+To Public License, Version 2, as published by Sam Hocevar. See
+http://sam.zoy.org/wtfpl/COPYING for more details.
+
+*Tab=3***********************************************************************/
+
+
+
+#pragma once
+#if ! defined (fgrn_SplConv_HEADER_INCLUDED)
+#define fgrn_SplConv_HEADER_INCLUDED
+
+
+
+/*\\\ INCLUDE FILES \\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\*/
+
+#include "fgrn/SplFmt.h"
+#include "fstb/def.h"
+
+#include <cstdint>
+
+
+
+namespace fgrn
+{
+
+
+
+class SplConv
+{
+
+/*\\\ PUBLIC \\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\*/
+
+public:
+
+	static void    conv_row_to_float (float * fstb_RESTRICT dst_ptr, const uint8_t * fstb_RESTRICT src_ptr, SplFmt fmt, int x_beg, int x_end) noexcept;
+	static void    conv_row_from_float (uint8_t * fstb_RESTRICT dst_ptr, const float * fstb_RESTRICT src_ptr, SplFmt fmt, int x_beg, int x_end) noexcept;
+
+	static float   conv_half_to_float (uint16_t h) noexcept;
+	static uint16_t
+	               conv_float_to_half (float x) noexcept;
+
+
+
+/*\\\ PROTECTED \\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\*/
+
+protected:
+
+
+
+/*\\\ PRIVATE \\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\*/
+
+private:
+
+	template <typename T>
+	static void    conv_row_int_to_float (float * fstb_RESTRICT dst_ptr, const T * fstb_RESTRICT src_ptr, int res, int x_beg, int x_end) noexcept;
+	template <typename T>
+	static void    conv_row_float_to_int (T * fstb_RESTRICT dst_ptr, const float * fstb_RESTRICT src_ptr, int res, int x_beg, int x_end) noexcept;
+
+
+
+/*\\\ FORBIDDEN MEMBER FUNCTIONS \\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\*/
+
+private:
+
+	               SplConv ()                               = delete;
+	               SplConv (const SplConv &other)           = delete;
+	               SplConv (SplConv &&other)                = delete;
+	SplConv &      operator = (const SplConv &other)        = delete;
+	SplConv &      operator = (SplConv &&other)             = delete;
+	bool           operator == (const SplConv &other) const = delete;
+	bool           operator != (const SplConv &other) const = delete;
+
+}; // class SplConv
+
+
+
+}  // namespace fgrn
+
+
+
+//#include "fgrn/SplConv.hpp"
+
+
+
+#endif   // fgrn_SplConv_HEADER_INCLUDED
+
+
+
+/*\\\ EOF \\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\*/
@@ -0,0 +1,108 @@
+/*****************************************************************************
+
+        SplFmt.h
+        Author: Laurent de Soras, 2022
+
+Storage format of the plane samples. Whatever the format, the nominal
+range is mapped on [0 ; 1]: [0 ; 2^res - 1] for the integers, and the
+value itself for the floating point types.
+
+--- Legal stuff ---
+
+This program is free software. It comes without any warranty, to
+the extent permitted by applicable law. You can redistribute it
+and/or modify it under the terms of the Do What The Fuck You Want
+To Public License, Version 2, as published by Sam Hocevar. See
+http://sam.zoy.org/wtfpl/COPYING for more details.
+
+*Tab=3***********************************************************************/
+
+
+
+#pragma once
+#if ! defined (fgrn_SplFmt_HEADER_INCLUDED)
+#define fgrn_SplFmt_HEADER_INCLUDED
+
+
+
+/*\\\ INCLUDE FILES \\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\*/
+
+
+
+namespace fgrn
+{
+
+
+
+class SplFmt
+{
+
+/*\\\ PUBLIC \\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\*/
+
+public:
+
+	enum Type
+	{
+		Type_FLOAT = 0, // 32-bit floating point
+		Type_HALF,      // 16-bit floating point (IEEE 754 binary16)
+		Type_INT,       // Unsigned integer, 8 to 16 bits
+
+		Type_NBR_ELT
+	};
+
+	constexpr      SplFmt () = default;
+	constexpr      SplFmt (Type type, int res) noexcept;
+
+	inline bool    is_valid () const noexcept;
+	inline bool    is_float32 () const noexcept;
+	inline int     get_size () const noexcept;
+	inline int     get_id () const noexcept;
+
+	inline bool    operator == (const SplFmt &other) const noexcept;
+	inline bool    operator != (const SplFmt &other) const noexcept;
+
+	static constexpr SplFmt
+	               make_float () noexcept;
+	static constexpr SplFmt
+	               make_half () noexcept;
+	static constexpr SplFmt
+	               make_int (int res) noexcept;
+
+	Type           _type = Type_FLOAT;
+
+	// Bits per sample. 32 for Type_FLOAT, 16 for Type_HALF, [8 ; 16] for
+	// Type_INT. Integers up to 8 bits are stored as bytes, the others as
+	// 16-bit words.
+	int            _res  = 32;
+
+
+
+/*\\\ PROTECTED \\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\*/
+
+protected:
+
+
+
+/*\\\ PRIVATE \\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\*/
+
+private:
+
+
+
+}; // class SplFmt
+
+
+
+}  // namespace fgrn
+
+
+
+#include "fgrn/SplFmt.hpp"
+
+
+
+#endif   // fgrn_SplFmt_HEADER_INCLUDED
+
+
+
+/*\\\ EOF \\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\*/
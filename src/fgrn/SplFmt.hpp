@@ -0,0 +1,136 @@
+/*****************************************************************************
+
+        SplFmt.hpp
+        Author: Laurent de Soras, 2022
+
+--- Legal stuff ---
+
+This program is free software. It comes without any warranty, to
+the extent permitted by applicable law. You can redistribute it
+and/or modify it under the terms of the Do What The Fuck You Want
+To Public License, Version 2, as published by Sam Hocevar. See
+http://sam.zoy.org/wtfpl/COPYING for more details.
+
+*Tab=3***********************************************************************/
+
+
+
+#if ! defined (fgrn_SplFmt_CODEHEADER_INCLUDED)
+#define fgrn_SplFmt_CODEHEADER_INCLUDED
+
+
+
+/*\\\ INCLUDE FILES \\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\*/
+
+#include <cassert>
+
+
+
+namespace fgrn
+{
+
+
+
+/*\\\ PUBLIC \\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\*/
+
+
+
+constexpr SplFmt::SplFmt (Type type, int res) noexcept
+:	_type (type)
+,	_res (res)
+{
+	// Nothing
+}
+
+
+
+bool	SplFmt::is_valid () const noexcept
+{
+	switch (_type)
+	{
+	case Type_FLOAT: return (_res == 32);
+	case Type_HALF:  return (_res == 16);
+	case Type_INT:   return (_res >= 8 && _res <= 16);
+	default:         return false;
+	}
+}
+
+
+
+bool	SplFmt::is_float32 () const noexcept
+{
+	return (_type == Type_FLOAT);
+}
+
+
+
+// Bytes per sample
+int	SplFmt::get_size () const noexcept
+{
+	assert (is_valid ());
+
+	return (_res + 7) >> 3;
+}
+
+
+
+// Compact identifier, stable across the versions and the platforms
+int	SplFmt::get_id () const noexcept
+{
+	return (int (_type) << 8) + _res;
+}
+
+
+
+bool	SplFmt::operator == (const SplFmt &other) const noexcept
+{
+	return (_type == other._type && _res == other._res);
+}
+
+
+
+bool	SplFmt::operator != (const SplFmt &other) const noexcept
+{
+	return ! (*this == other);
+}
+
+
+
+constexpr SplFmt	SplFmt::make_float () noexcept
+{
+	return SplFmt (Type_FLOAT, 32);
+}
+
+
+
+constexpr SplFmt	SplFmt::make_half () noexcept
+{
+	return SplFmt (Type_HALF, 16);
+}
+
+
+
+constexpr SplFmt	SplFmt::make_int (int res) noexcept
+{
+	return SplFmt (Type_INT, res);
+}
+
+
+
+/*\\\ PROTECTED \\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\*/
+
+
+
+/*\\\ PRIVATE \\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\*/
+
+
+
+}  // namespace fgrn
+
+
+
+#endif   // fgrn_SplFmt_CODEHEADER_INCLUDED
+
+
+
+/*\\\ EOF \\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\*/
@@ -0,0 +1,147 @@
+/*****************************************************************************
+
+        TileMask.cpp
+        Author: Laurent de Soras, 2022
+
+--- Legal stuff ---
+
+This program is free software. It comes without any warranty, to
+the extent permitted by applicable law. You can redistribute it
+and/or modify it under the terms of the Do What The Fuck You Want
+To Public License, Version 2, as published by Sam Hocevar. See
+http://sam.zoy.org/wtfpl/COPYING for more details.
+
+*Tab=3***********************************************************************/
+
+
+
+
+/*\\\ INCLUDE FILES \\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\*/
+
+#include "fgrn/TileMask.h"
+
+#include <algorithm>
+
+#include <cassert>
+
+
+
+namespace fgrn
+{
+
+
+
+/*\\\ PUBLIC \\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\*/
+
+
+
+void	TileMask::reset (int w, int h, int tile_size, bool flag)
+{
+	assert (w > 0);
+	assert (h > 0);
+	assert (tile_size > 0);
+
+	_w         = w;
+	_h         = h;
+	_tile_size = tile_size;
+	_nbr_tx    = (w + tile_size - 1) / tile_size;
+	_nbr_ty    = (h + tile_size - 1) / tile_size;
+
+	_flag_arr.assign (size_t (_nbr_tx * _nbr_ty), uint8_t (flag ? 1 : 0));
+	_cnt_row_arr.assign (size_t (_nbr_ty), (flag) ? _nbr_tx : 0);
+	_cnt_total = (flag) ? _nbr_tx * _nbr_ty : 0;
+}
+
+
+
+void	TileMask::set_tile (int tx, int ty, bool flag) noexcept
+{
+	assert (tx >= 0);
+	assert (tx < _nbr_tx);
+	assert (ty >= 0);
+	assert (ty < _nbr_ty);
+
+	auto &         f_cur = _flag_arr [ty * _nbr_tx + tx];
+	const auto     f_new = uint8_t (flag ? 1 : 0);
+	if (f_new != f_cur)
+	{
+		const int      inc = (flag) ? 1 : -1;
+		_cnt_row_arr [ty] += inc;
+		_cnt_total        += inc;
+		f_cur = f_new;
+	}
+}
+
+
+
+// Sets all the tiles intersecting the given pixel area. Coordinates are
+// clipped to the picture; ends are exclusive.
+void	TileMask::set_area (int x_beg, int y_beg, int x_end, int y_end) noexcept
+{
+	assert (_tile_size > 0);
+
+	x_beg = std::max (x_beg, 0);
+	y_beg = std::max (y_beg, 0);
+	x_end = std::min (x_end, _w);
+	y_end = std::min (y_end, _h);
+	if (x_beg >= x_end || y_beg >= y_end)
+	{
+		return;
+	}
+
+	const int      tx_beg =  x_beg                   / _tile_size;
+	const int      ty_beg =  y_beg                   / _tile_size;
+	const int      tx_end = (x_end + _tile_size - 1) / _tile_size;
+	const int      ty_end = (y_end + _tile_size - 1) / _tile_size;
+	for (int ty = ty_beg; ty < ty_end; ++ty)
+	{
+		for (int tx = tx_beg; tx < tx_end; ++tx)
+		{
+			set_tile (tx, ty, true);
+		}
+	}
+}
+
+
+
+// Checks if any tile is set on the pixel rows [y_beg ; y_end[, clipped to
+// the picture.
+bool	TileMask::is_row_range_set (int y_beg, int y_end) const noexcept
+{
+	assert (_tile_size > 0);
+
+	y_beg = std::max (y_beg, 0);
+	y_end = std::min (y_end, _h);
+	if (y_beg >= y_end)
+	{
+		return false;
+	}
+
+	const int      ty_beg =  y_beg                   / _tile_size;
+	const int      ty_end = (y_end + _tile_size - 1) / _tile_size;
+	for (int ty = ty_beg; ty < ty_end; ++ty)
+	{
+		if (is_tile_row_set (ty))
+		{
+			return true;
+		}
+	}
+
+	return false;
+}
+
+
+
+/*\\\ PROTECTED \\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\*/
+
+
+
+/*\\\ PRIVATE \\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\*/
+
+
+
+}  // namespace fgrn
+
+
+
+/*\\\ EOF \\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\*/
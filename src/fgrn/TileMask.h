@@ -0,0 +1,124 @@
+/*****************************************************************************
+
+        TileMask.h
+        Author: Laurent de Soras, 2022
+
+Flags set on square tiles covering a picture. Used to restrict the
+rendering to a part of the picture.
+
+--- Legal stuff ---
+
+This program is free software. It comes without any warranty, to
+the extent permitted by applicable law. You can redistribute it
+and/or modify it under the terms of the Do What The Fuck You Want
+To Public License, Version 2, as published by Sam Hocevar. See
+http://sam.zoy.org/wtfpl/COPYING for more details.
+
+*Tab=3***********************************************************************/
+
+
+
+#pragma once
+#if ! defined (fgrn_TileMask_HEADER_INCLUDED)
+#define fgrn_TileMask_HEADER_INCLUDED
+
+
+
+/*\\\ INCLUDE FILES \\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\*/
+
+#include <vector>
+
+#include <cstdint>
+
+
+
+namespace fgrn
+{
+
+
+
+class TileMask
+{
+
+/*\\\ PUBLIC \\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\*/
+
+public:
+
+	void           reset (int w, int h, int tile_size, bool flag);
+	void           set_tile (int tx, int ty, bool flag) noexcept;
+	void           set_area (int x_beg, int y_beg, int x_end, int y_end) noexcept;
+
+	inline int     get_w () const noexcept;
+	inline int     get_h () const noexcept;
+	inline int     get_tile_size () const noexcept;
+	inline int     get_nbr_tiles_x () const noexcept;
+	inline int     get_nbr_tiles_y () const noexcept;
+	inline bool    is_tile_set (int tx, int ty) const noexcept;
+	inline bool    is_tile_row_set (int ty) const noexcept;
+	inline int     get_nbr_tiles_set_row (int ty) const noexcept;
+	inline bool    is_row_set (int y) const noexcept;
+	bool           is_row_range_set (int y_beg, int y_end) const noexcept;
+	inline int     get_nbr_tiles_set () const noexcept;
+
+	template <typename F>
+	void           process_row_spans (int y, F fnc) const;
+
+
+
+/*\\\ PROTECTED \\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\*/
+
+protected:
+
+
+
+/*\\\ PRIVATE \\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\*/
+
+private:
+
+	// Picture size in pixels, > 0 once initialised
+	int            _w         = 0;
+	int            _h         = 0;
+
+	// Tile size in pixels, > 0 once initialised
+	int            _tile_size = 0;
+
+	// Number of tiles, horizontally and vertically
+	int            _nbr_tx    = 0;
+	int            _nbr_ty    = 0;
+
+	// Flag for each tile, rows are stored contiguously (stride = _nbr_tx)
+	std::vector <uint8_t>
+	               _flag_arr;
+
+	// Number of set tiles for each row of tiles
+	std::vector <int>
+	               _cnt_row_arr;
+
+	int            _cnt_total = 0;
+
+
+
+/*\\\ FORBIDDEN MEMBER FUNCTIONS \\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\*/
+
+private:
+
+	bool           operator == (const TileMask &other) const = delete;
+	bool           operator != (const TileMask &other) const = delete;
+
+}; // class TileMask
+
+
+
+}  // namespace fgrn
+
+
+
+#include "fgrn/TileMask.hpp"
+
+
+
+#endif   // fgrn_TileMask_HEADER_INCLUDED
+
+
+
+/*\\\ EOF \\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\*/
@@ -0,0 +1,178 @@
+/*****************************************************************************
+
+        TileMask.hpp
+        Author: Laurent de Soras, 2022
+
+--- Legal stuff ---
+
+This program is free software. It comes without any warranty, to
+the extent permitted by applicable law. You can redistribute it
+and/or modify it under the terms of the Do What The Fuck You Want
+To Public License, Version 2, as published by Sam Hocevar. See
+http://sam.zoy.org/wtfpl/COPYING for more details.
+
+*Tab=3***********************************************************************/
+
+
+
+#if ! defined (fgrn_TileMask_CODEHEADER_INCLUDED)
+#define fgrn_TileMask_CODEHEADER_INCLUDED
+
+
+
+/*\\\ INCLUDE FILES \\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\*/
+
+#include <algorithm>
+
+#include <cassert>
+
+
+
+namespace fgrn
+{
+
+
+
+/*\\\ PUBLIC \\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\*/
+
+
+
+int	TileMask::get_w () const noexcept
+{
+	return _w;
+}
+
+
+
+int	TileMask::get_h () const noexcept
+{
+	return _h;
+}
+
+
+
+int	TileMask::get_tile_size () const noexcept
+{
+	return _tile_size;
+}
+
+
+
+int	TileMask::get_nbr_tiles_x () const noexcept
+{
+	return _nbr_tx;
+}
+
+
+
+int	TileMask::get_nbr_tiles_y () const noexcept
+{
+	return _nbr_ty;
+}
+
+
+
+bool	TileMask::is_tile_set (int tx, int ty) const noexcept
+{
+	assert (tx >= 0);
+	assert (tx < _nbr_tx);
+	assert (ty >= 0);
+	assert (ty < _nbr_ty);
+
+	return (_flag_arr [ty * _nbr_tx + tx] != 0);
+}
+
+
+
+bool	TileMask::is_tile_row_set (int ty) const noexcept
+{
+	assert (ty >= 0);
+	assert (ty < _nbr_ty);
+
+	return (_cnt_row_arr [ty] > 0);
+}
+
+
+
+int	TileMask::get_nbr_tiles_set_row (int ty) const noexcept
+{
+	assert (ty >= 0);
+	assert (ty < _nbr_ty);
+
+	return _cnt_row_arr [ty];
+}
+
+
+
+// y is a pixel row
+bool	TileMask::is_row_set (int y) const noexcept
+{
+	assert (y >= 0);
+	assert (y < _h);
+
+	return is_tile_row_set (y / _tile_size);
+}
+
+
+
+int	TileMask::get_nbr_tiles_set () const noexcept
+{
+	return _cnt_total;
+}
+
+
+
+// Calls fnc (x_beg, x_end) for each horizontal span of contiguous set
+// tiles on the pixel row y. x_end is exclusive.
+template <typename F>
+void	TileMask::process_row_spans (int y, F fnc) const
+{
+	assert (y >= 0);
+	assert (y < _h);
+
+	const int      ty = y / _tile_size;
+	if (! is_tile_row_set (ty))
+	{
+		return;
+	}
+
+	const auto     flag_ptr = &_flag_arr [ty * _nbr_tx];
+	int            tx       = 0;
+	while (tx < _nbr_tx)
+	{
+		if (flag_ptr [tx] == 0)
+		{
+			++ tx;
+		}
+		else
+		{
+			const int      tx_beg = tx;
+			do
+			{
+				++ tx;
+			}
+			while (tx < _nbr_tx && flag_ptr [tx] != 0);
+			fnc (tx_beg * _tile_size, std::min (tx * _tile_size, _w));
+		}
+	}
+}
+
+
+
+/*\\\ PROTECTED \\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\*/
+
+
+
+/*\\\ PRIVATE \\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\*/
+
+
+
+}  // namespace fgrn
+
+
+
+#endif   // fgrn_TileMask_CODEHEADER_INCLUDED
+
+
+
+/*\\\ EOF \\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\*/
@@ -0,0 +1,388 @@
+/*****************************************************************************
+
+        Transfer.cpp
+        Author: Laurent de Soras, 2022
+
+--- Legal stuff ---
+
+This program is free software. It comes without any warranty, to
+the extent permitted by applicable law. You can redistribute it
+and/or modify it under the terms of the Do What The Fuck You Want
+To Public License, Version 2, as published by Sam Hocevar. See
+http://sam.zoy.org/wtfpl/COPYING for more details.
+
+*Tab=3***********************************************************************/
+
+
+
+#if defined (_MSC_VER)
+	#pragma warning (1 : 4130 4223 4705 4706)
+	#pragma warning (4 : 4355 4786 4800)
+#endif
+
+
+
+/*\\\ INCLUDE FILES \\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\*/
+
+#include "fgrn/SplConv.h"
+#include "fgrn/Transfer.h"
+#include "fstb/Approx.h"
+
+#include <algorithm>
+
+#include <cassert>
+#include <cmath>
+
+
+
+namespace fgrn
+{
+
+
+
+// PQ constants, SMPTE ST 2084
+static constexpr double Transfer_pq_m1 = 2610.0 / 16384;
+static constexpr double Transfer_pq_m2 = 2523.0 / 4096 * 128;
+static constexpr double Transfer_pq_c1 = 3424.0 / 4096;
+static constexpr double Transfer_pq_c2 = 2413.0 / 4096 * 32;
+static constexpr double Transfer_pq_c3 = 2392.0 / 4096 * 32;
+
+
+
+/*\\\ PUBLIC \\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\*/
+
+
+
+// src_fmt is the format of the source planes. The linearization table is
+// built for this format, other formats are still accepted but use the
+// slower path.
+Transfer::Transfer (Curve curve, SplFmt src_fmt)
+:	_curve (curve)
+,	_src_fmt (src_fmt)
+{
+	assert (curve >= 0);
+	assert (curve < Curve_NBR_ELT);
+	assert (src_fmt.is_valid ());
+
+	if (_curve != Curve_LINEAR && ! _src_fmt.is_float32 ())
+	{
+		if (_src_fmt._type == SplFmt::Type_HALF)
+		{
+			_lut.resize (size_t (1) << 16);
+			for (int k = 0; k < int (_lut.size ()); ++k)
+			{
+				const float    val = SplConv::conv_half_to_float (uint16_t (k));
+				_lut [k] = float (decode_ref (_curve, val));
+			}
+		}
+		else
+		{
+			const int      val_max = (1 << _src_fmt._res) - 1;
+			_lut.resize (size_t (val_max) + 1);
+			for (int k = 0; k <= val_max; ++k)
+			{
+				_lut [k] = float (decode_ref (_curve, double (k) / val_max));
+			}
+		}
+	}
+}
+
+
+
+Transfer::Curve	Transfer::get_curve () const noexcept
+{
+	return _curve;
+}
+
+
+
+bool	Transfer::is_linear () const noexcept
+{
+	return (_curve == Curve_LINEAR);
+}
+
+
+
+SplFmt	Transfer::get_src_fmt () const noexcept
+{
+	return _src_fmt;
+}
+
+
+
+// Same as SplConv::conv_row_to_float(), the converted samples are then
+// linearized.
+void	Transfer::conv_row_to_linear (float * fstb_RESTRICT dst_ptr, const uint8_t * fstb_RESTRICT src_ptr, SplFmt fmt, int x_beg, int x_end) const noexcept
+{
+	assert (dst_ptr != nullptr);
+	assert (src_ptr != nullptr);
+	assert (fmt.is_valid ());
+	assert (x_beg >= 0);
+	assert (x_beg <= x_end);
+
+	if (has_lut (fmt))
+	{
+		// Integer values out of the nominal range are clipped
+		const auto     lut_ptr = _lut.data ();
+		const int      idx_max = int (_lut.size ()) - 1;
+		if (fmt.get_size () == 1)
+		{
+			for (int x = x_beg; x < x_end; ++x)
+			{
+				dst_ptr [x] = lut_ptr [std::min (int (src_ptr [x]), idx_max)];
+			}
+		}
+		else
+		{
+			const auto     s16_ptr = reinterpret_cast <const uint16_t *> (src_ptr);
+			for (int x = x_beg; x < x_end; ++x)
+			{
+				dst_ptr [x] = lut_ptr [std::min (int (s16_ptr [x]), idx_max)];
+			}
+		}
+	}
+
+	else
+	{
+		SplConv::conv_row_to_float (dst_ptr, src_ptr, fmt, x_beg, x_end);
+		if (_curve != Curve_LINEAR)
+		{
+			for (int x = x_beg; x < x_end; ++x)
+			{
+				dst_ptr [x] = decode (_curve, dst_ptr [x]);
+			}
+		}
+	}
+}
+
+
+
+// Same as SplConv::conv_row_from_float(), the linear samples are encoded
+// first. The [x_beg ; x_end[ part of the source row is encoded in place.
+void	Transfer::conv_row_from_linear (uint8_t * fstb_RESTRICT dst_ptr, float * fstb_RESTRICT src_ptr, SplFmt fmt, int x_beg, int x_end) const noexcept
+{
+	assert (dst_ptr != nullptr);
+	assert (src_ptr != nullptr);
+	assert (fmt.is_valid ());
+	assert (x_beg >= 0);
+	assert (x_beg <= x_end);
+
+	if (_curve != Curve_LINEAR)
+	{
+		for (int x = x_beg; x < x_end; ++x)
+		{
+			src_ptr [x] = encode (_curve, src_ptr [x]);
+		}
+	}
+
+	SplConv::conv_row_from_float (dst_ptr, src_ptr, fmt, x_beg, x_end);
+}
+
+
+
+// Encoded value -> linear value
+float	Transfer::decode (Curve curve, float val) noexcept
+{
+	if (curve == Curve_LINEAR)
+	{
+		return val;
+	}
+	if (! (val > 0)) // Catches NaN too
+	{
+		return 0;
+	}
+	val = std::min (val, 1.f);
+
+	switch (curve)
+	{
+	case Curve_SRGB:
+		return (val <= 0.04045f)
+			? val * float (1.0 / 12.92)
+			: pow_approx ((val + 0.055f) * float (1.0 / 1.055), 2.4f);
+
+	case Curve_BT1886:
+		return pow_approx (val, 2.4f);
+
+	case Curve_PQ:
+		// The subtractions cancel most of the significant bits near the peak
+		// and the large exponents amplify the remaining errors, so PQ is
+		// computed in double precision. Integer sources use the table anyway.
+		return float (decode_ref (curve, val));
+
+	default:
+		assert (false);
+		return val;
+	}
+}
+
+
+
+// Linear value -> encoded value
+float	Transfer::encode (Curve curve, float val) noexcept
+{
+	if (curve == Curve_LINEAR)
+	{
+		return val;
+	}
+	if (! (val > 0))
+	{
+		val = 0;
+	}
+	val = std::min (val, 1.f);
+
+	switch (curve)
+	{
+	case Curve_SRGB:
+		return (val <= 0.0031308f)
+			? val * 12.92f
+			: pow_approx (val, float (1.0 / 2.4)) * 1.055f - 0.055f;
+
+	case Curve_BT1886:
+		return pow_approx (val, float (1.0 / 2.4));
+
+	case Curve_PQ:
+		// Double precision, see decode()
+		return float (encode_ref (curve, val));
+
+	default:
+		assert (false);
+		return val;
+	}
+}
+
+
+
+// Reference implementation of decode(), for the tables and the tests
+double	Transfer::decode_ref (Curve curve, double val) noexcept
+{
+	if (curve == Curve_LINEAR)
+	{
+		return val;
+	}
+	if (! (val > 0))
+	{
+		return 0;
+	}
+	val = std::min (val, 1.0);
+
+	switch (curve)
+	{
+	case Curve_SRGB:
+		return (val <= 0.04045)
+			? val / 12.92
+			: std::pow ((val + 0.055) / 1.055, 2.4);
+
+	case Curve_BT1886:
+		return std::pow (val, 2.4);
+
+	case Curve_PQ:
+		{
+			const double   p = std::pow (val, 1 / Transfer_pq_m2);
+			const double   n = std::max (p - Transfer_pq_c1, 0.0);
+			return std::pow (n / (Transfer_pq_c2 - Transfer_pq_c3 * p), 1 / Transfer_pq_m1);
+		}
+
+	default:
+		assert (false);
+		return val;
+	}
+}
+
+
+
+// Reference implementation of encode()
+double	Transfer::encode_ref (Curve curve, double val) noexcept
+{
+	if (curve == Curve_LINEAR)
+	{
+		return val;
+	}
+	if (! (val > 0))
+	{
+		val = 0;
+	}
+	val = std::min (val, 1.0);
+
+	switch (curve)
+	{
+	case Curve_SRGB:
+		return (val <= 0.0031308)
+			? val * 12.92
+			: std::pow (val, 1 / 2.4) * 1.055 - 0.055;
+
+	case Curve_BT1886:
+		return std::pow (val, 1 / 2.4);
+
+	case Curve_PQ:
+		{
+			const double   y = std::pow (val, Transfer_pq_m1);
+			return std::pow (
+				(Transfer_pq_c1 + Transfer_pq_c2 * y) / (1 + Transfer_pq_c3 * y),
+				Transfer_pq_m2
+			);
+		}
+
+	default:
+		assert (false);
+		return val;
+	}
+}
+
+
+
+// Returns the curve from its parameter name, or -1 if not found
+int	Transfer::find_curve (const std::string &name) noexcept
+{
+	static const char * const  name_arr [Curve_NBR_ELT] =
+	{
+		"linear", "srgb", "bt1886", "pq"
+	};
+	for (int c_idx = 0; c_idx < Curve_NBR_ELT; ++c_idx)
+	{
+		if (name == name_arr [c_idx])
+		{
+			return c_idx;
+		}
+	}
+
+	return -1;
+}
+
+
+
+/*\\\ PROTECTED \\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\*/
+
+
+
+/*\\\ PRIVATE \\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\*/
+
+
+
+bool	Transfer::has_lut (SplFmt fmt) const noexcept
+{
+	return (! _lut.empty () && fmt == _src_fmt);
+}
+
+
+
+// x^e for x >= 0. Relative error around 4e-6 * |e|.
+float	Transfer::pow_approx (float x, float e) noexcept
+{
+	if (! (x > 0))
+	{
+		return 0;
+	}
+
+	const float    l = e * fstb::Approx::log2_7th (x);
+
+	// Below the normal float range
+	return (l < -126) ? 0.f : fstb::Approx::exp2_7th (l);
+}
+
+
+
+}  // namespace fgrn
+
+
+
+/*\\\ EOF \\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\*/
@@ -0,0 +1,141 @@
+/*****************************************************************************
+
+        Transfer.h
+        Author: Laurent de Soras, 2022
+
+Transfer curves of the plane samples. The grain is rendered in linear
+light, so the encoded samples are linearized when the source rows are
+loaded, and the rendered rows are re-encoded when they are stored. This
+avoids two full-frame conversion filters around the grain generator.
+
+The nominal ranges are [0 ; 1] on both sides. Out-of-range values are
+clipped. For PQ, a linear value of 1 is 10000 cd/m2.
+
+Integer and half-float sources are linearized with a table built for the
+source format. Otherwise, sRGB and BT.1886 use polynomial approximations of
+the power functions, and PQ is computed in double precision.
+
+--- Legal stuff ---
+
+This program is free software. It comes without any warranty, to
+the extent permitted by applicable law. You can redistribute it
+and/or modify it under the terms of the Do What The Fuck You Want
+To Public License, Version 2, as published by Sam Hocevar. See
+http://sam.zoy.org/wtfpl/COPYING for more details.
+
+*Tab=3***********************************************************************/
+
+
+
+#pragma once
+#if ! defined (fgrn_Transfer_HEADER_INCLUDED)
+#define fgrn_Transfer_HEADER_INCLUDED
+
+
+
+/*\\\ INCLUDE FILES \\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\*/
+
+#include "fgrn/SplFmt.h"
+#include "fstb/def.h"
+
+#include <string>
+#include <vector>
+
+#include <cstdint>
+
+
+
+namespace fgrn
+{
+
+
+
+class Transfer
+{
+
+/*\\\ PUBLIC \\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\*/
+
+public:
+
+	enum Curve
+	{
+		Curve_LINEAR = 0,
+		Curve_SRGB,       // IEC 61966-2-1
+		Curve_BT1886,     // ITU-R BT.1886, 2.4 power with a null black level
+		Curve_PQ,         // SMPTE ST 2084
+
+		Curve_NBR_ELT
+	};
+
+	explicit       Transfer (Curve curve, SplFmt src_fmt);
+
+	Curve          get_curve () const noexcept;
+	bool           is_linear () const noexcept;
+	SplFmt         get_src_fmt () const noexcept;
+
+	void           conv_row_to_linear (float * fstb_RESTRICT dst_ptr, const uint8_t * fstb_RESTRICT src_ptr, SplFmt fmt, int x_beg, int x_end) const noexcept;
+	void           conv_row_from_linear (uint8_t * fstb_RESTRICT dst_ptr, float * fstb_RESTRICT src_ptr, SplFmt fmt, int x_beg, int x_end) const noexcept;
+
+	static float   decode (Curve curve, float val) noexcept;
+	static float   encode (Curve curve, float val) noexcept;
+	static double  decode_ref (Curve curve, double val) noexcept;
+	static double  encode_ref (Curve curve, double val) noexcept;
+
+	static int     find_curve (const std::string &name) noexcept;
+
+
+
+/*\\\ PROTECTED \\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\*/
+
+protected:
+
+
+
+/*\\\ PRIVATE \\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\*/
+
+private:
+
+	bool           has_lut (SplFmt fmt) const noexcept;
+
+	static inline float
+	               pow_approx (float x, float e) noexcept;
+
+	Curve          _curve = Curve_LINEAR;
+	SplFmt         _src_fmt;
+
+	// Linear values, indexed by the raw source sample. Only for the integer
+	// and half-float source formats with a non-linear curve.
+	std::vector <float>
+	               _lut;
+
+
+
+/*\\\ FORBIDDEN MEMBER FUNCTIONS \\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\*/
+
+private:
+
+	               Transfer ()                               = delete;
+	               Transfer (const Transfer &other)          = delete;
+	               Transfer (Transfer &&other)               = delete;
+	Transfer &     operator = (const Transfer &other)        = delete;
+	Transfer &     operator = (Transfer &&other)             = delete;
+	bool           operator == (const Transfer &other) const = delete;
+	bool           operator != (const Transfer &other) const = delete;
+
+}; // class Transfer
+
+
+
+}  // namespace fgrn
+
+
+
+//#include "fgrn/Transfer.hpp"
+
+
+
+#endif   // fgrn_Transfer_HEADER_INCLUDED
+
+
+
+/*\\\ EOF \\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\*/
@@ -23,6 +23,9 @@ http://sam.zoy.org/wtfpl/COPYING for more details.
 
 /*\\\ INCLUDE FILES \\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\*/
 
+#include "fgrn/PrngHashMul.h"
+#include "fgrn/PrngHashShift.h"
+#include "fstb/def.h"
 #include "fstb/Vf32.h"
 #include "fstb/Vs32.h"
 #include "fstb/Vu32.h"
@@ -38,34 +41,62 @@ namespace fgrn
 
 
 
-class UtilPrng
+// H is the hash backend, giving the random bits and their conversion into
+// uniformly distributed floating point numbers. See PrngHashMul.
+template <typename H>
+class UtilPrngTpl
 {
 
 /*\\\ PUBLIC \\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\*/
 
 public:
 
+	typedef H HashType;
+
 	// More or less arbitrary limit to be refined, keeping in mind the balance
 	// between accuracy and speed. At least, stay below 70.
 	static constexpr float  _poisson_algo_cutoff = 30;
 
+	// Truncated normal distribution, built from an Irwin-Hall distribution:
+	// sum of _norm_trunc_nbr random numbers of _norm_trunc_res bits.
+	// Integer sums are in [0 ; _norm_trunc_max], centered on _norm_trunc_avg.
+	// _norm_trunc_mul converts a centered sum into a normal variable with a
+	// unit standard deviation.
+	static constexpr int    _norm_trunc_nbr = 6;
+	static constexpr int    _norm_trunc_res = 10;
+	static constexpr int    _norm_trunc_max =
+		_norm_trunc_nbr * ((1 << _norm_trunc_res) - 1);
+	static constexpr int    _norm_trunc_avg = _norm_trunc_max / 2;
+	static constexpr float  _norm_trunc_mul =
+		float (fstb::SQRT2) / float ((1 << _norm_trunc_res) - 1);
+
+	static fstb_FORCEINLINE uint32_t
+	               hash (uint32_t x) noexcept;
 	static inline float
 	               gen_uniform (uint32_t rnd_state) noexcept;
 	static inline int
 	               gen_poisson (uint32_t rnd_state, float lambda) noexcept;
+	static inline int
+	               gen_binomial (uint32_t rnd_state, int n, float p) noexcept;
 	static inline std::array <float, 2>
 	               make_norm_from_uni (float u0, float u1) noexcept;
+	static inline int
+	               gen_norm_trunc_int (uint32_t rnd_state) noexcept;
 	static inline float
 	               gen_norm_trunc (uint32_t rnd_state) noexcept;
 	static inline float
 	               gen_log_norm (uint32_t rnd_state, float mu_log, float sigma) noexcept;
 
+	static fstb_FORCEINLINE fstb::Vu32
+	               hash (fstb::Vu32 x) noexcept;
 	static inline fstb::Vf32
 	               gen_uniform (fstb::Vu32 x) noexcept;
 	static inline fstb::Vs32
 	               gen_poisson (fstb::Vu32 rnd_state, fstb::Vf32 lambda) noexcept;
 	static inline std::array <fstb::Vf32, 2>
 	               make_norm_from_uni (fstb::Vf32 u0, fstb::Vf32 u1) noexcept;
+	static inline fstb::Vs32
+	               gen_norm_trunc_int (fstb::Vu32 rnd_state) noexcept;
 	static inline fstb::Vf32
 	               gen_norm_trunc (fstb::Vu32 rnd_state) noexcept;
 	static inline fstb::Vf32
@@ -95,15 +126,15 @@ private:
 
 private:
 
-	               UtilPrng ()                               = delete;
-	               UtilPrng (const UtilPrng &other)          = delete;
-	               UtilPrng (UtilPrng &&other)               = delete;
-	UtilPrng &     operator = (const UtilPrng &other)        = delete;
-	UtilPrng &     operator = (UtilPrng &&other)             = delete;
-	bool           operator == (const UtilPrng &other) const = delete;
-	bool           operator != (const UtilPrng &other) const = delete;
+	               UtilPrngTpl ()                               = delete;
+	               UtilPrngTpl (const UtilPrngTpl &other)       = delete;
+	               UtilPrngTpl (UtilPrngTpl &&other)            = delete;
+	UtilPrngTpl &  operator = (const UtilPrngTpl &other)        = delete;
+	UtilPrngTpl &  operator = (UtilPrngTpl &&other)             = delete;
+	bool           operator == (const UtilPrngTpl &other) const = delete;
+	bool           operator != (const UtilPrngTpl &other) const = delete;
 
-}; // class UtilPrng
+}; // class UtilPrngTpl
 
 
 
@@ -115,6 +146,27 @@ private:
 
 
 
+namespace fgrn
+{
+
+
+
+// Selects the hash backend for the whole rendering.
+// PrngHashShift is cheaper but does not pass the statistical tests of the
+// test program (grain positions are visibly correlated), so it is kept only
+// for experimentation.
+#if defined (fgrn_UtilPrng_HASH_SHIFT)
+typedef UtilPrngTpl <PrngHashShift> UtilPrng;
+#else
+typedef UtilPrngTpl <PrngHashMul> UtilPrng;
+#endif
+
+
+
+}  // namespace fgrn
+
+
+
 #endif   // fgrn_UtilPrng_HEADER_INCLUDED
 
 
@@ -25,7 +25,6 @@ http://www.wtfpl.net/ for more details.
 #include "fstb/Approx.h"
 #include "fstb/def.h"
 #include "fstb/fnc.h"
-#include "fstb/Hash.h"
 #include "fstb/ToolsSimd.h"
 #include "fstb/Vs32.h"
 
@@ -44,36 +43,42 @@ namespace fgrn
 
 
 
-// Returns a random number in range [0 ; 1]
-float	UtilPrng::gen_uniform (uint32_t rnd_state) noexcept
+template <typename H>
+constexpr float	UtilPrngTpl <H>::_poisson_algo_cutoff;
+template <typename H>
+constexpr int	UtilPrngTpl <H>::_norm_trunc_nbr;
+template <typename H>
+constexpr int	UtilPrngTpl <H>::_norm_trunc_res;
+template <typename H>
+constexpr int	UtilPrngTpl <H>::_norm_trunc_max;
+template <typename H>
+constexpr int	UtilPrngTpl <H>::_norm_trunc_avg;
+template <typename H>
+constexpr float	UtilPrngTpl <H>::_norm_trunc_mul;
+
+
+
+template <typename H>
+uint32_t	UtilPrngTpl <H>::hash (uint32_t x) noexcept
 {
-	constexpr auto mul = float (1.0 / double (UINT32_MAX));
-	const auto     x_u = fstb::Hash::hash (rnd_state);
-	const auto     val = float (x_u) * mul;
+	return H::hash (x);
+}
+
 
-	return val;
 
-/*** To do:
-	Check if this cheaper formula is valid as an alternate hash for generating
-	grain coordinates and radius (use at least the 17 lowest bits):
-	a =  a ^ (a >>  4);
-	a = (a ^ 0xDEADBEEF) + (a << 5);
-	a =  a ^ (a >> 11);
-	Source: Bob Jenkins, http://burtleburtle.net/bob/hash/integer.html
-
-	Another thing to check:
-	union Combo { float _f; uint32_t _i; };
-	Combo val;
-	val._i = (127 << 23) | (x_u >> 9);
-	return val._f - 1.f;
-***/
+// Returns a random number in range [0 ; 1]
+template <typename H>
+float	UtilPrngTpl <H>::gen_uniform (uint32_t rnd_state) noexcept
+{
+	return H::conv_uni (H::hash (rnd_state));
 }
 
 
 
 // Consumes two consecutive rnd_state
 // lambda = average number of events
-int	UtilPrng::gen_poisson (uint32_t rnd_state, float lambda) noexcept
+template <typename H>
+int	UtilPrngTpl <H>::gen_poisson (uint32_t rnd_state, float lambda) noexcept
 {
 	assert (lambda >= 0);
 
@@ -120,7 +125,53 @@ int	UtilPrng::gen_poisson (uint32_t rnd_state, float lambda) noexcept
 
 
 
-std::array <float, 2>	UtilPrng::make_norm_from_uni (float u0, float u1) noexcept
+// Consumes two consecutive rnd_state
+// n = number of trials, p = success probability for each trial
+template <typename H>
+int	UtilPrngTpl <H>::gen_binomial (uint32_t rnd_state, int n, float p) noexcept
+{
+	assert (n >= 0);
+	assert (p >= 0);
+	assert (p <= 1);
+
+	// We work on the least probable outcome to keep the number of iterations
+	// low and the first term of the sum far from 0.
+	const bool     flip_flag = (p > 0.5f);
+	const auto     pm        = (flip_flag) ? 1 - p : p;
+	const auto     avg       = float (n) * pm;
+
+	int            k = 0;
+	const auto     u0 = gen_uniform (rnd_state);
+	if (avg >= _poisson_algo_cutoff)
+	{
+		// Normal approximation, as for the Poisson distribution
+		const auto     u1    = gen_uniform (rnd_state + 1);
+		const auto     norm  = make_norm_from_uni (u0, u1).front ();
+		const auto     dev   = sqrtf (avg * (1 - pm));
+		const auto     equiv = norm * dev + avg;
+		k = fstb::limit (fstb::round_int (equiv), 0, n);
+	}
+	else
+	{
+		// Inverse transform sampling
+		const auto     r    = pm / (1 - pm);
+		auto           prod = powf (1 - pm, float (n));
+		auto           sum  = prod;
+		while (sum < u0 && k < n)
+		{
+			prod *= r * float (n - k) / float (k + 1);
+			sum  += prod;
+			++ k;
+		}
+	}
+
+	return (flip_flag) ? n - k : k;
+}
+
+
+
+template <typename H>
+std::array <float, 2>	UtilPrngTpl <H>::make_norm_from_uni (float u0, float u1) noexcept
 {
 	assert (u0 >= 0);
 	assert (u0 <= 1);
@@ -142,28 +193,34 @@ std::array <float, 2>	UtilPrng::make_norm_from_uni (float u0, float u1) noexcept
 
 
 // Consumes two consecutive rnd_state
-float	UtilPrng::gen_norm_trunc (uint32_t rnd_state) noexcept
+// Returns the uncentered Irwin-Hall sum, in [0 ; _norm_trunc_max]
+template <typename H>
+int	UtilPrngTpl <H>::gen_norm_trunc_int (uint32_t rnd_state) noexcept
 {
 	// Sums 6 10-bit random numbers, as an Irwin-Hall distribution
-	// The output range is [-4.243 ; 4.243], keeping the variable extent
-	// limited.
 	// https://en.wikipedia.org/wiki/Irwin%E2%80%93Hall_distribution
-	constexpr auto nbr  = 6;
-	constexpr auto res  = 10;
+	static_assert (_norm_trunc_nbr == 6, "");
+	constexpr auto res  = _norm_trunc_res;
 	constexpr auto m    = (uint32_t (1) << res) - 1;
-	constexpr auto avg  = int (m * nbr / 2);
-	const auto     r0   = fstb::Hash::hash (rnd_state    );
-	const auto     r1   = fstb::Hash::hash (rnd_state + 1);
+	const auto     r0   = hash (rnd_state    );
+	const auto     r1   = hash (rnd_state + 1);
 	const auto     rsu  =
 		  (r0 & m) + ((r0 >> res) & m) + ((r0 >> (2 * res)) & m)
 		+ (r1 & m) + ((r1 >> res) & m) + ((r1 >> (2 * res)) & m);
-	const auto     rss  = int (rsu) - avg;
 
-	// Adjusts the standard deviation
-	// scale = sqrt (12 / nbr)
-	constexpr auto std_scale = float (fstb::SQRT2);
-	constexpr auto mul  = std_scale / float (m);
-	const auto     norm = float (rss) * mul;
+	return int (rsu);
+}
+
+
+
+// Consumes two consecutive rnd_state
+template <typename H>
+float	UtilPrngTpl <H>::gen_norm_trunc (uint32_t rnd_state) noexcept
+{
+	// The output range is [-4.243 ; 4.243], keeping the variable extent
+	// limited.
+	const auto     rss  = gen_norm_trunc_int (rnd_state) - _norm_trunc_avg;
+	const auto     norm = float (rss) * _norm_trunc_mul;
 
 	return norm;
 }
@@ -171,7 +228,8 @@ float	UtilPrng::gen_norm_trunc (uint32_t rnd_state) noexcept
 
 
 // Consumes two consecutive rnd_state
-float	UtilPrng::gen_log_norm (uint32_t rnd_state, float mu_log, float sigma) noexcept
+template <typename H>
+float	UtilPrngTpl <H>::gen_log_norm (uint32_t rnd_state, float mu_log, float sigma) noexcept
 {
 	assert (mu_log >= -80); // Reasonable values for exp float
 	assert (mu_log <= +80);
@@ -185,22 +243,24 @@ float	UtilPrng::gen_log_norm (uint32_t rnd_state, float mu_log, float sigma) noe
 
 
 
-fstb::Vf32	UtilPrng::gen_uniform (fstb::Vu32 x) noexcept
+template <typename H>
+fstb::Vu32	UtilPrngTpl <H>::hash (fstb::Vu32 x) noexcept
+{
+	return H::hash (x);
+}
+
+
+
+template <typename H>
+fstb::Vf32	UtilPrngTpl <H>::gen_uniform (fstb::Vu32 x) noexcept
 {
-	// _mm_cvtepi32_ps works only on signed data, so we divide everything
-	// by 2 to fit in the positive part. Resulting difference with the
-	// scalar code is tiny, but does exist for some values.
-	x = fstb::Hash::hash (x) >> 1;
-	auto           f   = fstb::ToolsSimd::conv_s32_to_f32 (fstb::Vs32 (x));
-	const auto     mul = fstb::Vf32 (float (1.0 / double (UINT32_MAX >> 1)));
-	f *= mul;
-
-	return f;
+	return H::conv_uni (H::hash (x));
 }
 
 
 
-fstb::Vs32	UtilPrng::gen_poisson (fstb::Vu32 rnd_state, fstb::Vf32 lambda) noexcept
+template <typename H>
+fstb::Vs32	UtilPrngTpl <H>::gen_poisson (fstb::Vu32 rnd_state, fstb::Vf32 lambda) noexcept
 {
 	// Use the standard distribution approximation by default, for all lambda
 	// values
@@ -231,7 +291,8 @@ fstb::Vs32	UtilPrng::gen_poisson (fstb::Vu32 rnd_state, fstb::Vf32 lambda) noexc
 
 
 
-std::array <fstb::Vf32, 2>	UtilPrng::make_norm_from_uni (fstb::Vf32 u0, fstb::Vf32 u1) noexcept
+template <typename H>
+std::array <fstb::Vf32, 2>	UtilPrngTpl <H>::make_norm_from_uni (fstb::Vf32 u0, fstb::Vf32 u1) noexcept
 {
 	assert ((u0 >= fstb::Vf32 (0)).and_h ());
 	assert ((u0 <= fstb::Vf32 (1)).and_h ());
@@ -247,31 +308,37 @@ std::array <fstb::Vf32, 2>	UtilPrng::make_norm_from_uni (fstb::Vf32 u0, fstb::Vf
 
 
 
-fstb::Vf32	UtilPrng::gen_norm_trunc (fstb::Vu32 rnd_state) noexcept
+template <typename H>
+fstb::Vs32	UtilPrngTpl <H>::gen_norm_trunc_int (fstb::Vu32 rnd_state) noexcept
 {
-	constexpr auto nbr = 6;
-	constexpr auto res = 10;
+	static_assert (_norm_trunc_nbr == 6, "");
+	constexpr auto res = _norm_trunc_res;
 	constexpr auto m   = (uint32_t (1) << res) - 1;
-	constexpr auto avg = int (nbr * m / 2);
 	const auto     one = fstb::Vu32 (1);
 	const auto     vm  = fstb::Vu32 (m);
-	const auto     r0  = fstb::Hash::hash (rnd_state      );
-	const auto     r1  = fstb::Hash::hash (rnd_state + one);
+	const auto     r0  = hash (rnd_state      );
+	const auto     r1  = hash (rnd_state + one);
 	const auto     a0  = fstb::Vs32 ( r0               & vm);
 	const auto     a1  = fstb::Vs32 ((r0 >>  res     ) & vm);
 	const auto     a2  = fstb::Vs32 ((r0 >> (res * 2)) & vm);
 	const auto     a3  = fstb::Vs32 ( r1               & vm);
 	const auto     a4  = fstb::Vs32 ((r1 >>  res     ) & vm);
 	const auto     a5  = fstb::Vs32 ((r1 >> (res * 2)) & vm);
-	const auto     a6  = fstb::Vs32 (avg);
-	const auto     rss =
-		  ((a0 + a1) +  a2      )
-		+ ((a3 + a4) + (a5 - a6));
-
-	// scale = sqrt (12 / nbr)
-	constexpr auto std_scale = float (fstb::SQRT2);
-	constexpr auto mul  = std_scale / float (m);
-	const auto     vmu  = fstb::Vf32 (mul);
+	const auto     rsu =
+		  ((a0 + a1) + a2)
+		+ ((a3 + a4) + a5);
+
+	return rsu;
+}
+
+
+
+template <typename H>
+fstb::Vf32	UtilPrngTpl <H>::gen_norm_trunc (fstb::Vu32 rnd_state) noexcept
+{
+	const auto     rss  =
+		gen_norm_trunc_int (rnd_state) - fstb::Vs32 (_norm_trunc_avg);
+	const auto     vmu  = fstb::Vf32 (_norm_trunc_mul);
 	const auto     norm = fstb::ToolsSimd::conv_s32_to_f32 (rss) * vmu;
 
 	return norm;
@@ -279,7 +346,8 @@ fstb::Vf32	UtilPrng::gen_norm_trunc (fstb::Vu32 rnd_state) noexcept
 
 
 
-fstb::Vf32	UtilPrng::gen_log_norm (fstb::Vu32 rnd_state, fstb::Vf32 mu_log, fstb::Vf32 sigma) noexcept
+template <typename H>
+fstb::Vf32	UtilPrngTpl <H>::gen_log_norm (fstb::Vu32 rnd_state, fstb::Vf32 mu_log, fstb::Vf32 sigma) noexcept
 {
 	const auto     norm = gen_norm_trunc (rnd_state);
 	auto           earg = mu_log + norm * sigma;
@@ -299,8 +367,9 @@ fstb::Vf32	UtilPrng::gen_log_norm (fstb::Vu32 rnd_state, fstb::Vf32 mu_log, fstb
 
 
 
+template <typename H>
 template <int N>
-void	UtilPrng::gen_poisson_one (std::tuple <int32_t, int32_t, int32_t, int32_t> &n, const std::tuple <float, float, float, float> &x, const std::tuple <uint32_t, uint32_t, uint32_t, uint32_t> &rnd_state, unsigned int mask) noexcept
+void	UtilPrngTpl <H>::gen_poisson_one (std::tuple <int32_t, int32_t, int32_t, int32_t> &n, const std::tuple <float, float, float, float> &x, const std::tuple <uint32_t, uint32_t, uint32_t, uint32_t> &rnd_state, unsigned int mask) noexcept
 {
 	if ((mask & (1 << N)) != 0)
 	{
@@ -315,7 +384,8 @@ void	UtilPrng::gen_poisson_one (std::tuple <int32_t, int32_t, int32_t, int32_t>
 
 // an in [0 ; 1]
 // Returns { cos, sin } of an * 2 * pi
-std::array <fstb::Vf32, 2>	UtilPrng::cos_sin_twopi (fstb::Vf32 an) noexcept
+template <typename H>
+std::array <fstb::Vf32, 2>	UtilPrngTpl <H>::cos_sin_twopi (fstb::Vf32 an) noexcept
 {
 	assert ((an >= fstb::Vf32 (0)).and_h ());
 	assert ((an <= fstb::Vf32 (1)).and_h ());
@@ -41,6 +41,7 @@ VisionFilter::VisionFilter (float sigma, int nbr_points, float grain_radius_avg,
 :	_nbr_points (nbr_points)
 ,	_rad_avg (grain_radius_avg)
 ,	_rad_stddev (grain_radius_stddev)
+,	_gauss_flag (sigma > 0)
 {
 	assert (nbr_points > 0);
 	assert (grain_radius_avg > 0);
@@ -52,6 +53,43 @@ VisionFilter::VisionFilter (float sigma, int nbr_points, float grain_radius_avg,
 
 
 
+// Checks if the grains centered in the source pixel (cx_r, cy_r) could
+// intersect the filter point (fx, fy), given an upper bound for the grain
+// radius. Coordinates are relative to the filter center. This is the rule
+// used to build the groups of source pixels, so a smaller grain_rad_max
+// gives a subset of the group the point belongs to.
+bool	VisionFilter::is_cell_in_reach (float fx, float fy, int cx_r, int cy_r, float grain_rad_max) const noexcept
+{
+	assert (grain_rad_max > 0);
+
+	if (! _gauss_flag)
+	{
+		return (cx_r == 0 && cy_r == 0);
+	}
+
+	return (
+		   cx_r >= fstb::round_int (fx - grain_rad_max)
+		&& cx_r <= fstb::round_int (fx + grain_rad_max)
+		&& cy_r >= fstb::round_int (fy - grain_rad_max)
+		&& cy_r <= fstb::round_int (fy + grain_rad_max)
+	);
+}
+
+
+
+// Approximation of an upper bound for the grain radius. This is a trade-off
+// between exhaustivity (accuracy) and performance.
+// The filter reach grows with this value.
+float	VisionFilter::compute_grain_rad_max (float grain_radius_avg, float grain_radius_stddev) noexcept
+{
+	assert (grain_radius_avg > 0);
+	assert (grain_radius_stddev >= 0);
+
+	return grain_radius_avg * expf (grain_radius_stddev * 3);
+}
+
+
+
 /*\\\ PROTECTED \\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\*/
 
 
@@ -63,11 +101,13 @@ VisionFilter::VisionFilter (float sigma, int nbr_points, float grain_radius_avg,
 void	VisionFilter::build_filter (float sigma, float grain_radius_avg, float grain_radius_stddev)
 {
 	_filter.clear ();
+	_kernel.clear ();
+
+	// Number of points per source pixel, for the kernel
+	std::map <C2di, int> tap_map;
 
-	// Approximation of an upper bound for the grain radius. This is a trade-
-	// off between exhaustivity (accuracy) and performance.
 	const auto     expected_grain_rad =
-		grain_radius_avg * expf (grain_radius_stddev * 3);
+		compute_grain_rad_max (grain_radius_avg, grain_radius_stddev);
 
 	// Filter: limits the distance from the center to 4 times the standard
 	// deviation. Again, an accuracy/performance trade-off.
@@ -96,6 +136,7 @@ void	VisionFilter::build_filter (float sigma, float grain_radius_avg, float grai
 				c -= 0.5f;
 			}
 			cov.insert ({ 0, 0 });
+			++ tap_map [C2di { 0, 0 }];
 		}
 
 		// Gaussian filter
@@ -119,6 +160,9 @@ void	VisionFilter::build_filter (float sigma, float grain_radius_avg, float grai
 			{
 				c *= scale;
 			}
+			++ tap_map [C2di {
+				fstb::round_int (coord [0]), fstb::round_int (coord [1])
+			}];
 
 			// Finds the bounding box (source pixels) where the centers of the
 			// potentially intersecting grains could be located.
@@ -155,6 +199,16 @@ void	VisionFilter::build_filter (float sigma, float grain_radius_avg, float grai
 		add_and_wrap (a2n, a2);
 	}
 
+	const auto     w_mul = 1.f / float (_nbr_points);
+	for (const auto &tap_entry : tap_map)
+	{
+		Tap            tap;
+		tap._dx = tap_entry.first [0];
+		tap._dy = tap_entry.first [1];
+		tap._w  = float (tap_entry.second) * w_mul;
+		_kernel.push_back (tap);
+	}
+
 	compute_filter_area ();
 }
 
@@ -183,6 +237,9 @@ void	VisionFilter::compute_filter_area () noexcept
 
 	_w = max_x + 1 - min_x;
 	_h = max_y + 1 - min_y;
+
+	// Kernel taps are located within the same box
+	_reach = std::max (std::max (-min_x, max_x), std::max (-min_y, max_y));
 }
 
 
@@ -29,6 +29,7 @@ http://sam.zoy.org/wtfpl/COPYING for more details.
 #include <map>
 #include <memory>
 #include <set>
+#include <vector>
 
 #include <cstdint>
 
@@ -53,6 +54,17 @@ public:
 	// All coordinates are in pixels and relative to the filter center.
 	typedef std::map <PixSet, PointList> FilterMap;
 
+	// One tap of the filter kernel sampled on the source pixel grid.
+	// Coordinates are relative to the filter center. All weights sum to 1.
+	class Tap
+	{
+	public:
+		int            _dx = 0;
+		int            _dy = 0;
+		float          _w  = 0;
+	};
+	typedef std::vector <Tap> Kernel;
+
 	explicit       VisionFilter (float sigma, int nbr_points, float grain_radius_avg, float grain_radius_stddev);
 	               VisionFilter (const VisionFilter &other)  = default;
 	               VisionFilter (VisionFilter &&other)       = default;
@@ -64,9 +76,16 @@ public:
 	inline float   get_grain_radius_stddev () const noexcept;
 	inline int     get_w () const noexcept;
 	inline int     get_h () const noexcept;
+	inline int     get_reach () const noexcept;
 	inline int     get_nbr_points () const noexcept;
 	inline const FilterMap &
 	               use_map () const noexcept;
+	inline const Kernel &
+	               use_kernel () const noexcept;
+
+	bool           is_cell_in_reach (float fx, float fy, int cx_r, int cy_r, float grain_rad_max) const noexcept;
+
+	static float   compute_grain_rad_max (float grain_radius_avg, float grain_radius_stddev) noexcept;
 
 
 
@@ -100,13 +119,23 @@ private:
 	float          _rad_avg    = 0;
 	float          _rad_stddev = 0;
 
+	// Indicates a gaussian filter (sigma > 0) instead of a square pixel
+	bool           _gauss_flag = false;
+
 	FilterMap      _filter;
 
+	// Same filter, as a list of weighted pixels
+	Kernel         _kernel;
+
 	// Filter width and height in source pixels, > 0.
 	// Helps for setting the size of the cell cache.
 	int            _w = 0;
 	int            _h = 0;
 
+	// Largest horizontal or vertical distance between the filter center and
+	// a source pixel involved in the rendering of a destination pixel, >= 0.
+	int            _reach = 0;
+
 
 
 /*\\\ FORBIDDEN MEMBER FUNCTIONS \\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\*/
@@ -61,6 +61,13 @@ int	VisionFilter::get_h () const noexcept
 
 
 
+int	VisionFilter::get_reach () const noexcept
+{
+   return _reach;
+}
+
+
+
 int VisionFilter::get_nbr_points () const noexcept
 {
    return _nbr_points;
@@ -75,6 +82,13 @@ const VisionFilter::FilterMap &	VisionFilter::use_map () const noexcept
 
 
 
+const VisionFilter::Kernel &	VisionFilter::use_kernel () const noexcept
+{
+   return _kernel;
+}
+
+
+
 /*\\\ PROTECTED \\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\*/
 
 
@@ -0,0 +1,125 @@
+/*****************************************************************************
+
+        VisionFilterPool.cpp
+        Author: Laurent de Soras, 2022
+
+--- Legal stuff ---
+
+This program is free software. It comes without any warranty, to
+the extent permitted by applicable law. You can redistribute it
+and/or modify it under the terms of the Do What The Fuck You Want
+To Public License, Version 2, as published by Sam Hocevar. See
+http://sam.zoy.org/wtfpl/COPYING for more details.
+
+*Tab=3***********************************************************************/
+
+
+
+
+/*\\\ INCLUDE FILES \\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\*/
+
+#include "fgrn/VisionFilterPool.h"
+
+#include <cassert>
+
+
+
+namespace fgrn
+{
+
+
+
+/*\\\ PUBLIC \\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\*/
+
+
+
+VisionFilterPool &	VisionFilterPool::use_instance ()
+{
+	static VisionFilterPool instance;
+
+	return instance;
+}
+
+
+
+// Returns a filter built with the given parameters, shared with the other
+// users of the same parameters. Parameters are the same as the VisionFilter
+// constructor.
+VisionFilterPool::FilterSPtr	VisionFilterPool::use_filter (float sigma, int nbr_points, float grain_radius_avg, float grain_radius_stddev)
+{
+	assert (nbr_points > 0);
+	assert (grain_radius_avg > 0);
+	assert (grain_radius_stddev >= 0);
+
+	const Key      key { sigma, nbr_points, grain_radius_avg, grain_radius_stddev };
+
+	std::lock_guard <std::mutex> lock (_mtx);
+
+	FilterSPtr     filter_sptr;
+	const auto     it = _filter_map.find (key);
+	if (it != _filter_map.end ())
+	{
+		filter_sptr = it->second.lock ();
+	}
+
+	if (filter_sptr == nullptr)
+	{
+		// Takes the opportunity to clean the map before growing it
+		remove_expired ();
+
+		// Built with the lock held, so concurrent requests for the same
+		// parameters don't build the filter twice.
+		filter_sptr = std::make_shared <const VisionFilter> (
+			sigma, nbr_points, grain_radius_avg, grain_radius_stddev
+		);
+		_filter_map [key] = filter_sptr;
+	}
+
+	return filter_sptr;
+}
+
+
+
+// Number of filters currently alive
+int	VisionFilterPool::get_nbr_filters ()
+{
+	std::lock_guard <std::mutex> lock (_mtx);
+
+	remove_expired ();
+
+	return int (_filter_map.size ());
+}
+
+
+
+/*\\\ PROTECTED \\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\*/
+
+
+
+/*\\\ PRIVATE \\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\*/
+
+
+
+// Call with the mutex locked
+void	VisionFilterPool::remove_expired ()
+{
+	for (auto it = _filter_map.begin (); it != _filter_map.end (); )
+	{
+		if (it->second.expired ())
+		{
+			it = _filter_map.erase (it);
+		}
+		else
+		{
+			++ it;
+		}
+	}
+}
+
+
+
+}  // namespace fgrn
+
+
+
+/*\\\ EOF \\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\*/
@@ -0,0 +1,117 @@
+/*****************************************************************************
+
+        VisionFilterPool.h
+        Author: Laurent de Soras, 2022
+
+Process-wide collection of immutable VisionFilter objects, shared between
+all the users requesting the same parameters. Building a filter with a high
+number of points is expensive, and scripts may instantiate the same grain
+filter many times.
+Filters are released when they are not used anymore.
+Thread-safe.
+
+--- Legal stuff ---
+
+This program is free software. It comes without any warranty, to
+the extent permitted by applicable law. You can redistribute it
+and/or modify it under the terms of the Do What The Fuck You Want
+To Public License, Version 2, as published by Sam Hocevar. See
+http://sam.zoy.org/wtfpl/COPYING for more details.
+
+*Tab=3***********************************************************************/
+
+
+
+#pragma once
+#if ! defined (fgrn_VisionFilterPool_HEADER_INCLUDED)
+#define fgrn_VisionFilterPool_HEADER_INCLUDED
+
+
+
+/*\\\ INCLUDE FILES \\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\*/
+
+#include "fgrn/VisionFilter.h"
+
+#include <map>
+#include <memory>
+#include <mutex>
+#include <tuple>
+
+
+
+namespace fgrn
+{
+
+
+
+class VisionFilterPool
+{
+
+/*\\\ PUBLIC \\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\*/
+
+public:
+
+	typedef std::shared_ptr <const VisionFilter> FilterSPtr;
+
+	static VisionFilterPool &
+	               use_instance ();
+
+	FilterSPtr     use_filter (float sigma, int nbr_points, float grain_radius_avg, float grain_radius_stddev);
+	int            get_nbr_filters ();
+
+
+
+/*\\\ PROTECTED \\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\*/
+
+protected:
+
+
+
+/*\\\ PRIVATE \\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\*/
+
+private:
+
+	// sigma, nbr_points, grain_radius_avg, grain_radius_stddev
+	typedef std::tuple <float, int, float, float> Key;
+	typedef std::map <Key, std::weak_ptr <const VisionFilter> > FilterMap;
+
+	               VisionFilterPool ()  = default;
+
+	void           remove_expired ();
+
+	// Mutex to lock before accessing the map
+	std::mutex     _mtx;
+	FilterMap      _filter_map;
+
+
+
+/*\\\ FORBIDDEN MEMBER FUNCTIONS \\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\*/
+
+private:
+
+	               VisionFilterPool (const VisionFilterPool &other)  = delete;
+	               VisionFilterPool (VisionFilterPool &&other)       = delete;
+	VisionFilterPool &
+	               operator = (const VisionFilterPool &other)        = delete;
+	VisionFilterPool &
+	               operator = (VisionFilterPool &&other)             = delete;
+	bool           operator == (const VisionFilterPool &other) const = delete;
+	bool           operator != (const VisionFilterPool &other) const = delete;
+
+}; // class VisionFilterPool
+
+
+
+}  // namespace fgrn
+
+
+
+//#include "fgrn/VisionFilterPool.hpp"
+
+
+
+#endif   // fgrn_VisionFilterPool_HEADER_INCLUDED
+
+
+
+/*\\\ EOF \\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\*/
@@ -0,0 +1,417 @@
+/*****************************************************************************
+
+        libfgrn.cpp
+        Author: Laurent de Soras, 2022
+
+--- Legal stuff ---
+
+This program is free software. It comes without any warranty, to
+the extent permitted by applicable law. You can redistribute it
+and/or modify it under the terms of the Do What The Fuck You Want
+To Public License, Version 2, as published by Sam Hocevar. See
+http://sam.zoy.org/wtfpl/COPYING for more details.
+
+*Tab=3***********************************************************************/
+
+
+
+#if defined (_MSC_VER)
+	#pragma warning (1 : 4130 4223 4705 4706)
+	#pragma warning (4 : 4355 4786 4800)
+#endif
+
+
+
+/*\\\ INCLUDE FILES \\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\*/
+
+#include "fgrn/GenGrain.h"
+#include "fgrn/TileMask.h"
+#include "fgrn/VisionFilter.h"
+#include "fgrn/VisionFilterPool.h"
+#include "fstb/CpuId.h"
+#include "libfgrn.h"
+
+#include <algorithm>
+#include <atomic>
+#include <vector>
+
+#include <cassert>
+#include <cstring>
+
+
+
+static_assert (int (fgrn::RenderMode_FULL ) == fgrn_Mode_FULL , "");
+static_assert (int (fgrn::RenderMode_DRAFT) == fgrn_Mode_DRAFT, "");
+static_assert (int (fgrn::RenderMode_STAT ) == fgrn_Mode_STAT , "");
+
+
+
+/*\\\ PRIVATE \\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\*/
+
+
+
+struct fgrn_Context
+{
+public:
+
+	explicit       fgrn_Context (const fgrn_Param &param, bool simd4_flag, bool avx_flag);
+
+	fgrn::VisionFilterPool::FilterSPtr
+	               _filter_sptr;
+	fgrn::GenGrain _gen;
+	fgrn::RenderMode
+	               _mode = fgrn::RenderMode_FULL;
+
+	// Picture parts only: area to render, and temporary destination with the
+	// size of the source area.
+	fgrn::TileMask _tile_mask;
+	std::vector <float>
+	               _tmp_arr;
+
+	// Set when a task failed during the current pass
+	std::atomic <bool>
+	               _task_err_flag { false };
+
+private:
+
+	               fgrn_Context ()                               = delete;
+	               fgrn_Context (const fgrn_Context &other)      = delete;
+	               fgrn_Context (fgrn_Context &&other)           = delete;
+	fgrn_Context & operator = (const fgrn_Context &other)        = delete;
+	fgrn_Context & operator = (fgrn_Context &&other)             = delete;
+
+};
+
+
+
+fgrn_Context::fgrn_Context (const fgrn_Param &param, bool simd4_flag, bool avx_flag)
+:	_filter_sptr (fgrn::VisionFilterPool::use_instance ().use_filter (
+		param.sigma, param.res, param.rad, param.dev
+	))
+,	_gen (simd4_flag, avx_flag)
+,	_mode (static_cast <fgrn::RenderMode> (param.mode))
+{
+	// Nothing
+}
+
+
+
+static bool	fgrn_check_param (const fgrn_Param &param) noexcept
+{
+	return (
+		   param.sigma >= 0 && param.sigma <= 1
+		&& param.res > 0
+		&& param.rad > 0
+		&& param.dev >= 0 && param.dev <= 1
+		&& param.mode >= fgrn_Mode_FULL && param.mode <= fgrn_Mode_STAT
+	);
+}
+
+
+
+static bool	fgrn_check_size (int w, int h, int max_nbr_threads) noexcept
+{
+	return (w > 0 && h > 0 && max_nbr_threads > 0);
+}
+
+
+
+// Exceptions cannot cross the caller code, so they are turned into a flag.
+template <void (fgrn::GenGrain::*PROC) (int idx)>
+static void fgrn_CC	fgrn_run_task (void *task_data_ptr, int task_idx)
+{
+	assert (task_data_ptr != nullptr);
+
+	auto &         ctx = *static_cast <fgrn_Context *> (task_data_ptr);
+	try
+	{
+		(ctx._gen.*PROC) (task_idx);
+	}
+	catch (...)
+	{
+		ctx._task_err_flag.store (true);
+	}
+}
+
+
+
+// Without pool, the tasks are run sequentially in the calling thread.
+static int	fgrn_run_pass (fgrn_Context &ctx, fgrn_TaskPtr task_ptr, int nbr_tasks, fgrn_ParallelForPtr pfor_ptr, void *pool_data_ptr)
+{
+	assert (task_ptr != nullptr);
+	assert (nbr_tasks > 0);
+
+	ctx._task_err_flag.store (false);
+
+	if (pfor_ptr == nullptr)
+	{
+		for (int t_idx = 0; t_idx < nbr_tasks; ++t_idx)
+		{
+			task_ptr (&ctx, t_idx);
+		}
+	}
+	else if (pfor_ptr (pool_data_ptr, task_ptr, &ctx, nbr_tasks) != 0)
+	{
+		return fgrn_Err_CALLBACK;
+	}
+
+	return (ctx._task_err_flag.load ()) ? fgrn_Err_EXCEPTION : fgrn_Err_OK;
+}
+
+
+
+// Runs both passes, after GenGrain::mt_start()
+static int	fgrn_run_passes (fgrn_Context &ctx, int nbr_threads, fgrn_ParallelForPtr pfor_ptr, void *pool_data_ptr)
+{
+	int            ret_val = fgrn_run_pass (
+		ctx, &fgrn_run_task <&fgrn::GenGrain::mt_proc_pass1>,
+		nbr_threads, pfor_ptr, pool_data_ptr
+	);
+	if (ret_val == fgrn_Err_OK && ctx._mode != fgrn::RenderMode_DRAFT)
+	{
+		ctx._gen.mt_prepare_pass2 ();
+		ret_val = fgrn_run_pass (
+			ctx, &fgrn_run_task <&fgrn::GenGrain::mt_proc_pass2>,
+			nbr_threads, pfor_ptr, pool_data_ptr
+		);
+	}
+
+	return ret_val;
+}
+
+
+
+static bool	fgrn_check_rect (const fgrn_Rect &rect, int pic_w, int pic_h) noexcept
+{
+	return (
+		   rect.w > 0 && rect.h > 0 && rect.x >= 0 && rect.y >= 0
+		&& rect.x <= pic_w - rect.w && rect.y <= pic_h - rect.h
+	);
+}
+
+
+
+// The source area contains the vision filter reach around the part. Its
+// horizontal boundaries are aligned so the pixels are processed with the
+// same code paths as the whole picture.
+static fgrn_Rect	fgrn_compute_rect_src (const fgrn_Context &ctx, const fgrn_Rect &rect_dst, int pic_w, int pic_h) noexcept
+{
+	fgrn::GenGrain::Rect rect_g;
+	rect_g._x = rect_dst.x;
+	rect_g._y = rect_dst.y;
+	rect_g._w = rect_dst.w;
+	rect_g._h = rect_dst.h;
+	rect_g = fgrn::GenGrain::compute_rect_src (
+		rect_g, pic_w, pic_h, ctx._filter_sptr->get_reach (),
+		fgrn::GrainDensity::_org_align, 1
+	);
+
+	fgrn_Rect      rect_src;
+	rect_src.x = rect_g._x;
+	rect_src.y = rect_g._y;
+	rect_src.w = rect_g._w;
+	rect_src.h = rect_g._h;
+
+	return rect_src;
+}
+
+
+
+/*\\\ PUBLIC \\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\*/
+
+
+
+fgrn_EXPORT (int)	fgrn_get_interface_version (void)
+{
+	return fgrn_INTERFACE_VERSION;
+}
+
+
+
+fgrn_EXPORT (void)	fgrn_init_param (fgrn_Param *param_ptr)
+{
+	assert (param_ptr != nullptr);
+
+	param_ptr->sigma   = 0.35f;
+	param_ptr->res     = 1024;
+	param_ptr->rad     = 0.025f;
+	param_ptr->dev     = 0;
+	param_ptr->mode    = fgrn_Mode_FULL;
+	param_ptr->cpu_opt = 1;
+}
+
+
+
+fgrn_EXPORT (int)	fgrn_create_context (fgrn_Context **ctx_ptr_ptr, const fgrn_Param *param_ptr)
+{
+	if (ctx_ptr_ptr == nullptr || param_ptr == nullptr)
+	{
+		return fgrn_Err_INVALID_ARG;
+	}
+	*ctx_ptr_ptr = nullptr;
+	if (! fgrn_check_param (*param_ptr))
+	{
+		return fgrn_Err_INVALID_ARG;
+	}
+
+	try
+	{
+		fstb::CpuId    cpu;
+		const bool     opt_flag   = (param_ptr->cpu_opt != 0);
+		const bool     simd4_flag = (opt_flag && cpu._sse2_flag);
+		const bool     avx_flag   = (opt_flag && cpu._avx_flag);
+		*ctx_ptr_ptr = new fgrn_Context (*param_ptr, simd4_flag, avx_flag);
+	}
+	catch (...)
+	{
+		return fgrn_Err_EXCEPTION;
+	}
+
+	return fgrn_Err_OK;
+}
+
+
+
+fgrn_EXPORT (void)	fgrn_destroy_context (fgrn_Context *ctx_ptr)
+{
+	delete ctx_ptr;
+}
+
+
+
+// The result is an upper estimate of the memory allocated during the
+// processing, in bytes. The context itself and its vision filter are
+// already allocated and are not included.
+fgrn_EXPORT (int)	fgrn_get_memory_needs (const fgrn_Context *ctx_ptr, int w, int h, int max_nbr_threads, int64_t *size_ptr)
+{
+	if (   ctx_ptr == nullptr || size_ptr == nullptr
+	    || ! fgrn_check_size (w, h, max_nbr_threads))
+	{
+		return fgrn_Err_INVALID_ARG;
+	}
+
+	*size_ptr = fgrn::GenGrain::estimate_mem_size (
+		w, h, *ctx_ptr->_filter_sptr, ctx_ptr->_mode, max_nbr_threads
+	);
+
+	return fgrn_Err_OK;
+}
+
+
+
+// pfor_ptr: parallel-for callback, or nullptr to run everything in the
+// calling thread.
+fgrn_EXPORT (int)	fgrn_process_plane (fgrn_Context *ctx_ptr, float *dst_ptr, ptrdiff_t dst_stride, const float *src_ptr, ptrdiff_t src_stride, int w, int h, uint32_t seed, int max_nbr_threads, fgrn_ParallelForPtr pfor_ptr, void *pool_data_ptr)
+{
+	if (   ctx_ptr == nullptr || dst_ptr == nullptr || src_ptr == nullptr
+	    || dst_ptr == src_ptr || ! fgrn_check_size (w, h, max_nbr_threads))
+	{
+		return fgrn_Err_INVALID_ARG;
+	}
+
+	auto &         ctx = *ctx_ptr;
+	int            ret_val = fgrn_Err_OK;
+	try
+	{
+		const int      nbr_threads = ctx._gen.mt_start (
+			dst_ptr, src_ptr, w, h, src_stride, dst_stride,
+			*ctx._filter_sptr, seed, ctx._mode, max_nbr_threads
+		);
+		ret_val = fgrn_run_passes (ctx, nbr_threads, pfor_ptr, pool_data_ptr);
+	}
+	catch (...)
+	{
+		ret_val = fgrn_Err_EXCEPTION;
+	}
+
+	return ret_val;
+}
+
+
+
+// Source area required to render the *rect_dst_ptr part of a picture of
+// size pic_w * pic_h.
+fgrn_EXPORT (int)	fgrn_get_rect_src (const fgrn_Context *ctx_ptr, const fgrn_Rect *rect_dst_ptr, int pic_w, int pic_h, fgrn_Rect *rect_src_ptr)
+{
+	if (   ctx_ptr == nullptr || rect_dst_ptr == nullptr
+	    || rect_src_ptr == nullptr
+	    || ! fgrn_check_rect (*rect_dst_ptr, pic_w, pic_h))
+	{
+		return fgrn_Err_INVALID_ARG;
+	}
+
+	*rect_src_ptr = fgrn_compute_rect_src (*ctx_ptr, *rect_dst_ptr, pic_w, pic_h);
+
+	return fgrn_Err_OK;
+}
+
+
+
+// Renders the *rect_dst_ptr part of a picture of size pic_w * pic_h.
+// dst_ptr points on the part, src_ptr on the area given by
+// fgrn_get_rect_src(). The seed is the one of the whole picture.
+fgrn_EXPORT (int)	fgrn_process_rect (fgrn_Context *ctx_ptr, float *dst_ptr, ptrdiff_t dst_stride, const float *src_ptr, ptrdiff_t src_stride, const fgrn_Rect *rect_dst_ptr, int pic_w, int pic_h, uint32_t seed, int max_nbr_threads, fgrn_ParallelForPtr pfor_ptr, void *pool_data_ptr)
+{
+	if (   ctx_ptr == nullptr || dst_ptr == nullptr || src_ptr == nullptr
+	    || rect_dst_ptr == nullptr || max_nbr_threads <= 0
+	    || ! fgrn_check_rect (*rect_dst_ptr, pic_w, pic_h))
+	{
+		return fgrn_Err_INVALID_ARG;
+	}
+
+	auto &         ctx      = *ctx_ptr;
+	const auto &   rect_dst = *rect_dst_ptr;
+	const auto     rect_src = fgrn_compute_rect_src (ctx, rect_dst, pic_w, pic_h);
+	const int      ofs_x    = rect_dst.x - rect_src.x;
+	const int      ofs_y    = rect_dst.y - rect_src.y;
+	int            ret_val  = fgrn_Err_OK;
+	try
+	{
+		// The generator may write anywhere in the source area
+		const int      w = rect_src.w;
+		const int      h = rect_src.h;
+		ctx._tmp_arr.resize (size_t (w) * size_t (h));
+
+		constexpr int  tile_size = 16;
+		ctx._tile_mask.reset (w, h, tile_size, false);
+		ctx._tile_mask.set_area (
+			ofs_x, ofs_y, ofs_x + rect_dst.w, ofs_y + rect_dst.h
+		);
+
+		fgrn::GenGrain::PlaneArray plane_arr;
+		auto &         plane = plane_arr [0];
+		plane._dst_ptr    = ctx._tmp_arr.data ();
+		plane._src_ptr    = src_ptr;
+		plane._dst_stride = w;
+		plane._src_stride = src_stride;
+
+		const int      nbr_threads = ctx._gen.mt_start (
+			plane_arr, 1, w, h, *ctx._filter_sptr, seed, ctx._mode,
+			max_nbr_threads, &ctx._tile_mask, nullptr, 1, 0, 0,
+			rect_src.x, rect_src.y
+		);
+		ret_val = fgrn_run_passes (ctx, nbr_threads, pfor_ptr, pool_data_ptr);
+	}
+	catch (...)
+	{
+		ret_val = fgrn_Err_EXCEPTION;
+	}
+
+	if (ret_val == fgrn_Err_OK)
+	{
+		for (int y = 0; y < rect_dst.h; ++y)
+		{
+			memcpy (
+				dst_ptr + y * dst_stride,
+				ctx._tmp_arr.data () + (y + ofs_y) * rect_src.w + ofs_x,
+				size_t (rect_dst.w) * sizeof (*dst_ptr)
+			);
+		}
+	}
+
+	return ret_val;
+}
+
+
+
+/*\\\ EOF \\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\*/
@@ -0,0 +1,162 @@
+/*****************************************************************************
+
+        libfgrn.h
+        Author: Laurent de Soras, 2022
+
+	Public C interface of the film grain engine, for embedding it without a
+	frameserver.
+
+	Usage:
+	- Fill a fgrn_Param structure with fgrn_init_param() and change the
+	  required fields.
+	- Create a context with fgrn_create_context(). This builds the vision
+	  filter, which may take some time for large filters.
+	- Optionally check the memory required for a given picture size with
+	  fgrn_get_memory_needs().
+	- Call fgrn_process_plane() for each picture.
+	- Release the context with fgrn_destroy_context().
+
+	A picture can also be rendered in several parts, for example on
+	different machines. fgrn_get_rect_src() gives the source area required
+	to render a part, and fgrn_process_rect() renders the part from this
+	area. The result is identical to the same part of the whole picture
+	rendered with fgrn_process_plane() and the same seed.
+
+	Pictures are planes of 32-bit float values, nominal range [0 ; 1].
+	Strides are in pixels. The source and destination planes must not
+	overlap.
+
+	A context processes a single picture at once, but several contexts may
+	be used simultaneously from different threads.
+
+	Threading is handled by the caller through a parallel-for callback.
+	The callback must call task_ptr (task_data_ptr, i) once for each i in
+	[0 ; nbr_tasks - 1], in any order and from any thread, and return only
+	when all the calls are finished, with a memory fence (joining the tasks
+	with a standard synchronisation primitive is enough). It returns 0 on
+	success. The callback is called twice per picture at most.
+
+--- Legal stuff ---
+
+This program is free software. It comes without any warranty, to
+the extent permitted by applicable law. You can redistribute it
+and/or modify it under the terms of the Do What The Fuck You Want
+To Public License, Version 2, as published by Sam Hocevar. See
+http://sam.zoy.org/wtfpl/COPYING for more details.
+
+*Tab=3***********************************************************************/
+
+
+
+#if ! defined (fgrn_HEADER_INCLUDED)
+#define	fgrn_HEADER_INCLUDED
+
+#if defined (_MSC_VER)
+	#pragma once
+	#pragma warning (4 : 4250)
+#endif
+
+
+
+/*\\\ INCLUDE FILES \\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\*/
+
+#include <stddef.h>
+#include <stdint.h>
+
+
+
+/*\\\ PUBLIC \\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\*/
+
+
+
+#if defined (_WIN32) || defined (WIN32) || defined (__WIN32__) || defined (__CYGWIN__) || defined (__CYGWIN32__)
+ #define fgrn_CC __cdecl
+ #define fgrn_EXPORT(ret) __declspec(dllexport) ret fgrn_CC
+
+#else
+ #define fgrn_CC
+ #if defined (__GNUC__) && __GNUC__ >= 4
+  #define fgrn_EXPORT(ret) __attribute__((visibility("default"))) ret fgrn_CC
+ #else
+  #define fgrn_EXPORT(ret) ret fgrn_CC
+ #endif
+
+#endif
+
+
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+
+
+typedef	struct fgrn_Context	fgrn_Context;
+
+typedef	void (fgrn_CC *fgrn_TaskPtr) (void *task_data_ptr, int task_idx);
+typedef	int (fgrn_CC *fgrn_ParallelForPtr) (void *pool_data_ptr, fgrn_TaskPtr task_ptr, void *task_data_ptr, int nbr_tasks);
+
+enum
+{
+	fgrn_Mode_FULL = 0,
+	fgrn_Mode_DRAFT,
+	fgrn_Mode_STAT
+};
+
+typedef	struct fgrn_Param
+{
+	float          sigma;      // Vision filter radius, pixels, [0 ; 1]
+	int            res;        // Number of filter points, > 0
+	float          rad;        // Average grain radius, pixels, > 0
+	float          dev;        // Grain radius standard deviation, [0 ; 1]
+	int            mode;       // fgrn_Mode_*
+	int            cpu_opt;    // 0 = plain C++ only, 1 = any available SIMD
+}	fgrn_Param;
+
+enum
+{
+	fgrn_Err_OK = 0,
+
+	fgrn_Err_EXCEPTION = -999,
+	fgrn_Err_INVALID_ARG,
+	fgrn_Err_CALLBACK
+};
+
+// Rectangular part of a picture, in pixels
+typedef	struct fgrn_Rect
+{
+	int            x;
+	int            y;
+	int            w;
+	int            h;
+}	fgrn_Rect;
+
+enum {	fgrn_INTERFACE_VERSION = 1	};
+
+
+
+fgrn_EXPORT (int)   fgrn_get_interface_version (void);
+fgrn_EXPORT (void)  fgrn_init_param (fgrn_Param *param_ptr);
+fgrn_EXPORT (int)   fgrn_create_context (fgrn_Context **ctx_ptr_ptr, const fgrn_Param *param_ptr);
+fgrn_EXPORT (void)  fgrn_destroy_context (fgrn_Context *ctx_ptr);
+
+fgrn_EXPORT (int)   fgrn_get_memory_needs (const fgrn_Context *ctx_ptr, int w, int h, int max_nbr_threads, int64_t *size_ptr);
+fgrn_EXPORT (int)   fgrn_process_plane (fgrn_Context *ctx_ptr, float *dst_ptr, ptrdiff_t dst_stride, const float *src_ptr, ptrdiff_t src_stride, int w, int h, uint32_t seed, int max_nbr_threads, fgrn_ParallelForPtr pfor_ptr, void *pool_data_ptr);
+
+fgrn_EXPORT (int)   fgrn_get_rect_src (const fgrn_Context *ctx_ptr, const fgrn_Rect *rect_dst_ptr, int pic_w, int pic_h, fgrn_Rect *rect_src_ptr);
+fgrn_EXPORT (int)   fgrn_process_rect (fgrn_Context *ctx_ptr, float *dst_ptr, ptrdiff_t dst_stride, const float *src_ptr, ptrdiff_t src_stride, const fgrn_Rect *rect_dst_ptr, int pic_w, int pic_h, uint32_t seed, int max_nbr_threads, fgrn_ParallelForPtr pfor_ptr, void *pool_data_ptr);
+
+
+
+#ifdef __cplusplus
+}
+#endif
+
+
+
+#endif	// fgrn_HEADER_INCLUDED
+
+
+
+/*\\\ EOF \\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\*/
@@ -35,9 +35,12 @@ const char * __stdcall	AvisynthPluginInit3 (::IScriptEnvironment *env_ptr, const
 	AVS_linkage = vectors_ptr;
 
 	env_ptr->AddFunction (chkdravs_GRAIN,
-		"c"         "[sigma]f"  "[res]i" "[rad]f" //  0
-		"[dev]f"    "[seed]i"   "[cf]b"  "[cp]b"  //  4
-		"[draft]b"  "[cpuopt]i"
+		"c"         "[sigma]f"  "[res]i" "[rad]." //  0
+		"[dev]."    "[seed]i"   "[cf]b"  "[cp]b"  //  4
+		"[draft]."  "[cache]i"  "[cache_dir]s"    //  8
+		"[cache_dir_size]i"     "[weight]s"       // 11
+		"[scale]f"  "[transfer]s" "[amount]."     // 13
+		"[mask]c"   "[cpuopt]i"                   // 16
 		, &main_avs_create <chkdravs::Grain>, nullptr
 	);
 
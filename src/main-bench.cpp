@@ -0,0 +1,686 @@
+/*****************************************************************************
+
+        main-bench.cpp
+        Author: Laurent de Soras, 2022
+
+Benchmark of the grain generator. Renders synthetic pictures or a frame
+loaded from a file across sweeps of the grain parameters, and reports the
+durations of both passes in CSV or JSON on stdout.
+
+Each configuration is rendered a few times for warm-up, then timed over
+several repetitions. The reported times are the medians of the
+repetitions, in milliseconds. The vision filter is built before the timed
+runs, its construction time is reported separately.
+
+--- Legal stuff ---
+
+This program is free software. It comes without any warranty, to
+the extent permitted by applicable law. You can redistribute it
+and/or modify it under the terms of the Do What The Fuck You Want
+To Public License, Version 2, as published by Sam Hocevar. See
+http://sam.zoy.org/wtfpl/COPYING for more details.
+
+*Tab=3***********************************************************************/
+
+
+
+#if defined (_MSC_VER)
+	#pragma warning (4 : 4786 4800)
+#endif
+
+
+
+/*\\\ INCLUDE FILES \\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\*/
+
+#include "chkdr/CpuOptBase.h"
+#include "chkdr/GrainProc.h"
+#include "chkdrcli/FrameFormat.h"
+#include "chkdrcli/StreamProc.h"
+#include "fgrn/GenGrain.h"
+#include "fgrn/RenderMode.h"
+#include "fgrn/VisionFilter.h"
+#include "fstb/def.h"
+
+#include <algorithm>
+#include <chrono>
+#include <exception>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <cassert>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+
+
+/*\\\ FUNCTIONS \\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\*/
+
+
+
+class MainParam
+{
+public:
+	class Size
+	{
+	public:
+		int            _w = 0;
+		int            _h = 0;
+	};
+
+	std::vector <Size>
+	               _size_arr;
+	std::string    _pathname_src;
+	bool           _raw_flag    = false;
+	int            _raw_w       = 0;
+	int            _raw_h       = 0;
+	int            _nbr_threads = 0; // 0 = number of CPUs
+	int            _nbr_warmup  = 1;
+	int            _nbr_reps    = 3;
+	bool           _json_flag   = false;
+
+	std::vector <double>
+	               _sigma_arr   { 0.35 };
+	std::vector <double>
+	               _res_arr     { 1024 };
+	std::vector <double>
+	               _rad_arr     { 0.025 };
+	std::vector <double>
+	               _dev_arr     { 0 };
+	std::vector <double>
+	               _draft_arr   { 0 };
+	std::vector <double>
+	               _cpuopt_arr  { -1 }; // Any available
+};
+
+
+
+// Picture to render, single plane
+class Source
+{
+public:
+	std::string    _name;
+	int            _w = 0;
+	int            _h = 0;
+	std::vector <float>
+	               _pic;
+};
+
+
+
+// Result of a configuration, durations in ms
+class Result
+{
+public:
+	const Source * _src_ptr   = nullptr;
+	float          _sigma     = 0;
+	int            _res       = 0;
+	float          _rad       = 0;
+	float          _dev       = 0;
+	int            _draft     = 0;
+	int            _cpuopt    = 0;
+	int            _nbr_threads = 0;
+	double         _filter_ms = 0;
+	double         _pass1_ms  = 0;
+	double         _pass2_ms  = 0;
+	double         _total_ms  = 0;
+	double         _total_min_ms = 0;
+};
+
+
+
+static void	MAIN_print_usage ()
+{
+	fprintf (stderr,
+		"Usage: chickendreambench [options]\n"
+		"Times the grain rendering over sweeps of parameters. The results are\n"
+		"written to stdout, one line or object per configuration. Times are\n"
+		"medians in ms.\n"
+		"Lists are comma-separated, every combination is rendered.\n"
+		"\n"
+		"Pictures:\n"
+		"   --size <w>x<h>[,...]   Synthetic pictures (640x360, unless --input\n"
+		"                          is set)\n"
+		"   --input <file>         First plane of the first frame of a Y4M\n"
+		"                          stream (Cgrayf32 or Cgbrpf32) or a raw file\n"
+		"   --raw <w>x<h>          The input is a raw 32-bit float plane\n"
+		"\n"
+		"Sweeps:\n"
+		"   --sigma <float[,...]>  (0.35)\n"
+		"   --res <int[,...]>      (1024)\n"
+		"   --rad <float[,...]>    (0.025)\n"
+		"   --dev <float[,...]>    (0)\n"
+		"   --draft <0|1|2[,...]>  (0)\n"
+		"   --cpuopt <int[,...]>   (-1)\n"
+		"\n"
+		"Measurement:\n"
+		"   --threads <n>          Number of threads per pass (number of CPUs)\n"
+		"   --warmup <n>           Untimed runs per configuration (1)\n"
+		"   --reps <n>             Timed runs per configuration (3)\n"
+		"   --json                 JSON output instead of CSV\n"
+	);
+}
+
+
+
+static std::vector <double>	MAIN_parse_flt_list (const std::string &txt)
+{
+	std::vector <double> val_arr;
+	size_t         beg = 0;
+	do
+	{
+		const auto     end = txt.find (',', beg);
+		const auto     elt = txt.substr (beg, end - beg);
+		char *         end_0 = nullptr;
+		val_arr.push_back (strtod (elt.c_str (), &end_0));
+		if (elt.empty () || *end_0 != '\0')
+		{
+			throw std::invalid_argument ("invalid number list: " + txt);
+		}
+		beg = (end == std::string::npos) ? end : end + 1;
+	}
+	while (beg != std::string::npos);
+
+	return val_arr;
+}
+
+
+
+static int	MAIN_parse_int (const std::string &txt)
+{
+	char *         end_0 = nullptr;
+	const auto     val   = strtol (txt.c_str (), &end_0, 10);
+	if (txt.empty () || *end_0 != '\0')
+	{
+		throw std::invalid_argument ("invalid integer: " + txt);
+	}
+
+	return int (val);
+}
+
+
+
+static MainParam::Size	MAIN_parse_size (const std::string &txt)
+{
+	const auto     pos = txt.find ('x');
+	if (pos == std::string::npos)
+	{
+		throw std::invalid_argument ("expected <w>x<h>: " + txt);
+	}
+	MainParam::Size   size;
+	size._w = MAIN_parse_int (txt.substr (0, pos));
+	size._h = MAIN_parse_int (txt.substr (pos + 1));
+	if (size._w <= 0 || size._h <= 0)
+	{
+		throw std::invalid_argument ("invalid size: " + txt);
+	}
+
+	return size;
+}
+
+
+
+static void	MAIN_parse_cmd_line (MainParam &param, int argc, char *argv [])
+{
+	for (int arg_pos = 1; arg_pos < argc; ++arg_pos)
+	{
+		const std::string opt = argv [arg_pos];
+		if (opt == "--json")
+		{
+			param._json_flag = true;
+			continue;
+		}
+
+		// All the other options take a value
+		if (arg_pos + 1 >= argc)
+		{
+			throw std::invalid_argument ("missing value for " + opt);
+		}
+		const std::string val = argv [++ arg_pos];
+
+		if (opt == "--size")
+		{
+			size_t         beg = 0;
+			do
+			{
+				const auto     end = val.find (',', beg);
+				param._size_arr.push_back (
+					MAIN_parse_size (val.substr (beg, end - beg))
+				);
+				beg = (end == std::string::npos) ? end : end + 1;
+			}
+			while (beg != std::string::npos);
+		}
+		else if (opt == "--raw")
+		{
+			const auto     size = MAIN_parse_size (val);
+			param._raw_flag = true;
+			param._raw_w    = size._w;
+			param._raw_h    = size._h;
+		}
+		else if (opt == "--input")   { param._pathname_src = val; }
+		else if (opt == "--threads") { param._nbr_threads = MAIN_parse_int (val); }
+		else if (opt == "--warmup")  { param._nbr_warmup  = MAIN_parse_int (val); }
+		else if (opt == "--reps")    { param._nbr_reps    = MAIN_parse_int (val); }
+		else if (opt == "--sigma")   { param._sigma_arr   = MAIN_parse_flt_list (val); }
+		else if (opt == "--res")     { param._res_arr     = MAIN_parse_flt_list (val); }
+		else if (opt == "--rad")     { param._rad_arr     = MAIN_parse_flt_list (val); }
+		else if (opt == "--dev")     { param._dev_arr     = MAIN_parse_flt_list (val); }
+		else if (opt == "--draft")   { param._draft_arr   = MAIN_parse_flt_list (val); }
+		else if (opt == "--cpuopt")  { param._cpuopt_arr  = MAIN_parse_flt_list (val); }
+		else
+		{
+			throw std::invalid_argument ("unknown option " + opt);
+		}
+	}
+
+	if (param._nbr_warmup < 0 || param._nbr_reps < 1)
+	{
+		throw std::invalid_argument ("warmup must be >= 0 and reps >= 1.");
+	}
+	if (param._size_arr.empty () && param._pathname_src.empty ())
+	{
+		param._size_arr.push_back ({ 640, 360 });
+	}
+}
+
+
+
+// Same rules as the plug-in, for a single grain layer
+static void	MAIN_check_param (const MainParam &param)
+{
+	for (auto sigma : param._sigma_arr)
+	{
+		if (! chkdr::GrainProc::check_sigma (float (sigma)))
+		{
+			throw std::invalid_argument ("sigma must be in range [0 ; 1].");
+		}
+	}
+	for (auto res : param._res_arr)
+	{
+		if (! chkdr::GrainProc::check_res (int (res)))
+		{
+			throw std::invalid_argument ("res must be > 0.");
+		}
+	}
+	for (auto rad : param._rad_arr)
+	{
+		if (! chkdr::GrainProc::check_rad (float (rad)))
+		{
+			throw std::invalid_argument ("rad must be > 0.");
+		}
+	}
+	for (auto dev : param._dev_arr)
+	{
+		if (! chkdr::GrainProc::check_dev (float (dev)))
+		{
+			throw std::invalid_argument ("dev must be in range [0 ; 1]");
+		}
+	}
+	// The atlas is not rendered by the generator
+	for (auto draft : param._draft_arr)
+	{
+		if (   ! chkdr::GrainProc::check_mode (int (draft))
+		    || int (draft) == fgrn::RenderMode_ATLAS)
+		{
+			throw std::invalid_argument ("draft must be in range [0 ; 2]");
+		}
+	}
+}
+
+
+
+// Smooth gradients with some detail, covering the whole range
+static Source	MAIN_build_synth (int w, int h)
+{
+	Source         src;
+	src._name = "synth";
+	src._w    = w;
+	src._h    = h;
+	src._pic.resize (size_t (w) * size_t (h));
+	for (int y = 0; y < h; ++y)
+	{
+		const double   ry = double (y) / double (h);
+		for (int x = 0; x < w; ++x)
+		{
+			const double   rx = double (x) / double (w);
+			const double   v  =
+				  0.5 * rx + 0.3 * ry
+				+ 0.1 * sin (rx * 40) * cos (ry * 25);
+			src._pic [size_t (y) * w + x] = float (std::min (std::max (v, 0.0), 1.0));
+		}
+	}
+
+	return src;
+}
+
+
+
+// Only the first plane is kept
+static Source	MAIN_load_src (const MainParam &param)
+{
+	FILE *         f_ptr = fopen (param._pathname_src.c_str (), "rb");
+	if (f_ptr == nullptr)
+	{
+		throw std::runtime_error ("cannot open " + param._pathname_src);
+	}
+	std::unique_ptr <FILE, decltype (&fclose)> f_uptr (f_ptr, &fclose);
+
+	chkdrcli::FrameFormat fmt;
+	if (param._raw_flag)
+	{
+		fmt._w = param._raw_w;
+		fmt._h = param._raw_h;
+	}
+	else
+	{
+		std::string    line;
+		if (   ! chkdrcli::StreamProc::read_line (line, *f_ptr)
+		    || ! fmt.parse_y4m_header (line)
+		    || ! chkdrcli::StreamProc::read_line (line, *f_ptr)
+		    || line.compare (
+		       	0, strlen (chkdrcli::FrameFormat::_y4m_frame_0),
+		       	chkdrcli::FrameFormat::_y4m_frame_0
+		       ) != 0)
+		{
+			throw std::runtime_error (
+				"invalid Y4M stream, or colorspace not Cgrayf32 or Cgbrpf32."
+			);
+		}
+	}
+
+	Source         src;
+	src._name = param._pathname_src;
+	src._w    = fmt._w;
+	src._h    = fmt._h;
+	src._pic.resize (size_t (fmt.get_plane_size ()));
+	if (fread (src._pic.data (), sizeof (float), src._pic.size (), f_ptr)
+	    != src._pic.size ())
+	{
+		throw std::runtime_error ("truncated frame in " + param._pathname_src);
+	}
+
+	return src;
+}
+
+
+
+typedef std::chrono::high_resolution_clock MAIN_ClkType;
+
+static double	MAIN_get_duration_ms (MAIN_ClkType::time_point t_beg, MAIN_ClkType::time_point t_end)
+{
+	return std::chrono::duration <double, std::milli> (t_end - t_beg).count ();
+}
+
+
+
+// Runs a pass on nbr_threads threads, the calling one included
+template <void (fgrn::GenGrain::*PROC) (int)>
+static void	MAIN_run_pass (fgrn::GenGrain &gen, int nbr_threads)
+{
+	std::vector <std::thread> thread_arr;
+	for (int t_cnt = 1; t_cnt < nbr_threads; ++t_cnt)
+	{
+		thread_arr.emplace_back ([&gen, t_cnt] () { (gen.*PROC) (t_cnt); });
+	}
+	(gen.*PROC) (0);
+	for (auto &thread : thread_arr)
+	{
+		thread.join ();
+	}
+}
+
+
+
+static double	MAIN_compute_median (std::vector <double> val_arr)
+{
+	assert (! val_arr.empty ());
+
+	std::sort (val_arr.begin (), val_arr.end ());
+	const auto     len = val_arr.size ();
+
+	return (val_arr [(len - 1) / 2] + val_arr [len / 2]) * 0.5;
+}
+
+
+
+static Result	MAIN_bench_config (const MainParam &param, const Source &src, float sigma, int res, float rad, float dev, int draft, int cpuopt, int max_nbr_threads)
+{
+	Result         result;
+	result._src_ptr = &src;
+	result._sigma   = sigma;
+	result._res     = res;
+	result._rad     = rad;
+	result._dev     = dev;
+	result._draft   = draft;
+	result._cpuopt  = cpuopt;
+
+	chkdr::CpuOptBase cpu_opt;
+	cpu_opt.set_level (static_cast <chkdr::CpuOptBase::Level> (
+		cpuopt & chkdr::CpuOptBase::Level_MASK
+	));
+	fgrn::GenGrain gen (cpu_opt.has_sse2 (), cpu_opt.has_avx ());
+
+	const auto     t_flt = MAIN_ClkType::now ();
+	const fgrn::VisionFilter   filter (sigma, res, rad, dev);
+	result._filter_ms = MAIN_get_duration_ms (t_flt, MAIN_ClkType::now ());
+
+	const auto     mode = static_cast <fgrn::RenderMode> (draft);
+	std::vector <float> dst (src._pic.size ());
+	std::vector <double> pass1_arr;
+	std::vector <double> pass2_arr;
+	std::vector <double> total_arr;
+	const int      nbr_runs = param._nbr_warmup + param._nbr_reps;
+	for (int run_cnt = 0; run_cnt < nbr_runs; ++run_cnt)
+	{
+		// mt_start() is part of the pass 1
+		const auto     t_beg = MAIN_ClkType::now ();
+		const int      nbr_threads = gen.mt_start (
+			dst.data (), src._pic.data (), src._w, src._h, src._w, src._w,
+			filter, 12345, mode, max_nbr_threads
+		);
+		MAIN_run_pass <&fgrn::GenGrain::mt_proc_pass1> (gen, nbr_threads);
+		const auto     t_mid = MAIN_ClkType::now ();
+		if (mode != fgrn::RenderMode_DRAFT)
+		{
+			gen.mt_prepare_pass2 ();
+			MAIN_run_pass <&fgrn::GenGrain::mt_proc_pass2> (gen, nbr_threads);
+		}
+		const auto     t_end = MAIN_ClkType::now ();
+
+		result._nbr_threads = nbr_threads;
+		if (run_cnt >= param._nbr_warmup)
+		{
+			pass1_arr.push_back (MAIN_get_duration_ms (t_beg, t_mid));
+			pass2_arr.push_back (MAIN_get_duration_ms (t_mid, t_end));
+			total_arr.push_back (MAIN_get_duration_ms (t_beg, t_end));
+		}
+	}
+
+	result._pass1_ms     = MAIN_compute_median (pass1_arr);
+	result._pass2_ms     = MAIN_compute_median (pass2_arr);
+	result._total_ms     = MAIN_compute_median (total_arr);
+	result._total_min_ms =
+		*std::min_element (total_arr.begin (), total_arr.end ());
+
+	return result;
+}
+
+
+
+// Escapes the characters of a JSON string, or doubles the quotes for CSV
+static std::string	MAIN_quote (const std::string &txt, bool json_flag)
+{
+	std::string    res = "\"";
+	for (const char c : txt)
+	{
+		if (c == '"')
+		{
+			res += (json_flag) ? "\\\"" : "\"\"";
+		}
+		else if (c == '\\' && json_flag)
+		{
+			res += "\\\\";
+		}
+		else if (uint8_t (c) >= 0x20)
+		{
+			res += c;
+		}
+	}
+	res += '"';
+
+	return res;
+}
+
+
+
+static void	MAIN_print_result (const Result &result, bool json_flag, bool first_flag)
+{
+	const Source & src    = *result._src_ptr;
+	const double   mpix_s = (result._total_ms > 0)
+		? double (src._w) * double (src._h) * 1e-3 / result._total_ms
+		: 0.0;
+
+	if (json_flag)
+	{
+		printf (
+			"%s\n  {\"source\": %s, \"w\": %d, \"h\": %d, "
+			"\"sigma\": %g, \"res\": %d, \"rad\": %g, \"dev\": %g, "
+			"\"draft\": %d, \"cpuopt\": %d, \"threads\": %d, "
+			"\"filter_ms\": %.3f, \"pass1_ms\": %.3f, \"pass2_ms\": %.3f, "
+			"\"total_ms\": %.3f, \"total_min_ms\": %.3f, \"mpix_s\": %.4f}",
+			(first_flag) ? "" : ",",
+			MAIN_quote (src._name, true).c_str (), src._w, src._h,
+			result._sigma, result._res, result._rad, result._dev,
+			result._draft, result._cpuopt, result._nbr_threads,
+			result._filter_ms, result._pass1_ms, result._pass2_ms,
+			result._total_ms, result._total_min_ms, mpix_s
+		);
+	}
+	else
+	{
+		printf (
+			"%s,%d,%d,%g,%d,%g,%g,%d,%d,%d,%.3f,%.3f,%.3f,%.3f,%.3f,%.4f\n",
+			MAIN_quote (src._name, false).c_str (), src._w, src._h,
+			result._sigma, result._res, result._rad, result._dev,
+			result._draft, result._cpuopt, result._nbr_threads,
+			result._filter_ms, result._pass1_ms, result._pass2_ms,
+			result._total_ms, result._total_min_ms, mpix_s
+		);
+	}
+	fflush (stdout);
+}
+
+
+
+static int	MAIN_run (int argc, char *argv [])
+{
+	MainParam      param;
+	MAIN_parse_cmd_line (param, argc, argv);
+	MAIN_check_param (param);
+
+	std::vector <Source> src_arr;
+	for (const auto &size : param._size_arr)
+	{
+		src_arr.push_back (MAIN_build_synth (size._w, size._h));
+	}
+	if (! param._pathname_src.empty ())
+	{
+		src_arr.push_back (MAIN_load_src (param));
+	}
+
+	int            nbr_threads = param._nbr_threads;
+	if (nbr_threads <= 0)
+	{
+		nbr_threads = std::max (int (std::thread::hardware_concurrency ()), 1);
+	}
+
+	if (param._json_flag)
+	{
+		printf ("[");
+	}
+	else
+	{
+		printf (
+			"source,w,h,sigma,res,rad,dev,draft,cpuopt,threads,"
+			"filter_ms,pass1_ms,pass2_ms,total_ms,total_min_ms,mpix_s\n"
+		);
+	}
+
+	bool           first_flag = true;
+	for (const auto &src : src_arr)
+	{
+		for (auto sigma : param._sigma_arr)
+		{
+			for (auto res : param._res_arr)
+			{
+				for (auto rad : param._rad_arr)
+				{
+					for (auto dev : param._dev_arr)
+					{
+						for (auto draft : param._draft_arr)
+						{
+							for (auto cpuopt : param._cpuopt_arr)
+							{
+								const auto     result = MAIN_bench_config (
+									param, src, float (sigma), int (res),
+									float (rad), float (dev), int (draft),
+									int (cpuopt), nbr_threads
+								);
+								MAIN_print_result (
+									result, param._json_flag, first_flag
+								);
+								first_flag = false;
+							}
+						}
+					}
+				}
+			}
+		}
+	}
+
+	if (param._json_flag)
+	{
+		printf ("\n]\n");
+	}
+
+	return 0;
+}
+
+
+
+int main (int argc, char *argv [])
+{
+	int            ret_val = 0;
+
+	try
+	{
+		ret_val = MAIN_run (argc, argv);
+	}
+	catch (std::invalid_argument &e)
+	{
+		fprintf (stderr, "chickendreambench: %s\n\n", e.what ());
+		MAIN_print_usage ();
+		ret_val = 1;
+	}
+	catch (std::exception &e)
+	{
+		fprintf (stderr, "chickendreambench: %s\n", e.what ());
+		ret_val = 2;
+	}
+	catch (...)
+	{
+		fprintf (stderr, "chickendreambench: unexpected exception.\n");
+		ret_val = 2;
+	}
+
+	return ret_val;
+}
+
+
+
+/*\\\ EOF \\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\*/
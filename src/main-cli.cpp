@@ -0,0 +1,547 @@
+/*****************************************************************************
+
+        main-cli.cpp
+        Author: Laurent de Soras, 2022
+
+Command-line renderer. Reads a stream of 32-bit float planar frames (raw or
+Y4M) from a file or stdin, adds grain and writes the result to stdout.
+
+--- Legal stuff ---
+
+This program is free software. It comes without any warranty, to
+the extent permitted by applicable law. You can redistribute it
+and/or modify it under the terms of the Do What The Fuck You Want
+To Public License, Version 2, as published by Sam Hocevar. See
+http://sam.zoy.org/wtfpl/COPYING for more details.
+
+*Tab=3***********************************************************************/
+
+
+
+#if defined (_MSC_VER)
+	#pragma warning (4 : 4786 4800)
+#endif
+
+
+
+/*\\\ INCLUDE FILES \\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\*/
+
+#include "chkdr/CpuOptBase.h"
+#include "chkdr/GrainProc.h"
+#include "chkdrcli/FrameFormat.h"
+#include "chkdrcli/ShmRender.h"
+#include "chkdrcli/StreamProc.h"
+#include "fstb/def.h"
+
+#if fstb_SYS == fstb_SYS_WIN
+	#include <fcntl.h>
+	#include <io.h>
+#endif
+
+#include <algorithm>
+#include <chrono>
+#include <exception>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+
+
+/*\\\ FUNCTIONS \\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\*/
+
+
+
+class MainParam
+{
+public:
+	std::string    _pathname_src;
+	std::string    _pathname_dst;
+	bool           _raw_flag   = false;
+	int            _raw_w      = 0;
+	int            _raw_h      = 0;
+	int            _nbr_planes = 1;
+	int            _nbr_threads = 0; // 0 = number of CPUs
+	int            _nbr_procs  = 0; // 0 = no worker process
+	bool           _verbose_flag = true;
+
+	float          _sigma      = 0.35f;
+	int            _res        = 1024;
+	std::vector <double>
+	               _rad_arr    { 0.025 };
+	std::vector <double>
+	               _dev_arr    { 0 };
+	std::vector <double>
+	               _wgt_arr    { 1 };
+	float          _scale      = 1;
+	std::string    _transfer   = "linear";
+	std::vector <double>
+	               _amt_arr    { 1 };
+	uint32_t       _seed       = 12345;
+	bool           _cf_flag    = false;
+	bool           _cp_flag    = false;
+	int            _mode       = fgrn::RenderMode_FULL;
+	int            _cache      = -1; // MiB, -1 = default for the mode and cf
+	std::string    _cache_dir;
+	int            _cache_dir_size = chkdr::GrainProc::_def_cache_dir_size_mib;
+	int            _cpuopt     = chkdr::CpuOptBase::Level_ANY_AVAILABLE;
+};
+
+
+
+static void	MAIN_print_usage ()
+{
+	fprintf (stderr,
+		"Usage: chickendreamcli [options] [input]\n"
+		"Adds film grain to a stream of 32-bit float planar frames.\n"
+		"The input is a Y4M stream (Cgrayf32 or Cgbrpf32) or raw frames, read\n"
+		"from a file or from stdin when missing or \"-\". The result is written\n"
+		"in the same format to stdout.\n"
+		"\n"
+		"Stream options:\n"
+		"   -o <file>              Output file instead of stdout\n"
+		"   --raw <w>x<h>          Raw input frames of the given size\n"
+		"   --planes <1|3>         Number of planes per raw frame (1)\n"
+		"   --threads <n>          Number of frames rendered simultaneously\n"
+		"                          (number of CPUs)\n"
+		"   --procs <n>            Renders each frame with n worker processes\n"
+		"                          sharing the frames in memory (POSIX only,\n"
+		"                          requires scale = 1)\n"
+		"   --quiet                No per-frame timings on stderr\n"
+		"\n"
+		"Grain options (see the plug-in documentation):\n"
+		"   --sigma <float>        (0.35)\n"
+		"   --res <int>            (1024)\n"
+		"   --rad <float[,...]>    (0.025)\n"
+		"   --dev <float[,...]>    (0)\n"
+		"   --weight <float[,...]> (1)\n"
+		"   --scale <float>        (1)\n"
+		"   --transfer <name>      (linear)\n"
+		"   --amount <float[,float]> (1)\n"
+		"   --seed <int>           (12345)\n"
+		"   --cf <0|1>             (0)\n"
+		"   --cp <0|1>             (0)\n"
+		"   --draft <0|1|2>        (0)\n"
+		"   --cache <MiB>          (128 for draft = 0 and cf = 1, else 0)\n"
+		"   --cache_dir <dir>      (none)\n"
+		"   --cache_dir_size <MiB> (4096)\n"
+		"   --cpuopt <int>         (-1)\n"
+	);
+}
+
+
+
+static std::vector <double>	MAIN_parse_flt_list (const std::string &txt)
+{
+	std::vector <double> val_arr;
+	size_t         beg = 0;
+	do
+	{
+		const auto     end = txt.find (',', beg);
+		const auto     elt = txt.substr (beg, end - beg);
+		char *         end_0 = nullptr;
+		val_arr.push_back (strtod (elt.c_str (), &end_0));
+		if (elt.empty () || *end_0 != '\0')
+		{
+			throw std::invalid_argument ("invalid number list: " + txt);
+		}
+		beg = (end == std::string::npos) ? end : end + 1;
+	}
+	while (beg != std::string::npos);
+
+	return val_arr;
+}
+
+
+
+static double	MAIN_parse_flt (const std::string &txt)
+{
+	const auto     val_arr = MAIN_parse_flt_list (txt);
+	if (val_arr.size () != 1)
+	{
+		throw std::invalid_argument ("invalid number: " + txt);
+	}
+
+	return val_arr.front ();
+}
+
+
+
+static int	MAIN_parse_int (const std::string &txt)
+{
+	char *         end_0 = nullptr;
+	const auto     val   = strtol (txt.c_str (), &end_0, 10);
+	if (txt.empty () || *end_0 != '\0')
+	{
+		throw std::invalid_argument ("invalid integer: " + txt);
+	}
+
+	return int (val);
+}
+
+
+
+static void	MAIN_parse_cmd_line (MainParam &param, int argc, char *argv [])
+{
+	for (int arg_pos = 1; arg_pos < argc; ++arg_pos)
+	{
+		const std::string opt = argv [arg_pos];
+		if (opt == "--quiet")
+		{
+			param._verbose_flag = false;
+			continue;
+		}
+		if (opt.empty () || opt [0] != '-' || opt == "-")
+		{
+			if (! param._pathname_src.empty ())
+			{
+				throw std::invalid_argument ("more than one input.");
+			}
+			param._pathname_src = opt;
+			continue;
+		}
+
+		// All the other options take a value
+		if (arg_pos + 1 >= argc)
+		{
+			throw std::invalid_argument ("missing value for " + opt);
+		}
+		const std::string val = argv [++ arg_pos];
+
+		if (opt == "-o")
+		{
+			param._pathname_dst = val;
+		}
+		else if (opt == "--raw")
+		{
+			const auto     pos = val.find ('x');
+			if (pos == std::string::npos)
+			{
+				throw std::invalid_argument ("--raw: expected <w>x<h>.");
+			}
+			param._raw_flag = true;
+			param._raw_w    = MAIN_parse_int (val.substr (0, pos));
+			param._raw_h    = MAIN_parse_int (val.substr (pos + 1));
+		}
+		else if (opt == "--planes")         { param._nbr_planes  = MAIN_parse_int (val); }
+		else if (opt == "--threads")        { param._nbr_threads = MAIN_parse_int (val); }
+		else if (opt == "--procs")          { param._nbr_procs   = MAIN_parse_int (val); }
+		else if (opt == "--sigma")          { param._sigma   = float (MAIN_parse_flt (val)); }
+		else if (opt == "--res")            { param._res     = MAIN_parse_int (val); }
+		else if (opt == "--rad")            { param._rad_arr = MAIN_parse_flt_list (val); }
+		else if (opt == "--dev")            { param._dev_arr = MAIN_parse_flt_list (val); }
+		else if (opt == "--weight")         { param._wgt_arr = MAIN_parse_flt_list (val); }
+		else if (opt == "--scale")          { param._scale   = float (MAIN_parse_flt (val)); }
+		else if (opt == "--transfer")       { param._transfer = val; }
+		else if (opt == "--amount")         { param._amt_arr = MAIN_parse_flt_list (val); }
+		else if (opt == "--seed")           { param._seed    = uint32_t (MAIN_parse_int (val)); }
+		else if (opt == "--cf")             { param._cf_flag = (MAIN_parse_int (val) != 0); }
+		else if (opt == "--cp")             { param._cp_flag = (MAIN_parse_int (val) != 0); }
+		else if (opt == "--draft")          { param._mode    = MAIN_parse_int (val); }
+		else if (opt == "--cache")          { param._cache   = MAIN_parse_int (val); }
+		else if (opt == "--cache_dir")      { param._cache_dir = val; }
+		else if (opt == "--cache_dir_size") { param._cache_dir_size = MAIN_parse_int (val); }
+		else if (opt == "--cpuopt")         { param._cpuopt  = MAIN_parse_int (val); }
+		else
+		{
+			throw std::invalid_argument ("unknown option " + opt);
+		}
+	}
+}
+
+
+
+// Same rules as the plug-in
+static std::unique_ptr <chkdr::GrainProc>	MAIN_create_proc (const MainParam &param)
+{
+	if (! chkdr::GrainProc::check_sigma (param._sigma))
+	{
+		throw std::invalid_argument ("sigma must be in range [0 ; 1].");
+	}
+	if (! chkdr::GrainProc::check_res (param._res))
+	{
+		throw std::invalid_argument ("res must be > 0.");
+	}
+	const int      nbr_layers = int (param._rad_arr.size ());
+	if (nbr_layers < 1 || nbr_layers > chkdr::GrainProc::_max_nbr_layers)
+	{
+		throw std::invalid_argument ("rad must have 1 to 3 elements.");
+	}
+	if (   int (param._dev_arr.size ()) > nbr_layers
+	    || int (param._wgt_arr.size ()) > nbr_layers)
+	{
+		throw std::invalid_argument (
+			"dev and weight cannot have more elements than rad."
+		);
+	}
+	chkdr::GrainProc::LayerArray layer_arr;
+	for (int l_idx = 0; l_idx < nbr_layers; ++l_idx)
+	{
+		const int      d_idx = std::min (l_idx, int (param._dev_arr.size ()) - 1);
+		const int      w_idx = std::min (l_idx, int (param._wgt_arr.size ()) - 1);
+		auto &         layer = layer_arr [l_idx];
+		layer._rad_avg    = float (param._rad_arr [l_idx]);
+		layer._rad_stddev = float (param._dev_arr [d_idx]);
+		layer._weight     = float (param._wgt_arr [w_idx]);
+		if (! chkdr::GrainProc::check_rad (layer._rad_avg))
+		{
+			throw std::invalid_argument ("rad must be > 0.");
+		}
+		if (! chkdr::GrainProc::check_dev (layer._rad_stddev))
+		{
+			throw std::invalid_argument ("dev must be in range [0 ; 1]");
+		}
+	}
+	if (! chkdr::GrainProc::check_weights (layer_arr, nbr_layers))
+	{
+		throw std::invalid_argument ("weight must be >= 0, with a positive sum.");
+	}
+	// The atlas mode requires a frameserver to select the output frames
+	if (   ! chkdr::GrainProc::check_mode (param._mode)
+	    || param._mode == fgrn::RenderMode_ATLAS)
+	{
+		throw std::invalid_argument ("draft must be in range [0 ; 2]");
+	}
+	if (! chkdr::GrainProc::check_nbr_layers (nbr_layers, param._mode))
+	{
+		throw std::invalid_argument ("several grain layers require draft = 0.");
+	}
+	if (! chkdr::GrainProc::check_scale (param._scale))
+	{
+		throw std::invalid_argument ("scale must be in range [0.125 ; 8].");
+	}
+	if (! chkdr::GrainProc::check_scale_mode (param._scale, param._mode, nbr_layers))
+	{
+		throw std::invalid_argument (
+			"scale requires draft = 0 and a single grain layer."
+		);
+	}
+	const int      curve = fgrn::Transfer::find_curve (param._transfer);
+	if (! chkdr::GrainProc::check_transfer (curve))
+	{
+		throw std::invalid_argument (
+			"transfer must be linear, srgb, bt1886 or pq."
+		);
+	}
+	if (param._amt_arr.size () > 2)
+	{
+		throw std::invalid_argument ("amount must have 1 or 2 elements.");
+	}
+	const auto     amount_blk = float (param._amt_arr.front ());
+	const auto     amount_wht = float (param._amt_arr.back ());
+	if (   ! chkdr::GrainProc::check_amount (amount_blk)
+	    || ! chkdr::GrainProc::check_amount (amount_wht))
+	{
+		throw std::invalid_argument ("amount must be in range [0 ; 1].");
+	}
+	if (! chkdr::GrainProc::check_amount_mode (
+		amount_blk, amount_wht, param._mode, param._scale
+	))
+	{
+		throw std::invalid_argument ("amount < 1 requires scale = 1.");
+	}
+	const int      cache = (param._cache >= 0) ? param._cache
+		: chkdr::GrainProc::compute_def_cache_size (param._mode, param._cf_flag);
+	if (! chkdr::GrainProc::check_cache_size (cache))
+	{
+		throw std::invalid_argument ("cache must be >= 0.");
+	}
+	if (! chkdr::GrainProc::check_cache_dir (param._cache_dir))
+	{
+		throw std::invalid_argument ("cache_dir must be an existing directory.");
+	}
+	if (! chkdr::GrainProc::check_cache_size (param._cache_dir_size))
+	{
+		throw std::invalid_argument ("cache_dir_size must be >= 0.");
+	}
+
+	chkdr::CpuOptBase cpu_opt;
+	cpu_opt.set_level (static_cast <chkdr::CpuOptBase::Level> (
+		param._cpuopt & chkdr::CpuOptBase::Level_MASK
+	));
+
+	return std::make_unique <chkdr::GrainProc> (
+		param._sigma, param._res, param._scale, layer_arr, nbr_layers,
+		param._seed, param._cf_flag, param._cp_flag,
+		static_cast <fgrn::RenderMode> (param._mode),
+		static_cast <fgrn::Transfer::Curve> (curve),
+		amount_blk, amount_wht,
+		int64_t (cache) << 20,
+		param._cache_dir, int64_t (param._cache_dir_size) << 20,
+		cpu_opt.has_sse2 (), cpu_opt.has_avx ()
+	);
+}
+
+
+
+static void	MAIN_close_file (FILE *f_ptr)
+{
+	if (f_ptr != nullptr && f_ptr != stdin && f_ptr != stdout)
+	{
+		fclose (f_ptr);
+	}
+}
+
+
+
+typedef std::unique_ptr <FILE, decltype (&MAIN_close_file)> FileUPtr;
+
+static FileUPtr	MAIN_open_file (const std::string &pathname, bool write_flag)
+{
+	FILE *         f_ptr = nullptr;
+	if (pathname.empty () || pathname == "-")
+	{
+		f_ptr = (write_flag) ? stdout : stdin;
+#if fstb_SYS == fstb_SYS_WIN
+		_setmode (_fileno (f_ptr), _O_BINARY);
+#endif
+	}
+	else
+	{
+		f_ptr = fopen (pathname.c_str (), (write_flag) ? "wb" : "rb");
+		if (f_ptr == nullptr)
+		{
+			throw std::runtime_error ("cannot open " + pathname);
+		}
+	}
+
+	return FileUPtr (f_ptr, &MAIN_close_file);
+}
+
+
+
+static int	MAIN_run (int argc, char *argv [])
+{
+	MainParam      param;
+	MAIN_parse_cmd_line (param, argc, argv);
+	auto           proc_uptr = MAIN_create_proc (param);
+	if (param._nbr_procs < 0)
+	{
+		throw std::invalid_argument ("procs must be >= 0.");
+	}
+	if (param._nbr_procs > 0)
+	{
+#if fstb_SYS == fstb_SYS_WIN
+		throw std::invalid_argument ("procs is not available on this system.");
+#else
+		if (! chkdr::GrainProc::check_rect_mode (param._mode, param._scale))
+		{
+			throw std::invalid_argument ("procs requires scale = 1.");
+		}
+#endif
+	}
+
+	auto           f_src_uptr = MAIN_open_file (param._pathname_src, false);
+	chkdrcli::FrameFormat fmt_src;
+	if (param._raw_flag)
+	{
+		fmt_src._w          = param._raw_w;
+		fmt_src._h          = param._raw_h;
+		fmt_src._nbr_planes = param._nbr_planes;
+		if (! fmt_src.is_valid ())
+		{
+			throw std::invalid_argument (
+				"invalid raw frame size or number of planes."
+			);
+		}
+	}
+	else
+	{
+		std::string    line;
+		if (   ! chkdrcli::StreamProc::read_line (line, *f_src_uptr)
+		    || ! fmt_src.parse_y4m_header (line))
+		{
+			throw std::runtime_error (
+				"invalid Y4M stream, or colorspace not Cgrayf32 or Cgbrpf32."
+			);
+		}
+	}
+
+	auto           fmt_dst = fmt_src;
+	fmt_dst._w = chkdr::GrainProc::compute_scaled_size (fmt_src._w, param._scale);
+	fmt_dst._h = chkdr::GrainProc::compute_scaled_size (fmt_src._h, param._scale);
+
+	auto           f_dst_uptr = MAIN_open_file (param._pathname_dst, true);
+	if (fmt_dst._y4m_flag)
+	{
+		fprintf (f_dst_uptr.get (), "%s\n", fmt_dst.build_y4m_header ().c_str ());
+	}
+
+	int            nbr_threads = param._nbr_threads;
+	if (nbr_threads <= 0)
+	{
+		nbr_threads = std::max (int (std::thread::hardware_concurrency ()), 1);
+	}
+
+	// The worker processes are forked before any thread is started
+	chkdrcli::ShmRender * shm_ptr = nullptr;
+#if fstb_SYS != fstb_SYS_WIN
+	std::unique_ptr <chkdrcli::ShmRender> shm_uptr;
+	if (param._nbr_procs > 0)
+	{
+		shm_uptr = std::make_unique <chkdrcli::ShmRender> (
+			*proc_uptr, fmt_src, param._nbr_procs
+		);
+		shm_ptr     = shm_uptr.get ();
+		nbr_threads = 1;
+	}
+#endif
+
+	typedef std::chrono::high_resolution_clock ClkType;
+	const auto     t_beg = ClkType::now ();
+	chkdrcli::StreamProc stream_proc (
+		*proc_uptr, fmt_src, fmt_dst, *f_src_uptr, *f_dst_uptr,
+		nbr_threads, param._verbose_flag, shm_ptr
+	);
+	stream_proc.run ();
+	const auto     dur = std::chrono::duration <double> (
+		ClkType::now () - t_beg
+	).count ();
+
+	const int      nbr_frames = stream_proc.get_nbr_frames ();
+	fprintf (
+		stderr, "%d frames, %.3f s, %.2f fps\n",
+		nbr_frames, dur, (dur > 0) ? double (nbr_frames) / dur : 0.0
+	);
+
+	return 0;
+}
+
+
+
+int main (int argc, char *argv [])
+{
+	int            ret_val = 0;
+
+	try
+	{
+		ret_val = MAIN_run (argc, argv);
+	}
+	catch (std::invalid_argument &e)
+	{
+		fprintf (stderr, "chickendreamcli: %s\n\n", e.what ());
+		MAIN_print_usage ();
+		ret_val = 1;
+	}
+	catch (std::exception &e)
+	{
+		fprintf (stderr, "chickendreamcli: %s\n", e.what ());
+		ret_val = 2;
+	}
+	catch (...)
+	{
+		fprintf (stderr, "chickendreamcli: unexpected exception.\n");
+		ret_val = 2;
+	}
+
+	return ret_val;
+}
+
+
+
+/*\\\ EOF \\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\*/
@@ -15,7 +15,9 @@ http://sam.zoy.org/wtfpl/COPYING for more details.
 
 
 
+#include "chkdrvs/Density.h"
 #include "chkdrvs/Grain.h"
+#include "chkdrvs/Render.h"
 #include "chkdrvs/version.h"
 #include "fstb/def.h"
 #include "vsutl/Redirect.h"
@@ -41,15 +43,47 @@ VS_EXTERNAL_API (void) VapourSynthPluginInit2 (::VSPlugin *plugin_ptr, const ::V
 		"clip:vnode;"
 		"sigma:float:opt;"
 		"res:int:opt;"
+		"rad:float[]:opt;"
+		"dev:float[]:opt;"
+		"weight:float[]:opt;"
+		"scale:float:opt;"
+		"seed:int:opt;"
+		"cf:int:opt;"
+		"cp:int:opt;"
+		"draft:int:opt;"
+		"cache:int:opt;"
+		"cache_dir:data:opt;"
+		"cache_dir_size:int:opt;"
+		"transfer:data:opt;"
+		"amount:float[]:opt;"
+		"mask:vnode:opt;"
+		"cpuopt:int:opt;"
+	,	"clip:vnode;"
+	,	&vsutl::Redirect <chkdrvs::Grain>::create, nullptr, plugin_ptr
+	);
+
+	api_ptr->registerFunction ("density",
+		"clip:vnode;"
 		"rad:float:opt;"
 		"dev:float:opt;"
 		"seed:int:opt;"
 		"cf:int:opt;"
 		"cp:int:opt;"
+		"cpuopt:int:opt;"
+	,	"clip:vnode;"
+	,	&vsutl::Redirect <chkdrvs::Density>::create, nullptr, plugin_ptr
+	);
+
+	api_ptr->registerFunction ("render",
+		"clip:vnode;"
+		"sigma:float:opt;"
+		"res:int:opt;"
+		"rad:float:opt;"
+		"dev:float:opt;"
 		"draft:int:opt;"
 		"cpuopt:int:opt;"
 	,	"clip:vnode;"
-	,	&vsutl::Redirect <chkdrvs::Grain>::create, nullptr, plugin_ptr
+	,	&vsutl::Redirect <chkdrvs::Render>::create, nullptr, plugin_ptr
 	);
 }
 
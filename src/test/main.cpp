@@ -23,15 +23,32 @@ http://www.wtfpl.net/ for more details.
 
 /*\\\ INCLUDE FILES \\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\*/
 
+#include "chkdr/DensityProc.h"
+#include "chkdr/GrainProc.h"
+#include "chkdrcli/FrameFormat.h"
+#include "chkdrcli/ShmRender.h"
 #include "fstb/def.h"
 #include "fstb/fnc.h"
 #include "fgrn/GenGrain.h"
+#include "fgrn/RenderMode.h"
+#include "fgrn/RenderStats.h"
+#include "fgrn/SplConv.h"
+#include "fgrn/SplFmt.h"
+#include "fgrn/Transfer.h"
 #include "fgrn/UtilPrng.h"
 #include "fgrn/VisionFilter.h"
+#include "fgrn/VisionFilterPool.h"
+#include "libfgrn.h"
 
 #if defined (_MSC_VER)
 #include <crtdbg.h>
+#include <direct.h>
 #include <new.h>
+#include <sys/utime.h>
+#else
+#include <sys/stat.h>
+#include <unistd.h>
+#include <utime.h>
 #endif   // _MSC_VER
 
 #include <algorithm>
@@ -39,12 +56,16 @@ http://www.wtfpl.net/ for more details.
 #include <chrono>
 #include <iostream>
 #include <new>
+#include <string>
+#include <thread>
+#include <type_traits>
 #include <vector>
 
 #include <cassert>
 #include <cmath>
 #include <cstdint>
 #include <cstdio>
+#include <cstring>
 
 
 
@@ -377,6 +398,2614 @@ void	save_linear_pic (int w, int h, const std::vector <float> &pic_l)
 
 
 
+class PicStat
+{
+public:
+	double         _avg  = 0;
+	double         _dev  = 0;
+	double         _corr = 0; // Correlation between horizontally adjacent pixels
+};
+
+// Statistics on a rectangular area of a picture
+PicStat	compute_pic_stat (const std::vector <float> &pic, int stride, int x_beg, int y_beg, int w, int h)
+{
+	double         sum  = 0;
+	double         sum2 = 0;
+	double         sumx = 0;
+	for (int y = y_beg; y < y_beg + h; ++y)
+	{
+		for (int x = x_beg; x < x_beg + w; ++x)
+		{
+			const double   v = pic [y * stride + x];
+			sum  += v;
+			sum2 += v * v;
+			if (x + 1 < x_beg + w)
+			{
+				sumx += v * pic [y * stride + x + 1];
+			}
+		}
+	}
+
+	PicStat        st;
+	const double   n   = double (w * h);
+	const double   n_x = double ((w - 1) * h);
+	st._avg = sum / n;
+	const auto     var = std::max (sum2 / n - st._avg * st._avg, 1e-12);
+	st._dev  = sqrt (var);
+	st._corr = (sumx / n_x - st._avg * st._avg) / var;
+
+	return st;
+}
+
+
+
+double	get_duration_s (std::chrono::high_resolution_clock::time_point t_beg, std::chrono::high_resolution_clock::time_point t_end)
+{
+	typedef std::chrono::high_resolution_clock ClkType;
+	return
+		  double ((t_end - t_beg).count ())
+		* double (ClkType::period::num)
+		/ double (ClkType::period::den);
+}
+
+
+
+// Checks that the statistical renderer gives output statistics close to the
+// full renderer. The bands are tall enough to estimate the neighbour
+// correlation within about 0.01. Returns the number of failed checks.
+int	test_stat_engine ()
+{
+	printf ("Statistical rendering engine vs full rendering...\n");
+
+	constexpr int  nbr_bands = 4;
+	constexpr int  band_w    = 48;
+	constexpr int  w         = nbr_bands * band_w;
+	constexpr int  h         = 512;
+	constexpr int  margin    = 4; // Excludes the band borders from the stats
+	const std::array <float, nbr_bands> lum_arr {{ 0.05f, 0.2f, 0.5f, 0.8f }};
+
+	std::vector <float> pic_s (w * h);
+	for (int y = 0; y < h; ++y)
+	{
+		for (int x = 0; x < w; ++x)
+		{
+			pic_s [y * w + x] = lum_arr [x / band_w];
+		}
+	}
+	auto           pic_full = pic_s;
+	auto           pic_stat = pic_s;
+
+	int            nbr_err = 0;
+	typedef std::chrono::high_resolution_clock ClkType;
+	ClkType        clk;
+	fgrn::GenGrain grain_gen (true, false);
+	for (float sigma : { 0.f, 0.35f })
+	{
+		const fgrn::VisionFilter   vf (sigma, 256, 0.1f, 0.f);
+
+		const auto     t_0 = clk.now ();
+		grain_gen.process (
+			pic_full.data (), pic_s.data (), w, h, w, w, vf, 12345,
+			fgrn::RenderMode_FULL
+		);
+		const auto     t_1 = clk.now ();
+		grain_gen.process (
+			pic_stat.data (), pic_s.data (), w, h, w, w, vf, 12345,
+			fgrn::RenderMode_STAT
+		);
+		const auto     t_2 = clk.now ();
+		printf (
+			"sigma = %.2f, full: %.3f s, stat: %.3f s\n", sigma,
+			get_duration_s (t_0, t_1), get_duration_s (t_1, t_2)
+		);
+
+		for (int b_cnt = 0; b_cnt < nbr_bands; ++b_cnt)
+		{
+			const auto     x_beg = b_cnt * band_w + margin;
+			const auto     bw    = band_w - 2 * margin;
+			const auto     st_f  = compute_pic_stat (pic_full, w, x_beg, 0, bw, h);
+			const auto     st_s  = compute_pic_stat (pic_stat, w, x_beg, 0, bw, h);
+			const auto     dev_r = st_s._dev / st_f._dev;
+			// The statistical engine is unbiased, its average must match the
+			// source level. The full renderer ignores the grains from the
+			// neighbouring cells when sigma = 0, so it underestimates the
+			// coverage and is used as a reference only when sigma > 0.
+			const auto     lum     = double (lum_arr [b_cnt]);
+			const auto     tol_avg = 0.001 + 0.01 * lum;
+			const bool     ok_flag =
+				   std::abs (st_s._avg - lum) < tol_avg
+				&& (sigma == 0 || std::abs (st_s._avg - st_f._avg) < tol_avg)
+				&& dev_r > 0.8 && dev_r < 1.25
+				&& std::abs (st_s._corr - st_f._corr) < 0.05;
+			printf (
+				"lum %.2f: avg %.4f / %.4f, dev %.4f / %.4f, corr %+.3f / %+.3f %s\n",
+				lum_arr [b_cnt],
+				st_f._avg , st_s._avg,
+				st_f._dev , st_s._dev,
+				st_f._corr, st_s._corr,
+				ok_flag ? "" : "*** Error ***"
+			);
+			if (! ok_flag)
+			{
+				++ nbr_err;
+			}
+		}
+	}
+	printf ("\n");
+
+	return nbr_err;
+}
+
+
+
+// Rendering with a variable grain radius should cost about the same as with
+// a constant radius, and give the same average level.
+int	test_radius_dev ()
+{
+	printf ("Variable vs constant grain radius...\n");
+
+	constexpr int  w   = 128;
+	constexpr int  h   = 128;
+	constexpr float   lum = 0.25f;
+	const std::vector <float> pic_s (w * h, lum);
+	auto           pic_d = pic_s;
+
+	int            nbr_err = 0;
+	typedef std::chrono::high_resolution_clock ClkType;
+	ClkType        clk;
+	constexpr int  nbr_runs = 3;
+	fgrn::GenGrain grain_gen (true, false);
+	std::array <double, 2> dur_arr {};
+	int            dev_idx = 0;
+	for (float dev : { 0.f, 0.25f })
+	{
+		const fgrn::VisionFilter   vf (0.35f, 256, 0.05f, dev);
+
+		// Best of several runs
+		double         dur = 1e9;
+		for (int run = 0; run < nbr_runs; ++run)
+		{
+			const auto     t_beg = clk.now ();
+			grain_gen.process (
+				pic_d.data (), pic_s.data (), w, h, w, w, vf, 12345,
+				fgrn::RenderMode_FULL
+			);
+			const auto     t_end = clk.now ();
+			dur = std::min (dur, get_duration_s (t_beg, t_end));
+		}
+		dur_arr [dev_idx] = dur;
+		++ dev_idx;
+
+		const auto     st      = compute_pic_stat (pic_d, w, 0, 0, w, h);
+		const bool     ok_flag = (std::abs (st._avg - lum) < 0.01);
+		printf (
+			"dev = %.2f: %.3f s, avg %.4f %s\n",
+			dev, dur, st._avg,
+			ok_flag ? "" : "*** Error ***"
+		);
+		if (! ok_flag)
+		{
+			++ nbr_err;
+		}
+	}
+
+	// The larger grains reach more cells, so some overhead is expected.
+	constexpr double  max_ratio = 1.5;
+	const auto     ratio    = dur_arr [1] / dur_arr [0];
+	const bool     spd_flag = (ratio < max_ratio);
+	printf (
+		"Variable/constant time ratio: %.2f (max %.2f) %s\n\n",
+		ratio, max_ratio, spd_flag ? "" : "*** Error ***"
+	);
+	if (! spd_flag)
+	{
+		++ nbr_err;
+	}
+
+	return nbr_err;
+}
+
+
+
+// Joint rendering of 3 planes with the same seed must give exactly the same
+// result as separate renderings.
+int	test_joint_planes ()
+{
+	printf ("Joint vs separate plane rendering...\n");
+
+	constexpr int  nbr_planes = 3;
+	constexpr int  w = 96;
+	constexpr int  h = 64;
+
+	// Horizontal, vertical and diagonal gradients
+	std::array <std::vector <float>, nbr_planes> src_arr;
+	std::array <std::vector <float>, nbr_planes> dst_sep_arr;
+	std::array <std::vector <float>, nbr_planes> dst_jnt_arr;
+	for (int p_idx = 0; p_idx < nbr_planes; ++p_idx)
+	{
+		auto &         src = src_arr [p_idx];
+		src.resize (w * h);
+		for (int y = 0; y < h; ++y)
+		{
+			for (int x = 0; x < w; ++x)
+			{
+				const auto     rx = float (x) / float (w - 1);
+				const auto     ry = float (y) / float (h - 1);
+				const auto     v  =
+					  (p_idx == 0) ? rx
+					: (p_idx == 1) ? ry
+					:                (rx + ry) * 0.5f;
+				src [y * w + x] = v;
+			}
+		}
+		dst_sep_arr [p_idx].resize (w * h);
+		dst_jnt_arr [p_idx].resize (w * h);
+	}
+
+	int            nbr_err = 0;
+	typedef std::chrono::high_resolution_clock ClkType;
+	ClkType        clk;
+	for (float dev : { 0.f, 0.25f })
+	{
+		const fgrn::VisionFilter   vf (0.35f, 256, 0.05f, dev);
+		fgrn::GenGrain grain_gen (true, false);
+
+		const auto     t_0 = clk.now ();
+		for (int p_idx = 0; p_idx < nbr_planes; ++p_idx)
+		{
+			grain_gen.process (
+				dst_sep_arr [p_idx].data (), src_arr [p_idx].data (),
+				w, h, w, w, vf, 12345, fgrn::RenderMode_FULL
+			);
+		}
+		const auto     t_1 = clk.now ();
+		fgrn::GenGrain::PlaneArray plane_arr;
+		for (int p_idx = 0; p_idx < nbr_planes; ++p_idx)
+		{
+			auto &         plane = plane_arr [p_idx];
+			plane._dst_ptr    = dst_jnt_arr [p_idx].data ();
+			plane._src_ptr    = src_arr [p_idx].data ();
+			plane._dst_stride = w;
+			plane._src_stride = w;
+		}
+		grain_gen.process (
+			plane_arr, nbr_planes, w, h, vf, 12345, fgrn::RenderMode_FULL
+		);
+		const auto     t_2 = clk.now ();
+
+		const bool     ok_flag = (dst_sep_arr == dst_jnt_arr);
+		printf (
+			"dev = %.2f, separate: %.3f s, joint: %.3f s %s\n",
+			dev, get_duration_s (t_0, t_1), get_duration_s (t_1, t_2),
+			ok_flag ? "" : "*** Error ***"
+		);
+		if (! ok_flag)
+		{
+			++ nbr_err;
+		}
+	}
+	printf ("\n");
+
+	return nbr_err;
+}
+
+
+
+// Identical planes of a frame rendered jointly should be rendered once and
+// copied, with the same result as separate renderings. Gray pictures must
+// render about 3 times faster than separately, and clearly faster than
+// pictures with 3 distinct planes. Timings are the best of a few runs,
+// after a warm-up.
+int	test_duplicate_planes ()
+{
+	printf ("Duplicate plane detection...\n");
+
+	constexpr int  nbr_planes = 3;
+	constexpr int  w          = 96;
+	constexpr int  h          = 64;
+	constexpr auto stride     = ptrdiff_t (w * sizeof (float));
+
+	// Horizontal gradients: plain, mirrored and sheared. They have the same
+	// values on each row, so their rendering costs are comparable.
+	// Variant 0 is gray (R = G = B), variant 1 has a different blue plane
+	// and variant 2 has 3 distinct planes.
+	const auto     gen_plane = [] (std::vector <float> &pic, int type) {
+		pic.resize (w * h);
+		for (int y = 0; y < h; ++y)
+		{
+			for (int x = 0; x < w; ++x)
+			{
+				const int      xs =
+					  (type == 0) ? x
+					: (type == 1) ? w - 1 - x
+					:               (x + y) % w;
+				pic [y * w + x] = float (xs) / float (w - 1);
+			}
+		}
+	};
+	const std::array <std::array <int, nbr_planes>, 3> type_arr {{
+		{{ 0, 0, 0 }}, {{ 0, 0, 1 }}, {{ 0, 1, 2 }}
+	}};
+
+	constexpr int  nbr_runs = 5;
+	int            nbr_err = 0;
+	typedef std::chrono::high_resolution_clock ClkType;
+	ClkType        clk;
+	std::array <double, 3> dur_sep_arr {};
+	std::array <double, 3> dur_jnt_arr {};
+	for (int t_idx = 0; t_idx < int (type_arr.size ()); ++t_idx)
+	{
+		const auto &   types = type_arr [t_idx];
+		std::array <std::vector <float>, nbr_planes> src_arr;
+		std::array <std::vector <float>, nbr_planes> dst_sep_arr;
+		std::array <std::vector <float>, nbr_planes> dst_jnt_arr;
+		chkdr::GrainProc::DstPtrArray dst_ptr_arr {};
+		chkdr::GrainProc::SrcPtrArray src_ptr_arr {};
+		chkdr::GrainProc::StrideArray stride_arr {};
+		for (int p_idx = 0; p_idx < nbr_planes; ++p_idx)
+		{
+			gen_plane (src_arr [p_idx], types [p_idx]);
+			dst_sep_arr [p_idx].resize (w * h);
+			dst_jnt_arr [p_idx].resize (w * h);
+			dst_ptr_arr [p_idx] =
+				reinterpret_cast <uint8_t *> (dst_jnt_arr [p_idx].data ());
+			src_ptr_arr [p_idx] =
+				reinterpret_cast <const uint8_t *> (src_arr [p_idx].data ());
+			stride_arr [p_idx]  = stride;
+		}
+
+		chkdr::GrainProc  proc_sep (
+			0.35f, 256, 0.05f, 0, 12345, false, true, fgrn::RenderMode_FULL,
+			0, "", 0, true, false
+		);
+		chkdr::GrainProc  proc_jnt (
+			0.35f, 256, 0.05f, 0, 12345, false, true, fgrn::RenderMode_FULL,
+			0, "", 0, true, false
+		);
+
+		auto &         dur_sep = dur_sep_arr [t_idx];
+		auto &         dur_jnt = dur_jnt_arr [t_idx];
+		dur_sep = 1e9;
+		dur_jnt = 1e9;
+		for (int run = 0; run <= nbr_runs; ++run)
+		{
+			const auto     t_0 = clk.now ();
+			for (int p_idx = 0; p_idx < nbr_planes; ++p_idx)
+			{
+				proc_sep.process_plane (
+					reinterpret_cast <uint8_t *> (dst_sep_arr [p_idx].data ()),
+					stride, src_ptr_arr [p_idx], stride, w, h, 0, p_idx
+				);
+			}
+			const auto     t_1 = clk.now ();
+			proc_jnt.process_frame (
+				dst_ptr_arr, stride_arr, src_ptr_arr, stride_arr, w, h, 0, nbr_planes
+			);
+			const auto     t_2 = clk.now ();
+
+			// Run 0 is the warm-up
+			if (run > 0)
+			{
+				dur_sep = std::min (dur_sep, get_duration_s (t_0, t_1));
+				dur_jnt = std::min (dur_jnt, get_duration_s (t_1, t_2));
+			}
+		}
+
+		const bool     ok_flag = (dst_sep_arr == dst_jnt_arr);
+		printf (
+			"Planes %d %d %d, separate: %.3f s, joint: %.3f s %s\n",
+			types [0], types [1], types [2], dur_sep, dur_jnt,
+			ok_flag ? "" : "*** Error ***"
+		);
+		if (! ok_flag)
+		{
+			++ nbr_err;
+		}
+	}
+
+	// Speed-up of the gray picture, with a safety margin
+	const double   gain_sep = dur_sep_arr [0] / dur_jnt_arr [0];
+	const double   gain_jnt = dur_jnt_arr [2] / dur_jnt_arr [0];
+	const bool     fast_flag = (gain_sep >= 2.0 && gain_jnt >= 1.25);
+	printf (
+		"Gray speed-up: %.2f vs separate, %.2f vs distinct planes %s\n",
+		gain_sep, gain_jnt, fast_flag ? "" : "*** Error ***"
+	);
+	if (! fast_flag)
+	{
+		++ nbr_err;
+	}
+	printf ("\n");
+
+	return nbr_err;
+}
+
+
+
+// Two-stage rendering: grain count maps from DensityProc, then
+// GrainProc::process_density(). The result must match the single-stage
+// rendering for all the modes using the grain counts.
+int	test_density_split ()
+{
+	printf ("Split rendering (density + render)...\n");
+
+	constexpr int  nbr_planes = 3;
+	constexpr int  w          = 96;
+	constexpr int  h          = 64;
+	constexpr auto stride     = ptrdiff_t (w * sizeof (float));
+	constexpr auto stride_q   = ptrdiff_t (w * sizeof (int32_t));
+	constexpr int  frame_idx  = 3;
+
+	std::array <std::vector <float>, nbr_planes> src_arr;
+	for (int p_idx = 0; p_idx < nbr_planes; ++p_idx)
+	{
+		auto &         pic = src_arr [p_idx];
+		pic.resize (w * h);
+		for (int y = 0; y < h; ++y)
+		{
+			for (int x = 0; x < w; ++x)
+			{
+				pic [y * w + x] = float ((x + y * (p_idx + 1)) % w) / float (w);
+			}
+		}
+	}
+
+	const std::array <fgrn::RenderMode, 3> mode_arr {{
+		fgrn::RenderMode_FULL, fgrn::RenderMode_DRAFT, fgrn::RenderMode_STAT
+	}};
+	const std::array <bool, 2> cp_arr {{ true, false }};
+
+	int            nbr_err = 0;
+	for (const auto mode : mode_arr)
+	{
+		for (const bool cp_flag : cp_arr)
+		{
+			chkdr::GrainProc  proc_ref (
+				0.35f, 256, 0.05f, 0.25f, 12345, false, cp_flag, mode,
+				0, "", 0, true, false
+			);
+			chkdr::DensityProc   proc_den (
+				0.05f, 0.25f, 12345, false, cp_flag, true
+			);
+			chkdr::GrainProc  proc_ren (
+				0.35f, 256, 0.05f, 0.25f, 0, false, false, mode,
+				0, "", 0, true, false
+			);
+
+			std::array <std::vector <float>, nbr_planes> dst_ref_arr;
+			std::array <std::vector <float>, nbr_planes> dst_spl_arr;
+			std::array <std::vector <int32_t>, nbr_planes> q_arr;
+			chkdr::GrainProc::DstPtrArray dst_ptr_arr {};
+			chkdr::GrainProc::SrcPtrArray q_ptr_arr {};
+			chkdr::GrainProc::StrideArray stride_arr {};
+			chkdr::GrainProc::StrideArray stride_q_arr {};
+			chkdr::GrainProc::SeedArray   seed_arr {};
+			for (int p_idx = 0; p_idx < nbr_planes; ++p_idx)
+			{
+				dst_ref_arr [p_idx].resize (w * h);
+				dst_spl_arr [p_idx].resize (w * h);
+				q_arr [p_idx].resize (w * h);
+				const auto     src_ptr =
+					reinterpret_cast <const uint8_t *> (src_arr [p_idx].data ());
+				proc_ref.process_plane (
+					reinterpret_cast <uint8_t *> (dst_ref_arr [p_idx].data ()),
+					stride, src_ptr, stride, w, h, frame_idx, p_idx
+				);
+				proc_den.process_plane (
+					reinterpret_cast <uint8_t *> (q_arr [p_idx].data ()),
+					stride_q, src_ptr, stride, w, h, frame_idx, p_idx
+				);
+				dst_ptr_arr [p_idx]  =
+					reinterpret_cast <uint8_t *> (dst_spl_arr [p_idx].data ());
+				q_ptr_arr [p_idx]    =
+					reinterpret_cast <const uint8_t *> (q_arr [p_idx].data ());
+				stride_arr [p_idx]   = stride;
+				stride_q_arr [p_idx] = stride_q;
+				seed_arr [p_idx]     = proc_den.compute_seed (frame_idx, p_idx);
+			}
+			proc_ren.process_density (
+				dst_ptr_arr, stride_arr, q_ptr_arr, stride_q_arr,
+				w, h, seed_arr, nbr_planes
+			);
+
+			const bool     ok_flag = (dst_ref_arr == dst_spl_arr);
+			printf (
+				"Mode %d, cp %d %s\n", int (mode), int (cp_flag),
+				ok_flag ? "" : "*** Error ***"
+			);
+			if (! ok_flag)
+			{
+				++ nbr_err;
+			}
+		}
+	}
+	printf ("\n");
+
+	return nbr_err;
+}
+
+
+
+// Multi-layer rendering, compared with the weighted sum of single layer
+// renderings. Each layer keeps its own seed and radius distribution, so the
+// results must match, including the layer with varying radii.
+int	test_layers ()
+{
+	printf ("Multi-layer grain...\n");
+
+	constexpr int  w          = 96;
+	constexpr int  h          = 64;
+	constexpr auto stride     = ptrdiff_t (w * sizeof (float));
+	constexpr int  nbr_layers = 3;
+	constexpr int  frame_idx  = 2;
+	constexpr auto seed       = uint32_t (12345);
+
+	std::vector <float> src (w * h);
+	for (int y = 0; y < h; ++y)
+	{
+		for (int x = 0; x < w; ++x)
+		{
+			src [y * w + x] = float (x + y) / float (w + h - 2);
+		}
+	}
+	const auto     src_ptr = reinterpret_cast <const uint8_t *> (src.data ());
+
+	chkdr::GrainProc::LayerArray layer_arr;
+	layer_arr [0] = { 0.03f, 0, 2 };
+	layer_arr [1] = { 0.08f, 0.2f, 1 };
+	layer_arr [2] = { 0.15f, 0, 1 };
+	float          w_sum = 0;
+	for (int l_idx = 0; l_idx < nbr_layers; ++l_idx)
+	{
+		w_sum += layer_arr [l_idx]._weight;
+	}
+
+	typedef std::chrono::high_resolution_clock ClkType;
+	ClkType        clk;
+	constexpr int  nbr_runs = 5;
+
+	// Stacked single layers
+	std::vector <std::unique_ptr <chkdr::GrainProc> > proc_uptr_arr;
+	for (int l_idx = 0; l_idx < nbr_layers; ++l_idx)
+	{
+		const auto &   layer = layer_arr [l_idx];
+		proc_uptr_arr.emplace_back (new chkdr::GrainProc (
+			0.35f, 256, layer._rad_avg, layer._rad_stddev,
+			fgrn::GenGrain::compute_layer_seed (seed, l_idx), false, false,
+			fgrn::RenderMode_FULL, 0, "", 0, true, false
+		));
+	}
+	std::vector <float> dst_ref (w * h);
+	std::vector <float> dst_tmp (w * h);
+	std::array <double, nbr_layers> dur_lay_arr;
+	dur_lay_arr.fill (1e9);
+	for (int run = 0; run <= nbr_runs; ++run)
+	{
+		std::fill (dst_ref.begin (), dst_ref.end (), 0.f);
+		for (int l_idx = 0; l_idx < nbr_layers; ++l_idx)
+		{
+			const auto     t_0 = clk.now ();
+			proc_uptr_arr [l_idx]->process_plane (
+				reinterpret_cast <uint8_t *> (dst_tmp.data ()), stride,
+				src_ptr, stride, w, h, frame_idx, 0
+			);
+			const auto     t_1 = clk.now ();
+			if (run > 0)
+			{
+				dur_lay_arr [l_idx] =
+					std::min (dur_lay_arr [l_idx], get_duration_s (t_0, t_1));
+			}
+			const auto     weight = layer_arr [l_idx]._weight / w_sum;
+			for (int pos = 0; pos < w * h; ++pos)
+			{
+				dst_ref [pos] += weight * dst_tmp [pos];
+			}
+		}
+	}
+
+	// Single pass
+	std::vector <float> dst_lay (w * h);
+	chkdr::GrainProc  proc (
+		0.35f, 256, 1, layer_arr, nbr_layers, seed, false, false,
+		fgrn::RenderMode_FULL, fgrn::Transfer::Curve_LINEAR, 1, 1, 0, "", 0, true, false
+	);
+	double         dur_one = 1e9;
+	for (int run = 0; run <= nbr_runs; ++run)
+	{
+		const auto     t_0 = clk.now ();
+		proc.process_plane (
+			reinterpret_cast <uint8_t *> (dst_lay.data ()), stride,
+			src_ptr, stride, w, h, frame_idx, 0
+		);
+		const auto     t_1 = clk.now ();
+		if (run > 0)
+		{
+			dur_one = std::min (dur_one, get_duration_s (t_0, t_1));
+		}
+	}
+	double         dur_stk = 0;
+	for (int l_idx = 0; l_idx < nbr_layers; ++l_idx)
+	{
+		printf ("Layer %d: %.3f s\n", l_idx, dur_lay_arr [l_idx]);
+		dur_stk += dur_lay_arr [l_idx];
+	}
+
+	float          err_max = 0;
+	for (int pos = 0; pos < w * h; ++pos)
+	{
+		err_max = std::max (err_max, std::abs (dst_lay [pos] - dst_ref [pos]));
+	}
+	const bool     ok_flag = (err_max < 1e-6f);
+	printf (
+		"Stacked: %.3f s, single pass: %.3f s, max error: %g %s\n\n",
+		dur_stk, dur_one, err_max,
+		ok_flag ? "" : "*** Error ***"
+	);
+
+	return ok_flag ? 0 : -1;
+}
+
+
+
+// Upscales a picture while rendering the grain, and compares it with the
+// resize-then-grain approach: pixel replication of the source, then
+// rendering of grains scaled by the same factor. Local averages of both
+// results should follow the source.
+int	test_output_scale ()
+{
+	printf ("Output scaling...\n");
+
+	constexpr int  w      = 96;
+	constexpr int  h      = 64;
+	constexpr int  scale  = 2;
+	constexpr int  w_dst  = w * scale;
+	constexpr int  h_dst  = h * scale;
+	constexpr auto rad    = 0.05f;
+	constexpr auto seed   = uint32_t (12345);
+	constexpr int  blk    = 16; // Block size for the local averages, output pixels
+
+	std::vector <float> src (w * h);
+	for (int y = 0; y < h; ++y)
+	{
+		for (int x = 0; x < w; ++x)
+		{
+			src [y * w + x] = float (x + y) / float (w + h - 2);
+		}
+	}
+	std::vector <float> src_up (w_dst * h_dst);
+	for (int y = 0; y < h_dst; ++y)
+	{
+		for (int x = 0; x < w_dst; ++x)
+		{
+			src_up [y * w_dst + x] = src [(y / scale) * w + x / scale];
+		}
+	}
+
+	typedef std::chrono::high_resolution_clock ClkType;
+	ClkType        clk;
+	constexpr int  nbr_runs = 10;
+
+	// Direct rendering at the output size
+	std::vector <float> dst_scl (w_dst * h_dst);
+	chkdr::GrainProc  proc_scl (
+		0.35f, 256, float (scale), chkdr::GrainProc::LayerArray { { { rad, 0, 1 } } },
+		1, seed, false, false, fgrn::RenderMode_FULL,
+		fgrn::Transfer::Curve_LINEAR, 1, 1, 0, "", 0, true, false
+	);
+	assert (chkdr::GrainProc::compute_scaled_size (w, float (scale)) == w_dst);
+	assert (chkdr::GrainProc::compute_scaled_size (h, float (scale)) == h_dst);
+	double         dur_scl = 1e9;
+	for (int run = 0; run <= nbr_runs; ++run)
+	{
+		const auto     t_0 = clk.now ();
+		proc_scl.process_plane (
+			reinterpret_cast <uint8_t *> (dst_scl.data ()), w_dst * sizeof (float),
+			reinterpret_cast <const uint8_t *> (src.data ()), w * sizeof (float),
+			w, h, 0, 0
+		);
+		const auto     t_1 = clk.now ();
+		if (run > 0)
+		{
+			dur_scl = std::min (dur_scl, get_duration_s (t_0, t_1));
+		}
+	}
+
+	// Resize, then grain
+	std::vector <float> dst_ref (w_dst * h_dst);
+	chkdr::GrainProc  proc_ref (
+		0.35f, 256, rad * scale, 0, seed, false, false,
+		fgrn::RenderMode_FULL, 0, "", 0, true, false
+	);
+	double         dur_ref = 1e9;
+	for (int run = 0; run <= nbr_runs; ++run)
+	{
+		const auto     t_0 = clk.now ();
+		proc_ref.process_plane (
+			reinterpret_cast <uint8_t *> (dst_ref.data ()), w_dst * sizeof (float),
+			reinterpret_cast <const uint8_t *> (src_up.data ()), w_dst * sizeof (float),
+			w_dst, h_dst, 0, 0
+		);
+		const auto     t_1 = clk.now ();
+		if (run > 0)
+		{
+			dur_ref = std::min (dur_ref, get_duration_s (t_0, t_1));
+		}
+	}
+
+	// Block averages
+	double         err_scl = 0;
+	double         err_ref = 0;
+	for (int by = 0; by < h_dst; by += blk)
+	{
+		for (int bx = 0; bx < w_dst; bx += blk)
+		{
+			double         sum_src = 0;
+			double         sum_scl = 0;
+			double         sum_ref = 0;
+			for (int y = by; y < by + blk; ++y)
+			{
+				for (int x = bx; x < bx + blk; ++x)
+				{
+					const int      pos = y * w_dst + x;
+					sum_src += src_up [pos];
+					sum_scl += dst_scl [pos];
+					sum_ref += dst_ref [pos];
+				}
+			}
+			err_scl = std::max (err_scl, std::abs (sum_scl - sum_src));
+			err_ref = std::max (err_ref, std::abs (sum_ref - sum_src));
+		}
+	}
+	err_scl /= blk * blk;
+	err_ref /= blk * blk;
+	const bool     acc_flag = (err_scl < 0.03 && err_ref < 0.03);
+	// Rendering the grain at the output size should cost less than resizing
+	// first.
+	const bool     spd_flag = (dur_scl < dur_ref);
+	const bool     ok_flag  = (acc_flag && spd_flag);
+	printf (
+		"Scaled: %.3f s, resize + grain: %.3f s %s\n"
+		"Max block error, scaled: %.4f, resize + grain: %.4f %s\n\n",
+		dur_scl, dur_ref,
+		spd_flag ? "" : "*** Error ***",
+		err_scl, err_ref,
+		acc_flag ? "" : "*** Error ***"
+	);
+
+	return ok_flag ? 0 : -1;
+}
+
+
+
+// Parallel-for callback for the C API: one thread per task
+static int fgrn_CC	test_c_api_pfor (void *pool_data_ptr, fgrn_TaskPtr task_ptr, void *task_data_ptr, int nbr_tasks)
+{
+	auto &         cnt = *static_cast <int *> (pool_data_ptr);
+	++ cnt;
+
+	std::vector <std::thread> thread_arr;
+	for (int t_idx = 0; t_idx < nbr_tasks; ++t_idx)
+	{
+		thread_arr.emplace_back (task_ptr, task_data_ptr, t_idx);
+	}
+	for (auto &t : thread_arr)
+	{
+		t.join ();
+	}
+
+	return 0;
+}
+
+
+
+// Renders a picture through the C API, with and without a caller-supplied
+// thread pool, and checks it against the single-thread C++ interface.
+int	test_c_api ()
+{
+	printf ("C API...\n");
+
+	constexpr int  w      = 150;
+	constexpr int  h      = 100;
+	constexpr int  stride = 160;
+	constexpr auto seed   = uint32_t (4321);
+
+	std::vector <float> src (stride * h);
+	for (int y = 0; y < h; ++y)
+	{
+		for (int x = 0; x < w; ++x)
+		{
+			src [y * stride + x] = float (x * y) / float (w * h);
+		}
+	}
+
+	bool           ok_flag = (fgrn_get_interface_version () == fgrn_INTERFACE_VERSION);
+
+	fgrn_Param     param;
+	fgrn_init_param (&param);
+	param.res = 256;
+	fgrn_Context * ctx_ptr = nullptr;
+	ok_flag &= (fgrn_create_context (&ctx_ptr, &param) == fgrn_Err_OK);
+	if (! ok_flag)
+	{
+		printf ("*** Error *** Cannot create the context.\n\n");
+		return -1;
+	}
+
+	int64_t        mem_size = 0;
+	ok_flag &= (
+		fgrn_get_memory_needs (ctx_ptr, w, h, 4, &mem_size) == fgrn_Err_OK
+	);
+	ok_flag &= (mem_size > int64_t (w) * h * 8);
+	ok_flag &= (
+		fgrn_get_memory_needs (ctx_ptr, 0, h, 4, &mem_size)
+		== fgrn_Err_INVALID_ARG
+	);
+
+	// Reference
+	auto           filter_sptr = fgrn::VisionFilterPool::use_instance ().use_filter (
+		param.sigma, param.res, param.rad, param.dev
+	);
+	std::vector <float> dst_ref (w * h);
+	fgrn::GenGrain gen_grain (false, false);
+	gen_grain.process (
+		dst_ref.data (), src.data (), w, h, stride, w,
+		*filter_sptr, seed, fgrn::RenderMode_FULL
+	);
+
+	// Separate destination, threaded
+	std::vector <float> dst (w * h);
+	int            nbr_calls = 0;
+	ok_flag &= (fgrn_process_plane (
+		ctx_ptr, dst.data (), w, src.data (), stride, w, h, seed, 4,
+		&test_c_api_pfor, &nbr_calls
+	) == fgrn_Err_OK);
+	ok_flag &= (nbr_calls == 2);
+
+	// In the calling thread, with a stride
+	std::vector <float> dst_st (stride * h);
+	ok_flag &= (fgrn_process_plane (
+		ctx_ptr, dst_st.data (), stride, src.data (), stride, w, h, seed, 4,
+		nullptr, nullptr
+	) == fgrn_Err_OK);
+	ok_flag &= (fgrn_process_plane (
+		ctx_ptr, src.data (), stride, src.data (), stride, w, h, seed, 1,
+		nullptr, nullptr
+	) == fgrn_Err_INVALID_ARG);
+
+	// In several parts, each one from its source area only
+	std::vector <float> dst_rect (w * h);
+	const fgrn_Rect   rect_arr [4] =
+	{
+		{  0,  0,     37,     41 }, { 37,  0, w - 37,     41 },
+		{  0, 41,     37, h - 41 }, { 37, 41, w - 37, h - 41 }
+	};
+	for (const auto &rect : rect_arr)
+	{
+		fgrn_Rect      rect_src;
+		ok_flag &= (
+			fgrn_get_rect_src (ctx_ptr, &rect, w, h, &rect_src) == fgrn_Err_OK
+		);
+		std::vector <float> src_part (rect_src.w * rect_src.h);
+		for (int y = 0; y < rect_src.h; ++y)
+		{
+			for (int x = 0; x < rect_src.w; ++x)
+			{
+				src_part [y * rect_src.w + x] =
+					src [(y + rect_src.y) * stride + x + rect_src.x];
+			}
+		}
+		ok_flag &= (fgrn_process_rect (
+			ctx_ptr, dst_rect.data () + rect.y * w + rect.x, w,
+			src_part.data (), rect_src.w, &rect, w, h, seed, 4,
+			&test_c_api_pfor, &nbr_calls
+		) == fgrn_Err_OK);
+	}
+	const fgrn_Rect   rect_bad { 0, 50, w, h };
+	ok_flag &= (fgrn_process_rect (
+		ctx_ptr, dst_rect.data (), w, src.data (), stride, &rect_bad, w, h,
+		seed, 4, nullptr, nullptr
+	) == fgrn_Err_INVALID_ARG);
+	fgrn_destroy_context (ctx_ptr);
+
+	int            nbr_diff = 0;
+	for (int y = 0; y < h; ++y)
+	{
+		for (int x = 0; x < w; ++x)
+		{
+			const auto     ref = dst_ref [y * w + x];
+			nbr_diff += (dst [y * w + x] != ref);
+			nbr_diff += (dst_st [y * stride + x] != ref);
+			nbr_diff += (dst_rect [y * w + x] != ref);
+		}
+	}
+	ok_flag &= (nbr_diff == 0);
+
+	param.rad = 0;
+	ok_flag &= (
+		fgrn_create_context (&ctx_ptr, &param) == fgrn_Err_INVALID_ARG
+	);
+	ok_flag &= (ctx_ptr == nullptr);
+
+	printf (
+		"Memory estimate: %.2f MiB, differences: %d %s\n\n",
+		double (mem_size) / double (1 << 20), nbr_diff,
+		ok_flag ? "" : "*** Error ***"
+	);
+
+	return ok_flag ? 0 : -1;
+}
+
+
+
+// Integer and half-float planes are converted on the fly. The output should
+// be the float rendering of the converted source, converted back to the
+// plane format.
+int	test_spl_fmt ()
+{
+	printf ("Integer and half-float planes...\n");
+
+	int            nbr_err = 0;
+
+	// Half-float round trip for all the finite values, and some rounding
+	// cases
+	int            nbr_diff_half = 0;
+	for (int h = 0; h < 0x10000; ++h)
+	{
+		if ((h & 0x7C00) != 0x7C00)
+		{
+			const auto     x = fgrn::SplConv::conv_half_to_float (uint16_t (h));
+			nbr_diff_half += (fgrn::SplConv::conv_float_to_half (x) != h);
+		}
+	}
+	nbr_diff_half += (fgrn::SplConv::conv_float_to_half (65519.f) != 0x7BFF);
+	nbr_diff_half += (fgrn::SplConv::conv_float_to_half (65520.f) != 0x7C00);
+	nbr_diff_half += (fgrn::SplConv::conv_float_to_half (1.f + 1.f / 2048) != 0x3C00);
+	nbr_diff_half += (fgrn::SplConv::conv_float_to_half (1.f + 3.f / 2048) != 0x3C02);
+	nbr_diff_half += (fgrn::SplConv::conv_float_to_half (ldexpf (1, -25)) != 0x0000);
+	nbr_diff_half += (fgrn::SplConv::conv_float_to_half (ldexpf (3, -26)) != 0x0001);
+	nbr_diff_half += (fgrn::SplConv::conv_float_to_half (-2.f) != 0xC000);
+	printf ("Half-float conversions: %d error(s)\n", nbr_diff_half);
+	if (nbr_diff_half != 0)
+	{
+		++ nbr_err;
+	}
+
+	constexpr int  w          = 96;
+	constexpr int  h          = 64;
+	constexpr int  nbr_planes = 3;
+	auto           filter_sptr = fgrn::VisionFilterPool::use_instance ().use_filter (
+		0.35f, 256, 0.1f, 0
+	);
+	fgrn::GenGrain gen_grain (true, false);
+
+	const std::array <fgrn::SplFmt, 4> fmt_arr {
+		fgrn::SplFmt::make_int (8), fgrn::SplFmt::make_int (10),
+		fgrn::SplFmt::make_int (16), fgrn::SplFmt::make_half ()
+	};
+	for (const auto &fmt : fmt_arr)
+	{
+		const int      spl_size = fmt.get_size ();
+		const auto     len      = size_t (w * spl_size);
+
+		// Source planes in the tested format, and their float conversion
+		std::array <std::vector <uint8_t>, nbr_planes> src_arr;
+		std::array <std::vector <float>, nbr_planes> src_flt_arr;
+		std::vector <float> row (w);
+		for (int p_idx = 0; p_idx < nbr_planes; ++p_idx)
+		{
+			auto &         src     = src_arr [p_idx];
+			auto &         src_flt = src_flt_arr [p_idx];
+			src.resize (len * h);
+			src_flt.resize (w * h);
+			for (int y = 0; y < h; ++y)
+			{
+				for (int x = 0; x < w; ++x)
+				{
+					row [x] = float ((x + y * (p_idx + 1)) % w) / float (w - 1);
+				}
+				fgrn::SplConv::conv_row_from_float (
+					src.data () + y * len, row.data (), fmt, 0, w
+				);
+				fgrn::SplConv::conv_row_to_float (
+					src_flt.data () + y * w, src.data () + y * len, fmt, 0, w
+				);
+			}
+		}
+
+		std::array <int, fgrn::RenderMode_ATLAS> nbr_diff_arr {};
+		for (int mode = 0; mode < fgrn::RenderMode_ATLAS; ++mode)
+		{
+			const auto     rmode = static_cast <fgrn::RenderMode> (mode);
+			const int      nbr_planes_proc =
+				(rmode == fgrn::RenderMode_FULL) ? nbr_planes : 1;
+
+			// Reference: float rendering, then conversion
+			std::array <std::vector <float>, nbr_planes> dst_ref_arr;
+			fgrn::GenGrain::PlaneArray plane_ref_arr;
+			std::array <std::vector <uint8_t>, nbr_planes> dst_arr;
+			fgrn::GenGrain::PlaneArray plane_arr;
+			for (int p_idx = 0; p_idx < nbr_planes_proc; ++p_idx)
+			{
+				dst_ref_arr [p_idx].resize (w * h);
+				dst_arr [p_idx].resize (len * h);
+
+				auto &         plane_ref = plane_ref_arr [p_idx];
+				plane_ref._dst_ptr    = dst_ref_arr [p_idx].data ();
+				plane_ref._src_ptr    = src_flt_arr [p_idx].data ();
+				plane_ref._dst_stride = w;
+				plane_ref._src_stride = w;
+
+				auto &         plane = plane_arr [p_idx];
+				plane._dst_ptr    = dst_arr [p_idx].data ();
+				plane._src_ptr    = src_arr [p_idx].data ();
+				plane._dst_stride = w;
+				plane._src_stride = w;
+				plane._dst_fmt    = fmt;
+				plane._src_fmt    = fmt;
+			}
+			gen_grain.process (
+				plane_ref_arr, nbr_planes_proc, w, h, *filter_sptr, 1234, rmode
+			);
+			gen_grain.process (
+				plane_arr, nbr_planes_proc, w, h, *filter_sptr, 1234, rmode
+			);
+
+			std::vector <uint8_t> dst_exp (len);
+			for (int p_idx = 0; p_idx < nbr_planes_proc; ++p_idx)
+			{
+				for (int y = 0; y < h; ++y)
+				{
+					fgrn::SplConv::conv_row_from_float (
+						dst_exp.data (), dst_ref_arr [p_idx].data () + y * w,
+						fmt, 0, w
+					);
+					nbr_diff_arr [mode] += (memcmp (
+						dst_exp.data (), dst_arr [p_idx].data () + y * len, len
+					) != 0);
+				}
+			}
+		}
+
+		// Through GrainProc, with the output cache (second call)
+		chkdr::GrainProc  proc (
+			0.35f, 256, 0.1f, 0, 1234, true, true, fgrn::RenderMode_FULL,
+			int64_t (1) << 20, "", 0, true, false
+		);
+		std::array <std::vector <uint8_t>, 2> dst_proc_arr;
+		for (int k = 0; k < 2; ++k)
+		{
+			dst_proc_arr [k].resize (len * h);
+			proc.process_plane (
+				dst_proc_arr [k].data (), ptrdiff_t (len),
+				src_arr [0].data (), ptrdiff_t (len),
+				w, h, k, 0, fmt
+			);
+		}
+		const bool     cache_flag = (
+			   dst_proc_arr [0] == dst_proc_arr [1]
+			&& proc.use_output_cache ().get_nbr_hits () == 1
+		);
+
+		const bool     ok_flag    =
+			(nbr_diff_arr == decltype (nbr_diff_arr) {} && cache_flag);
+		printf (
+			"Type %d, %2d bits, different rows: full %d, draft %d, stat %d, "
+			"cache %s %s\n",
+			int (fmt._type), fmt._res,
+			nbr_diff_arr [fgrn::RenderMode_FULL],
+			nbr_diff_arr [fgrn::RenderMode_DRAFT],
+			nbr_diff_arr [fgrn::RenderMode_STAT],
+			cache_flag ? "ok" : "failed",
+			ok_flag ? "" : "*** Error ***"
+		);
+		if (! ok_flag)
+		{
+			++ nbr_err;
+		}
+	}
+	printf ("\n");
+
+	return nbr_err;
+}
+
+
+
+// Transfer curves: accuracy of the approximations and of the tables, then
+// rendering of encoded planes. The output should be the linear rendering of
+// the linearized source, encoded back.
+int	test_transfer ()
+{
+	printf ("Transfer curves...\n");
+
+	int            nbr_err = 0;
+
+	typedef fgrn::Transfer TF;
+	for (int curve = TF::Curve_SRGB; curve < TF::Curve_NBR_ELT; ++curve)
+	{
+		const auto     c = static_cast <TF::Curve> (curve);
+
+		double         err_dec = 0;
+		double         err_enc = 0;
+		constexpr int  nbr_steps = 4096;
+		for (int k = 0; k <= nbr_steps; ++k)
+		{
+			const double   v = double (k) / nbr_steps;
+			err_dec = std::max (err_dec, fabs (TF::decode (c, float (v)) - TF::decode_ref (c, v)));
+			err_enc = std::max (err_enc, fabs (TF::encode (c, float (v)) - TF::encode_ref (c, v)));
+		}
+
+		// Tables
+		int            nbr_diff_lut = 0;
+		for (auto fmt : { fgrn::SplFmt::make_int (8), fgrn::SplFmt::make_int (16) })
+		{
+			const TF       tf (c, fmt);
+			const int      val_max = (1 << fmt._res) - 1;
+			std::vector <uint8_t> src (size_t (val_max + 1) * fmt.get_size ());
+			std::vector <float>   lin (val_max + 1);
+			for (int k = 0; k <= val_max; ++k)
+			{
+				if (fmt._res <= 8)
+				{
+					src [k] = uint8_t (k);
+				}
+				else
+				{
+					reinterpret_cast <uint16_t *> (src.data ()) [k] = uint16_t (k);
+				}
+			}
+			tf.conv_row_to_linear (lin.data (), src.data (), fmt, 0, val_max + 1);
+			for (int k = 0; k <= val_max; ++k)
+			{
+				nbr_diff_lut += (lin [k] != float (TF::decode_ref (c, double (k) / val_max)));
+			}
+		}
+
+		const bool     ok_flag =
+			(err_dec < 2e-5 && err_enc < 2e-5 && nbr_diff_lut == 0);
+		printf (
+			"Curve %d, max error: decode %.3g, encode %.3g, table %d %s\n",
+			curve, err_dec, err_enc, nbr_diff_lut,
+			ok_flag ? "" : "*** Error ***"
+		);
+		if (! ok_flag)
+		{
+			++ nbr_err;
+		}
+	}
+
+	constexpr int  w = 96;
+	constexpr int  h = 64;
+	auto           filter_sptr = fgrn::VisionFilterPool::use_instance ().use_filter (
+		0.35f, 256, 0.1f, 0
+	);
+	fgrn::GenGrain gen_grain (true, false);
+
+	for (auto curve : { TF::Curve_SRGB, TF::Curve_PQ })
+	{
+		for (auto fmt : { fgrn::SplFmt::make_int (16), fgrn::SplFmt::make_float () })
+		{
+			const TF       tf (curve, fmt);
+			const int      spl_size = fmt.get_size ();
+			const auto     len      = size_t (w * spl_size);
+
+			// Encoded source and its linearized version
+			std::vector <uint8_t> src (len * h);
+			std::vector <float>   src_lin (w * h);
+			std::vector <float>   row (w);
+			for (int y = 0; y < h; ++y)
+			{
+				for (int x = 0; x < w; ++x)
+				{
+					row [x] = float ((x + y) % w) / float (w - 1);
+				}
+				fgrn::SplConv::conv_row_from_float (
+					src.data () + y * len, row.data (), fmt, 0, w
+				);
+				tf.conv_row_to_linear (
+					src_lin.data () + y * w, src.data () + y * len, fmt, 0, w
+				);
+			}
+
+			std::array <int, fgrn::RenderMode_ATLAS> nbr_diff_arr {};
+			std::vector <uint8_t> dst_full;
+			for (int mode = 0; mode < fgrn::RenderMode_ATLAS; ++mode)
+			{
+				const auto     rmode = static_cast <fgrn::RenderMode> (mode);
+
+				// Reference: linear rendering, then encoding
+				std::vector <float>   dst_ref (w * h);
+				fgrn::GenGrain::PlaneArray plane_ref_arr;
+				auto &         plane_ref = plane_ref_arr [0];
+				plane_ref._dst_ptr    = dst_ref.data ();
+				plane_ref._src_ptr    = src_lin.data ();
+				plane_ref._dst_stride = w;
+				plane_ref._src_stride = w;
+				gen_grain.process (
+					plane_ref_arr, 1, w, h, *filter_sptr, 1234, rmode
+				);
+
+				std::vector <uint8_t> dst (len * h);
+				fgrn::GenGrain::PlaneArray plane_arr;
+				auto &         plane = plane_arr [0];
+				plane._dst_ptr    = dst.data ();
+				plane._src_ptr    = src.data ();
+				plane._dst_stride = w;
+				plane._src_stride = w;
+				plane._dst_fmt    = fmt;
+				plane._src_fmt    = fmt;
+				plane._tf_ptr     = &tf;
+				gen_grain.process (plane_arr, 1, w, h, *filter_sptr, 1234, rmode);
+
+				std::vector <uint8_t> dst_exp (len);
+				for (int y = 0; y < h; ++y)
+				{
+					tf.conv_row_from_linear (
+						dst_exp.data (), dst_ref.data () + y * w, fmt, 0, w
+					);
+					nbr_diff_arr [mode] += (memcmp (
+						dst_exp.data (), dst.data () + y * len, len
+					) != 0);
+				}
+				if (rmode == fgrn::RenderMode_FULL)
+				{
+					dst_full = dst;
+				}
+			}
+
+			// Through GrainProc
+			chkdr::GrainProc  proc (
+				0.35f, 256, 1, chkdr::GrainProc::LayerArray { { { 0.1f, 0, 1 } } },
+				1, 1234, true, true, fgrn::RenderMode_FULL, curve, 1, 1,
+				0, "", 0, true, false
+			);
+			std::vector <uint8_t> dst_proc (len * h);
+			proc.process_plane (
+				dst_proc.data (), ptrdiff_t (len), src.data (), ptrdiff_t (len),
+				w, h, 0, 0, fmt
+			);
+			const bool     proc_flag = (dst_proc == dst_full);
+
+			const bool     ok_flag   =
+				(nbr_diff_arr == decltype (nbr_diff_arr) {} && proc_flag);
+			printf (
+				"Curve %d, type %d, %2d bits, different rows: full %d, draft %d, "
+				"stat %d, GrainProc %s %s\n",
+				int (curve), int (fmt._type), fmt._res,
+				nbr_diff_arr [fgrn::RenderMode_FULL],
+				nbr_diff_arr [fgrn::RenderMode_DRAFT],
+				nbr_diff_arr [fgrn::RenderMode_STAT],
+				proc_flag ? "ok" : "failed",
+				ok_flag ? "" : "*** Error ***"
+			);
+			if (! ok_flag)
+			{
+				++ nbr_err;
+			}
+		}
+	}
+	printf ("\n");
+
+	return nbr_err;
+}
+
+
+
+// Grain amount: the output should be the source mixed with the full grain
+// rendering, in linear light.
+int	test_amount ()
+{
+	printf ("Grain amount...\n");
+
+	constexpr int  w       = 96;
+	constexpr int  h       = 64;
+	constexpr auto amt_blk = 0.3f;
+	constexpr auto amt_wht = 0.8f;
+	constexpr auto stride  = ptrdiff_t (w * sizeof (float));
+
+	std::vector <float> src (w * h);
+	for (int y = 0; y < h; ++y)
+	{
+		for (int x = 0; x < w; ++x)
+		{
+			src [y * w + x] = float ((x + y) % w) / float (w - 1);
+		}
+	}
+
+	auto           filter_sptr = fgrn::VisionFilterPool::use_instance ().use_filter (
+		0.35f, 256, 0.1f, 0
+	);
+	fgrn::GenGrain gen_grain (true, false);
+
+	int            nbr_err = 0;
+	for (int mode = 0; mode < fgrn::RenderMode_ATLAS; ++mode)
+	{
+		const auto     rmode = static_cast <fgrn::RenderMode> (mode);
+
+		std::vector <float> dst_ref (w * h);
+		fgrn::GenGrain::PlaneArray plane_ref_arr;
+		auto &         plane_ref = plane_ref_arr [0];
+		plane_ref._dst_ptr    = dst_ref.data ();
+		plane_ref._src_ptr    = src.data ();
+		plane_ref._dst_stride = w;
+		plane_ref._src_stride = w;
+		gen_grain.process (plane_ref_arr, 1, w, h, *filter_sptr, 1234, rmode);
+
+		std::vector <float> dst (w * h);
+		fgrn::GenGrain::PlaneArray plane_arr;
+		auto &         plane = plane_arr [0];
+		plane._dst_ptr    = dst.data ();
+		plane._src_ptr    = src.data ();
+		plane._dst_stride = w;
+		plane._src_stride = w;
+		plane._amount_blk = amt_blk;
+		plane._amount_wht = amt_wht;
+		gen_grain.process (plane_arr, 1, w, h, *filter_sptr, 1234, rmode);
+
+		float          err_max = 0;
+		for (int pos = 0; pos < w * h; ++pos)
+		{
+			const float    lum    = src [pos];
+			const float    amount = amt_blk + (amt_wht - amt_blk) * lum;
+			const float    expect = lum + amount * (dst_ref [pos] - lum);
+			err_max = std::max (err_max, std::abs (dst [pos] - expect));
+		}
+
+		const bool     ok_flag = (err_max < 1e-6f);
+		printf (
+			"Mode %d, max error: %g %s\n", mode, err_max,
+			ok_flag ? "" : "*** Error ***"
+		);
+		if (! ok_flag)
+		{
+			++ nbr_err;
+		}
+	}
+
+	// Null amount through GrainProc: the source is left untouched
+	chkdr::GrainProc  proc (
+		0.35f, 256, 1, chkdr::GrainProc::LayerArray { { { 0.1f, 0, 1 } } },
+		1, 1234, true, true, fgrn::RenderMode_FULL,
+		fgrn::Transfer::Curve_LINEAR, 0, 0, 0, "", 0, true, false
+	);
+	std::vector <float> dst_proc (w * h);
+	proc.process_plane (
+		reinterpret_cast <uint8_t *> (dst_proc.data ()), stride,
+		reinterpret_cast <const uint8_t *> (src.data ()), stride, w, h, 0, 0
+	);
+	const bool     proc_flag = (dst_proc == src);
+	printf (
+		"GrainProc, null amount: %s %s\n\n",
+		proc_flag ? "ok" : "failed",
+		proc_flag ? "" : "*** Error ***"
+	);
+	if (! proc_flag)
+	{
+		++ nbr_err;
+	}
+
+	return nbr_err;
+}
+
+
+
+// Grain mask: only the tiles containing the mask are rendered, the output
+// elsewhere is the source. Masked pixels should be identical to a full
+// rendering, mixed with the source according to the mask value.
+int	test_mask ()
+{
+	printf ("Grain mask...\n");
+
+	constexpr int  w      = 96;
+	constexpr int  h      = 64;
+	constexpr auto stride = ptrdiff_t (w * sizeof (float));
+
+	std::vector <float>   src (w * h);
+	std::vector <uint8_t> msk (w * h, 0);
+	for (int y = 0; y < h; ++y)
+	{
+		for (int x = 0; x < w; ++x)
+		{
+			src [y * w + x] = float ((x + y) % w) / float (w - 1);
+			if (x >= 40 && x < 56 && y >= 8 && y < 24)
+			{
+				msk [y * w + x] = (x < 48) ? 255 : 128;
+			}
+		}
+	}
+	chkdr::GrainProc::Mask  mask;
+	mask._ptr    = msk.data ();
+	mask._stride = w;
+	mask._fmt    = fgrn::SplFmt::make_int (8);
+
+	int            nbr_err = 0;
+	for (int mode = 0; mode < fgrn::RenderMode_ATLAS; ++mode)
+	{
+		const auto     rmode = static_cast <fgrn::RenderMode> (mode);
+		chkdr::GrainProc  proc (
+			0.35f, 256, 1, chkdr::GrainProc::LayerArray { { { 0.1f, 0, 1 } } },
+			1, 1234, false, false, rmode,
+			fgrn::Transfer::Curve_LINEAR, 1, 1, 0, "", 0, true, false
+		);
+
+		std::vector <float> dst_ref (w * h);
+		proc.process_plane (
+			reinterpret_cast <uint8_t *> (dst_ref.data ()), stride,
+			reinterpret_cast <const uint8_t *> (src.data ()), stride, w, h, 0, 0
+		);
+
+		std::vector <float> dst (w * h, -1.f);
+		proc.process_plane (
+			reinterpret_cast <uint8_t *> (dst.data ()), stride,
+			reinterpret_cast <const uint8_t *> (src.data ()), stride, w, h, 0, 0,
+			fgrn::SplFmt::make_float (), &mask
+		);
+
+		float          err_max = 0;
+		for (int pos = 0; pos < w * h; ++pos)
+		{
+			const float    m      = float (msk [pos]) * (1.f / 255);
+			const float    lum    = src [pos];
+			const float    expect = lum + m * (dst_ref [pos] - lum);
+			err_max = std::max (err_max, std::abs (dst [pos] - expect));
+		}
+
+		const bool     ok_flag = (err_max < 1e-6f);
+		printf (
+			"Mode %d, max error: %g %s\n", mode, err_max,
+			ok_flag ? "" : "*** Error ***"
+		);
+		if (! ok_flag)
+		{
+			++ nbr_err;
+		}
+	}
+	printf ("\n");
+
+	return nbr_err;
+}
+
+
+
+// Picture rendered in several parts, compared to the whole picture
+int	test_rect ()
+{
+	printf ("Picture parts...\n");
+
+	constexpr int  w      = 150;
+	constexpr int  h      = 110;
+	constexpr auto stride = ptrdiff_t (w * sizeof (float));
+
+	std::vector <float>   src (w * h);
+	std::vector <uint8_t> msk (w * h, 0);
+	for (int y = 0; y < h; ++y)
+	{
+		for (int x = 0; x < w; ++x)
+		{
+			src [y * w + x] = float ((x + y) % w) / float (w - 1);
+			if (x >= 20 && x < 90 && y >= 30 && y < 60)
+			{
+				msk [y * w + x] = (x < 50) ? 255 : 128;
+			}
+		}
+	}
+
+	// Uneven split
+	constexpr int  split_x = 37;
+	constexpr int  split_y = 45;
+	const std::array <chkdr::GrainProc::Rect, 4> rect_arr {{
+		{ 0,       0,       split_x,     split_y     },
+		{ split_x, 0,       w - split_x, split_y     },
+		{ 0,       split_y, split_x,     h - split_y },
+		{ split_x, split_y, w - split_x, h - split_y }
+	}};
+
+	int            nbr_err = 0;
+	for (int mode = 0; mode < fgrn::RenderMode_ATLAS; ++mode)
+	{
+		const auto     rmode = static_cast <fgrn::RenderMode> (mode);
+		chkdr::GrainProc  proc (
+			0.35f, 256, 1, chkdr::GrainProc::LayerArray { { { 0.1f, 0, 1 } } },
+			1, 1234, false, false, rmode,
+			fgrn::Transfer::Curve_LINEAR, 1, 1, 0, "", 0, true, false
+		);
+
+		for (int msk_flag = 0; msk_flag < 2; ++msk_flag)
+		{
+			chkdr::GrainProc::Mask  mask;
+			mask._ptr    = msk.data ();
+			mask._stride = w;
+			mask._fmt    = fgrn::SplFmt::make_int (8);
+			const auto     msk_ptr = (msk_flag != 0) ? &mask : nullptr;
+
+			std::vector <float> dst_ref (w * h);
+			proc.process_plane (
+				reinterpret_cast <uint8_t *> (dst_ref.data ()), stride,
+				reinterpret_cast <const uint8_t *> (src.data ()), stride, w, h,
+				3, 0, fgrn::SplFmt::make_float (), msk_ptr
+			);
+
+			std::vector <float> dst (w * h, -1.f);
+			for (const auto &rect : rect_arr)
+			{
+				const auto     rect_src = proc.compute_rect_src (rect, w, h);
+				const auto     ofs_src  = rect_src._y * w + rect_src._x;
+				chkdr::GrainProc::Mask  mask_rect = mask;
+				mask_rect._ptr += ofs_src;
+				proc.process_rect (
+					reinterpret_cast <uint8_t *> (
+						dst.data () + rect._y * w + rect._x
+					), stride,
+					reinterpret_cast <const uint8_t *> (src.data () + ofs_src),
+					stride, rect, w, h, 3, 0, fgrn::SplFmt::make_float (),
+					(msk_flag != 0) ? &mask_rect : nullptr
+				);
+			}
+
+			int            nbr_dif = 0;
+			for (int pos = 0; pos < w * h; ++pos)
+			{
+				if (dst [pos] != dst_ref [pos])
+				{
+					++ nbr_dif;
+				}
+			}
+
+			const bool     ok_flag = (nbr_dif == 0);
+			printf (
+				"Mode %d, mask %d, different pixels: %d %s\n",
+				mode, msk_flag, nbr_dif, ok_flag ? "" : "*** Error ***"
+			);
+			if (! ok_flag)
+			{
+				++ nbr_err;
+			}
+		}
+	}
+	printf ("\n");
+
+	return nbr_err;
+}
+
+
+
+// Y4M stream header parsing and generation for the command-line renderer
+int	test_frame_format ()
+{
+	printf ("Y4M stream headers...\n");
+
+	bool           ok_flag = true;
+
+	chkdrcli::FrameFormat fmt;
+	ok_flag &= fmt.parse_y4m_header (
+		"YUV4MPEG2 W64 H32 F25:1 Ip A1:1 Cgbrpf32 XCOLORRANGE=FULL"
+	);
+	ok_flag &= (fmt._w == 64 && fmt._h == 32 && fmt._nbr_planes == 3);
+	ok_flag &= (fmt.get_frame_size () == 64 * 32 * 3 * 4);
+	fmt._w = 128;
+	ok_flag &= (
+		   fmt.build_y4m_header ()
+		== "YUV4MPEG2 W128 H32 Cgbrpf32 F25:1 Ip A1:1 XCOLORRANGE=FULL"
+	);
+
+	ok_flag &= fmt.parse_y4m_header ("YUV4MPEG2 W7 H5 Cgrayf32");
+	ok_flag &= (fmt._nbr_planes == 1 && fmt._y4m_tags.empty ());
+
+	// Unsupported colorspaces, missing size, bad signature
+	ok_flag &= ! fmt.parse_y4m_header ("YUV4MPEG2 W64 H32 C444p16");
+	ok_flag &= ! fmt.parse_y4m_header ("YUV4MPEG2 W64 H32");
+	ok_flag &= ! fmt.parse_y4m_header ("YUV4MPEG2 H32 Cgrayf32");
+	ok_flag &= ! fmt.parse_y4m_header ("YUV4MPEG W64 H32 Cgrayf32");
+
+	if (! ok_flag)
+	{
+		printf ("*** Error: unexpected parsing result ***\n");
+	}
+	printf ("\n");
+
+	return ok_flag ? 0 : -1;
+}
+
+
+
+#if fstb_SYS != fstb_SYS_WIN
+
+// Frames rendered by several processes in shared memory, checked against
+// the single-process rendering.
+int	test_shm_render ()
+{
+	printf ("Multi-process rendering...\n");
+
+	constexpr int  nbr_procs = 3;
+	chkdrcli::FrameFormat fmt;
+	fmt._w          = 130;
+	fmt._h          = 100;
+	fmt._nbr_planes = 3;
+	const auto     plane_size = fmt.get_plane_size ();
+	const auto     stride     = ptrdiff_t (fmt._w * sizeof (float));
+
+	int            nbr_err = 0;
+	for (int mode = 0; mode < fgrn::RenderMode_ATLAS; ++mode)
+	{
+		const auto     rmode = static_cast <fgrn::RenderMode> (mode);
+		chkdr::GrainProc  proc (
+			0.35f, 256, 1, chkdr::GrainProc::LayerArray { { { 0.1f, 0, 1 } } },
+			1, 1234, false, false, rmode,
+			fgrn::Transfer::Curve_LINEAR, 1, 1, 0, "", 0, true, false
+		);
+		chkdrcli::ShmRender shm_render (proc, fmt, nbr_procs);
+
+		// Several frames, to check that the workers are reused
+		for (int frame_idx = 0; frame_idx < 2; ++frame_idx)
+		{
+			float *        src_ptr = shm_render.use_src ();
+			for (int pos = 0; pos < plane_size * fmt._nbr_planes; ++pos)
+			{
+				src_ptr [pos] = float ((pos * 7 + frame_idx * 13) % 101) / 100.f;
+			}
+			shm_render.process_frame (frame_idx);
+
+			int            nbr_dif = 0;
+			std::vector <float> dst_ref (plane_size);
+			for (int plane_idx = 0; plane_idx < fmt._nbr_planes; ++plane_idx)
+			{
+				const auto     ofs = plane_idx * plane_size;
+				proc.process_plane (
+					reinterpret_cast <uint8_t *> (dst_ref.data ()), stride,
+					reinterpret_cast <const uint8_t *> (src_ptr + ofs), stride,
+					fmt._w, fmt._h, frame_idx, plane_idx
+				);
+				const float *  dst_ptr = shm_render.use_dst () + ofs;
+				for (int pos = 0; pos < plane_size; ++pos)
+				{
+					if (dst_ptr [pos] != dst_ref [pos])
+					{
+						++ nbr_dif;
+					}
+				}
+			}
+
+			const bool     ok_flag = (nbr_dif == 0);
+			printf (
+				"Mode %d, frame %d, different pixels: %d %s\n",
+				mode, frame_idx, nbr_dif, ok_flag ? "" : "*** Error ***"
+			);
+			if (! ok_flag)
+			{
+				++ nbr_err;
+			}
+		}
+	}
+	printf ("\n");
+
+	return nbr_err;
+}
+
+#endif   // fstb_SYS
+
+
+
+// Renders a sequence with localised changes using the temporal reuse of
+// GrainProc (constant seed for all frames). Each frame is checked against
+// a fresh instance which has to render the whole picture.
+int	test_temporal_reuse ()
+{
+	printf ("Temporal reuse of the unchanged areas...\n");
+
+	constexpr int  w          = 200;
+	constexpr int  h          = 150;
+	constexpr auto stride     = ptrdiff_t (w * sizeof (float));
+	constexpr int  nbr_frames = 5;
+
+	std::vector <float>  src (w * h);
+	for (int y = 0; y < h; ++y)
+	{
+		for (int x = 0; x < w; ++x)
+		{
+			src [y * w + x] = float (x + y) / float (w + h - 2);
+		}
+	}
+	std::vector <float>  dst_tmp (w * h);
+	std::vector <float>  dst_ref (w * h);
+
+	int            nbr_err = 0;
+	typedef std::chrono::high_resolution_clock ClkType;
+	ClkType        clk;
+	for (int mode = 0; mode < fgrn::RenderMode_NBR_ELT; ++mode)
+	{
+		const auto     r_mode = static_cast <fgrn::RenderMode> (mode);
+		chkdr::GrainProc  proc_tmp (
+			0.35f, 256, 0.05f, 0, 12345, true, false, r_mode, 0, "", 0, true, false
+		);
+		auto           src_f = src;
+		printf ("Mode %d:", mode);
+		for (int f_idx = 0; f_idx < nbr_frames; ++f_idx)
+		{
+			// Frame 1: no change, frame 2: small area, frame 3: area on the
+			// border, frame 4: everything.
+			const auto     change_fnc = [&src_f] (int x0, int y0, int x1, int y1)
+			{
+				for (int y = y0; y < y1; ++y)
+				{
+					for (int x = x0; x < x1; ++x)
+					{
+						src_f [y * w + x] = 1.f - src_f [y * w + x];
+					}
+				}
+			};
+			switch (f_idx)
+			{
+			case 2: change_fnc (70, 40, 90, 52); break;
+			case 3: change_fnc (w - 5, h - 30, w, h); break;
+			case 4: change_fnc (0, 0, w, h); break;
+			default: break;
+			}
+
+			chkdr::GrainProc  proc_ref (
+				0.35f, 256, 0.05f, 0, 12345, true, false, r_mode, 0, "", 0, true, false
+			);
+			proc_ref.process_plane (
+				reinterpret_cast <uint8_t *> (dst_ref.data ()), stride,
+				reinterpret_cast <const uint8_t *> (src_f.data ()), stride,
+				w, h, f_idx, 0
+			);
+			const auto     t_0 = clk.now ();
+			proc_tmp.process_plane (
+				reinterpret_cast <uint8_t *> (dst_tmp.data ()), stride,
+				reinterpret_cast <const uint8_t *> (src_f.data ()), stride,
+				w, h, f_idx, 0
+			);
+			const auto     t_1 = clk.now ();
+
+			const bool     ok_flag = (dst_tmp == dst_ref);
+			printf (
+				" %.4f s%s", get_duration_s (t_0, t_1),
+				ok_flag ? "" : " *** Error ***"
+			);
+			if (! ok_flag)
+			{
+				++ nbr_err;
+			}
+		}
+		printf ("\n");
+	}
+	printf ("\n");
+
+	return nbr_err;
+}
+
+
+
+// Repeated source frames should be served by the output cache.
+int	test_output_cache ()
+{
+	printf ("Output cache...\n");
+
+	constexpr int  w          = 160;
+	constexpr int  h          = 120;
+	constexpr auto stride     = ptrdiff_t (w * sizeof (float));
+	constexpr auto frame_size = int64_t (w * h * sizeof (float));
+
+	// Two different source frames
+	std::array <std::vector <float>, 2> src_arr;
+	for (int k = 0; k < 2; ++k)
+	{
+		auto &         src = src_arr [k];
+		src.resize (w * h);
+		for (int y = 0; y < h; ++y)
+		{
+			for (int x = 0; x < w; ++x)
+			{
+				src [y * w + x] = float ((k == 0) ? x : y) / float (w);
+			}
+		}
+	}
+
+	int            nbr_err = 0;
+	typedef std::chrono::high_resolution_clock ClkType;
+	ClkType        clk;
+
+	// Budget for 2 frames, then for a single frame (eviction)
+	for (int nbr_frames_cached = 2; nbr_frames_cached > 0; --nbr_frames_cached)
+	{
+		chkdr::GrainProc  proc (
+			0.35f, 256, 0.05f, 0, 12345, true, false, fgrn::RenderMode_FULL,
+			frame_size * nbr_frames_cached, "", 0, true, false
+		);
+		std::array <std::vector <float>, 3> dst_arr;
+		double         dur_arr [3] = { 0, 0, 0 };
+
+		// Sequence A B A
+		for (int f_idx = 0; f_idx < 3; ++f_idx)
+		{
+			auto &         dst = dst_arr [f_idx];
+			dst.resize (w * h);
+			const auto     t_0 = clk.now ();
+			proc.process_plane (
+				reinterpret_cast <uint8_t *> (dst.data ()), stride,
+				reinterpret_cast <const uint8_t *> (src_arr [f_idx & 1].data ()),
+				stride, w, h, f_idx, 0
+			);
+			dur_arr [f_idx] = get_duration_s (t_0, clk.now ());
+		}
+
+		const auto &   cache    = proc.use_output_cache ();
+		const auto     hits     = cache.get_nbr_hits ();
+		const auto     misses   = cache.get_nbr_misses ();
+		const auto     hits_exp = (nbr_frames_cached >= 2) ? 1 : 0;
+		const bool     ok_flag  =
+			   dst_arr [0] == dst_arr [2]
+			&& hits == hits_exp
+			&& misses == 3 - hits_exp
+			&& cache.get_size () <= cache.get_budget ();
+		printf (
+			"Budget %d frame(s): %.4f s %.4f s %.4f s, hits: %d, misses: %d%s\n",
+			nbr_frames_cached, dur_arr [0], dur_arr [1], dur_arr [2],
+			int (hits), int (misses), ok_flag ? "" : " *** Error ***"
+		);
+		if (! ok_flag)
+		{
+			++ nbr_err;
+		}
+	}
+	printf ("\n");
+
+	return nbr_err;
+}
+
+
+
+// Rendered frames should persist in the disk cache across GrainProc
+// instances, and the size limit should be enforced when a new instance
+// opens the directory. The files of other parameters and the recent
+// temporary files should be kept, the abandoned temporary files deleted.
+int	test_disk_cache ()
+{
+	printf ("Disk cache...\n");
+
+	constexpr int  w          = 160;
+	constexpr int  h          = 120;
+	constexpr auto stride     = ptrdiff_t (w * sizeof (float));
+	constexpr auto frame_size = int64_t (w * h * sizeof (float));
+	constexpr auto file_size  = frame_size + 64; // Header included
+	const std::string dir     = "chkdr-test-cache";
+
+#if defined (_MSC_VER)
+	::_mkdir (dir.c_str ());
+#else
+	::mkdir (dir.c_str (), 0755);
+#endif
+	if (! chkdr::GrainProc::check_cache_dir (dir))
+	{
+		printf ("Cannot create the %s directory. *** Error ***\n\n", dir.c_str ());
+		return -1;
+	}
+
+	// Two different source frames
+	std::array <std::vector <float>, 2> src_arr;
+	for (int k = 0; k < 2; ++k)
+	{
+		auto &         src = src_arr [k];
+		src.resize (w * h);
+		for (int y = 0; y < h; ++y)
+		{
+			for (int x = 0; x < w; ++x)
+			{
+				src [y * w + x] = float ((k == 0) ? x : y) / float (w);
+			}
+		}
+	}
+
+	// Foreign entry, recent and abandoned temporary files
+	const std::array <std::string, 3> extra_arr {{
+		dir + "/chkdr-0000000000000000-0000000000000000.bin",
+		dir + "/chkdr-0000000000000000-0000000000000001.bin.tmp-00000000-00000000",
+		dir + "/chkdr-0000000000000000-0000000000000002.bin.tmp-00000000-00000000"
+	}};
+	for (const auto &pathname : extra_arr)
+	{
+		FILE *         f_ptr = fopen (pathname.c_str (), "wb");
+		if (f_ptr != nullptr)
+		{
+			fclose (f_ptr);
+		}
+	}
+	{
+#if defined (_MSC_VER)
+		struct ::_utimbuf t;
+		t.actime  = 0;
+		t.modtime = 0;
+		::_utime (extra_arr [2].c_str (), &t);
+#else
+		struct ::utimbuf  t;
+		t.actime  = 0;
+		t.modtime = 0;
+		::utime (extra_arr [2].c_str (), &t);
+#endif
+	}
+
+	int            nbr_err = 0;
+	typedef std::chrono::high_resolution_clock ClkType;
+	ClkType        clk;
+	std::array <std::vector <float>, 2> ref_arr;
+
+	// Session 0 fills the cache, session 1 reads it, session 2 has room for
+	// a single frame and session 3 empties the directory.
+	const std::array <int64_t, 4> budget_arr {{
+		file_size * 2, file_size * 2, file_size, 1
+	}};
+	for (int session = 0; session < int (budget_arr.size ()); ++session)
+	{
+		chkdr::GrainProc  proc (
+			0.35f, 256, 0.05f, 0, 12345, true, false, fgrn::RenderMode_FULL,
+			0, dir, budget_arr [session], true, false
+		);
+		const auto &   cache  = proc.use_disk_cache ();
+		const auto     nbr_entries_init = cache.get_nbr_entries ();
+
+		bool           ok_flag  = true;
+		double         dur      = 0;
+		if (session < 2)
+		{
+			for (int f_idx = 0; f_idx < 2; ++f_idx)
+			{
+				std::vector <float>  dst (w * h);
+				const auto     t_0 = clk.now ();
+				proc.process_plane (
+					reinterpret_cast <uint8_t *> (dst.data ()), stride,
+					reinterpret_cast <const uint8_t *> (src_arr [f_idx].data ()),
+					stride, w, h, f_idx, 0
+				);
+				dur += get_duration_s (t_0, clk.now ());
+				if (session == 0)
+				{
+					ref_arr [f_idx] = dst;
+				}
+				else
+				{
+					ok_flag &= (dst == ref_arr [f_idx]);
+				}
+			}
+		}
+
+		const auto     hits     = cache.get_nbr_hits ();
+		const auto     misses   = cache.get_nbr_misses ();
+		const auto     hits_exp = (session == 1) ? 2 : 0;
+		const int      nbr_exp  = (session < 2) ? 2 : 1 - (session - 2);
+		ok_flag &=
+			   hits == hits_exp
+			&& misses == ((session == 0) ? 2 : 0)
+			&& cache.get_nbr_entries () == nbr_exp
+			&& cache.get_size () <= cache.get_budget ();
+		printf (
+			"Session %d: %.4f s, entries found: %d, hits: %d, misses: %d, entries: %d%s\n",
+			session, dur, nbr_entries_init, int (hits), int (misses),
+			cache.get_nbr_entries (), ok_flag ? "" : " *** Error ***"
+		);
+		if (! ok_flag)
+		{
+			++ nbr_err;
+		}
+	}
+
+	// Only the abandoned temporary file should be gone
+	for (int k = 0; k < int (extra_arr.size ()); ++k)
+	{
+		const bool     exist_flag = (remove (extra_arr [k].c_str ()) == 0);
+		if (exist_flag != (k < 2))
+		{
+			printf (
+				"Extra file %d %s. *** Error ***\n",
+				k, exist_flag ? "not deleted" : "deleted"
+			);
+			++ nbr_err;
+		}
+	}
+	printf ("\n");
+
+#if defined (_MSC_VER)
+	::_rmdir (dir.c_str ());
+#else
+	::rmdir (dir.c_str ());
+#endif
+
+	return nbr_err;
+}
+
+
+
+// Filter instances with the same parameters should share their
+// VisionFilter.
+int	test_filter_pool ()
+{
+	printf ("Vision filter pool...\n");
+
+	auto &         pool = fgrn::VisionFilterPool::use_instance ();
+	const int      nbr_init = pool.get_nbr_filters ();
+
+	int            nbr_err = 0;
+	typedef std::chrono::high_resolution_clock ClkType;
+	ClkType        clk;
+	{
+		const auto     t_0 = clk.now ();
+		chkdr::GrainProc  proc_1 (
+			0.35f, 16384, 0.025f, 0, 12345, false, false,
+			fgrn::RenderMode_FULL, 0, "", 0, true, false
+		);
+		const auto     t_1 = clk.now ();
+		chkdr::GrainProc  proc_2 (
+			0.35f, 16384, 0.025f, 0, 54321, true, false,
+			fgrn::RenderMode_FULL, 0, "", 0, true, false
+		);
+		const auto     t_2 = clk.now ();
+		chkdr::GrainProc  proc_3 (
+			0.35f, 16384, 0.05f, 0, 12345, false, false,
+			fgrn::RenderMode_FULL, 0, "", 0, true, false
+		);
+		const int      nbr_filters = pool.get_nbr_filters () - nbr_init;
+		printf (
+			"Creation: %.4f s, same filter: %.4f s, filters: %d\n",
+			get_duration_s (t_0, t_1), get_duration_s (t_1, t_2), nbr_filters
+		);
+		if (nbr_filters != 2)
+		{
+			printf ("*** Error: 2 filters expected ***\n");
+			++ nbr_err;
+		}
+	}
+	if (pool.get_nbr_filters () != nbr_init)
+	{
+		printf ("*** Error: filters not released ***\n");
+		++ nbr_err;
+	}
+	printf ("\n");
+
+	return nbr_err;
+}
+
+
+
+// Compares the statistics of the atlas synthesis with the full rendering
+int	test_atlas ()
+{
+	printf ("Texture atlas synthesis vs full rendering...\n");
+
+	constexpr int  nbr_bands = 4;
+	constexpr int  band_w    = 64;
+	constexpr int  w         = nbr_bands * band_w;
+	constexpr int  h         = 96;
+	constexpr int  margin    = 4;
+	constexpr auto stride    = ptrdiff_t (w * sizeof (float));
+	// Some levels fall between the atlas levels
+	const std::array <float, nbr_bands> lum_arr {{ 0.05f, 0.23f, 0.5f, 0.77f }};
+
+	std::vector <float> pic_s (w * h);
+	for (int y = 0; y < h; ++y)
+	{
+		for (int x = 0; x < w; ++x)
+		{
+			pic_s [y * w + x] = lum_arr [x / band_w];
+		}
+	}
+	auto           pic_full  = pic_s;
+	auto           pic_atlas = pic_s;
+
+	int            nbr_err = 0;
+	typedef std::chrono::high_resolution_clock ClkType;
+	ClkType        clk;
+	chkdr::GrainProc  proc_full (
+		0.35f, 256, 0.1f, 0, 12345, false, false,
+		fgrn::RenderMode_FULL, 0, "", 0, true, false
+	);
+	chkdr::GrainProc  proc_atlas (
+		0.35f, 256, 0.1f, 0, 12345, false, false,
+		fgrn::RenderMode_ATLAS, 0, "", 0, true, false
+	);
+
+	const auto     t_0 = clk.now ();
+	proc_full.process_plane (
+		reinterpret_cast <uint8_t *> (pic_full.data ()), stride,
+		reinterpret_cast <const uint8_t *> (pic_s.data ()), stride,
+		w, h, 0, 0
+	);
+	const auto     t_1 = clk.now ();
+	// The first frame builds the atlas
+	proc_atlas.process_plane (
+		reinterpret_cast <uint8_t *> (pic_atlas.data ()), stride,
+		reinterpret_cast <const uint8_t *> (pic_s.data ()), stride,
+		w, h, 1, 0
+	);
+	const auto     t_2 = clk.now ();
+	proc_atlas.process_plane (
+		reinterpret_cast <uint8_t *> (pic_atlas.data ()), stride,
+		reinterpret_cast <const uint8_t *> (pic_s.data ()), stride,
+		w, h, 0, 0
+	);
+	const auto     t_3 = clk.now ();
+	printf (
+		"full: %.3f s, atlas build: %.3f s, atlas: %.5f s\n",
+		get_duration_s (t_0, t_1), get_duration_s (t_1, t_2),
+		get_duration_s (t_2, t_3)
+	);
+
+	for (int b_cnt = 0; b_cnt < nbr_bands; ++b_cnt)
+	{
+		const auto     x_beg = b_cnt * band_w + margin;
+		const auto     bw    = band_w - 2 * margin;
+		const auto     st_f  = compute_pic_stat (pic_full , w, x_beg, 0, bw, h);
+		const auto     st_a  = compute_pic_stat (pic_atlas, w, x_beg, 0, bw, h);
+		const auto     dev_r = st_a._dev / st_f._dev;
+		const bool     ok_flag =
+			   std::abs (st_a._avg - st_f._avg) < 0.02 + 0.05 * st_f._avg
+			&& dev_r > 0.6 && dev_r < 1.5
+			&& std::abs (st_a._corr - st_f._corr) < 0.2;
+		printf (
+			"lum %.2f: avg %.4f / %.4f, dev %.4f / %.4f, corr %+.3f / %+.3f %s\n",
+			lum_arr [b_cnt],
+			st_f._avg , st_a._avg,
+			st_f._dev , st_a._dev,
+			st_f._corr, st_a._corr,
+			ok_flag ? "" : "*** Error ***"
+		);
+		if (! ok_flag)
+		{
+			++ nbr_err;
+		}
+	}
+	printf ("\n");
+
+	return nbr_err;
+}
+
+
+
+// The neighbour correlation across the atlas block boundaries should be
+// close to the one of the full rendering. Without the cross-fade, the
+// pixels on both sides of a boundary come from unrelated patch locations
+// and the correlation drops to 0. Large grains make it easy to measure.
+int	test_atlas_seams ()
+{
+	printf ("Texture atlas block boundaries...\n");
+
+	constexpr int  w      = 256;
+	constexpr int  h      = 256;
+	constexpr int  blk    = 32; // GrainProc::_atlas_block_size
+	constexpr auto stride = ptrdiff_t (w * sizeof (float));
+	constexpr auto lum    = 0.5f;
+	constexpr auto rad    = 0.4f;
+
+	const std::vector <float> pic_s (w * h, lum);
+	auto           pic_full  = pic_s;
+	auto           pic_atlas = pic_s;
+
+	chkdr::GrainProc  proc_full (
+		0.35f, 256, rad, 0, 12345, false, false,
+		fgrn::RenderMode_FULL, 0, "", 0, true, false
+	);
+	chkdr::GrainProc  proc_atlas (
+		0.35f, 256, rad, 0, 12345, false, false,
+		fgrn::RenderMode_ATLAS, 0, "", 0, true, false
+	);
+	proc_full.process_plane (
+		reinterpret_cast <uint8_t *> (pic_full.data ()), stride,
+		reinterpret_cast <const uint8_t *> (pic_s.data ()), stride,
+		w, h, 0, 0
+	);
+	proc_atlas.process_plane (
+		reinterpret_cast <uint8_t *> (pic_atlas.data ()), stride,
+		reinterpret_cast <const uint8_t *> (pic_s.data ()), stride,
+		w, h, 0, 0
+	);
+
+	const auto     st_f = compute_pic_stat (pic_full , w, 0, 0, w, h);
+	const auto     st_a = compute_pic_stat (pic_atlas, w, 0, 0, w, h);
+
+	// Pixel pairs across the vertical and horizontal block boundaries
+	double         sum_xy = 0;
+	int            nbr_pairs = 0;
+	for (int b = blk; b < w; b += blk)
+	{
+		for (int k = 0; k < h; ++k)
+		{
+			sum_xy +=
+				  (pic_atlas [k * w + b - 1] - st_a._avg)
+				* (pic_atlas [k * w + b    ] - st_a._avg);
+			sum_xy +=
+				  (pic_atlas [(b - 1) * w + k] - st_a._avg)
+				* (pic_atlas [ b      * w + k] - st_a._avg);
+			nbr_pairs += 2;
+		}
+	}
+	const auto     corr_seam = sum_xy / (nbr_pairs * st_a._dev * st_a._dev);
+
+	const bool     ok_flag = (std::abs (corr_seam - st_f._corr) < 0.1);
+	printf (
+		"corr full: %+.3f, atlas: %+.3f, atlas at the boundaries: %+.3f %s\n\n",
+		st_f._corr, st_a._corr, corr_seam,
+		ok_flag ? "" : "*** Error ***"
+	);
+
+	return ok_flag ? 0 : -1;
+}
+
+
+
+// Rendering statistics. When they are compiled out, the counters must stay
+// null. Otherwise they must be consistent and add up over several planes.
+int	test_render_stats ()
+{
+	printf ("Rendering statistics (%s)...\n",
+		fgrn::RenderStats::_enabled_flag ? "enabled" : "disabled"
+	);
+
+	typedef fgrn::RenderStats RS;
+
+	constexpr int  w      = 96;
+	constexpr int  h      = 64;
+	constexpr auto stride = ptrdiff_t (w * sizeof (float));
+
+	std::vector <float> src (w * h);
+	for (int pos = 0; pos < w * h; ++pos)
+	{
+		src [pos] = float (pos % w) / float (w - 1);
+	}
+	std::vector <float> dst (w * h);
+
+	int            nbr_err = 0;
+	for (int mode = 0; mode < fgrn::RenderMode_ATLAS; ++mode)
+	{
+		for (int nbr_layers = 1; nbr_layers <= 2; ++nbr_layers)
+		{
+			if (nbr_layers > 1 && mode != fgrn::RenderMode_FULL)
+			{
+				continue;
+			}
+			chkdr::GrainProc  proc (
+				0.35f, 256, 1,
+				chkdr::GrainProc::LayerArray {{
+					{ 0.05f, 0, 1 }, { 0.15f, 0, 1 }, { 0.1f, 0, 1 }
+				}},
+				nbr_layers, 1234, false, false,
+				static_cast <fgrn::RenderMode> (mode),
+				fgrn::Transfer::Curve_LINEAR, 1, 1, 0, "", 0, true, false
+			);
+
+			// The same plane twice: counters are doubled
+			chkdr::GrainProc::StatsArray stats_arr;
+			std::array <RS, 2>   sum_arr;
+			for (int pass = 0; pass < 2; ++pass)
+			{
+				proc.process_plane (
+					reinterpret_cast <uint8_t *> (dst.data ()), stride,
+					reinterpret_cast <const uint8_t *> (src.data ()), stride,
+					w, h, 0, 0, fgrn::SplFmt::make_float (), nullptr, &stats_arr
+				);
+				sum_arr [pass] = chkdr::GrainProc::sum_stats (stats_arr);
+			}
+			const auto &   st1 = sum_arr [0];
+			const auto &   st2 = sum_arr [1];
+			const auto     cnt = [&st1] (RS::Cnt c) { return st1._cnt_arr [c]; };
+
+			bool           ok_flag = true;
+			if (! RS::_enabled_flag)
+			{
+				for (int c = 0; c < RS::Cnt_NBR_ELT; ++c)
+				{
+					ok_flag &= (st2._cnt_arr [c] == 0);
+				}
+				ok_flag &= (st2._pass1_s == 0 && st2._pass2_s == 0);
+			}
+			else
+			{
+				for (int c = 0; c < RS::Cnt_NBR_ELT; ++c)
+				{
+					ok_flag &= (st2._cnt_arr [c] == 2 * st1._cnt_arr [c]);
+				}
+				ok_flag &= (st1._pass1_s > 0);
+				ok_flag &= (cnt (RS::Cnt_EARLY_EXITS) <= cnt (RS::Cnt_CHECKS));
+				if (mode == fgrn::RenderMode_FULL)
+				{
+					ok_flag &= (st1._pass2_s > 0);
+					ok_flag &= (cnt (RS::Cnt_CACHE_MISSES) > 0);
+					ok_flag &= (cnt (RS::Cnt_Q_TOTAL) > 0);
+					ok_flag &= (cnt (RS::Cnt_EARLY_EXITS) > 0);
+					ok_flag &= (cnt (RS::Cnt_GRAINS_TESTED) >= cnt (RS::Cnt_EARLY_EXITS));
+					const auto     nbr_uses =
+						cnt (RS::Cnt_CACHE_HITS) + cnt (RS::Cnt_CACHE_MISSES);
+					ok_flag &= (nbr_layers > 1)
+						? (cnt (RS::Cnt_CHECKS) >= nbr_uses)
+						: (cnt (RS::Cnt_CHECKS) == nbr_uses);
+				}
+				else
+				{
+					// The counters are not collected in these modes, but the pass
+					// durations are.
+					for (int c = 0; c < RS::Cnt_NBR_ELT; ++c)
+					{
+						ok_flag &= (st1._cnt_arr [c] == 0);
+					}
+					ok_flag &= (
+						   mode != fgrn::RenderMode_STAT
+						|| st1._pass2_s > 0
+					);
+				}
+			}
+
+			printf (
+				"Mode %d, %d layer(s): cells %lld, checks %lld, exits %lld, "
+				"pass 1 %.2f ms, pass 2 %.2f ms %s\n",
+				mode, nbr_layers,
+				static_cast <long long> (cnt (RS::Cnt_CACHE_MISSES)),
+				static_cast <long long> (cnt (RS::Cnt_CHECKS)),
+				static_cast <long long> (cnt (RS::Cnt_EARLY_EXITS)),
+				st1._pass1_s * 1000, st1._pass2_s * 1000,
+				ok_flag ? "" : "*** Error ***"
+			);
+			if (! ok_flag)
+			{
+				++ nbr_err;
+			}
+		}
+	}
+	printf ("\n");
+
+	return nbr_err;
+}
+
+
+
+// Chi-square statistic of a histogram, for a uniform distribution
+double	compute_chi2 (const std::vector <int> &hist)
+{
+	assert (! hist.empty ());
+
+	double         sum = 0;
+	for (auto n : hist)
+	{
+		sum += double (n);
+	}
+	const auto     expected = sum / double (hist.size ());
+
+	double         chi2 = 0;
+	for (auto n : hist)
+	{
+		chi2 += fstb::sq (double (n) - expected) / expected;
+	}
+
+	return chi2;
+}
+
+
+
+// Pearson correlation of two series
+double	compute_corr (const std::vector <float> &a, const std::vector <float> &b)
+{
+	assert (a.size () == b.size ());
+	assert (! a.empty ());
+
+	const auto     n = a.size ();
+	double         sa  = 0;
+	double         sb  = 0;
+	double         saa = 0;
+	double         sbb = 0;
+	double         sab = 0;
+	for (size_t k = 0; k < n; ++k)
+	{
+		sa  += a [k];
+		sb  += b [k];
+		saa += double (a [k]) * double (a [k]);
+		sbb += double (b [k]) * double (b [k]);
+		sab += double (a [k]) * double (b [k]);
+	}
+	const auto     ma = sa / double (n);
+	const auto     mb = sb / double (n);
+	const auto     va = saa / double (n) - ma * ma;
+	const auto     vb = sbb / double (n) - mb * mb;
+
+	return (sab / double (n) - ma * mb) / sqrt (va * vb);
+}
+
+
+
+// Checks the statistical quality of a hash backend for UtilPrngTpl.
+// Random states are consumed exactly like GrainDensity (one Poisson-
+// distributed grain count per cell) and GenGrain::build_cell (consecutive
+// states for the grain coordinates), because the hash must be good for
+// these sequences and not in general.
+// Returns the number of failed checks.
+template <typename H>
+int	test_prng_backend (const char *name_0)
+{
+	assert (name_0 != nullptr);
+
+	typedef fgrn::UtilPrngTpl <H> UP;
+	printf ("PRNG hash backend \"%s\"...\n", name_0);
+
+	constexpr int  simd_w     = fstb::Vf32::_length;
+	constexpr int  cell_w_l2  = 7;
+	constexpr int  cell_w     = 1 << cell_w_l2;
+	constexpr int  nbr_cells  = cell_w * cell_w;
+	constexpr int  nbr_grains = 64; // Per cell, for the uniformity tests
+	static_assert (nbr_grains % simd_w == 0, "");
+	constexpr int  nbr_pairs  = nbr_cells * nbr_grains;
+	constexpr uint32_t   seed = 12345;
+
+	// Same addressing as GrainDensity::compute_q ()
+	const auto     gen_cell_state = [] (int c) {
+		const auto     x = uint32_t (c & (cell_w - 1));
+		const auto     y = uint32_t (c >> cell_w_l2);
+		return UP::hash (seed + (y << 20) + (x << 8)) + 2;
+	};
+
+	// Grain coordinates, SIMD and scalar versions
+	std::vector <float> cx_arr (nbr_pairs);
+	std::vector <float> cy_arr (nbr_pairs);
+	float          dif_max = 0;
+	for (int c = 0; c < nbr_cells; ++c)
+	{
+		const auto     rnd_state = gen_cell_state (c);
+		auto           vrnd      = fstb::Vu32 (
+			rnd_state, rnd_state + 2, rnd_state + 4, rnd_state + 6
+		);
+		const auto     ofs = c * nbr_grains;
+		for (int pos = 0; pos < nbr_grains; pos += simd_w)
+		{
+			const auto     cx = UP::gen_uniform (vrnd                 );
+			const auto     cy = UP::gen_uniform (vrnd + fstb::Vu32 (1));
+			vrnd += fstb::Vu32 (simd_w * 2);
+			cx.storeu (&cx_arr [ofs + pos]);
+			cy.storeu (&cy_arr [ofs + pos]);
+		}
+		for (int pos = 0; pos < nbr_grains; ++pos)
+		{
+			const auto     cx = UP::gen_uniform (rnd_state + pos * 2    );
+			const auto     cy = UP::gen_uniform (rnd_state + pos * 2 + 1);
+			dif_max = std::max (dif_max, std::abs (cx - cx_arr [ofs + pos]));
+			dif_max = std::max (dif_max, std::abs (cy - cy_arr [ofs + pos]));
+		}
+	}
+
+	int            nbr_err = 0;
+	const auto     check   = [&nbr_err] (const char *txt_0, double val, bool ok_flag) {
+		printf ("%-28s: %10.5f %s\n", txt_0, val, ok_flag ? "" : "*** Error ***");
+		if (! ok_flag)
+		{
+			++ nbr_err;
+		}
+	};
+
+	check ("Scalar/SIMD max difference", dif_max, dif_max < 1e-6f);
+
+	// 1D uniformity, 256 bins, df = 255.
+	// The limits correspond to a p-value of about 1e-4.
+	constexpr int  nbr_bins_1d = 256;
+	constexpr double  chi2_max = 340;
+	std::vector <int> hist_1d (nbr_bins_1d, 0);
+	for (int k = 0; k < nbr_pairs; ++k)
+	{
+		++ hist_1d [std::min (int (cx_arr [k] * nbr_bins_1d), nbr_bins_1d - 1)];
+		++ hist_1d [std::min (int (cy_arr [k] * nbr_bins_1d), nbr_bins_1d - 1)];
+	}
+	const auto     chi2_1d = compute_chi2 (hist_1d);
+	check ("Chi-square 1D (df = 255)", chi2_1d, chi2_1d < chi2_max);
+
+	// 2D uniformity of the grain centers, 16 x 16 bins
+	constexpr int  nbr_bins_2d = 16;
+	std::vector <int> hist_2d (nbr_bins_2d * nbr_bins_2d, 0);
+	for (int k = 0; k < nbr_pairs; ++k)
+	{
+		const auto     bx = std::min (int (cx_arr [k] * nbr_bins_2d), nbr_bins_2d - 1);
+		const auto     by = std::min (int (cy_arr [k] * nbr_bins_2d), nbr_bins_2d - 1);
+		++ hist_2d [by * nbr_bins_2d + bx];
+	}
+	const auto     chi2_2d = compute_chi2 (hist_2d);
+	check ("Chi-square 2D (df = 255)", chi2_2d, chi2_2d < chi2_max);
+
+	// Serial correlations: x/y of the same grain and x of consecutive grains
+	const auto     corr_max = 5 / sqrt (double (nbr_pairs));
+	const auto     corr_xy  = compute_corr (cx_arr, cy_arr);
+	check ("Correlation x/y", corr_xy, std::abs (corr_xy) < corr_max);
+	const std::vector <float> cx0_arr (cx_arr.begin (), cx_arr.end () - 1);
+	const std::vector <float> cx1_arr (cx_arr.begin () + 1, cx_arr.end ());
+	const auto     corr_xx  = compute_corr (cx0_arr, cx1_arr);
+	check ("Correlation x(n)/x(n+1)", corr_xx, std::abs (corr_xx) < corr_max);
+
+	// Grain picture: Poisson-distributed grain counts, then the grains are
+	// rasterised at a 8x8 subpixel resolution. The expected coverage is
+	// 0.5 everywhere, we check the average on the whole picture, as well as
+	// the average on each subpixel position to detect position biases.
+	constexpr int  sub_l2 = 3;
+	constexpr int  sub    = 1 << sub_l2;
+	constexpr float   rad = 0.15f;
+	const auto     lambda = float (-log (0.5) / (fstb::PI * rad * rad));
+	std::vector <int> q_arr (nbr_cells);
+	std::vector <std::vector <float> > grain_arr (nbr_cells);
+	for (int c = 0; c < nbr_cells; ++c)
+	{
+		const auto     x = uint32_t (c & (cell_w - 1));
+		const auto     y = uint32_t (c >> cell_w_l2);
+		auto           rnd_state = UP::hash (seed + (y << 20) + (x << 8));
+		const auto     q         = UP::gen_poisson (rnd_state, lambda);
+		rnd_state += 2;
+		auto &         grain     = grain_arr [c];
+		grain.resize (q * 2);
+		for (int pos = 0; pos < q; ++pos)
+		{
+			grain [pos * 2    ] = UP::gen_uniform (rnd_state + pos * 2    );
+			grain [pos * 2 + 1] = UP::gen_uniform (rnd_state + pos * 2 + 1);
+		}
+	}
+	std::vector <double> cov_pos (sub * sub, 0);
+	double         cov_sum = 0;
+	for (int cy = 1; cy < cell_w - 1; ++cy)
+	{
+		for (int cx = 1; cx < cell_w - 1; ++cx)
+		{
+			for (int sy = 0; sy < sub; ++sy)
+			{
+				for (int sx = 0; sx < sub; ++sx)
+				{
+					const auto     px = (float (sx) + 0.5f) / float (sub);
+					const auto     py = (float (sy) + 0.5f) / float (sub);
+					bool           hit_flag = false;
+					for (int ny = -1; ny <= 1 && ! hit_flag; ++ny)
+					{
+						for (int nx = -1; nx <= 1 && ! hit_flag; ++nx)
+						{
+							const auto &   grain =
+								grain_arr [((cy + ny) << cell_w_l2) + cx + nx];
+							const int      q = int (grain.size ()) / 2;
+							for (int pos = 0; pos < q && ! hit_flag; ++pos)
+							{
+								const auto     dx = grain [pos * 2    ] + float (nx) - px;
+								const auto     dy = grain [pos * 2 + 1] + float (ny) - py;
+								hit_flag = (dx * dx + dy * dy < rad * rad);
+							}
+						}
+					}
+					if (hit_flag)
+					{
+						cov_pos [sy * sub + sx] += 1;
+						cov_sum += 1;
+					}
+				}
+			}
+		}
+	}
+	const auto     nbr_inner = fstb::sq (cell_w - 2);
+	const auto     cov_avg   = cov_sum / double (nbr_inner * sub * sub);
+	double         cov_dif   = 0;
+	for (auto &c : cov_pos)
+	{
+		c /= double (nbr_inner);
+		cov_dif = std::max (cov_dif, std::abs (c - 0.5));
+	}
+	check ("Grain coverage (0.5)", cov_avg, std::abs (cov_avg - 0.5) < 0.01);
+	check ("Coverage position bias", cov_dif, cov_dif < 0.05);
+
+	// Speed, informative only
+	typedef std::chrono::high_resolution_clock ClkType;
+	ClkType        clk;
+	constexpr int  nbr_spd = 1 << 22;
+	auto           vrnd    = fstb::Vu32 (0, 1, 2, 3);
+	auto           vsum    = fstb::Vf32::zero ();
+	const auto     t_beg   = clk.now ();
+	for (int k = 0; k < nbr_spd; k += simd_w)
+	{
+		vsum += UP::gen_uniform (vrnd);
+		vrnd += fstb::Vu32 (simd_w);
+	}
+	const auto     t_end   = clk.now ();
+	printf (
+		"Speed: %.3f ns/value (%f)\n\n",
+		get_duration_s (t_beg, t_end) * 1e9 / double (nbr_spd),
+		vsum.sum_h () / float (nbr_spd)
+	);
+
+	return nbr_err;
+}
+
+
+
 int main (int argc, char *argv [])
 {
 	fstb::unused (argc, argv);
@@ -391,6 +3020,24 @@ int main (int argc, char *argv [])
 		build_gaussian_distrib_2d (1'000);
 #endif
 
+#if 1
+		{
+			const auto     err_mul   =
+				test_prng_backend <fgrn::PrngHashMul> ("mul");
+			const auto     err_shift =
+				test_prng_backend <fgrn::PrngHashShift> ("shift");
+
+			// Only the backend actually used for the rendering has to pass
+			constexpr bool shift_flag = std::is_same <
+				fgrn::UtilPrng::HashType, fgrn::PrngHashShift
+			>::value;
+			if ((shift_flag ? err_shift : err_mul) != 0)
+			{
+				ret_val = -1;
+			}
+		}
+#endif
+
 #if 1
 		using UP = fgrn::UtilPrng;
 		Histogram      hist;
@@ -431,6 +3078,160 @@ int main (int argc, char *argv [])
 		hist.print ();
 #endif
 
+#if 1
+		if (test_stat_engine () != 0)
+		{
+			ret_val = -1;
+		}
+#endif
+
+#if 1
+		if (test_radius_dev () != 0)
+		{
+			ret_val = -1;
+		}
+#endif
+
+#if 1
+		if (test_joint_planes () != 0)
+		{
+			ret_val = -1;
+		}
+#endif
+
+#if 1
+		if (test_duplicate_planes () != 0)
+		{
+			ret_val = -1;
+		}
+#endif
+
+#if 1
+		if (test_density_split () != 0)
+		{
+			ret_val = -1;
+		}
+#endif
+
+#if 1
+		if (test_layers () != 0)
+		{
+			ret_val = -1;
+		}
+#endif
+
+#if 1
+		if (test_output_scale () != 0)
+		{
+			ret_val = -1;
+		}
+#endif
+
+#if 1
+		if (test_c_api () != 0)
+		{
+			ret_val = -1;
+		}
+#endif
+
+#if 1
+		if (test_spl_fmt () != 0)
+		{
+			ret_val = -1;
+		}
+#endif
+
+#if 1
+		if (test_transfer () != 0)
+		{
+			ret_val = -1;
+		}
+#endif
+
+#if 1
+		if (test_amount () != 0)
+		{
+			ret_val = -1;
+		}
+#endif
+
+#if 1
+		if (test_mask () != 0)
+		{
+			ret_val = -1;
+		}
+#endif
+
+#if 1
+		if (test_rect () != 0)
+		{
+			ret_val = -1;
+		}
+#endif
+
+#if 1
+		if (test_frame_format () != 0)
+		{
+			ret_val = -1;
+		}
+#endif
+
+#if fstb_SYS != fstb_SYS_WIN
+		if (test_shm_render () != 0)
+		{
+			ret_val = -1;
+		}
+#endif
+
+#if 1
+		if (test_temporal_reuse () != 0)
+		{
+			ret_val = -1;
+		}
+#endif
+
+#if 1
+		if (test_output_cache () != 0)
+		{
+			ret_val = -1;
+		}
+#endif
+
+#if 1
+		if (test_disk_cache () != 0)
+		{
+			ret_val = -1;
+		}
+#endif
+
+#if 1
+		if (test_filter_pool () != 0)
+		{
+			ret_val = -1;
+		}
+#endif
+
+#if 1
+		if (test_atlas () != 0)
+		{
+			ret_val = -1;
+		}
+#endif
+
+#if 1
+		if (test_atlas_seams () != 0)
+		{
+			ret_val = -1;
+		}
+#endif
+
+#if 1
+		if (test_render_stats () != 0)
+		{
+			ret_val = -1;
+		}
+#endif
+
 #if 0
 
 		const auto     c1203 = fstb::Vu32 (1, 2, 0, 3);
@@ -451,32 +3252,6 @@ int main (int argc, char *argv [])
 
 #endif
 
-#if 0
-		const int      w     = 256;
-		const auto     h     = w;
-		auto           pic_s = compose_pic (w, h);
-		auto           pic_d = pic_s;
-
-		using GG = fgrn::GenGrain;
-		GG             grain_gen;
-
-		typedef std::chrono::high_resolution_clock ClkType;
-		ClkType        clk;
-		const auto     t_beg = clk.now ();
-
-		const fgrn::VisionFilter   vf (0.35f, 1000, 0.025f, 0.0f);
-		grain_gen.process (pic_d.data (), pic_s.data (), w, h, w, h, vf, 12345);
-
-		const auto     t_end = clk.now ();
-		const auto     dur_s =
-			  double ((t_end - t_beg).count ())
-			* double (ClkType::period::num)
-			/ double (ClkType::period::den);
-		printf ("Duration: %.3f s\n", dur_s);
-
-		save_linear_pic (w, h, pic_d);
-#endif
-
 
 		/*** To do ***/
 